@@ -22,8 +22,9 @@
 // Trigger Input from ESP32 Main
 #define TRIGGER_PIN 13  // From ESP32 main GPIO 4
 
-// UART Output to ESP32 Main
-#define UART_TX_PIN 14   // U0TXD (Standard Serial TX) -> Connect to ESP32 Main GPIO 33
+// UART Output to ESP32 Main (status link, Serial1; Serial stays on USB for logs)
+#define UART_TX_PIN 14   // -> Connect to ESP32 Main GPIO 35
+#define UART_LINK_BAUD 921600  // Must match CAM_UART_BAUD on the main controller
 
 // Status LED
 #define STATUS_LED_PIN 33  // Built-in LED (usually GPIO 33 on AI Thinker)
@@ -57,18 +58,56 @@
 #define JPEG_QUALITY 12  // 0-63, lower is higher quality (12 = ~150KB)
 #define FB_COUNT 1  // Number of frame buffers
 
+// Thumbnail kept for the main controller to pull when WiFi is down
+#define THUMB_FRAME_SIZE FRAMESIZE_QQVGA  // 160x120, typically 3-5 KB
+#define THUMB_JPEG_QUALITY 20
+#define THUMB_MAX_BYTES 16384  // Must not exceed CAM_THUMB_MAX on the main controller
+
 // ==================== SPIFFS CONFIGURATION ====================
 #define SPIFFS_MAX_IMAGES 20  // Maximum queued images before deletion
 #define IMAGE_PREFIX "/capture_"
 #define IMAGE_EXTENSION ".jpg"
 
 // ==================== TIMING CONFIGURATION ====================
-#define WIFI_CONNECT_TIMEOUT_MS 10000  // WiFi connection timeout
+#define WIFI_CONNECT_TIMEOUT_MS 10000  // WiFi connection timeout (per network after a scan)
 #define SERVER_TIMEOUT_MS 10000  // HTTP request timeout (images are large)
+#define TLS_RECORD_BYTES 4096  // Request bytes per write(); the core's mbedTLS output record size
+#define RESUMABLE_CHUNK_BYTES 16384  // Bytes per PUT of a resumable upload; smaller queued images go in one request
+#define BATCH_UPLOAD_MAX_IMAGES 10  // Queued images per batch request
+#define BATCH_UPLOAD_MAX_BYTES 262144  // JPEG bytes per batch request (held in RAM while it is sent)
 #define NTP_SYNC_INTERVAL_MS 3600000  // Re-sync NTP every hour
 #define TRIGGER_DEBOUNCE_MS 100  // Debounce trigger input
 #define MIN_SIGNAL_STRENGTH -70  // Minimum WiFi RSSI for upload attempt
-#define HEARTBEAT_INTERVAL_MS 60000  // 1 minute heartbeat
+#define HEARTBEAT_INTERVAL_MS 60000  // 1 minute heartbeat (ESP-NOW telemetry; direct posts stretch, see liveness.h)
+#define LIVENESS_FAST_MS 15000  // Direct heartbeat interval during an incident or after failed requests
+#define LIVENESS_MAX_MS 300000  // Longest quiet interval until the backend advertises X-Heartbeat-Max
+#define LIVENESS_INCIDENT_HOLD_MS 600000  // Fast heartbeats for this long after a triggered capture
+#define TRACE_EXPORT_BATCH 32  // Trace records per export request (sent with the heartbeat)
+#define UART_ACK_TIMEOUT_MS 60  // Resend the status link window if the oldest frame is not acked
+#define UART_MAX_SENDS 5  // Then drop the window and resync
+#define RELAY_RTO_MS 60  // Resend an ESP-NOW relay fragment not acked within this
+#define RELAY_AIR_TIMEOUT_MS 20  // Assume a send finished if its callback never came
+#define RELAY_STALL_MS 15000  // Abandon a relay without progress (same on the main controller)
+#define RELAY_RESULT_TIMEOUT_MS 60000  // Wait for the forward result before keeping the SPIFFS copy
+#define TELEMETRY_ACK_TIMEOUT_MS 100  // Post the heartbeat directly if the main controller has not acked by then
+
+// ==================== WIFI CONNECT ====================
+// Reconnects go straight to the cached access point; a scan is the fallback (wifi_connector.h)
+// Networks tried after a scan, strongest first: { { "ssid", "password" }, ... }
+#define WIFI_NETWORKS { { WIFI_SSID, WIFI_PASSWORD } }
+#define WIFI_FAST_CONNECT_TIMEOUT_MS 3000  // Directed attempt to the cached BSSID and channel
+#define WIFI_IP_REUSE_MS 3600000  // Reuse the last DHCP lease statically within this long (same boot only)
+
+// ==================== RETRY POLICY ====================
+// Backoff with jitter and a circuit breaker per backend endpoint (retry_policy.h)
+#define EXPECT_CONTINUE_MIN_BYTES 32768  // Bodies this large wait for 100 Continue before going out (not resumable chunks)
+#define EXPECT_CONTINUE_WAIT_MS 1500  // Send the body anyway if the server stays silent this long
+#define IMAGE_RETRY_BASE_MS 5000  // Wait after a failed image upload, doubles per failure
+#define IMAGE_RETRY_MAX_MS 300000
+#define IMAGE_BREAKER_TRIP 3  // Failed uploads in a row that open the breaker (captures go to SPIFFS)
+#define IMAGE_BREAKER_OPEN_MS 600000  // No uploads for this long, then one probe
+#define WIFI_RETRY_BASE_MS 5000  // Wait after a failed connect round, doubles per failure; a drop retries at once
+#define WIFI_RETRY_MAX_MS 300000
 
 // ==================== STATUS LED PATTERNS ====================
 #define LED_BLINK_FAST 100  // Fast blink for activity
@@ -123,6 +123,49 @@ camera_fb_t* CameraHandler::captureImage() {
     return fb;
 }
 
+uint8_t* CameraHandler::captureThumbnail(size_t* len) {
+    *len = 0;
+    sensor_t* sensor = esp_camera_sensor_get();
+    if (!initialized || sensor == nullptr) {
+        return nullptr;
+    }
+    
+    sensor->set_framesize(sensor, THUMB_FRAME_SIZE);
+    sensor->set_quality(sensor, THUMB_JPEG_QUALITY);
+    
+    // The first frame after a size change can still be the old geometry
+    camera_fb_t* fb = esp_camera_fb_get();
+    if (fb) {
+        esp_camera_fb_return(fb);
+    }
+    fb = esp_camera_fb_get();
+    
+    uint8_t* jpeg = nullptr;
+    if (fb && fb->len <= THUMB_MAX_BYTES) {
+        jpeg = (uint8_t*)malloc(fb->len);
+        if (jpeg) {
+            memcpy(jpeg, fb->buf, fb->len);
+            *len = fb->len;
+        }
+    } else if (fb) {
+        Serial.printf("Thumbnail too large: %d bytes\n", fb->len);
+    }
+    if (fb) {
+        esp_camera_fb_return(fb);
+    }
+    
+    sensor->set_framesize(sensor, IMAGE_SIZE);
+    sensor->set_quality(sensor, JPEG_QUALITY);
+    
+    // Same for the next full-size capture
+    fb = esp_camera_fb_get();
+    if (fb) {
+        esp_camera_fb_return(fb);
+    }
+    
+    return jpeg;
+}
+
 void CameraHandler::releaseFrameBuffer(camera_fb_t* fb) {
     if (fb) {
         esp_camera_fb_return(fb);
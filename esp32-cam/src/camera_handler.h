@@ -21,6 +21,10 @@ public:
     
     bool begin();
     camera_fb_t* captureImage();
+    
+    // Small JPEG (THUMB_FRAME_SIZE) in a malloc'd buffer for the status
+    // link; the sensor is switched back to IMAGE_SIZE afterwards
+    uint8_t* captureThumbnail(size_t* len);
     void releaseFrameBuffer(camera_fb_t* fb);
     bool isInitialized();
 };
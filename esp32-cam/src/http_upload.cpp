@@ -5,13 +5,168 @@
 
 #include "http_upload.h"
 #include "config.h"
+#include "trace.h"
+#include <rom/crc.h>
+#include <mbedtls/md.h>
+
+#define UNCONFIRMED_MAGIC 0x55433031  // "UC01"
+
+// SHA-256 of an image; the ESP32 SHA peripheral does the work
+static void hashImage(const uint8_t* data, size_t len, uint8_t* hash) {
+    mbedtls_md(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), data, len, hash);
+}
+
+static void hashHex(const uint8_t* hash, char* hex) {
+    for (int i = 0; i < IMAGE_HASH_BYTES; i++) {
+        snprintf(hex + i * 2, 3, "%02x", hash[i]);
+    }
+}
+
+static const WiFiNetwork wifiNetworks[] = WIFI_NETWORKS;
 
 HTTPUploader::HTTPUploader(const char* url, const char* key) 
-    : serverUrl(url), apiKey(key) {
+    : apiKey(key), client(nullptr), lastWrite({ 0, 0, 0 }),
+      wifiConnector(wifiNetworks, sizeof(wifiNetworks) / sizeof(wifiNetworks[0]),
+                    { WIFI_FAST_CONNECT_TIMEOUT_MS, WIFI_CONNECT_TIMEOUT_MS, WIFI_IP_REUSE_MS,
+                      WIFI_RETRY_BASE_MS, WIFI_RETRY_MAX_MS }),
+      liveness({ HEARTBEAT_INTERVAL_MS, LIVENESS_FAST_MS, LIVENESS_MAX_MS,
+                 LIVENESS_INCIDENT_HOLD_MS }),
+      imageRetry("images", { IMAGE_RETRY_BASE_MS, IMAGE_RETRY_MAX_MS,
+                             IMAGE_BREAKER_TRIP, IMAGE_BREAKER_OPEN_MS }),
+      resumable(true), batching(true), replyLost(false), preflight(true), store(nullptr) {
+    reply[0] = '\0';
+    memset(&unconfirmed, 0, sizeof(unconfirmed));
+    if (!httpParseEndpoint(url, endpoint)) {
+        Serial.printf("Backend URL does not fit: %s\n", url);
+    }
+    
+    // The other endpoints hang off the image endpoint's parent
+    snprintf(apiBase, sizeof(apiBase), "%s", endpoint.path);
+    char* image = strstr(apiBase, "/image/image");
+    if (!image) {
+        image = strrchr(apiBase, '/');
+    }
+    if (image) {
+        *image = '\0';
+    }
+    
+    snprintf(boundary, sizeof(boundary), "----ESP32CAMBoundary%08lX", (unsigned long)esp_random());
+    snprintf(multipartType, sizeof(multipartType), "multipart/form-data; boundary=%s", boundary);
+    
+    secureClient.setInsecure(); // Skip certificate validation for simplicity/robustness
+    client = endpoint.secure ? (Client*)&secureClient : (Client*)&plainClient;
+}
+
+int HTTPUploader::request(const char* method, const char* prefix, const char* path,
+                          const char* contentType, const HttpHeader* headers, size_t headerCount,
+                          const HttpSlice* body, size_t count, HttpResponse& response) {
+    static uint8_t stage[TLS_RECORD_BYTES];  // loop() only
+    HttpSlice slices[UPLOAD_MAX_SLICES + 1];
+    lastWrite = { 0, 0, 0 };
+    response.status = -1;
+    reply[0] = '\0';
+    replyLost = false;
+    if (count > UPLOAD_MAX_SLICES) {
+        return -1;
+    }
+    size_t bodyLen = 0;
+    for (size_t i = 0; i < count; i++) {
+        bodyLen += body[i].len;
+    }
+    bool isHead = strcmp(method, "HEAD") == 0;
+    
+    char buf[384];
+    HttpRequestHead head(buf, sizeof(buf));
+    head.begin(method, endpoint, prefix, path);
+    head.header("User-Agent", "ESP32-CAM");
+    head.header("X-API-Key", apiKey);
+    if (contentType) {
+        head.header("Content-Type", contentType);
+    }
+    if (!isHead) {
+        head.header("Content-Length", (unsigned long)bodyLen);
+    }
+    head.header("Connection", "keep-alive");
+    // Images and chunks only go out once the backend has accepted the
+    // headers; a cold or failing backend costs a round trip, not the body
+    unsigned long continueWaitMs = 0;
+    if (bodyLen >= EXPECT_CONTINUE_MIN_BYTES) {
+        head.header("Expect", "100-continue");
+        continueWaitMs = EXPECT_CONTINUE_WAIT_MS;
+    }
+    for (size_t i = 0; i < headerCount; i++) {
+        head.header(headers[i].name, headers[i].value);
+    }
+    size_t headLen = head.finish();
+    if (headLen == 0) {
+        return -1;
+    }
+    
+    slices[0].data = head.data();
+    slices[0].len = headLen;
+    memcpy(slices + 1, body, count * sizeof(HttpSlice));
+    
+    HttpExchange x{};
+    x.timeoutMs = SERVER_TIMEOUT_MS;
+    x.continueWaitMs = continueWaitMs;
+    x.stage = stage;
+    x.stageLen = sizeof(stage);
+    x.hasBody = !isHead;
+    x.body = reply;
+    x.bodyCap = sizeof(reply);
+    
+    // A kept-alive connection the server closed while idle fails the
+    // first exchange; retry once on a fresh one
+    bool ok = false;
+    for (int attempt = 0; attempt < 2 && !ok; attempt++) {
+        bool reused = client->connected();
+        if (!reused) {
+            Serial.printf("Connecting to %s:%u...\n", endpoint.host, endpoint.port);
+            if (!client->connect(endpoint.host, endpoint.port)) {
+                Serial.println("Connection failed!");
+                return -1;
+            }
+        }
+        ok = httpExchange(*client, slices, count + 1, x, response);
+        lastWrite = x.stats;
+        // Sent in full but unanswered: the backend may have stored it
+        replyLost = x.sent && !ok;
+        if (!ok) {
+            client->stop();
+            if (!reused) {
+                break;
+            }
+        }
+    }
+    if (ok && x.bodySkipped) {
+        Serial.printf("Backend answered %d to the headers - %u-byte body not sent\n",
+                      response.status, (unsigned)bodyLen);
+    }
+    if (!ok) {
+        response.status = -1;
+        return -1;
+    }
+    if (!response.keepAlive) {
+        client->stop();
+    }
+    
+    if (response.heartbeatMaxS > 0) {
+        liveness.setServerMaxS(response.heartbeatMaxS);
+    }
+    if (response.status > 0 && contentType) {
+        wire.noteResponse(response.acceptPost[0] ? response.acceptPost : nullptr,
+                          response.status, contentType);
+    }
+    return response.status;
+}
+
+bool HTTPUploader::heartbeatDue() {
+    liveness.setLinkUp(isConnected());
+    return liveness.isDue();
 }
 
 bool HTTPUploader::connectWiFi() {
-    if (WiFi.status() == WL_CONNECTED) {
+    if (wifiConnector.isUp()) {
         return true;
     }
     
@@ -22,34 +177,16 @@ bool HTTPUploader::connectWiFi() {
 
     WiFi.mode(WIFI_STA);
     WiFi.setSleep(false); // Disable power saving for better stability
-    WiFi.disconnect();
-    delay(1000); // Increased delay for stability
     
-    WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
-    
-    unsigned long start = millis();
-    int lastStatus = -1;
-
-    while (WiFi.status() != WL_CONNECTED) {
-        if (millis() - start > WIFI_CONNECT_TIMEOUT_MS) {
-            Serial.println("\nWiFi connection failed!");
-            Serial.print("Final Status: ");
-            Serial.println(WiFi.status());
-            Serial.println("Reasons: 1=NoSSID, 4=Fail, 6=Disconnect");
-            return false;
-        }
-        
-        int currentStatus = WiFi.status();
-        if (currentStatus != lastStatus) {
-            Serial.printf("\nStatus changed: %d -> %d ", lastStatus, currentStatus);
-            lastStatus = currentStatus;
-        }
-        
-        delay(500);
-        Serial.print(".");
+    if (!wifiConnector.connect()) {
+        Serial.println("WiFi connection failed!");
+        Serial.print("Final Status: ");
+        Serial.println(WiFi.status());
+        Serial.println("Reasons: 1=NoSSID, 4=Fail, 6=Disconnect");
+        return false;
     }
     
-    Serial.println("\nWiFi connected!");
+    Serial.println("WiFi connected!");
     Serial.print("IP address: ");
     Serial.println(WiFi.localIP());
     Serial.printf("Channel: %d\n", WiFi.channel());
@@ -59,32 +196,54 @@ bool HTTPUploader::connectWiFi() {
 }
 
 bool HTTPUploader::isConnected() {
-    return WiFi.status() == WL_CONNECTED;
+    return wifiConnector.isUp();
 }
 
 int HTTPUploader::getSignalStrength() {
     return WiFi.RSSI();
 }
 
-String HTTPUploader::createMultipartBoundary() {
-    return "----ESP32CAMBoundary" + String(random(100000, 999999));
-}
-
-bool HTTPUploader::uploadImage(camera_fb_t* fb, unsigned long timestamp) {
+bool HTTPUploader::uploadImage(camera_fb_t* fb, unsigned long timestamp, uint32_t incidentId) {
     if (!fb) {
         Serial.println("No frame buffer provided");
         return false;
     }
     
-    return uploadImageFromBuffer(fb->buf, fb->len, timestamp);
+    return uploadImageFromBuffer(fb->buf, fb->len, timestamp, incidentId);
 }
 
-bool HTTPUploader::uploadImageFromBuffer(uint8_t* buffer, size_t size, unsigned long timestamp) {
+bool HTTPUploader::uploadImageFromBuffer(uint8_t* buffer, size_t size, unsigned long timestamp,
+                                         uint32_t incidentId) {
     if (!isConnected()) {
         Serial.println("WiFi not connected");
         return false;
     }
+    if (!admitImage()) {
+        return false;
+    }
+    return postImage(buffer, size, timestamp, incidentId);
+}
 
+// Counts for liveness and for the image retry policy
+void HTTPUploader::noteImageExchange(int status) {
+    liveness.noteExchange(status > 0 && status < 500);
+    imageRetry.noteResult(status);
+}
+
+// Every image entry point asks once; the answer must be followed by a
+// noteImageExchange() so a breaker probe is not left hanging
+bool HTTPUploader::admitImage() {
+    if (imageRetry.ready()) {
+        return true;
+    }
+    imageRetry.noteShed();
+    Serial.printf("Image upload skipped - backend retry in %lu s\n",
+                  imageRetry.msUntilReady() / 1000);
+    return false;
+}
+
+bool HTTPUploader::postImage(uint8_t* buffer, size_t size, unsigned long timestamp,
+                             uint32_t incidentId) {
     // Check signal strength
     int rssi = getSignalStrength();
     if (rssi < MIN_SIGNAL_STRENGTH) {
@@ -93,244 +252,477 @@ bool HTTPUploader::uploadImageFromBuffer(uint8_t* buffer, size_t size, unsigned
 
     Serial.printf("Uploading image to backend: %d bytes\n", size);
     
-    String boundary = createMultipartBoundary();
-    
-    // Construct multipart headers (but don't combine yet)
-    String head = "--" + boundary + "\r\n";
-    head += "Content-Disposition: form-data; name=\"file\"; filename=\"capture.jpg\"\r\n";
-    head += "Content-Type: image/jpeg\r\n\r\n";
-    
-    String tail = "\r\n--" + boundary + "--\r\n";
-    
-    size_t totalLen = head.length() + size + tail.length();
-    
-    // Use the underlying WiFiClient from HTTPClient isn't directly exposed for writing in a standard way
-    // reliably across all versions, so we'll use strict HTTPClient methods or
-    // manual WiFiClientSecure if we want to stream.
-    // simpler approach: The ESP32 HTTPClient library *does* support sending a stream,
-    // but constructing a stream from parts is hard.
-    //
-    // However, since we are using HTTPS, we should be careful with manual implementation.
-    // PlatformIO ESP32 usually allows `begin` then `addHeader` then... 
-    // actually, let's try to verify if we can do this:
-    // http.begin(url);
-    // http.addHeader(...);
-    // // The internal client is private. 
-    //
-    // OK, looking at standard valid ESP32 solutions for this:
-    // The "correct" way to avoid big buffer is to not use HTTPClient for the body, 
-    // OR use a custom Stream class. 
-    // 
-    // Let's implement a clean manual HTTPS POST using WiFiClientSecure.
-    // But I need to parse the URL (host, port, path).
-    // The URL is in config.h.
-    
-    // Parse URL
-    String urlStr = serverUrl;
-    String protocol = "https";
-    int port = 443;
-    String host;
-    String path;
-    
-    int doubleSlash = urlStr.indexOf("//");
-    if (doubleSlash != -1) {
-        protocol = urlStr.substring(0, doubleSlash - 1); // http or https
-        int nextSlash = urlStr.indexOf('/', doubleSlash + 2);
-        if (nextSlash != -1) {
-            host = urlStr.substring(doubleSlash + 2, nextSlash);
-            path = urlStr.substring(nextSlash);
-        } else {
-            host = urlStr.substring(doubleSlash + 2);
-            path = "/";
-        }
+    // Metadata fields go before the file so the backend can match the
+    // incident without buffering the image
+    char preamble[384];
+    int n = snprintf(preamble, sizeof(preamble),
+                     "--%s\r\n"
+                     "Content-Disposition: form-data; name=\"timestamp\"\r\n\r\n"
+                     "%lu\r\n",
+                     boundary, timestamp);
+    if (incidentId) {
+        n += snprintf(preamble + n, sizeof(preamble) - n,
+                      "--%s\r\n"
+                      "Content-Disposition: form-data; name=\"incident_id\"\r\n\r\n"
+                      "%08lX\r\n",
+                      boundary, (unsigned long)incidentId);
     }
-    
-    // Handle port in host
-    int colon = host.indexOf(':');
-    if (colon != -1) {
-        port = host.substring(colon + 1).toInt();
-        host = host.substring(0, colon);
-    } else {
-        if (protocol == "http") port = 80;
+    n += snprintf(preamble + n, sizeof(preamble) - n,
+                  "--%s\r\n"
+                  "Content-Disposition: form-data; name=\"file\"; filename=\"capture.jpg\"\r\n"
+                  "Content-Type: image/jpeg\r\n\r\n",
+                  boundary);
+    
+    char trailer[48];
+    int t = snprintf(trailer, sizeof(trailer), "\r\n--%s--\r\n", boundary);
+    
+    // The JPEG goes out straight from the caller's buffer
+    HttpSlice body[] = {
+        { (const uint8_t*)preamble, (size_t)n },
+        { buffer, size },
+        { (const uint8_t*)trailer, (size_t)t },
+    };
+    // The content hash makes a resend of the same frame harmless and lets
+    // the queue ask before resending (alreadyStored)
+    uint8_t hash[IMAGE_HASH_BYTES];
+    char hex[IMAGE_HASH_BYTES * 2 + 1];
+    hashImage(buffer, size, hash);
+    hashHex(hash, hex);
+    HttpHeader headers[] = { { "Idempotency-Key", hex } };
+    
+    HttpResponse response;
+    int status = request("POST", endpoint.path, "", multipartType, headers, 1, body, 3, response);
+    bool success = status == 200 || status == 201;
+    if (replyLost) {
+        rememberUnconfirmed(hash);
+        saveUnconfirmed();
     }
+    noteImageExchange(status);
     
-    WiFiClient* clientPtr;
-    WiFiClientSecure secureClient;
-    WiFiClient plainClient;
-    
-    if (protocol == "https") {
-        secureClient.setInsecure(); // Skip certificate validation for simplicity/robustness
-        clientPtr = &secureClient;
-    } else {
-        clientPtr = &plainClient;
+    Serial.printf("Upload response: %d (%u bytes in %u writes, %lu ms, %.1f KB/s)\n",
+                  status, (unsigned)lastWrite.bytes, lastWrite.writes, lastWrite.ms,
+                  lastWrite.ms ? lastWrite.bytes / 1.024f / lastWrite.ms : 0.0f);
+    Serial.println(success ? "Upload successful" : "Upload failed (HTTP code)");
+    return success;
+}
+
+// Resumable upload: create a session, PUT byte ranges, finalize
+// (docs/ESP32_CAM_FIRMWARE.md). Returns the create status; progress is
+// zeroed unless the reply named the session
+int HTTPUploader::createSession(const QueuedImage& image, const uint8_t* buffer, size_t size,
+                                uint32_t crc,
+                                UploadProgress& progress) {
+    progress = UploadProgress{};
+    char incident[9];
+    char crcHex[9];
+    uint8_t hash[IMAGE_HASH_BYTES];
+    char hex[IMAGE_HASH_BYTES * 2 + 1];
+    hashImage(buffer, size, hash);
+    hashHex(hash, hex);
+    snprintf(incident, sizeof(incident), "%08lX", (unsigned long)image.incidentId);
+    snprintf(crcHex, sizeof(crcHex), "%08lX", (unsigned long)crc);
+    
+    StaticJsonDocument<256> doc;
+    doc["timestamp"] = image.timestamp;
+    if (image.incidentId) {
+        doc["incident_id"] = incident;
     }
-    
-    Serial.printf("Connecting to %s:%d...\n", host.c_str(), port);
-    
-    if (!clientPtr->connect(host.c_str(), port)) {
-        Serial.println("Connection failed!");
+    doc["size"] = size;
+    doc["crc32"] = crcHex;
+    doc["sha256"] = hex;
+    char body[256];
+    size_t len = serializeJson(doc, body, sizeof(body));
+    
+    HttpSlice slice = { (const uint8_t*)body, len };
+    HttpResponse response;
+    int status = request("POST", apiBase, "/image/upload", "application/json",
+                         nullptr, 0, &slice, 1, response);
+    if ((status == 200 || status == 201) && response.location[0]) {
+        progress.size = size;
+        progress.crc = crc;
+        progress.committed = 0;
+        memcpy(progress.session, response.location, sizeof(progress.session));
+    }
+    return status;
+}
+
+bool HTTPUploader::uploadResumable(SPIFFSManager& store, const QueuedImage& image,
+                                   uint8_t* buffer, size_t size) {
+    if (!resumable || size <= RESUMABLE_CHUNK_BYTES) {
+        return uploadImageFromBuffer(buffer, size, image.timestamp, image.incidentId);
+    }
+    if (!isConnected() || !admitImage()) {
         return false;
     }
     
-    Serial.println("Sending chunks...");
-    
-    // Send Request Line
-    clientPtr->print("POST " + path + " HTTP/1.1\r\n");
-    clientPtr->print("Host: " + host + "\r\n");
-    clientPtr->print("User-Agent: ESP32-CAM\r\n");
-    clientPtr->print("X-API-Key: " + apiKey + "\r\n");
-    clientPtr->print("Content-Type: multipart/form-data; boundary=" + boundary + "\r\n");
-    clientPtr->print("Content-Length: " + String(totalLen) + "\r\n");
-    clientPtr->print("Connection: close\r\n\r\n");
-    
-    // Send Body chunks
-    clientPtr->print(head);
-    
-    // Send image in 1KB chunks
-    const size_t chunkSize = 1024;
-    size_t remaining = size;
-    size_t offset = 0;
-    
-    while (remaining > 0) {
-        size_t toWrite = (remaining > chunkSize) ? chunkSize : remaining;
-        clientPtr->write(buffer + offset, toWrite);
-        remaining -= toWrite;
-        offset += toWrite;
-        
-        // Use yield() to prevent WDT reset during long uploads
-        if (offset % 10240 == 0) yield(); 
+    uint32_t crc = crc32_le(0, buffer, size);
+    UploadProgress progress{};
+    HttpResponse response;
+    int status = -1;
+    bool resume = store.loadProgress(image.filename, progress) &&
+                  progress.size == size && progress.crc == crc;
+    
+    if (resume) {
+        // The server may be one chunk ahead of our record
+        status = request("HEAD", "", progress.session, nullptr, nullptr, 0,
+                         nullptr, 0, response);
+        if ((status == 200 || status == 204) && response.uploadOffset >= 0 &&
+            response.uploadOffset <= (long)size) {
+            progress.committed = response.uploadOffset;
+        } else if (status == 404 || status == 410) {
+            resume = false;  // Session expired on the server
+        } else {
+            noteImageExchange(status);
+            return false;
+        }
     }
-    
-    clientPtr->print(tail);
-    
-    // Read Response
-    unsigned long timeout = millis();
-    while (clientPtr->available() == 0) {
-        if (millis() - timeout > 10000) {
-            Serial.println("Timeout waiting for response");
-            clientPtr->stop();
+    if (!resume) {
+        status = createSession(image, buffer, size, crc, progress);
+        if (status == 404 || status == 405 || status == 501) {
+            Serial.printf("No resumable uploads on the backend (HTTP %d) - sending whole images\n",
+                          status);
+            resumable = false;
+            store.clearProgress(image.filename);
+            return postImage(buffer, size, image.timestamp, image.incidentId);
+        }
+        if (status != 200 && status != 201) {
+            noteImageExchange(status);
             return false;
         }
-        delay(10);
+        if (!progress.session[0]) {
+            // Nowhere to PUT the chunks
+            Serial.printf("Upload session created without a Location (HTTP %d)\n", status);
+            noteImageExchange(status);
+            return false;
+        }
+        store.saveProgress(image.filename, progress);
     }
     
-    Serial.println("Reading response...");
-    String responseLine = clientPtr->readStringUntil('\n');
-    Serial.println(responseLine); // HTTP/1.1 200 OK
+    Serial.printf("Resumable upload %s: %lu of %u bytes already on the server\n",
+                  progress.session, (unsigned long)progress.committed, size);
     
-    bool success = false;
-    if (responseLine.indexOf("200") != -1 || responseLine.indexOf("201") != -1) {
-        success = true;
+    while (progress.committed < size) {
+        size_t first = progress.committed;
+        size_t n = size - first;
+        if (n > RESUMABLE_CHUNK_BYTES) {
+            n = RESUMABLE_CHUNK_BYTES;
+        }
+        char range[48];
+        char chunkCrc[9];
+        snprintf(range, sizeof(range), "bytes %u-%u/%u",
+                 (unsigned)first, (unsigned)(first + n - 1), (unsigned)size);
+        snprintf(chunkCrc, sizeof(chunkCrc), "%08lX",
+                 (unsigned long)crc32_le(0, buffer + first, n));
+        HttpHeader headers[] = { { "Content-Range", range }, { "X-Content-CRC32", chunkCrc } };
+        HttpSlice slice = { buffer + first, n };
+        status = request("PUT", "", progress.session, "application/octet-stream",
+                         headers, 2, &slice, 1, response);
+        
+        // A bad CRC (400) or an offset the server did not expect (409)
+        // still reports where the server is; anything else ends the try
+        if (status <= 0 || response.uploadOffset < 0 || response.uploadOffset > (long)size) {
+            Serial.printf("Resumable upload stopped at %u/%u bytes (HTTP %d)\n",
+                          (unsigned)first, (unsigned)size, status);
+            noteImageExchange(status);
+            return false;
+        }
+        if ((size_t)response.uploadOffset <= first) {
+            Serial.printf("Chunk at %u rejected (HTTP %d)\n", (unsigned)first, status);
+            noteImageExchange(status);
+            return false;  // Kept; the next attempt starts with HEAD
+        }
+        progress.committed = response.uploadOffset;
+        store.saveProgress(image.filename, progress);
     }
     
-    // Read headers (skip)
-    while (clientPtr->connected()) {
-        String line = clientPtr->readStringUntil('\n');
-        if (line == "\r") break;
+    status = request("POST", progress.session, "/complete", nullptr, nullptr, 0,
+                     nullptr, 0, response);
+    noteImageExchange(status);
+    if (replyLost) {
+        uint8_t hash[IMAGE_HASH_BYTES];
+        hashImage(buffer, size, hash);
+        rememberUnconfirmed(hash);
+        saveUnconfirmed();
     }
-    
-    // Read body (optional, print it)
-    if (clientPtr->available()) {
-        String body = clientPtr->readString();
-        Serial.println("Response body: " + body);
+    if (status == 200 || status == 201) {
+        Serial.println("Resumable upload complete");
+        return true;
     }
-    
-    clientPtr->stop();
-    Serial.println(success ? "Upload successful" : "Upload failed (HTTP code)");
-    return success;
+    if (status == 404 || status == 409 || status == 410 || status == 422) {
+        // Server lost or could not verify the image: start over next time
+        store.clearProgress(image.filename);
+    }
+    Serial.printf("Resumable upload finalize failed (HTTP %d)\n", status);
+    return false;
 }
 
-bool HTTPUploader::sendHeartbeat(const char* deviceId, const char* status, const char* ip, const char* version) {
-    if (!isConnected()) {
-        return false;
+// POST <API base>/image/batch, multipart: a "manifest" JSON field listing
+// each image's name, timestamp and incident, then one "files" part per
+// image in the same order. Reply: {"results": [201, 500, ...]}.
+int HTTPUploader::uploadBatch(const QueuedImage* images, uint8_t* const* buffers, int count,
+                              int* results) {
+    static_assert(BATCH_UPLOAD_MAX_IMAGES * 2 + 2 <= UPLOAD_MAX_SLICES,
+                  "batch does not fit the request slices");
+    if (!batching || !isConnected() || count <= 0 || count > BATCH_UPLOAD_MAX_IMAGES) {
+        return 0;
     }
     
-    // Manual JSON construction
-    String payload = "{";
-    payload += "\"device_id\":\"" + String(deviceId) + "\",";
-    payload += "\"status\":\"" + String(status) + "\",";
-    payload += "\"ip_address\":\"" + String(ip) + "\",";
-    payload += "\"firmware_version\":\"" + String(version) + "\"";
-    payload += "}";
-    
-    // Parse URL from config
-    String urlStr = serverUrl;
-    String protocol = "https";
-    int port = 443;
-    String host;
-    String basePath; // The base path of the backend URL
-    
-    int doubleSlash = urlStr.indexOf("//");
-    if (doubleSlash != -1) {
-        protocol = urlStr.substring(0, doubleSlash - 1);
-        int nextSlash = urlStr.indexOf('/', doubleSlash + 2);
-        if (nextSlash != -1) {
-            host = urlStr.substring(doubleSlash + 2, nextSlash);
-            basePath = urlStr.substring(nextSlash);
-        } else {
-            host = urlStr.substring(doubleSlash + 2);
-            basePath = "/";
+    // loop() only; kept off its stack
+    static StaticJsonDocument<2048> doc;
+    static char manifest[2048];
+    static char preambles[BATCH_UPLOAD_MAX_IMAGES][192];
+    
+    static uint8_t hashes[BATCH_UPLOAD_MAX_IMAGES][IMAGE_HASH_BYTES];
+    
+    doc.clear();
+    JsonArray entries = doc.to<JsonArray>();
+    for (int i = 0; i < count; i++) {
+        char incident[9];
+        char hex[IMAGE_HASH_BYTES * 2 + 1];
+        snprintf(incident, sizeof(incident), "%08lX", (unsigned long)images[i].incidentId);
+        hashImage(buffers[i], images[i].size, hashes[i]);
+        hashHex(hashes[i], hex);
+        JsonObject entry = entries.createNestedObject();
+        entry["name"] = images[i].filename.c_str() + 1;  // Without the leading '/'
+        entry["timestamp"] = images[i].timestamp;
+        if (images[i].incidentId) {
+            entry["incident_id"] = incident;
         }
+        entry["sha256"] = hex;  // Copied into the document
     }
-    
-    // Clean base path (remove specific endpoint if present)
-    String fullPath = basePath;
-    int imageIdx = fullPath.indexOf("/image/image");
-    if (imageIdx != -1) {
-        fullPath = fullPath.substring(0, imageIdx) + "/device/heartbeat";
-    } else {
-        // Fallback: try to replace last segment
-         int lastSlash = fullPath.lastIndexOf('/');
-         if (lastSlash != -1) {
-            fullPath = fullPath.substring(0, lastSlash) + "/device/heartbeat";
-         }
+    int n = snprintf(manifest, sizeof(manifest),
+                     "--%s\r\n"
+                     "Content-Disposition: form-data; name=\"manifest\"\r\n"
+                     "Content-Type: application/json\r\n\r\n",
+                     boundary);
+    n += serializeJson(doc, manifest + n, sizeof(manifest) - n);
+    if (n + 1 >= (int)sizeof(manifest)) {
+        return 0;
     }
     
-    // Handle port in host
-    int colon = host.indexOf(':');
-    if (colon != -1) {
-        port = host.substring(colon + 1).toInt();
-        host = host.substring(0, colon);
-    } else {
-        if (protocol == "http") port = 80;
+    HttpSlice body[UPLOAD_MAX_SLICES];
+    size_t slices = 0;
+    body[slices++] = { (const uint8_t*)manifest, (size_t)n };
+    for (int i = 0; i < count; i++) {
+        // The CRLF ends the previous part
+        int p = snprintf(preambles[i], sizeof(preambles[i]),
+                         "\r\n--%s\r\n"
+                         "Content-Disposition: form-data; name=\"files\"; filename=\"%s\"\r\n"
+                         "Content-Type: image/jpeg\r\n\r\n",
+                         boundary, images[i].filename.c_str() + 1);
+        body[slices++] = { (const uint8_t*)preambles[i], (size_t)p };
+        body[slices++] = { buffers[i], images[i].size };
     }
+    char trailer[48];
+    int t = snprintf(trailer, sizeof(trailer), "\r\n--%s--\r\n", boundary);
+    body[slices++] = { (const uint8_t*)trailer, (size_t)t };
     
-    WiFiClient* clientPtr;
-    WiFiClientSecure secureClient;
-    WiFiClient plainClient;
+    if (!admitImage()) {
+        return 0;
+    }
+    HttpResponse response;
+    int status = request("POST", apiBase, "/image/batch", multipartType, nullptr, 0,
+                         body, slices, response);
+    noteImageExchange(status);
+    if (replyLost) {
+        for (int i = 0; i < count; i++) {
+            rememberUnconfirmed(hashes[i]);
+        }
+        saveUnconfirmed();
+    }
+    Serial.printf("Batch upload of %d images: HTTP %d (%u bytes in %u writes, %lu ms, %.1f KB/s)\n",
+                  count, status, (unsigned)lastWrite.bytes, lastWrite.writes, lastWrite.ms,
+                  lastWrite.ms ? lastWrite.bytes / 1.024f / lastWrite.ms : 0.0f);
+    
+    if (status == 404 || status == 405 || status == 501) {
+        Serial.println("No batch uploads on the backend - sending images one by one");
+        batching = false;
+        return -1;
+    }
+    if (status != 200 && status != 201 && status != 207) {
+        return 0;
+    }
     
-    if (protocol == "https") {
-        secureClient.setInsecure();
-        clientPtr = &secureClient;
-    } else {
-        clientPtr = &plainClient;
+    // Only images with a result of their own count as delivered
+    StaticJsonDocument<384> parsed;
+    if (deserializeJson(parsed, reply, response.bodyLen)) {
+        return 0;
+    }
+    JsonArray list = parsed["results"];
+    int got = 0;
+    for (JsonVariant v : list) {
+        if (got == count) {
+            break;
+        }
+        results[got++] = v.as<int>();
+    }
+    return got;
+}
+
+void HTTPUploader::begin(SPIFFSManager& queue) {
+    wifiConnector.begin();
+    store = &queue;
+    if (!store->loadUnconfirmed(&unconfirmed, sizeof(unconfirmed)) ||
+        unconfirmed.magic != UNCONFIRMED_MAGIC || unconfirmed.count > UNCONFIRMED_HASHES) {
+        memset(&unconfirmed, 0, sizeof(unconfirmed));
+        return;
+    }
+    // Records written as a ring may hold answered (all-zero) slots
+    static const uint8_t answered[IMAGE_HASH_BYTES] = {};
+    for (int i = unconfirmed.count - 1; i >= 0; i--) {
+        if (memcmp(unconfirmed.hashes[i], answered, IMAGE_HASH_BYTES) == 0) {
+            forgetUnconfirmed(i);
+        }
+    }
+    if (unconfirmed.count > 0) {
+        Serial.printf("%u uploads from before the reboot are unconfirmed - "
+                      "asking the backend before resending\n", unconfirmed.count);
+    }
+}
+
+void HTTPUploader::saveUnconfirmed() {
+    if (store) {
+        unconfirmed.magic = UNCONFIRMED_MAGIC;
+        store->saveUnconfirmed(&unconfirmed, sizeof(unconfirmed));
+    }
+}
+
+void HTTPUploader::rememberUnconfirmed(const uint8_t* hash) {
+    for (int i = 0; i < unconfirmed.count; i++) {
+        if (memcmp(unconfirmed.hashes[i], hash, IMAGE_HASH_BYTES) == 0) {
+            return;  // A resend whose reply was lost again
+        }
+    }
+    if (unconfirmed.count == UNCONFIRMED_HASHES) {
+        forgetUnconfirmed(0);  // The oldest goes; its resend stays harmless
+    }
+    memcpy(unconfirmed.hashes[unconfirmed.count++], hash, IMAGE_HASH_BYTES);
+}
+
+void HTTPUploader::forgetUnconfirmed(int slot) {
+    unconfirmed.count--;
+    memmove(unconfirmed.hashes[slot], unconfirmed.hashes[slot + 1],
+            (unconfirmed.count - slot) * IMAGE_HASH_BYTES);
+}
+
+// HEAD <API base>/image/by-hash/<sha256>: 200 = stored, 404 = not. Only
+// asked for images whose earlier reply was lost; others cannot be there.
+bool HTTPUploader::alreadyStored(const uint8_t* buffer, size_t size) {
+    if (!preflight || unconfirmed.count == 0 || !isConnected()) {
+        return false;
+    }
+    uint8_t hash[IMAGE_HASH_BYTES];
+    hashImage(buffer, size, hash);
+    int slot = -1;
+    for (int i = 0; i < unconfirmed.count && slot < 0; i++) {
+        if (memcmp(unconfirmed.hashes[i], hash, IMAGE_HASH_BYTES) == 0) {
+            slot = i;
+        }
+    }
+    if (slot < 0) {
+        return false;
     }
     
-    if (!clientPtr->connect(host.c_str(), port)) {
+    char path[16 + IMAGE_HASH_BYTES * 2];
+    snprintf(path, sizeof(path), "/image/by-hash/");
+    hashHex(hash, path + strlen(path));
+    HttpResponse response;
+    int status = request("HEAD", apiBase, path, nullptr, nullptr, 0, nullptr, 0, response);
+    liveness.noteExchange(status > 0 && status < 500);
+    if (status == 405 || status == 501) {
+        preflight = false;  // Resends stay harmless through Idempotency-Key
         return false;
     }
+    if (status == 200 || status == 404) {
+        forgetUnconfirmed(slot);  // Answered either way
+        saveUnconfirmed();
+    }
+    if (status == 200) {
+        Serial.printf("Backend already has %u-byte image %.16s... - not resending\n",
+                      (unsigned)size, path + 15);
+        return true;
+    }
+    return false;
+}
+
+bool HTTPUploader::sendHeartbeat(const char* deviceId, const char* status, const char* ip, const char* version) {
+    StaticJsonDocument<256> doc;
+    doc["device_id"] = deviceId;
+    doc["status"] = status;
+    doc["ip_address"] = ip;
+    doc["firmware_version"] = version;
+    doc["next_heartbeat_s"] = liveness.nextIntervalMs() / 1000;
+    
+    int httpCode = postDocument("/device/heartbeat", doc);
+    bool ok = httpCode == 200 || httpCode == 201;
+    liveness.noteHeartbeat(ok);
+    return ok;
+}
+
+int HTTPUploader::exportTraces(const char* deviceId) {
+    if (!isConnected()) {
+        return 0;
+    }
     
-    clientPtr->print("POST " + fullPath + " HTTP/1.1\r\n");
-    clientPtr->print("Host: " + host + "\r\n");
-    clientPtr->print("User-Agent: ESP32-CAM\r\n");
-    clientPtr->print("X-API-Key: " + apiKey + "\r\n");
-    clientPtr->print("Content-Type: application/json\r\n");
-    clientPtr->print("Content-Length: " + String(payload.length()) + "\r\n");
-    clientPtr->print("Connection: close\r\n\r\n");
-    clientPtr->print(payload);
-    
-    // Read response
-    unsigned long timeout = millis();
-    while (clientPtr->available() == 0) {
-        if (millis() - timeout > 5000) {
-            clientPtr->stop();
-            return false;
+    // loop() only; kept off its stack
+    static StaticJsonDocument<3072> doc;
+    TraceRecord records[TRACE_EXPORT_BATCH];
+    int exported = 0;
+    
+    while (tracer.depth() > 0) {
+        uint32_t startIndex;
+        int count = tracer.peek(records, TRACE_EXPORT_BATCH, startIndex);
+        
+        // Times are only comparable with the main controller's once an
+        // ESP-NOW trigger has provided the clock offset
+        doc.clear();
+        doc["device_id"] = deviceId;
+        doc["clock_synced"] = tracer.isClockSynced();
+        doc["dropped"] = tracer.getDropped();
+        JsonArray spans = doc.createNestedArray("spans");
+        for (int i = 0; i < count; i++) {
+            char incident[9];
+            snprintf(incident, sizeof(incident), "%08lX", (unsigned long)records[i].incidentId);
+            JsonArray span = spans.createNestedArray();
+            span.add(incident);
+            span.add(Tracer::pointName(records[i].point));
+            span.add(records[i].timeMs);
         }
-        delay(10);
+        
+        if (!postJson("/trace/batch", doc)) {
+            break;  // Keep them for the next heartbeat
+        }
+        tracer.consume(startIndex + count);
+        exported += count;
+    }
+    return exported;
+}
+
+bool HTTPUploader::postJson(const char* endpoint, const JsonDocument& doc) {
+    int status = postDocument(endpoint, doc);
+    liveness.noteExchange(status > 0 && status < 500);
+    return status == 200 || status == 201;
+}
+
+int HTTPUploader::postDocument(const char* endpoint, const JsonDocument& doc) {
+    static uint8_t body[2048];  // loop() only
+    bool msgpack = wire.useMsgPack();
+    size_t len = wire.serialize(doc, msgpack, body, sizeof(body));
+    if (len == 0) {
+        return -1;
+    }
+    return postBody(endpoint, WireFormat::contentType(msgpack), body, len);
+}
+
+// POST a body to <API base>/<endpoint>. Returns the HTTP status, or a
+// negative value if there was no reply.
+int HTTPUploader::postBody(const char* path, const char* contentType,
+                           const uint8_t* body, size_t len) {
+    if (!isConnected()) {
+        return -1;
     }
     
-    String responseLine = clientPtr->readStringUntil('\n');
-    clientPtr->stop();
-    
-    return (responseLine.indexOf("200") != -1);
+    HttpSlice slice = { body, len };
+    HttpResponse response;
+    return request("POST", apiBase, path, contentType, nullptr, 0, &slice, 1, response);
 }
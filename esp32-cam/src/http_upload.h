@@ -8,27 +8,113 @@
 
 #include <Arduino.h>
 #include <WiFi.h>
-#include <HTTPClient.h>
 #include <WiFiClientSecure.h>
 #include "esp_camera.h"
+#include "http_request.h"
+#include "spiffs_manager.h"
+#include "liveness.h"
+#include "retry_policy.h"
+#include "wire_format.h"
+#include "wifi_connector.h"
+
+// Body slices per request: batch manifest, preamble + JPEG per image, trailer
+#define UPLOAD_MAX_SLICES 24
+
+// Images sent in full whose reply never came; checked before a resend
+#define UNCONFIRMED_HASHES 16
+#define IMAGE_HASH_BYTES 32  // SHA-256
+
+// Persisted as-is through SPIFFSManager; a layout change needs a new magic
+struct UnconfirmedHashes {
+    uint32_t magic;
+    uint8_t count;
+    uint8_t unused;
+    uint8_t hashes[UNCONFIRMED_HASHES][IMAGE_HASH_BYTES];  // Packed, oldest first
+};
 
 class HTTPUploader {
 private:
-    String apiKey;
-    String serverUrl;
-    HTTPClient http;
+    const char* apiKey;
+    HttpEndpoint endpoint;          // BACKEND_URL, split once
+    char apiBase[HTTP_PATH_MAX];    // Its path without "/image/image"
+    char boundary[32];              // Multipart boundary, fixed per boot
+    char multipartType[64];         // Content-Type carrying it
+    WiFiClientSecure secureClient;
+    WiFiClient plainClient;
+    Client* client;                 // Kept open between requests
+    HttpWriteStats lastWrite;       // Of the most recent request
+    WiFiConnector wifiConnector;
+    LivenessScheduler liveness;
+    RetryPolicy imageRetry;         // Every image path; shed while backing off
+    WireFormat wire;
+    bool resumable;                 // Cleared once the backend turns sessions down
+    bool batching;                  // Cleared once the backend turns batches down
+    char reply[192];                // Start of the last response body
+    bool replyLost;                 // Last request went out in full, no reply came
+    bool preflight;                 // Cleared once the backend has no hash lookup
+    UnconfirmedHashes unconfirmed;
+    SPIFFSManager* store;           // Keeps unconfirmed across reboots; nullptr = RAM only
+    
+    void rememberUnconfirmed(const uint8_t* hash);  // In memory; saveUnconfirmed() persists
+    void forgetUnconfirmed(int slot);
+    void saveUnconfirmed();
+    void noteImageExchange(int status);
+    bool admitImage();
+    bool postImage(uint8_t* buffer, size_t size, unsigned long timestamp, uint32_t incidentId);
     
-    String createMultipartBoundary();
+    int createSession(const QueuedImage& image, const uint8_t* buffer, size_t size,
+                      uint32_t crc, UploadProgress& progress);
+    int postBody(const char* path, const char* contentType, const uint8_t* body, size_t len);
+    int postDocument(const char* endpoint, const JsonDocument& doc);
+    // One request with up to UPLOAD_MAX_SLICES body slices to prefix + path; contentType
+    // nullptr = none. Returns the status, negative if there was no reply.
+    int request(const char* method, const char* prefix, const char* path,
+                const char* contentType, const HttpHeader* headers, size_t headerCount,
+                const HttpSlice* body, size_t count, HttpResponse& response);
     
 public:
     HTTPUploader(const char* url, const char* key);
     
-    bool uploadImage(camera_fb_t* fb, unsigned long timestamp);
-    bool uploadImageFromBuffer(uint8_t* buffer, size_t size, unsigned long timestamp);
+    // incidentId 0 = capture not tied to an alert
+    bool uploadImage(camera_fb_t* fb, unsigned long timestamp, uint32_t incidentId = 0);
+    bool uploadImageFromBuffer(uint8_t* buffer, size_t size, unsigned long timestamp,
+                               uint32_t incidentId = 0);
+    // Queued image in RESUMABLE_CHUNK_BYTES ranges, continuing from the
+    // progress stored next to it; plain upload if the backend has no sessions
+    bool uploadResumable(SPIFFSManager& store, const QueuedImage& image,
+                         uint8_t* buffer, size_t size);
+    // Several queued images in one request; results[i] is the backend's
+    // status for images[i]. Returns how many results came back, 0 if the
+    // request failed, -1 if the backend has no batch endpoint.
+    int uploadBatch(const QueuedImage* images, uint8_t* const* buffers, int count, int* results);
+    // True if this image went out in full before without a reply and the
+    // backend confirms it has it (HEAD by content hash); then no resend
+    bool alreadyStored(const uint8_t* buffer, size_t size);
+    bool batchEnabled() const { return batching; }
+    // False while image uploads are backing off or the breaker is open;
+    // uploads tried anyway return false at once without sending
+    bool imagesReady() const { return imageRetry.msUntilReady() == 0; }
+    unsigned long msUntilImagesReady() const { return imageRetry.msUntilReady(); }
+    void noteLinkUp() { imageRetry.reset(); }
+    void printRetryStats() const { imageRetry.printStats(); }
+    // Cached access point from NVS; unconfirmed uploads from the queue
+    void begin(SPIFFSManager& queue);
+    // Setup only; later reconnects run in pollWiFi() without blocking
     bool connectWiFi();
     bool isConnected();
+    WiFiLinkChange pollWiFi() { return wifiConnector.poll(); }
+    WiFiLinkSnapshot getWiFiLink() const { return wifiConnector.snapshot(); }
     int getSignalStrength();
+    // JSON or MessagePack, whichever the backend accepts (wire_format.h)
+    bool postJson(const char* endpoint, const JsonDocument& doc);
     bool sendHeartbeat(const char* deviceId, const char* status, const char* ip, const char* version);
+    // Only when no upload or other request has reached the backend lately
+    bool heartbeatDue();
+    void noteIncident() { liveness.noteIncident(); }
+    void printLiveness() const { liveness.printStats("Backend"); }
+    void printWireStats() const { wire.printStats("Backend"); }
+    void printWiFiStats() const { wifiConnector.printStats("Backend"); }
+    int exportTraces(const char* deviceId);  // Returns records sent
 };
 
 #endif // HTTP_UPLOAD_H
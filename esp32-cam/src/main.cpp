@@ -16,6 +16,7 @@
 #include "ntp_sync.h"
 #include "spiffs_manager.h"
 #include "http_upload.h"
+#include "retry_policy.h"
 
 // Global objects
 CameraHandler camera;
@@ -30,17 +31,29 @@ unsigned long lastCaptureTime = 0; // Added for cooldown
 unsigned long lastQueueCheckTime = 0;
 unsigned long lastHeartbeatTime = 0;
 const unsigned long TRIGGER_COOLDOWN = 5000;  // 5 seconds between captures
-const unsigned long QUEUE_CHECK_INTERVAL = 30000;  // Check queue every 30 seconds
+const unsigned long QUEUE_CHECK_INTERVAL = 30000;  // Relay offers; queue retries not paced by a failure
+
+// Queue drains follow the uploader's retry policy rather than a fixed timer
+static bool queuePending = true;  // SPIFFS may hold images
+static unsigned long nextDrainAt = 0;
 
 #include <esp_now.h>
+#include "espnow_protocol.h"
+#include "trace.h"
+#include "status_link.h"
+#include "relay_sender.h"
+#include "telemetry_sender.h"
 
-// Data structure for ESP-NOW
-typedef struct struct_message {
-  char a[32];
-  int command; // 1 = Trigger
-} struct_message;
+// Last ESP-NOW trigger, to ignore retransmits of a trigger already acked
+volatile uint32_t triggerIncidentId = 0;
+static uint16_t lastTriggerSeq = 0;
+static bool haveTriggerSeq = false;
 
-struct_message myData;
+// Counters for the heartbeat (loop() only)
+static uint32_t captureCount = 0;
+static uint32_t captureFailures = 0;
+static uint32_t uploadCount = 0;
+static uint32_t uploadFailures = 0;
 
 // Interrupt handler for trigger signal
 void IRAM_ATTR onTriggerReceived() {
@@ -53,12 +66,75 @@ void IRAM_ATTR onTriggerReceived() {
     }
 }
 
-// Callback when data is received via ESP-NOW
+// Callback when data is received via ESP-NOW.
+// Acks go out from here, not from loop(): loop() may be busy uploading
+// for seconds and the main controller falls back to the wire pulse after
+// a few tens of ms without an ack.
+static void addPeer(const uint8_t* mac) {
+  if (!esp_now_is_peer_exist(mac)) {
+    esp_now_peer_info_t peerInfo;
+    memset(&peerInfo, 0, sizeof(peerInfo));
+    memcpy(peerInfo.peer_addr, mac, 6);
+    peerInfo.channel = 0;
+    peerInfo.encrypt = false;
+    esp_now_add_peer(&peerInfo);
+  }
+}
+
 void OnDataRecv(const uint8_t * mac, const uint8_t *incomingData, int len) {
-  memcpy(&myData, incomingData, sizeof(myData));
-  if (myData.command == 1) {
-    triggerReceived = true; // Use same flag as physical trigger
+  unsigned long receivedAt = millis();
+  EspNowHeader header;
+  if (!espnowDecode(incomingData, len, header)) {
+    return;
+  }
+
+  // Reverse path of the UART status link
+  if (header.type == FRAME_LINK_ACK) {
+    statusLink.onAck((uint8_t)header.seq);
+    return;
+  }
+  if (header.type == FRAME_THUMB_REQUEST) {
+    statusLink.onThumbRequest(header.incidentId);
+    return;
+  }
+  if (header.type == FRAME_RELAY_REQUEST || header.type == FRAME_FRAGMENT_ACK ||
+      header.type == FRAME_RELAY_RESULT) {
+    relaySender.onFrame(header, incomingData + sizeof(EspNowHeader));
+    return;
+  }
+  if (header.type == FRAME_TELEMETRY_ACK) {
+    // Also teaches us the main controller's MAC before any trigger
+    addPeer(mac);
+    relaySender.setPeer(mac);
+    telemetrySender.setPeer(mac);
+    telemetrySender.onAck(header, incomingData + sizeof(EspNowHeader));
+    return;
+  }
+  if (header.type != FRAME_TRIGGER) {
+    return;
+  }
+
+  addPeer(mac);
+
+  // Ack every copy, including retransmits - the ack carries the trigger's seq
+  uint8_t ack[sizeof(EspNowHeader) + ESPNOW_CRC_SIZE];
+  size_t ackLen = espnowEncode(ack, sizeof(ack), FRAME_ACK, header.seq, header.incidentId);
+  esp_now_send(mac, ack, ackLen);
+
+  if (haveTriggerSeq && header.seq == lastTriggerSeq) {
+    return;  // Retransmit: our earlier ack was lost
   }
+  lastTriggerSeq = header.seq;
+  haveTriggerSeq = true;
+  relaySender.setPeer(mac);  // Where relay offers go
+  telemetrySender.setPeer(mac);
+
+  // First copy only: a retransmit's timestamp is older than its arrival.
+  // Air time (~1 ms) is ignored.
+  tracer.setClockOffset((int32_t)(header.timestamp - receivedAt));
+  tracer.recordAt(TP_ESPNOW_RECV, header.incidentId, receivedAt);
+  triggerIncidentId = header.incidentId;
+  triggerReceived = true; // Use same flag as physical trigger
 }
 
 
@@ -74,9 +150,82 @@ void blinkLED(int pin, int times, int delayMs) {
     }
 }
 
-void uploadQueuedImages() {
+// Batches first: queued images with no resumable upload in progress go
+// several to a request, up to the byte budget. Whatever a batch does not
+// deliver, and every image once batching stops, goes one at a time.
+static int uploadQueuedBatches(QueuedImage* images, int count, bool* done, size_t& bytes) {
+    int uploaded = 0;
+    int next = 0;
+    while (uploader.batchEnabled() && uploader.isConnected() && next < count) {
+        const QueuedImage* batch[BATCH_UPLOAD_MAX_IMAGES];
+        int picked[BATCH_UPLOAD_MAX_IMAGES];
+        int n = 0;
+        size_t budget = 0;
+        UploadProgress progress;
+        for (; next < count && n < BATCH_UPLOAD_MAX_IMAGES; next++) {
+            QueuedImage& image = images[next];
+            if (spiffsManager.loadProgress(image.filename, progress) ||
+                image.size > BATCH_UPLOAD_MAX_BYTES) {
+                continue;  // Left to the one-by-one pass
+            }
+            if (budget + image.size > BATCH_UPLOAD_MAX_BYTES) {
+                break;
+            }
+            budget += image.size;
+            batch[n] = &image;
+            picked[n++] = next;
+        }
+        if (n == 0) {
+            break;
+        }
+        
+        // Load them; one that cannot be read is left for the next pass
+        QueuedImage loaded[BATCH_UPLOAD_MAX_IMAGES];
+        uint8_t* buffers[BATCH_UPLOAD_MAX_IMAGES];
+        int indexes[BATCH_UPLOAD_MAX_IMAGES];
+        int m = 0;
+        for (int i = 0; i < n; i++) {
+            size_t size = 0;
+            if (!spiffsManager.readImage(batch[i]->filename, &buffers[m], &size)) {
+                continue;
+            }
+            if (uploader.alreadyStored(buffers[m], size)) {
+                spiffsManager.deleteImage(batch[i]->filename);
+                done[picked[i]] = true;
+                free(buffers[m]);
+                continue;
+            }
+            loaded[m] = *batch[i];
+            loaded[m].size = size;
+            indexes[m++] = picked[i];
+        }
+        
+        int results[BATCH_UPLOAD_MAX_IMAGES];
+        for (int i = 0; i < m; i++) {
+            tracer.record(TP_UPLOAD_START, tracer.isClockSynced() ? loaded[i].incidentId : 0);
+        }
+        int got = m > 0 ? uploader.uploadBatch(loaded, buffers, m, results) : 0;
+        for (int i = 0; i < m; i++) {
+            if (i < got && (results[i] == 200 || results[i] == 201)) {
+                tracer.record(TP_UPLOAD_END, tracer.isClockSynced() ? loaded[i].incidentId : 0);
+                spiffsManager.deleteImage(loaded[i].filename);
+                done[indexes[i]] = true;
+                bytes += loaded[i].size;
+                uploaded++;
+            }
+            free(buffers[i]);
+        }
+        if (got <= 0) {
+            break;  // Link or backend trouble: the one-by-one pass resumes
+        }
+    }
+    return uploaded;
+}
+
+// Returns the number of images still queued
+int uploadQueuedImages() {
     if (!uploader.isConnected()) {
-        return;
+        return spiffsManager.getQueuedImageCount();
     }
     
     int count = 0;
@@ -84,12 +233,29 @@ void uploadQueuedImages() {
     
     if (count == 0) {
         Serial.println("No queued images to upload");
-        return;
+        delete[] images;
+        return 0;
     }
     
     Serial.printf("Found %d queued images, attempting upload...\n", count);
+    unsigned long drainStart = millis();
+    size_t drainBytes = 0;
+    bool* done = new bool[count]();
+    int uploaded = uploadQueuedBatches(images, count, done, drainBytes);
+    if (uploaded > 0) {
+        blinkLED(STATUS_LED_PIN, 2, 100);
+    }
     
     for (int i = 0; i < count; i++) {
+        if (done[i] || !uploader.isConnected()) {
+            continue;
+        }
+        if (!uploader.imagesReady()) {
+            // Backing off after a failure: the rest waits for the retry
+            Serial.printf("Backend retry in %lu s - leaving the rest queued\n",
+                          uploader.msUntilImagesReady() / 1000);
+            break;
+        }
         Serial.printf("Uploading queued image: %s (%d bytes)\n", 
                      images[i].filename.c_str(), images[i].size);
         
@@ -97,9 +263,19 @@ void uploadQueuedImages() {
         size_t size = 0;
         
         if (spiffsManager.readImage(images[i].filename, &buffer, &size)) {
-            if (uploader.uploadImageFromBuffer(buffer, size, images[i].timestamp)) {
+            // Before the first trigger there is no offset to the main clock
+            uint32_t traceId = tracer.isClockSynced() ? images[i].incidentId : 0;
+            tracer.record(TP_UPLOAD_START, traceId);
+            if (uploader.alreadyStored(buffer, size)) {
+                spiffsManager.deleteImage(images[i].filename);
+                done[i] = true;
+            } else if (uploader.uploadResumable(spiffsManager, images[i], buffer, size)) {
+                tracer.record(TP_UPLOAD_END, traceId);
                 Serial.println("✓ Queued image uploaded successfully");
                 spiffsManager.deleteImage(images[i].filename);
+                done[i] = true;
+                drainBytes += size;
+                uploaded++;
                 
                 // Blink to confirm
                 blinkLED(STATUS_LED_PIN, 2, 100);
@@ -109,15 +285,126 @@ void uploadQueuedImages() {
             
             free(buffer);
         }
-        
-        delay(1000);  // Small delay between uploads
     }
     
+    unsigned long drainMs = millis() - drainStart;
+    Serial.printf("Queue drain: %d of %d images, %u bytes in %lu ms (%.1f KB/s)\n",
+                  uploaded, count, (unsigned)drainBytes, drainMs,
+                  drainMs ? drainBytes / 1.024f / drainMs : 0.0f);
+    
+    int left = 0;
+    for (int i = 0; i < count; i++) {
+        left += done[i] ? 0 : 1;
+    }
+    delete[] done;
+    delete[] images;
+    return left;
+}
+
+// Image relay: without WiFi, offer queued images to the main controller,
+// which forwards them over its own link (relay_sender.h)
+static bool findQueuedImage(uint32_t incidentId, QueuedImage& found) {
+    int count = 0;
+    QueuedImage* images = spiffsManager.getQueuedImages(count);
+    bool ok = false;
+    for (int i = 0; i < count && !ok; i++) {
+        if (images[i].incidentId != 0 &&
+            (incidentId == 0 || images[i].incidentId == incidentId)) {
+            found = images[i];
+            ok = true;
+        }
+    }
     delete[] images;
+    return ok;
 }
 
-void captureAndUpload() {
+void offerQueuedImage() {
+    QueuedImage image;
+    if (relaySender.busy() || !relaySender.hasPeer() || !findQueuedImage(0, image)) {
+        return;
+    }
+    uint16_t thumbLen = 0;
+    statusLink.thumbnailFor(image.incidentId, thumbLen);
+    relaySender.offer(image.incidentId, image.size, thumbLen);
+}
+
+void serviceRelay() {
+    uint32_t incidentId;
+    uint8_t kind;
+    QueuedImage image;
+    if (relaySender.takeRequest(incidentId, kind)) {
+        uint8_t* data = nullptr;
+        size_t size = 0;
+        if (kind == RELAY_THUMB) {
+            uint16_t thumbLen = 0;
+            const uint8_t* thumb = statusLink.thumbnailFor(incidentId, thumbLen);
+            // Copy: a new capture may replace the thumbnail mid-transfer
+            if (thumb && (data = (uint8_t*)malloc(thumbLen)) != nullptr) {
+                memcpy(data, thumb, thumbLen);
+                size = thumbLen;
+            }
+        } else if (findQueuedImage(incidentId, image)) {
+            spiffsManager.readImage(image.filename, &data, &size);
+        }
+        if (data) {
+            relaySender.start(incidentId, kind, data, size);
+        }
+    }
+
+    bool forwarded;
+    // A forwarded thumbnail leaves the full image queued
+    if (relaySender.takeResult(incidentId, forwarded, kind) && forwarded &&
+        kind == RELAY_FULL && findQueuedImage(incidentId, image)) {
+        spiffsManager.deleteImage(image.filename);
+        Serial.printf("Relayed image %08lX forwarded - removed from queue\n",
+                      (unsigned long)incidentId);
+    }
+
+    relaySender.poll();
+}
+
+// incidentId comes from the ESP-NOW trigger; 0 for wire triggers and the boot test
+// Our own HTTPS heartbeat; only when the main controller cannot post it
+// and no other request has reached the backend lately
+void sendDirectHeartbeat() {
+    if (!uploader.heartbeatDue()) {
+        Serial.println("✓ Heartbeat covered by recent backend traffic");
+        return;
+    }
+    Serial.println("Sending heartbeat...");
+    if (uploader.sendHeartbeat("ESP32_CAM", "online", WiFi.localIP().toString().c_str(), "v2.0")) {
+        Serial.println("✓ Heartbeat sent");
+    } else {
+        Serial.println("✗ Heartbeat failed");
+    }
+}
+
+bool sendTelemetry() {
+    WiFiLinkSnapshot link = uploader.getWiFiLink();
+    CamTelemetry report = {};
+    report.uptimeS = millis() / 1000;
+    report.ip = link.ip;  // Both 0 while down
+    report.rssi = link.rssi;
+    int queued = spiffsManager.getQueuedImageCount();
+    report.queueDepth = queued > 255 ? 255 : queued;
+    report.freeHeap = ESP.getFreeHeap();
+    report.captures = captureCount;
+    report.captureFailures = captureFailures;
+    report.uploads = uploadCount;
+    report.uploadFailures = uploadFailures;
+    report.linkFrames = statusLink.getFramesSent();
+    report.linkRetransmits = statusLink.getRetransmits();
+    report.linkDropped = statusLink.getDropped();
+    report.traceDropped = tracer.getDropped();
+    strncpy(report.firmware, "v2.0", sizeof(report.firmware));
+    return telemetrySender.send(report);
+}
+
+void captureAndUpload(uint32_t incidentId = 0) {
     Serial.println("\n========== CAPTURE TRIGGERED ==========");
+    if (incidentId) {
+        Serial.printf("Incident: %08lX\n", (unsigned long)incidentId);
+    }
     
     // Blink LED rapidly during capture
     blinkLED(STATUS_LED_PIN, 3, 50);
@@ -132,27 +419,61 @@ void captureAndUpload() {
     Serial.printf("Timestamp: %lu\n", timestamp);
     
     // Capture image
+    tracer.record(TP_SHUTTER, incidentId);
+    unsigned long captureStart = millis();
     camera_fb_t* fb = camera.captureImage();
     
+    CaptureReport capture = {};
+    capture.captureMs = millis() - captureStart;
+    
+    captureCount++;
+    if (incidentId) {
+        uploader.noteIncident();
+    }
     if (!fb) {
+        captureFailures++;
         Serial.println("✗ Image capture failed!");
+        statusLink.sendCaptureReport(incidentId, capture);
         
         // Error blink pattern
         blinkLED(STATUS_LED_PIN, 5, 50);
         return;
     }
     
+    tracer.record(TP_JPEG_READY, incidentId);
     Serial.printf("Image captured: %d bytes\n", fb->len);
+    capture.ok = 1;
+    capture.jpegBytes = fb->len;
     
     // Attempt upload to backend
     bool uploaded = false;
-    
-    if (uploader.isConnected()) {
+    bool online = uploader.isConnected();
+    UploadReport upload = {};
+    upload.result = UPLOAD_RESULT_OFFLINE;
+    
+    if (online && !uploader.imagesReady()) {
+        // Backend failing lately: straight to the queue, which retries
+        // when the backoff (or the open breaker) ends
+        Serial.printf("Backend retry in %lu s - saving to SPIFFS\n",
+                      uploader.msUntilImagesReady() / 1000);
+        upload.result = UPLOAD_RESULT_FAILED;
+        uploadFailures++;
+    } else if (online) {
         Serial.println("WiFi connected - uploading to backend...");
         
-        uploaded = uploader.uploadImage(fb, timestamp);
+        tracer.record(TP_UPLOAD_START, incidentId);
+        unsigned long uploadStart = millis();
+        uploaded = uploader.uploadImage(fb, timestamp, incidentId);
+        if (uploaded) {
+            uploadCount++;
+        } else {
+            uploadFailures++;
+        }
+        upload.uploadMs = millis() - uploadStart;
+        upload.result = uploaded ? UPLOAD_RESULT_OK : UPLOAD_RESULT_FAILED;
         
         if (uploaded) {
+            tracer.record(TP_UPLOAD_END, incidentId);
             Serial.println("✓ Image uploaded to backend successfully!");
             
             // Success blink pattern
@@ -165,8 +486,11 @@ void captureAndUpload() {
     }
     
     // Save to SPIFFS if upload failed or offline
+    bool queued = false;
     if (!uploaded) {
-        if (spiffsManager.saveImage(fb, timestamp)) {
+        queued = spiffsManager.saveImage(fb, timestamp, incidentId);
+        if (queued) {
+            queuePending = true;
             Serial.println("✓ Image queued in SPIFFS for later upload");
             
             // Offline mode blink pattern (3 rapid blinks)
@@ -182,6 +506,26 @@ void captureAndUpload() {
     // Release frame buffer
     camera.releaseFrameBuffer(fb);
     
+    // Without WiFi the main controller may still reach the backend over
+    // GPRS; keep a thumbnail it can pull over the status link
+    if (!online && incidentId) {
+        size_t thumbLen = 0;
+        uint8_t* thumb = camera.captureThumbnail(&thumbLen);
+        if (thumb) {
+            statusLink.setThumbnail(incidentId, thumb, thumbLen);
+            capture.thumbBytes = thumbLen;
+            Serial.printf("Thumbnail held for pull: %u bytes\n", (unsigned)thumbLen);
+        }
+    }
+    
+    upload.queued = spiffsManager.getQueuedImageCount();
+    statusLink.sendCaptureReport(incidentId, capture);
+    statusLink.sendUploadReport(incidentId, upload);
+    
+    if (queued && incidentId) {
+        relaySender.offer(incidentId, capture.jpegBytes, capture.thumbBytes);
+    }
+    
     Serial.println("======================================\n");
 }
 
@@ -197,6 +541,8 @@ void setup() {
     Serial.println("ESP32-CAM Burglary Alert System");
     Serial.println("==================================");
     
+    statusLink.begin(UART_TX_PIN, UART_LINK_BAUD);
+    
     // Initialize status LED
     pinMode(STATUS_LED_PIN, OUTPUT);
     digitalWrite(STATUS_LED_PIN, LOW);
@@ -250,6 +596,7 @@ void setup() {
     
     // Connect to WiFi
     Serial.println("\n--- WiFi Setup ---");
+    uploader.begin(spiffsManager);
     
     int retryCount = 0;
     while (!uploader.connectWiFi() && retryCount < 3) {
@@ -271,7 +618,7 @@ void setup() {
 
         // Check for queued images
         Serial.println("\n--- Checking Image Queue ---");
-        uploadQueuedImages();
+        queuePending = uploadQueuedImages() > 0;
 
         // Boot test: capture one snapshot and send to backend (verifies camera + WiFi + backend)
         Serial.println("\n--- Boot Test: Capture & Upload ---");
@@ -289,6 +636,8 @@ void setup() {
     } else {
       Serial.println("ESP-NOW Initialized");
       esp_now_register_recv_cb(OnDataRecv);
+      relaySender.begin();
+      telemetrySender.begin();
     }
 
     
@@ -313,66 +662,89 @@ void loop() {
     // Handle trigger
     if (triggerReceived) {
         triggerReceived = false;  // Reset flag
+        uint32_t incidentId = triggerIncidentId;
+        triggerIncidentId = 0;  // A later wire trigger must not inherit it
         
         unsigned long now = millis();
         
         // Check cooldown
         if (now - lastCaptureTime >= TRIGGER_COOLDOWN) {
-            captureAndUpload();
+            captureAndUpload(incidentId);
             lastCaptureTime = now;
         } else {
             Serial.println("Trigger ignored - cooldown active");
         }
     }
     
-    // Periodic queue upload check
+    // Queue upload: as soon as the image retry policy allows. Images
+    // left over without a failed upload (unreadable, skipped) wait for
+    // the slow timer instead of being retried on every pass.
     unsigned long now = millis();
+    if (uploader.isConnected() && queuePending && (long)(now - nextDrainAt) >= 0 &&
+        uploader.imagesReady()) {
+        queuePending = uploadQueuedImages() > 0;
+        now = millis();
+        nextDrainAt = queuePending && uploader.imagesReady() ? now + QUEUE_CHECK_INTERVAL : now;
+    }
     if (now - lastQueueCheckTime > QUEUE_CHECK_INTERVAL) {
         lastQueueCheckTime = now;
-        
-        if (uploader.isConnected()) {
-            int queuedCount = spiffsManager.getQueuedImageCount();
-            
-            if (queuedCount > 0) {
-                Serial.printf("Periodic check: %d images in queue\n", queuedCount);
-                uploadQueuedImages();
-            }
+        if (!uploader.isConnected()) {
+            offerQueuedImage();  // The main controller may still have a link
         }
     }
     
-    // Periodic Heartbeat
+    // Periodic Heartbeat: the main controller posts it with its own
     if (now - lastHeartbeatTime > HEARTBEAT_INTERVAL_MS) {
         lastHeartbeatTime = now;
-        if (uploader.isConnected()) {
-            Serial.println("Sending heartbeat...");
-            if (uploader.sendHeartbeat("ESP32_CAM", "online", WiFi.localIP().toString().c_str(), "v2.0")) {
-                Serial.println("✓ Heartbeat sent");
-            } else {
-                Serial.println("✗ Heartbeat failed");
-            }
+        statusLink.printStats();
+        uploader.printLiveness();
+        uploader.printWireStats();
+        uploader.printRetryStats();
+        uploader.printWiFiStats();
+        if (!sendTelemetry() && uploader.isConnected()) {
+            sendDirectHeartbeat();
+        }
+        int traced = uploader.exportTraces("ESP32_CAM");
+        if (traced > 0) {
+            Serial.printf("Exported %d trace records\n", traced);
+        }
+    }
+    bool forwarded;
+    if (telemetrySender.takeOutcome(forwarded)) {
+        if (forwarded) {
+            Serial.println("✓ Heartbeat handed to main controller");
+        } else if (uploader.isConnected()) {
+            sendDirectHeartbeat();
         }
     }
 
-    // Reconnect WiFi if disconnected
-    if (!uploader.isConnected()) {
-        static unsigned long lastReconnectAttempt = 0;
-        
-        if (now - lastReconnectAttempt > 60000) {  // Try every minute
-            lastReconnectAttempt = now;
-            Serial.println("Attempting WiFi reconnect...");
+    // WiFi events only set flags; reconnect rounds advance here without
+    // blocking, so triggers are never held up behind a connect attempt
+    switch (uploader.pollWiFi()) {
+        case WIFI_LINK_UP:
+            Serial.println("✓ Reconnected to WiFi");
+            digitalWrite(STATUS_LED_PIN, HIGH);
             
-            if (uploader.connectWiFi()) {
-                Serial.println("✓ Reconnected to WiFi");
-                digitalWrite(STATUS_LED_PIN, HIGH);
-                
-                // Sync time
-                ntpSync.syncTime();
-                
-                // Upload queue
-                uploadQueuedImages();
-            }
-        }
+            // Sync time
+            ntpSync.syncTime();
+            
+            // Failures while the link was down say nothing about the
+            // backend; drain the queue on the next pass
+            uploader.noteLinkUp();
+            queuePending = true;
+            nextDrainAt = millis();
+            break;
+        case WIFI_LINK_DOWN:
+            Serial.println("WiFi link lost - reconnecting in the background");
+            digitalWrite(STATUS_LED_PIN, LOW);
+            break;
+        default:
+            break;
     }
     
-    delay(50);  // Small delay to prevent tight loop
+    // Acks, retransmits, thumbnail chunks and relay fragments; poll fast
+    // while frames are in flight so transfers are not paced by the idle delay
+    statusLink.poll();
+    serviceRelay();
+    delay(statusLink.busy() || relaySender.busy() ? 1 : 50);  // Small delay to prevent tight loop
 }
@@ -0,0 +1,264 @@
+/**
+ * Relay Sender Implementation
+ * Windowed fragment transmission with selective repeat
+ */
+
+#include "relay_sender.h"
+#include "config.h"
+
+RelaySender relaySender;
+RelaySender* RelaySender::instance = nullptr;
+
+RelaySender::RelaySender()
+    : havePeer(false), seq(0), requestPending(false), requestIncident(0),
+      requestKind(RELAY_FULL), ackPending(false), ackIncident(0), resultPending(false),
+      resultIncident(0), resultOk(false), onAir(false), onAirSince(0), active(false),
+      delivered(false), incidentId(0), kind(RELAY_FULL), data(nullptr), total(0),
+      count(0), base(0), next(0), acked(0), startedAt(0), progressAt(0),
+      fragmentsSent(0), retransmits(0) {
+    memset(peer, 0, sizeof(peer));
+    memset(&latestAck, 0, sizeof(latestAck));
+    memset(sentAt, 0, sizeof(sentAt));
+    lock = portMUX_INITIALIZER_UNLOCKED;
+}
+
+void RelaySender::begin() {
+    instance = this;
+    esp_now_register_send_cb(onSent);
+}
+
+void RelaySender::setPeer(const uint8_t* mac) {
+    memcpy(peer, mac, sizeof(peer));
+    havePeer = true;
+}
+
+// WiFi task context. Any completion (trigger acks included) frees the
+// air slot; that only lets the next fragment go slightly early.
+void RelaySender::onSent(const uint8_t* mac, esp_now_send_status_t status) {
+    if (instance) {
+        instance->onAir = false;
+    }
+}
+
+bool RelaySender::sendFrame(EspNowFrameType type, uint32_t incident,
+                            const uint8_t* payload, uint8_t len) {
+    if (!havePeer) {
+        return false;
+    }
+    uint8_t frame[ESPNOW_FRAME_MAX];
+    size_t n = espnowEncode(frame, sizeof(frame), type, seq++, incident, payload, len);
+    if (n == 0) {
+        return false;
+    }
+    onAir = true;
+    onAirSince = millis();
+    if (esp_now_send(peer, frame, n) != ESP_OK) {
+        onAir = false;
+        return false;
+    }
+    return true;
+}
+
+bool RelaySender::offer(uint32_t incident, uint32_t fullBytes, uint16_t thumbBytes) {
+    if (active || !havePeer || incident == 0) {
+        return false;
+    }
+    RelayOffer o;
+    o.fullBytes = fullBytes;
+    o.thumbBytes = thumbBytes;
+    return sendFrame(FRAME_RELAY_OFFER, incident, (const uint8_t*)&o, sizeof(o));
+}
+
+void RelaySender::onFrame(const EspNowHeader& header, const uint8_t* payload) {
+    portENTER_CRITICAL(&lock);
+    switch (header.type) {
+        case FRAME_RELAY_REQUEST:
+            if (header.payloadLen >= sizeof(RelayRequest)) {
+                requestIncident = header.incidentId;
+                requestKind = payload[0];
+                requestPending = true;
+            }
+            break;
+        case FRAME_FRAGMENT_ACK:
+            if (header.payloadLen >= sizeof(FragmentAck)) {
+                memcpy(&latestAck, payload, sizeof(latestAck));
+                ackIncident = header.incidentId;
+                ackPending = true;
+            }
+            break;
+        case FRAME_RELAY_RESULT:
+            if (header.payloadLen >= sizeof(RelayResult)) {
+                resultIncident = header.incidentId;
+                resultOk = payload[0] != 0;
+                resultPending = true;
+            }
+            break;
+        default:
+            break;
+    }
+    portEXIT_CRITICAL(&lock);
+}
+
+bool RelaySender::takeRequest(uint32_t& incident, uint8_t& requestedKind) {
+    if (!requestPending) {
+        return false;
+    }
+    portENTER_CRITICAL(&lock);
+    incident = requestIncident;
+    requestedKind = requestKind;
+    requestPending = false;
+    portEXIT_CRITICAL(&lock);
+    return true;
+}
+
+bool RelaySender::takeResult(uint32_t& incident, bool& ok, uint8_t& relayedKind) {
+    if (!resultPending) {
+        return false;
+    }
+    portENTER_CRITICAL(&lock);
+    incident = resultIncident;
+    ok = resultOk;
+    resultPending = false;
+    portEXIT_CRITICAL(&lock);
+
+    relayedKind = RELAY_THUMB;
+    if (active && incident == incidentId) {
+        relayedKind = kind;
+        stop();
+    }
+    return true;
+}
+
+bool RelaySender::start(uint32_t incident, uint8_t requestedKind, uint8_t* jpeg, uint32_t len) {
+    uint32_t fragments = (len + RELAY_FRAGMENT_DATA - 1) / RELAY_FRAGMENT_DATA;
+    if (active || len == 0 || fragments > 0xFFFF) {
+        free(jpeg);
+        return false;
+    }
+
+    incidentId = incident;
+    kind = requestedKind;
+    data = jpeg;
+    total = len;
+    count = fragments;
+    base = 0;
+    next = 0;
+    acked = 0;
+    delivered = false;
+    fragmentsSent = 0;
+    retransmits = 0;
+    startedAt = progressAt = millis();
+    active = true;
+
+    // Drop acks left over from an earlier transfer
+    portENTER_CRITICAL(&lock);
+    ackPending = false;
+    portEXIT_CRITICAL(&lock);
+
+    Serial.printf("Relay %08lX: sending %s, %lu bytes in %u fragments\n",
+                  (unsigned long)incidentId, kind == RELAY_FULL ? "full image" : "thumbnail",
+                  (unsigned long)total, count);
+    return true;
+}
+
+void RelaySender::stop() {
+    free(data);
+    data = nullptr;
+    active = false;
+}
+
+bool RelaySender::sendFragment(uint16_t index) {
+    uint8_t payload[ESPNOW_PAYLOAD_MAX];
+    FragmentHeader frag;
+    frag.index = index;
+    frag.count = count;
+    frag.total = total;
+
+    uint32_t offset = (uint32_t)index * RELAY_FRAGMENT_DATA;
+    uint32_t n = total - offset;
+    if (n > RELAY_FRAGMENT_DATA) {
+        n = RELAY_FRAGMENT_DATA;
+    }
+    memcpy(payload, &frag, sizeof(frag));
+    memcpy(payload + sizeof(frag), data + offset, n);
+
+    if (!sendFrame(FRAME_FRAGMENT, incidentId, payload, sizeof(frag) + n)) {
+        return false;
+    }
+    sentAt[index % RELAY_WINDOW] = millis();
+    fragmentsSent++;
+    return true;
+}
+
+void RelaySender::processAck() {
+    portENTER_CRITICAL(&lock);
+    bool pending = ackPending && ackIncident == incidentId;
+    FragmentAck ack = latestAck;
+    ackPending = false;
+    portEXIT_CRITICAL(&lock);
+
+    if (!pending || ack.base < base || ack.base > count) {
+        return;  // Stale (reordered) or bogus
+    }
+    if (ack.base > base) {
+        progressAt = millis();
+    }
+    base = ack.base;
+    if (next < base) {
+        next = base;
+    }
+    // Each ack is a full snapshot of the receiver's window; base itself
+    // is missing by definition
+    acked = ack.mask << 1;
+
+    if (base == count && !delivered) {
+        delivered = true;
+        unsigned long ms = millis() - startedAt;
+        Serial.printf("Relay %08lX: %lu bytes delivered in %lu ms (%.1f KB/s), "
+                      "%lu fragments sent, %lu retransmitted\n",
+                      (unsigned long)incidentId, (unsigned long)total, ms,
+                      ms ? total / 1.024f / ms : 0.0f,
+                      (unsigned long)fragmentsSent, (unsigned long)retransmits);
+    }
+}
+
+void RelaySender::poll() {
+    if (!active) {
+        return;
+    }
+    processAck();
+
+    unsigned long now = millis();
+    // The main controller may spend a GPRS attach on forwarding
+    if (now - progressAt > (delivered ? RELAY_RESULT_TIMEOUT_MS : RELAY_STALL_MS)) {
+        Serial.printf("Relay %08lX: %s - giving up\n", (unsigned long)incidentId,
+                      delivered ? "no result from main controller" : "stalled");
+        stop();
+        return;
+    }
+    if (delivered) {
+        return;  // takeResult() ends it
+    }
+
+    // One frame with ESP-NOW at a time; the send callback clears this
+    if (onAir && now - onAirSince < RELAY_AIR_TIMEOUT_MS) {
+        return;
+    }
+
+    // Oldest expired unacked fragment first
+    for (uint16_t i = 0; i < next - base && i < RELAY_WINDOW; i++) {
+        uint16_t index = base + i;
+        if (!(acked & (1UL << i)) && now - sentAt[index % RELAY_WINDOW] > RELAY_RTO_MS) {
+            if (sendFragment(index)) {
+                retransmits++;
+            }
+            return;
+        }
+    }
+
+    if (next < count && next < base + RELAY_WINDOW) {
+        if (sendFragment(next)) {
+            next++;
+        }
+    }
+}
@@ -0,0 +1,92 @@
+/**
+ * Relay Sender Module
+ * Sends queued images to the main controller over ESP-NOW
+ *
+ * Used when this board has no WiFi but the main controller can still
+ * reach the backend. The main controller answers an offer with a request,
+ * acks every fragment (first missing index + bitmap) and reports whether
+ * the backend took the image. Only unacked fragments are resent.
+ *
+ * Flow control: at most RELAY_WINDOW fragments unacked and one frame
+ * handed to ESP-NOW at a time, so a trigger ack sent from the receive
+ * callback never waits behind a burst of fragments.
+ */
+
+#ifndef RELAY_SENDER_H
+#define RELAY_SENDER_H
+
+#include <Arduino.h>
+#include <esp_now.h>
+#include <freertos/FreeRTOS.h>
+#include "espnow_protocol.h"
+
+class RelaySender {
+private:
+    uint8_t peer[6];
+    bool havePeer;
+    uint16_t seq;
+
+    // Set from ESP-NOW callbacks
+    portMUX_TYPE lock;
+    volatile bool requestPending;
+    uint32_t requestIncident;
+    uint8_t requestKind;
+    volatile bool ackPending;
+    FragmentAck latestAck;
+    uint32_t ackIncident;
+    volatile bool resultPending;
+    uint32_t resultIncident;
+    bool resultOk;
+    volatile bool onAir;
+    unsigned long onAirSince;
+
+    // Transfer in progress
+    bool active;
+    bool delivered;        // All fragments acked, waiting for the result
+    uint32_t incidentId;
+    uint8_t kind;
+    uint8_t* data;         // malloc'd, owned
+    uint32_t total;
+    uint16_t count;
+    uint16_t base;         // First fragment not acked
+    uint16_t next;         // First fragment never sent
+    uint32_t acked;        // Bit i = fragment base + i acked
+    unsigned long sentAt[RELAY_WINDOW];  // By fragment % RELAY_WINDOW
+    unsigned long startedAt;
+    unsigned long progressAt;
+    uint32_t fragmentsSent;
+    uint32_t retransmits;
+
+    static RelaySender* instance;
+    static void onSent(const uint8_t* mac, esp_now_send_status_t status);
+
+    bool sendFrame(EspNowFrameType type, uint32_t incident, const uint8_t* payload, uint8_t len);
+    bool sendFragment(uint16_t index);
+    void processAck();
+    void stop();
+
+public:
+    RelaySender();
+
+    void begin();  // After esp_now_init()
+    void setPeer(const uint8_t* mac);  // Main controller, learned from its triggers
+    bool hasPeer() const { return havePeer; }
+
+    bool offer(uint32_t incidentId, uint32_t fullBytes, uint16_t thumbBytes);
+
+    // ESP-NOW receive callback context
+    void onFrame(const EspNowHeader& header, const uint8_t* payload);
+
+    // loop(): the caller loads the requested image and starts the transfer
+    bool takeRequest(uint32_t& incidentId, uint8_t& kind);
+    bool start(uint32_t incidentId, uint8_t kind, uint8_t* jpeg, uint32_t len);
+    // relayedKind is RELAY_THUMB when the result matches no transfer of ours
+    bool takeResult(uint32_t& incidentId, bool& ok, uint8_t& relayedKind);
+
+    void poll();
+    bool busy() const { return active; }
+};
+
+extern RelaySender relaySender;
+
+#endif // RELAY_SENDER_H
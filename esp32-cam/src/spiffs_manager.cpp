@@ -6,6 +6,10 @@
 #include "spiffs_manager.h"
 #include "config.h"
 
+#define PROGRESS_MAGIC 0x55503031  // "UP01"
+#define PROGRESS_EXTENSION ".up"
+#define UNCONFIRMED_FILE "/unconfirmed.bin"
+
 SPIFFSManager::SPIFFSManager() : initialized(false) {
 }
 
@@ -26,18 +30,25 @@ bool SPIFFSManager::begin() {
     return true;
 }
 
-String SPIFFSManager::generateFilename(unsigned long timestamp) {
+// /capture_<timestamp>[_<incident hex>].jpg - the incident ID travels with
+// the file so an upload hours later still carries it
+String SPIFFSManager::generateFilename(unsigned long timestamp, uint32_t incidentId) {
     char filename[64];
-    sprintf(filename, "%s%lu%s", IMAGE_PREFIX, timestamp, IMAGE_EXTENSION);
+    if (incidentId) {
+        sprintf(filename, "%s%lu_%08lX%s", IMAGE_PREFIX, timestamp,
+                (unsigned long)incidentId, IMAGE_EXTENSION);
+    } else {
+        sprintf(filename, "%s%lu%s", IMAGE_PREFIX, timestamp, IMAGE_EXTENSION);
+    }
     return String(filename);
 }
 
-bool SPIFFSManager::saveImage(camera_fb_t* fb, unsigned long timestamp) {
+bool SPIFFSManager::saveImage(camera_fb_t* fb, unsigned long timestamp, uint32_t incidentId) {
     if (!initialized || !fb) {
         return false;
     }
     
-    String filename = generateFilename(timestamp);
+    String filename = generateFilename(timestamp, incidentId);
     
     Serial.printf("Saving image to SPIFFS: %s (%d bytes)\n", filename.c_str(), fb->len);
     
@@ -112,12 +123,16 @@ QueuedImage* SPIFFSManager::getQueuedImages(int& count) {
             images[index].filename = filename;
             images[index].size = file.size();
             
-            // Extract timestamp from filename
-            String timestampStr = filename.substring(
+            // Extract timestamp and optional incident ID from filename
+            String stem = filename.substring(
                 strlen(IMAGE_PREFIX), 
                 filename.length() - strlen(IMAGE_EXTENSION)
             );
-            images[index].timestamp = timestampStr.toInt();
+            int underscore = stem.indexOf('_');
+            images[index].timestamp = stem.toInt();  // Stops at '_'
+            images[index].incidentId = underscore >= 0
+                ? strtoul(stem.c_str() + underscore + 1, nullptr, 16)
+                : 0;
             
             index++;
         }
@@ -139,6 +154,7 @@ bool SPIFFSManager::deleteImage(const String& filename) {
     }
     
     bool deleted = SPIFFS.remove(filename);
+    clearProgress(filename);
     
     if (deleted) {
         Serial.printf("Deleted: %s\n", filename.c_str());
@@ -221,3 +237,79 @@ bool SPIFFSManager::readImage(const String& filename, uint8_t** buffer, size_t*
     
     return true;
 }
+
+String SPIFFSManager::progressFilename(const String& image) {
+    return image.substring(0, image.length() - strlen(IMAGE_EXTENSION)) + PROGRESS_EXTENSION;
+}
+
+bool SPIFFSManager::loadProgress(const String& image, UploadProgress& progress) {
+    String name = progressFilename(image);
+    if (!initialized || !SPIFFS.exists(name)) {
+        return false;
+    }
+    
+    File file = SPIFFS.open(name, FILE_READ);
+    if (!file) {
+        return false;
+    }
+    size_t bytesRead = file.read((uint8_t*)&progress, sizeof(progress));
+    file.close();
+    
+    progress.session[sizeof(progress.session) - 1] = '\0';
+    return bytesRead == sizeof(progress) && progress.magic == PROGRESS_MAGIC &&
+           progress.committed <= progress.size;
+}
+
+// Rewritten after every acknowledged chunk; a write cut short by a reset
+// fails the size check in loadProgress() and the upload starts over
+bool SPIFFSManager::saveProgress(const String& image, const UploadProgress& progress) {
+    if (!initialized) {
+        return false;
+    }
+    
+    File file = SPIFFS.open(progressFilename(image), FILE_WRITE);
+    if (!file) {
+        return false;
+    }
+    UploadProgress record = progress;
+    record.magic = PROGRESS_MAGIC;
+    size_t written = file.write((const uint8_t*)&record, sizeof(record));
+    file.close();
+    return written == sizeof(record);
+}
+
+void SPIFFSManager::clearProgress(const String& image) {
+    String name = progressFilename(image);
+    if (initialized && SPIFFS.exists(name)) {
+        SPIFFS.remove(name);
+    }
+}
+
+bool SPIFFSManager::loadUnconfirmed(void* record, size_t len) {
+    if (!initialized || !SPIFFS.exists(UNCONFIRMED_FILE)) {
+        return false;
+    }
+    
+    File file = SPIFFS.open(UNCONFIRMED_FILE, FILE_READ);
+    if (!file) {
+        return false;
+    }
+    size_t bytesRead = file.read((uint8_t*)record, len);
+    file.close();
+    return bytesRead == len;
+}
+
+// Only written when a reply is lost or a lost one gets answered
+bool SPIFFSManager::saveUnconfirmed(const void* record, size_t len) {
+    if (!initialized) {
+        return false;
+    }
+    
+    File file = SPIFFS.open(UNCONFIRMED_FILE, FILE_WRITE);
+    if (!file) {
+        return false;
+    }
+    size_t written = file.write((const uint8_t*)record, len);
+    file.close();
+    return written == len;
+}
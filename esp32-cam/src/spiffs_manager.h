@@ -9,29 +9,51 @@
 #include <Arduino.h>
 #include <SPIFFS.h>
 #include "esp_camera.h"
+#include "http_request.h"
 
 struct QueuedImage {
     String filename;
     unsigned long timestamp;
+    uint32_t incidentId;  // 0 = not tied to an alert (wire trigger, boot test)
     size_t size;
 };
 
+// Resumable upload state, kept in <image>.up next to the queued image
+struct UploadProgress {
+    uint32_t magic;
+    uint32_t size;       // Image bytes
+    uint32_t crc;        // CRC-32 of the whole image
+    uint32_t committed;  // Bytes the server has acknowledged
+    char session[HTTP_PATH_MAX];  // Session path from the create reply
+};
+
 class SPIFFSManager {
 private:
     bool initialized;
     
-    String generateFilename(unsigned long timestamp);
+    String generateFilename(unsigned long timestamp, uint32_t incidentId);
+    String progressFilename(const String& image);
     
 public:
     SPIFFSManager();
     
     bool begin();
-    bool saveImage(camera_fb_t* fb, unsigned long timestamp);
+    bool saveImage(camera_fb_t* fb, unsigned long timestamp, uint32_t incidentId = 0);
     int getQueuedImageCount();
     QueuedImage* getQueuedImages(int& count);
     bool deleteImage(const String& filename);
     void cleanupOldImages();
     bool readImage(const String& filename, uint8_t** buffer, size_t* size);
+    
+    // Removed together with the image by deleteImage()
+    bool loadProgress(const String& image, UploadProgress& progress);
+    bool saveProgress(const String& image, const UploadProgress& progress);
+    void clearProgress(const String& image);
+    
+    // Opaque record of images whose upload reply was lost (HTTPUploader);
+    // kept with the queue so a reboot does not turn them into blind resends
+    bool loadUnconfirmed(void* record, size_t len);
+    bool saveUnconfirmed(const void* record, size_t len);
 };
 
 #endif // SPIFFS_MANAGER_H
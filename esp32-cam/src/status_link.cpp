@@ -0,0 +1,182 @@
+/**
+ * Status Link Implementation
+ * Go-back-N window over the UART, fed by ESP-NOW acks
+ */
+
+#include "status_link.h"
+#include "config.h"
+
+StatusLink statusLink(&Serial1);
+
+StatusLink::StatusLink(HardwareSerial* port)
+    : serial(port), baseSeq(0), nextSeq(0), inFlight(0), sends(0), sentAt(0),
+      resync(true), ackSeq(0), ackPending(false), thumbRequested(0), thumb(nullptr),
+      thumbLen(0), thumbIncident(0), thumbSent(0), thumbStreaming(false),
+      framesSent(0), retransmits(0), dropped(0) {
+    lock = portMUX_INITIALIZER_UNLOCKED;
+}
+
+void StatusLink::begin(int txPin, unsigned long baud) {
+    // A random first seq makes a stale expectation on the main side
+    // (from before our reboot) unlikely to swallow the resync frame
+    baseSeq = nextSeq = (uint8_t)esp_random();
+
+    // Whole window fits, so write() never blocks loop()
+    serial->setTxBufferSize(UART_WINDOW * UART_WIRE_MAX);
+    serial->begin(baud, SERIAL_8N1, -1, txPin);
+    Serial.printf("Status link on GPIO %d at %lu baud\n", txPin, baud);
+}
+
+bool StatusLink::queueFrame(UartFrameType type, uint32_t incidentId,
+                            const uint8_t* payload, uint16_t len) {
+    processAck();
+    if (inFlight >= UART_WINDOW) {
+        dropped++;
+        return false;
+    }
+
+    Slot& slot = window[nextSeq % UART_WINDOW];
+    slot.len = uartEncode(slot.wire, sizeof(slot.wire), type, nextSeq,
+                          resync ? UART_FLAG_RESYNC : 0, incidentId, payload, len);
+    if (slot.len == 0) {
+        return false;
+    }
+
+    serial->write(slot.wire, slot.len);
+    if (inFlight == 0) {
+        sentAt = millis();
+        sends = 1;
+    }
+    inFlight++;
+    nextSeq++;
+    resync = false;
+    framesSent++;
+    return true;
+}
+
+bool StatusLink::sendCaptureReport(uint32_t incidentId, const CaptureReport& report) {
+    return queueFrame(UART_CAPTURE_REPORT, incidentId, (const uint8_t*)&report, sizeof(report));
+}
+
+bool StatusLink::sendUploadReport(uint32_t incidentId, const UploadReport& report) {
+    return queueFrame(UART_UPLOAD_REPORT, incidentId, (const uint8_t*)&report, sizeof(report));
+}
+
+void StatusLink::setThumbnail(uint32_t incidentId, uint8_t* jpeg, uint16_t len) {
+    // A stream of the old one stops here; the main side times it out
+    free(thumb);
+    thumb = jpeg;
+    thumbLen = len;
+    thumbIncident = incidentId;
+    thumbSent = 0;
+    thumbStreaming = false;
+}
+
+const uint8_t* StatusLink::thumbnailFor(uint32_t incidentId, uint16_t& len) const {
+    if (!thumb || incidentId != thumbIncident) {
+        len = 0;
+        return nullptr;
+    }
+    len = thumbLen;
+    return thumb;
+}
+
+void StatusLink::onAck(uint8_t nextExpected) {
+    portENTER_CRITICAL(&lock);
+    ackSeq = nextExpected;
+    ackPending = true;
+    portEXIT_CRITICAL(&lock);
+}
+
+void StatusLink::onThumbRequest(uint32_t incidentId) {
+    thumbRequested = incidentId;
+}
+
+void StatusLink::processAck() {
+    portENTER_CRITICAL(&lock);
+    bool pending = ackPending;
+    uint8_t ack = ackSeq;
+    ackPending = false;
+    portEXIT_CRITICAL(&lock);
+
+    if (!pending) {
+        return;
+    }
+
+    // Cumulative: everything before ack has arrived. Acks for frames
+    // outside the window (stale, or from before a resync) are ignored.
+    uint8_t advance = ack - baseSeq;
+    if (advance == 0 || advance > inFlight) {
+        return;
+    }
+    baseSeq = ack;
+    inFlight -= advance;
+    sends = 1;
+    sentAt = millis();
+}
+
+void StatusLink::streamThumbnail() {
+    while (thumbStreaming && inFlight < UART_WINDOW - STATUS_LINK_REPORT_SLOTS) {
+        uint8_t payload[UART_PAYLOAD_MAX];
+        ThumbChunkHeader chunk;
+        chunk.offset = thumbSent;
+        chunk.total = thumbLen;
+
+        uint16_t n = thumbLen - thumbSent;
+        if (n > UART_THUMB_CHUNK_MAX) {
+            n = UART_THUMB_CHUNK_MAX;
+        }
+        memcpy(payload, &chunk, sizeof(chunk));
+        memcpy(payload + sizeof(chunk), thumb + thumbSent, n);
+
+        if (!queueFrame(UART_THUMB_CHUNK, thumbIncident, payload, sizeof(chunk) + n)) {
+            break;
+        }
+        thumbSent += n;
+        if (thumbSent >= thumbLen) {
+            thumbStreaming = false;  // All queued; the window finishes delivery
+        }
+    }
+}
+
+void StatusLink::poll() {
+    processAck();
+
+    if (inFlight > 0 && millis() - sentAt > UART_ACK_TIMEOUT_MS) {
+        if (sends >= UART_MAX_SENDS) {
+            // Main controller not listening (or its acks not reaching us):
+            // give up on these and restart the sequence on the next frame
+            dropped += inFlight;
+            inFlight = 0;
+            baseSeq = nextSeq;
+            resync = true;
+            thumbStreaming = false;
+        } else {
+            for (uint8_t i = 0; i < inFlight; i++) {
+                const Slot& slot = window[(uint8_t)(baseSeq + i) % UART_WINDOW];
+                serial->write(slot.wire, slot.len);
+            }
+            retransmits += inFlight;
+            sends++;
+            sentAt = millis();
+        }
+    }
+
+    uint32_t requested = thumbRequested;
+    if (requested != 0) {
+        thumbRequested = 0;
+        if (thumb && requested == thumbIncident && !thumbStreaming) {
+            Serial.printf("Thumbnail %08lX requested (%u bytes)\n",
+                          (unsigned long)requested, thumbLen);
+            thumbSent = 0;
+            thumbStreaming = true;
+        }
+    }
+    streamThumbnail();
+}
+
+void StatusLink::printStats() {
+    Serial.printf("Status link: %lu frames, %lu retransmits, %lu dropped\n",
+                  (unsigned long)framesSent, (unsigned long)retransmits,
+                  (unsigned long)dropped);
+}
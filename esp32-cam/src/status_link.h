@@ -0,0 +1,88 @@
+/**
+ * Status Link Module
+ * Sending end of the framed UART link to the main controller
+ *
+ * Capture/upload reports and thumbnail chunks go out on UART_TX_PIN
+ * (uart_protocol.h). Acks and thumbnail requests come back over ESP-NOW
+ * and are handed in from the receive callback; everything else runs
+ * from loop() through poll().
+ */
+
+#ifndef STATUS_LINK_H
+#define STATUS_LINK_H
+
+#include <Arduino.h>
+#include <HardwareSerial.h>
+#include <freertos/FreeRTOS.h>
+#include "uart_protocol.h"
+
+// Slots kept free for reports while a thumbnail is streaming
+#define STATUS_LINK_REPORT_SLOTS 2
+
+class StatusLink {
+private:
+    struct Slot {
+        uint8_t wire[UART_WIRE_MAX];
+        uint16_t len;
+    };
+
+    HardwareSerial* serial;
+    Slot window[UART_WINDOW];
+    uint8_t baseSeq;        // Oldest unacked
+    uint8_t nextSeq;
+    uint8_t inFlight;
+    uint8_t sends;          // Times the oldest frame has been written
+    unsigned long sentAt;   // Last (re)send of the window
+    bool resync;            // Next new frame carries UART_FLAG_RESYNC
+
+    // Set from the ESP-NOW callback
+    volatile uint8_t ackSeq;
+    volatile bool ackPending;
+    volatile uint32_t thumbRequested;
+    portMUX_TYPE lock;
+
+    // Thumbnail held for a pull (malloc'd, owned here)
+    uint8_t* thumb;
+    uint16_t thumbLen;
+    uint32_t thumbIncident;
+    uint16_t thumbSent;     // Bytes queued so far, 0 = not streaming
+    bool thumbStreaming;
+
+    uint32_t framesSent;
+    uint32_t retransmits;
+    uint32_t dropped;
+
+    bool queueFrame(UartFrameType type, uint32_t incidentId,
+                    const uint8_t* payload, uint16_t len);
+    void processAck();
+    void streamThumbnail();
+
+public:
+    StatusLink(HardwareSerial* port);
+
+    void begin(int txPin, unsigned long baud);
+
+    bool sendCaptureReport(uint32_t incidentId, const CaptureReport& report);
+    bool sendUploadReport(uint32_t incidentId, const UploadReport& report);
+
+    // Takes ownership of jpeg (malloc'd); replaces any older thumbnail
+    void setThumbnail(uint32_t incidentId, uint8_t* jpeg, uint16_t len);
+    const uint8_t* thumbnailFor(uint32_t incidentId, uint16_t& len) const;
+
+    // ESP-NOW receive callback context
+    void onAck(uint8_t nextExpected);
+    void onThumbRequest(uint32_t incidentId);
+
+    // Acks, retransmits and thumbnail streaming; call often while busy()
+    void poll();
+    bool busy() const { return inFlight > 0 || thumbStreaming; }
+
+    uint32_t getFramesSent() const { return framesSent; }
+    uint32_t getRetransmits() const { return retransmits; }
+    uint32_t getDropped() const { return dropped; }
+    void printStats();
+};
+
+extern StatusLink statusLink;
+
+#endif // STATUS_LINK_H
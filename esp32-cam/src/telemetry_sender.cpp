@@ -0,0 +1,88 @@
+/**
+ * Telemetry Sender Implementation
+ */
+
+#include "telemetry_sender.h"
+#include "config.h"
+
+TelemetrySender telemetrySender;
+
+static const uint8_t BROADCAST_MAC[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+TelemetrySender::TelemetrySender()
+    : havePeer(false), seq(0), waiting(false), sentSeq(0), sentAt(0),
+      ackPending(false), ackSeq(0), ackForwarding(false) {
+    memset(peer, 0, sizeof(peer));
+    lock = portMUX_INITIALIZER_UNLOCKED;
+}
+
+void TelemetrySender::begin() {
+    if (!esp_now_is_peer_exist(BROADCAST_MAC)) {
+        esp_now_peer_info_t peerInfo;
+        memset(&peerInfo, 0, sizeof(peerInfo));
+        memcpy(peerInfo.peer_addr, BROADCAST_MAC, 6);
+        peerInfo.channel = 0;
+        peerInfo.encrypt = false;
+        esp_now_add_peer(&peerInfo);
+    }
+}
+
+void TelemetrySender::setPeer(const uint8_t* mac) {
+    memcpy(peer, mac, sizeof(peer));
+    havePeer = true;
+}
+
+bool TelemetrySender::send(const CamTelemetry& report) {
+    uint8_t frame[ESPNOW_FRAME_MAX];
+    uint16_t frameSeq = seq++;
+    size_t n = espnowEncode(frame, sizeof(frame), FRAME_CAM_TELEMETRY, frameSeq, 0,
+                            (const uint8_t*)&report, sizeof(report));
+    if (n == 0) {
+        return false;
+    }
+
+    // Drop an ack for an earlier report
+    portENTER_CRITICAL(&lock);
+    ackPending = false;
+    portEXIT_CRITICAL(&lock);
+
+    if (esp_now_send(havePeer ? peer : BROADCAST_MAC, frame, n) != ESP_OK) {
+        waiting = false;
+        return false;
+    }
+    waiting = true;
+    sentSeq = frameSeq;
+    sentAt = millis();
+    return true;
+}
+
+void TelemetrySender::onAck(const EspNowHeader& header, const uint8_t* payload) {
+    if (header.payloadLen < sizeof(TelemetryAck)) {
+        return;
+    }
+    portENTER_CRITICAL(&lock);
+    ackSeq = header.seq;
+    ackForwarding = payload[0] != 0;
+    ackPending = true;
+    portEXIT_CRITICAL(&lock);
+}
+
+bool TelemetrySender::takeOutcome(bool& forwarded) {
+    if (!waiting) {
+        return false;
+    }
+
+    portENTER_CRITICAL(&lock);
+    bool acked = ackPending && ackSeq == sentSeq;
+    forwarded = acked && ackForwarding;
+    if (acked) {
+        ackPending = false;
+    }
+    portEXIT_CRITICAL(&lock);
+
+    if (!acked && millis() - sentAt < TELEMETRY_ACK_TIMEOUT_MS) {
+        return false;
+    }
+    waiting = false;
+    return true;
+}
@@ -0,0 +1,55 @@
+/**
+ * Telemetry Sender Module
+ * Hands the cam's heartbeat to the main controller over ESP-NOW
+ *
+ * The main controller posts one heartbeat for both devices, so the cam
+ * does not need its own HTTPS connection for it. Until a trigger or an
+ * ack tells us the main controller's MAC, reports are broadcast. A report
+ * that is not acked within TELEMETRY_ACK_TIMEOUT_MS, or whose ack says
+ * the main controller is offline, is posted directly instead.
+ */
+
+#ifndef TELEMETRY_SENDER_H
+#define TELEMETRY_SENDER_H
+
+#include <Arduino.h>
+#include <esp_now.h>
+#include <freertos/FreeRTOS.h>
+#include "espnow_protocol.h"
+
+class TelemetrySender {
+private:
+    uint8_t peer[6];
+    bool havePeer;
+    uint16_t seq;
+
+    // Report waiting for its ack
+    bool waiting;
+    uint16_t sentSeq;
+    unsigned long sentAt;
+
+    // Set from the ESP-NOW callback
+    portMUX_TYPE lock;
+    volatile bool ackPending;
+    uint16_t ackSeq;
+    bool ackForwarding;
+
+public:
+    TelemetrySender();
+
+    void begin();  // After esp_now_init(); adds the broadcast peer
+    void setPeer(const uint8_t* mac);
+
+    bool send(const CamTelemetry& report);
+
+    // ESP-NOW receive callback context
+    void onAck(const EspNowHeader& header, const uint8_t* payload);
+
+    // loop(): true once the last report's fate is known; forwarded is
+    // false when the caller should post the heartbeat itself
+    bool takeOutcome(bool& forwarded);
+};
+
+extern TelemetrySender telemetrySender;
+
+#endif // TELEMETRY_SENDER_H
@@ -0,0 +1,258 @@
+/**
+ * Image relay sender over a simulated ESP-NOW channel
+ *
+ * Each frame is on air for AIR_MS, then its send callback fires and,
+ * unless the channel loses it, a reference receiver (the main
+ * controller's rules, relay_receiver.cpp) acks it ACK_LATENCY_MS later.
+ * Acks can be lost too. Throughput and retransmits are reported.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include <deque>
+#include "config.h"
+#include "relay_sender.h"
+
+static const uint8_t MAIN_MAC[6] = { 0x24, 0x6F, 0x28, 0x11, 0x22, 0x33 };
+static const unsigned long AIR_MS = 2;          // ~250 B at the 1 Mbps ESP-NOW rate, with overhead
+static const unsigned long ACK_LATENCY_MS = 2;
+
+struct Channel {
+    RelaySender sender;
+    uint32_t rng = 1;
+    unsigned lossPercent = 0;   // Both directions
+    bool receiverGone = false;
+
+    // Receiver
+    uint32_t incident = 0;
+    std::vector<uint8_t> image;
+    std::vector<bool> have;
+    uint16_t base = 0;
+    unsigned duplicates = 0;
+
+    // Air
+    struct OnAir {
+        unsigned long doneAt;
+        std::vector<uint8_t> frame;
+    };
+    std::deque<OnAir> air;
+    std::deque<std::pair<unsigned long, std::vector<uint8_t>>> acks;
+    unsigned maxOnAir = 0;
+    unsigned fragmentsSent = 0;
+    uint16_t mainSeq = 0;
+
+    bool lost() {
+        rng = rng * 1103515245u + 12345u;
+        return (rng >> 16) % 100 < lossPercent;
+    }
+
+    void begin(uint32_t id, uint32_t len) {
+        fakeEspNowReset();
+        sender.begin();
+        sender.setPeer(MAIN_MAC);
+        incident = id;
+        image.assign(len, 0);
+        have.assign((len + RELAY_FRAGMENT_DATA - 1) / RELAY_FRAGMENT_DATA, false);
+    }
+
+    bool complete() const { return base == have.size(); }
+
+    void toSender(EspNowFrameType type, const void* payload, uint8_t len) {
+        uint8_t frame[ESPNOW_FRAME_MAX];
+        size_t n = espnowEncode(frame, sizeof(frame), type, mainSeq++, incident,
+                                (const uint8_t*)payload, len);
+        EspNowHeader h;
+        const uint8_t* p;
+        TEST_ASSERT_TRUE(espnowDecode(frame, n, h, &p));
+        sender.onFrame(h, p);
+    }
+
+    void receive(const std::vector<uint8_t>& frame) {
+        EspNowHeader h;
+        const uint8_t* p;
+        TEST_ASSERT_TRUE(espnowDecode(frame.data(), frame.size(), h, &p));
+        if (h.type != FRAME_FRAGMENT) return;
+        FragmentHeader f;
+        memcpy(&f, p, sizeof(f));
+        TEST_ASSERT_EQUAL(have.size(), f.count);
+        uint32_t offset = (uint32_t)f.index * RELAY_FRAGMENT_DATA;
+        if (have[f.index]) {
+            duplicates++;
+        } else {
+            memcpy(image.data() + offset, p + sizeof(f), h.payloadLen - sizeof(f));
+            have[f.index] = true;
+            while (base < have.size() && have[base]) base++;
+        }
+        FragmentAck ack = { base, 0 };
+        for (int i = 0; i < 32; i++) {
+            if (base + 1 + i < (int)have.size() && have[base + 1 + i]) ack.mask |= 1UL << i;
+        }
+        std::vector<uint8_t> a((uint8_t*)&ack, (uint8_t*)&ack + sizeof(ack));
+        acks.push_back({ millis() + ACK_LATENCY_MS, a });
+    }
+
+    // New sends go on air behind whatever is still there
+    void transmit() {
+        for (FakeEspNowFrame& f : fakeEspNowSent) {
+            EspNowHeader h;
+            if (espnowDecode(f.data.data(), f.data.size(), h) && h.type == FRAME_FRAGMENT) fragmentsSent++;
+            unsigned long start = air.empty() ? millis() : air.back().doneAt;
+            air.push_back({ start + AIR_MS, f.data });
+        }
+        fakeEspNowSent.clear();
+        if (air.size() > maxOnAir) maxOnAir = air.size();
+    }
+
+    void step() {
+        transmit();
+        while (!air.empty() && (long)(millis() - air.front().doneAt) >= 0) {
+            std::vector<uint8_t> frame = air.front().frame;
+            air.pop_front();
+            bool delivered = !receiverGone && !lost();
+            fakeEspNowSendDone(MAIN_MAC, delivered);
+            if (delivered) receive(frame);
+        }
+        while (!acks.empty() && (long)(millis() - acks.front().first) >= 0) {
+            if (!lost()) toSender(FRAME_FRAGMENT_ACK, acks.front().second.data(), sizeof(FragmentAck));
+            acks.pop_front();
+        }
+
+        sender.poll();
+        transmit();
+        fakeAdvance(1);
+    }
+};
+
+static uint8_t* makeJpeg(uint32_t len, std::vector<uint8_t>& copy) {
+    uint8_t* jpeg = (uint8_t*)malloc(len);
+    for (uint32_t i = 0; i < len; i++) jpeg[i] = (uint8_t)(i * 29 + (i >> 10));
+    copy.assign(jpeg, jpeg + len);
+    return jpeg;
+}
+
+void setUp(void) {
+    fakeResetClock();
+}
+
+void tearDown(void) {}
+
+void test_offer_request_and_result(void) {
+    Channel ch;
+    ch.begin(0x5001, 1000);
+    TEST_ASSERT_TRUE(ch.sender.offer(0x5001, 1000, 300));
+    EspNowHeader h;
+    const uint8_t* p;
+    TEST_ASSERT_EQUAL(1, fakeEspNowSent.size());
+    TEST_ASSERT_TRUE(espnowDecode(fakeEspNowSent[0].data.data(), fakeEspNowSent[0].data.size(), h, &p));
+    TEST_ASSERT_EQUAL(FRAME_RELAY_OFFER, h.type);
+    RelayOffer o;
+    memcpy(&o, p, sizeof(o));
+    TEST_ASSERT_EQUAL_UINT32(1000, o.fullBytes);
+    TEST_ASSERT_EQUAL(300, o.thumbBytes);
+    fakeEspNowSent.clear();
+
+    RelayRequest req = { RELAY_FULL };
+    ch.toSender(FRAME_RELAY_REQUEST, &req, sizeof(req));
+    uint32_t incident;
+    uint8_t kind;
+    TEST_ASSERT_TRUE(ch.sender.takeRequest(incident, kind));
+    TEST_ASSERT_EQUAL_UINT32(0x5001, incident);
+    TEST_ASSERT_EQUAL(RELAY_FULL, kind);
+
+    std::vector<uint8_t> original;
+    TEST_ASSERT_TRUE(ch.sender.start(0x5001, RELAY_FULL, makeJpeg(1000, original), 1000));
+    TEST_ASSERT_FALSE(ch.sender.offer(0x5002, 500, 0));  // One transfer at a time
+    for (int i = 0; i < 200 && !ch.complete(); i++) ch.step();
+    TEST_ASSERT_TRUE(ch.complete());
+    TEST_ASSERT_TRUE(original == ch.image);
+
+    RelayResult result = { 1 };
+    ch.toSender(FRAME_RELAY_RESULT, &result, sizeof(result));
+    bool ok = false;
+    uint8_t relayed;
+    TEST_ASSERT_TRUE(ch.sender.takeResult(incident, ok, relayed));
+    TEST_ASSERT_TRUE(ok);
+    TEST_ASSERT_EQUAL(RELAY_FULL, relayed);
+    TEST_ASSERT_FALSE(ch.sender.busy());
+}
+
+void test_unanswered_transfer_is_abandoned(void) {
+    Channel ch;
+    ch.begin(0x5101, 5000);
+    ch.receiverGone = true;
+    std::vector<uint8_t> original;
+    ch.sender.start(0x5101, RELAY_FULL, makeJpeg(5000, original), 5000);
+    for (unsigned long i = 0; i < RELAY_STALL_MS + 100; i++) ch.step();
+    TEST_ASSERT_FALSE(ch.sender.busy());
+}
+
+void test_missing_result_is_waited_out(void) {
+    Channel ch;
+    ch.begin(0x5201, 2000);
+    std::vector<uint8_t> original;
+    ch.sender.start(0x5201, RELAY_THUMB, makeJpeg(2000, original), 2000);
+    for (int i = 0; i < 500 && !ch.complete(); i++) ch.step();
+    TEST_ASSERT_TRUE(ch.complete());
+    for (int i = 0; i < 20; i++) ch.step();  // Final ack reaches the sender
+
+    fakeAdvance(RELAY_RESULT_TIMEOUT_MS - 1000);
+    ch.sender.poll();
+    TEST_ASSERT_TRUE(ch.sender.busy());  // A GPRS forward may take this long
+    fakeAdvance(2000);
+    ch.sender.poll();
+    TEST_ASSERT_FALSE(ch.sender.busy());
+}
+
+static void transfer(unsigned lossPercent, unsigned long& ms, Channel& ch) {
+    const uint32_t len = 40000;
+    ch.begin(0x6001, len);
+    ch.lossPercent = lossPercent;
+    std::vector<uint8_t> original;
+    unsigned long start = millis();
+    TEST_ASSERT_TRUE(ch.sender.start(0x6001, RELAY_FULL, makeJpeg(len, original), len));
+    for (unsigned long i = 0; i < 60000 && !ch.complete(); i++) ch.step();
+    ms = millis() - start;
+    TEST_ASSERT_TRUE(ch.complete());
+    TEST_ASSERT_TRUE(original == ch.image);
+
+    unsigned count = ch.have.size();
+    char msg[160];
+    snprintf(msg, sizeof(msg),
+             "%u%% loss: %lu B in %lu ms = %.1f KB/s, %u fragments sent for %u, "
+             "%u duplicates, most frames queued at once %u",
+             lossPercent, (unsigned long)len, ms, len / 1.024 / ms, ch.fragmentsSent, count,
+             ch.duplicates, ch.maxOnAir);
+    TEST_MESSAGE(msg);
+}
+
+void test_benchmark_relay_throughput_and_loss_recovery(void) {
+    unsigned long cleanMs, lossyMs, heavyMs;
+    Channel clean, lossy, heavy;
+    transfer(0, cleanMs, clean);
+    transfer(10, lossyMs, lossy);
+    transfer(30, heavyMs, heavy);
+
+    // Clean: no repeats, and the radio stays busy
+    TEST_ASSERT_EQUAL(clean.have.size(), clean.fragmentsSent);
+    unsigned long airMs = clean.have.size() * AIR_MS;
+    TEST_ASSERT_LESS_THAN(airMs * 3 / 2, cleanMs);
+
+    // Loss costs time, and selective repeat keeps resends close to what was lost
+    TEST_ASSERT_GREATER_THAN(cleanMs, lossyMs);
+    TEST_ASSERT_LESS_THAN(lossy.have.size() * 13 / 10, lossy.fragmentsSent);
+
+    // Flow control: one frame with ESP-NOW at a time, so a trigger ack
+    // queued from the receive callback waits behind one fragment at most
+    TEST_ASSERT_EQUAL(1, clean.maxOnAir);
+    TEST_ASSERT_EQUAL(1, lossy.maxOnAir);
+    TEST_ASSERT_EQUAL(1, heavy.maxOnAir);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_offer_request_and_result);
+    RUN_TEST(test_unanswered_transfer_is_abandoned);
+    RUN_TEST(test_missing_result_is_waited_out);
+    RUN_TEST(test_benchmark_relay_throughput_and_loss_recovery);
+    return UNITY_END();
+}
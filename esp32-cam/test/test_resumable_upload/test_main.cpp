@@ -0,0 +1,357 @@
+/**
+ * Resumable image upload over a lossy link
+ * A reference server with the session protocol of tools/upload_server.py
+ * (create, HEAD for the committed offset, PUT ranges with CRC-32,
+ * complete) runs behind the fake WiFi client. Its connections die after
+ * a random number of bytes, so no whole 150 KB image ever gets through
+ * in one piece; the resumable path must still deliver it, sending little
+ * more than the image.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include <map>
+#include <rom/crc.h>
+#include "config.h"
+#include "http_upload.h"
+#include "spiffs_manager.h"
+#include "fake_http_server.h"
+
+static const char* API = "/api/v1/burglary";
+static const size_t IMAGE_BYTES = 150 * 1024;
+
+struct Session {
+    size_t size;
+    std::string crc;
+    std::string data;
+};
+
+class ResumableServer : public FakeHttpServer {
+public:
+    std::map<std::string, Session> sessions;
+    std::string stored;           // Last completed image
+    unsigned creates = 0;
+    unsigned heads = 0;
+    unsigned completes = 0;
+    unsigned plainPosts = 0;
+    size_t putBytes = 0;          // Chunk bytes that arrived whole
+    size_t bytesIn = 0;           // Everything the device sent, lost or not
+    unsigned corruptNext = 0;     // Fail the CRC check of this many PUTs
+    unsigned silentNext = 0;      // Commit this many PUTs without answering
+    bool omitLocation = false;    // Create answers 201 but names no session
+
+    // Lossy link: each connection dies after dropMin to dropMax bytes,
+    // 0 = only what dropAfterBytes says
+    uint32_t rng = 7;
+    size_t dropMin = 0;
+    size_t dropMax = 0;
+    size_t linkBudget = 0;        // Link goes down for good after this many bytes, 0 = never
+
+    ResumableServer() {
+        handler = [this](const FakeHttpRequest& r) { return handle(r); };
+    }
+
+    int connect(const char* host, uint16_t port) override {
+        int ok = FakeHttpServer::connect(host, port);
+        if (dropMax > 0) {
+            rng = rng * 1103515245u + 12345u;
+            dropAfterBytes = dropMin + (dropMax > dropMin ? (rng >> 8) % (dropMax - dropMin) : 0);
+        }
+        return ok;
+    }
+    size_t write(const uint8_t* buf, size_t size) override {
+        if (linkBudget > 0) {
+            long left = linkBudget > bytesIn ? (long)(linkBudget - bytesIn) : 0;
+            if (dropAfterBytes < 0 || dropAfterBytes > left) dropAfterBytes = left;
+        }
+        size_t n = FakeHttpServer::write(buf, size);
+        bytesIn += n;
+        return n;
+    }
+    using FakeHttpServer::connect;
+    using FakeHttpServer::write;
+
+private:
+    static FakeHttpReply reply(int status, const std::string& headers = "") {
+        FakeHttpReply out;
+        out.status = status;
+        out.headers = headers;
+        return out;
+    }
+
+    static std::string offset(size_t n) { return "Upload-Offset: " + std::to_string(n) + "\r\n"; }
+
+    static std::string field(const std::string& json, const char* name) {
+        std::string key = std::string("\"") + name + "\":";
+        size_t p = json.find(key);
+        if (p == std::string::npos) return "";
+        p += key.size();
+        if (json[p] == '"') return json.substr(p + 1, json.find('"', p + 1) - p - 1);
+        return json.substr(p, json.find_first_of(",}", p) - p);
+    }
+
+    FakeHttpReply handle(const FakeHttpRequest& r) {
+        std::string base = std::string(API) + "/image/upload";
+        if (r.method == "POST" && r.path == base) {
+            creates++;
+            std::string id = std::to_string(creates);
+            sessions[id] = { (size_t)atol(field(r.body, "size").c_str()), field(r.body, "crc32"), "" };
+            return reply(201, omitLocation ? "" : "Location: " + base + "/" + id + "\r\n");
+        }
+        if (r.method == "POST" && r.path == std::string(API) + "/image/image") {
+            plainPosts++;
+            return reply(201);
+        }
+        if (r.path.compare(0, base.size() + 1, base + "/") != 0) {
+            return reply(404);
+        }
+        std::string id = r.path.substr(base.size() + 1);
+        bool complete = false;
+        size_t slash = id.find('/');
+        if (slash != std::string::npos) {
+            complete = id.substr(slash) == "/complete";
+            id = id.substr(0, slash);
+        }
+        auto it = sessions.find(id);
+        if (it == sessions.end()) {
+            return reply(404);
+        }
+        Session& s = it->second;
+
+        if (r.method == "HEAD") {
+            heads++;
+            return reply(200, offset(s.data.size()));
+        }
+        if (r.method == "PUT" && !complete) {
+            unsigned first, last, total;
+            if (sscanf(r.header("Content-Range").c_str(), "bytes %u-%u/%u", &first, &last, &total) != 3) {
+                return reply(400, offset(s.data.size()));
+            }
+            if (first != s.data.size() || total != s.size || last - first + 1 != r.body.size()) {
+                return reply(409, offset(s.data.size()));
+            }
+            uint32_t crc = crc32_le(0, (const uint8_t*)r.body.data(), r.body.size());
+            if (corruptNext > 0) {
+                corruptNext--;
+                crc ^= 1;
+            }
+            if (strtoul(r.header("X-Content-CRC32").c_str(), nullptr, 16) != crc) {
+                return reply(400, offset(s.data.size()));
+            }
+            putBytes += r.body.size();
+            s.data += r.body;
+            FakeHttpReply out = reply(204, offset(s.data.size()));
+            if (silentNext > 0) {
+                silentNext--;
+                out.silent = true;
+            }
+            return out;
+        }
+        if (r.method == "POST" && complete) {
+            char crc[9];
+            snprintf(crc, sizeof(crc), "%08lX",
+                     (unsigned long)crc32_le(0, (const uint8_t*)s.data.data(), s.data.size()));
+            if (s.data.size() != s.size || s.crc != crc) {
+                sessions.erase(it);
+                return reply(422);
+            }
+            completes++;
+            stored = s.data;
+            sessions.erase(it);
+            return reply(201);
+        }
+        return reply(405);
+    }
+};
+
+static ResumableServer* server;
+static SPIFFSManager* store;
+static HTTPUploader* uploader;
+static uint8_t image[IMAGE_BYTES];
+static QueuedImage queued;
+
+// A fresh boot: NVS and SPIFFS are kept, the radio starts over
+static void boot() {
+    delete uploader;
+    WiFi.fakeReset();
+    WiFi.aps = { { WIFI_SSID, { 0x10, 0x20, 0x30, 0x40, 0x50, 0x60 }, 6, -58 } };
+    uploader = new HTTPUploader(BACKEND_URL, API_KEY);
+    uploader->begin(*store);
+    for (int i = 0; i < 200 && !uploader->isConnected(); i++) {
+        uploader->pollWiFi();
+        if (WiFi.beginCount > 0 && WiFi.state != WL_CONNECTED) {
+            WiFi.fakeJoin(0x2A01A8C0);
+        }
+        fakeAdvance(WIFI_ATTEMPT_POLL_MS);
+    }
+    TEST_ASSERT_TRUE(uploader->isConnected());
+}
+
+// One queue drain pass: upload if the retry policy allows, else wait it out
+static bool attempt() {
+    if (!uploader->imagesReady()) {
+        fakeAdvance(uploader->msUntilImagesReady() + 1);
+    }
+    return uploader->uploadResumable(*store, queued, image, IMAGE_BYTES);
+}
+
+// The link carries this many more bytes, then nothing; 0 brings it back
+static void linkFailsAfter(size_t bytes) {
+    server->linkBudget = bytes ? server->bytesIn + bytes : 0;
+    server->dropAfterBytes = -1;
+}
+
+static void assertStored() {
+    TEST_ASSERT_EQUAL(1, server->completes);
+    TEST_ASSERT_EQUAL(IMAGE_BYTES, server->stored.size());
+    TEST_ASSERT_EQUAL_MEMORY(image, server->stored.data(), IMAGE_BYTES);
+    UploadProgress progress;
+    TEST_ASSERT_FALSE(store->loadProgress(queued.filename, progress) &&
+                      progress.committed < progress.size);
+}
+
+void setUp(void) {
+    fakeResetClock();
+    fakeNvsErase();
+    fakeFsErase();
+    for (size_t i = 0; i < IMAGE_BYTES; i++) image[i] = (uint8_t)(i * 13 + (i >> 12));
+    queued.filename = "/img_1700000000_0000A1F3.jpg";
+    queued.timestamp = 1700000000;
+    queued.incidentId = 0xA1F3;
+    queued.size = IMAGE_BYTES;
+
+    server = new ResumableServer();
+    fakeWiFiServer = server;
+    store = new SPIFFSManager();
+    TEST_ASSERT_TRUE(store->begin());
+    uploader = nullptr;
+    boot();
+}
+
+void tearDown(void) {
+    delete uploader;
+    uploader = nullptr;
+    delete store;
+    fakeWiFiServer = nullptr;
+    delete server;
+}
+
+void test_clean_link_sends_the_image_once(void) {
+    TEST_ASSERT_TRUE(attempt());
+    assertStored();
+    TEST_ASSERT_EQUAL(1, server->creates);
+    TEST_ASSERT_EQUAL(0, server->heads);
+    TEST_ASSERT_EQUAL(IMAGE_BYTES, server->putBytes);
+    TEST_ASSERT_EQUAL((IMAGE_BYTES + RESUMABLE_CHUNK_BYTES - 1) / RESUMABLE_CHUNK_BYTES,
+                      server->requests.size() - 2);  // Less create and complete
+}
+
+void test_lossy_link_delivers_what_a_whole_upload_cannot(void) {
+    server->dropMin = 20000;
+    server->dropMax = 80000;
+
+    // Every connection dies before 150 KB: the plain upload never lands
+    for (int i = 0; i < 3; i++) {
+        if (!uploader->imagesReady()) fakeAdvance(uploader->msUntilImagesReady() + 1);
+        TEST_ASSERT_FALSE(uploader->uploadImageFromBuffer(image, IMAGE_BYTES, queued.timestamp,
+                                                          queued.incidentId));
+    }
+    TEST_ASSERT_EQUAL(0, server->plainPosts);
+    uploader->noteLinkUp();  // Clear the backoff the failures left
+
+    size_t before = server->bytesIn;
+    int attempts = 0;
+    while (!attempt() && attempts < 40) attempts++;
+    attempts++;
+    assertStored();
+    TEST_ASSERT_EQUAL(1, server->creates);
+    TEST_ASSERT_EQUAL(IMAGE_BYTES, server->putBytes);  // Each range committed once
+
+    size_t sent = server->bytesIn - before;
+    char msg[160];
+    snprintf(msg, sizeof(msg),
+             "%u KB image over connections dying after 20-80 KB: %d attempts, %u connections, "
+             "%u KB sent (%.0f%% of the image)",
+             (unsigned)(IMAGE_BYTES / 1024), attempts, server->connections,
+             (unsigned)(sent / 1024), 100.0 * sent / IMAGE_BYTES);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_LESS_THAN(IMAGE_BYTES * 3 / 2, sent);
+}
+
+void test_progress_survives_a_reboot(void) {
+    // The link dies a few chunks in
+    linkFailsAfter(3 * RESUMABLE_CHUNK_BYTES + 2000);
+    TEST_ASSERT_FALSE(attempt());
+    UploadProgress progress;
+    TEST_ASSERT_TRUE(store->loadProgress(queued.filename, progress));
+    TEST_ASSERT_GREATER_THAN(0, progress.committed);
+    TEST_ASSERT_LESS_THAN(IMAGE_BYTES, progress.committed);
+
+    linkFailsAfter(0);
+    boot();
+    TEST_ASSERT_TRUE(attempt());
+    assertStored();
+    TEST_ASSERT_EQUAL(1, server->creates);
+    TEST_ASSERT_EQUAL(1, server->heads);
+    TEST_ASSERT_EQUAL(IMAGE_BYTES, server->putBytes);
+}
+
+void test_committed_chunk_with_a_lost_reply_is_not_committed_twice(void) {
+    // The first chunk lands but its reply does not; the resend on a fresh
+    // connection gets 409 with the server's offset and moves past it
+    server->silentNext = 1;
+    TEST_ASSERT_TRUE(attempt());
+    assertStored();
+    TEST_ASSERT_EQUAL(IMAGE_BYTES, server->putBytes);
+    TEST_ASSERT_EQUAL(2, server->connections);
+}
+
+void test_damaged_chunk_is_resent_from_the_server_offset(void) {
+    server->corruptNext = 1;
+    TEST_ASSERT_FALSE(attempt());
+    TEST_ASSERT_EQUAL(0, server->putBytes);
+    TEST_ASSERT_TRUE(attempt());
+    assertStored();
+    TEST_ASSERT_EQUAL(1, server->creates);
+}
+
+void test_expired_session_starts_over(void) {
+    linkFailsAfter(2 * RESUMABLE_CHUNK_BYTES + 1000);
+    TEST_ASSERT_FALSE(attempt());
+    server->sessions.clear();  // Server restarted, sessions gone
+    linkFailsAfter(0);
+
+    TEST_ASSERT_TRUE(attempt());
+    assertStored();
+    TEST_ASSERT_EQUAL(2, server->creates);
+}
+
+// Review regression: a create reply without Location must not send
+// chunks to a stale or uninitialised session path
+void test_session_without_a_location_is_not_used(void) {
+    UploadProgress stale = { 0, IMAGE_BYTES, crc32_le(0, image, IMAGE_BYTES), 0, "/gone/1" };
+    store->saveProgress(queued.filename, stale);  // Server will 404 the HEAD
+    server->omitLocation = true;
+    TEST_ASSERT_FALSE(attempt());
+    TEST_ASSERT_EQUAL(1, server->creates);
+    TEST_ASSERT_EQUAL(0, server->putBytes);
+    for (const FakeHttpRequest& r : server->requests) {
+        TEST_ASSERT_FALSE(r.method == "PUT");
+    }
+
+    server->omitLocation = false;
+    TEST_ASSERT_TRUE(attempt());
+    assertStored();
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_clean_link_sends_the_image_once);
+    RUN_TEST(test_lossy_link_delivers_what_a_whole_upload_cannot);
+    RUN_TEST(test_progress_survives_a_reboot);
+    RUN_TEST(test_committed_chunk_with_a_lost_reply_is_not_committed_twice);
+    RUN_TEST(test_damaged_chunk_is_resent_from_the_server_offset);
+    RUN_TEST(test_expired_session_starts_over);
+    RUN_TEST(test_session_without_a_location_is_not_used);
+    return UNITY_END();
+}
@@ -0,0 +1,367 @@
+/**
+ * Status link loopback
+ * The real sender against a reference receiver over a simulated UART
+ *
+ * The wire carries UART_LINK_BAUD / 10 bytes per second in simulated
+ * time and can corrupt chosen frames. The receiver follows the main
+ * controller's rules (cam_uart.cpp): in-order delivery, one cumulative
+ * ack per poll, sent back over ESP-NOW a couple of milliseconds later.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include <deque>
+#include <functional>
+#include "config.h"
+#include "status_link.h"
+
+static const unsigned long MAIN_POLL_MS = 10;   // CAM_UART_POLL_MS on the main controller
+static const unsigned long ACK_LATENCY_MS = 2;  // ESP-NOW hop back
+
+struct Delivered {
+    UartFrameHeader header;
+    std::vector<uint8_t> payload;
+};
+
+struct Loopback {
+    HardwareSerial port;
+    StatusLink link;
+
+    // Wire
+    std::deque<uint8_t> wire;
+    double wireCredit = 0;
+    unsigned long wireBytes = 0;
+    std::function<bool(unsigned frame)> corrupt;  // By frame count on the wire
+    unsigned wireFrames = 0;
+    bool ackLost = false;
+
+    // Receiver
+    std::vector<uint8_t> rx;
+    uint8_t expected = 0;
+    bool synced = false;
+    bool ackDue = false;
+    unsigned badFrames = 0;
+    unsigned long nextPollAt = 0;
+    std::deque<std::pair<unsigned long, uint8_t>> acks;  // Due time, next expected
+    std::vector<Delivered> delivered;
+
+    Loopback() : port(1), link(&port) {}
+
+    void begin() { link.begin(UART_TX_PIN, UART_LINK_BAUD); }
+
+    void receive(uint8_t c) {
+        if (c != 0) {
+            rx.push_back(c);
+            return;
+        }
+        if (rx.empty()) return;
+        UartFrameHeader h;
+        const uint8_t* payload;
+        if (uartDecode(rx.data(), rx.size(), h, &payload)) {
+            bool behind = synced && (uint8_t)(expected - h.seq - 1) < UART_WINDOW;
+            if ((h.flags & UART_FLAG_RESYNC) && !behind) {
+                expected = h.seq;
+                synced = true;
+            }
+            if (synced && h.seq == expected) {
+                expected++;
+                delivered.push_back({ h, std::vector<uint8_t>(payload, payload + h.payloadLen) });
+            }
+            ackDue = synced;
+        } else {
+            badFrames++;
+        }
+        rx.clear();
+    }
+
+    // One millisecond of everything
+    void step() {
+        // Sender output onto the wire, damaged if the channel says so
+        std::string out = port.takeTx();
+        size_t start = 0;
+        for (size_t i = 0; i < out.size(); i++) {
+            if (out[i] != 0) continue;
+            if (corrupt && corrupt(wireFrames) && i > start) {
+                out[start + (i - start) / 2] ^= 0x55;
+            }
+            wireFrames++;
+            wire.insert(wire.end(), out.begin() + start, out.begin() + i + 1);
+            start = i + 1;
+        }
+
+        // Bytes the UART moves this millisecond land in the receiver's FIFO
+        wireCredit += UART_LINK_BAUD / 10.0 / 1000.0;
+        while (wireCredit >= 1 && !wire.empty()) {
+            receive(wire.front());
+            wire.pop_front();
+            wireCredit--;
+            wireBytes++;
+        }
+        if (wire.empty()) wireCredit = 0;
+
+        if ((long)(millis() - nextPollAt) >= 0) {
+            nextPollAt = millis() + MAIN_POLL_MS;
+            if (ackDue && !ackLost) acks.push_back({ millis() + ACK_LATENCY_MS, expected });
+            ackDue = false;
+        }
+        while (!acks.empty() && (long)(millis() - acks.front().first) >= 0) {
+            link.onAck(acks.front().second);
+            acks.pop_front();
+        }
+
+        link.poll();
+        fakeAdvance(1);
+    }
+
+    void run(unsigned long ms) {
+        for (unsigned long i = 0; i < ms; i++) step();
+    }
+
+    // A request handed in from ESP-NOW only starts in the next poll
+    bool runUntilIdle(unsigned long limitMs) {
+        for (unsigned long i = 0; i < limitMs; i++) {
+            step();
+            if (!link.busy() && wire.empty()) return true;
+        }
+        return false;
+    }
+
+    // Reassembled thumbnail from delivered chunks, in delivery order
+    std::vector<uint8_t> thumbnail(uint32_t incidentId) {
+        std::vector<uint8_t> out;
+        for (const Delivered& d : delivered) {
+            if (d.header.type != UART_THUMB_CHUNK || d.header.incidentId != incidentId) continue;
+            ThumbChunkHeader chunk;
+            memcpy(&chunk, d.payload.data(), sizeof(chunk));
+            TEST_ASSERT_EQUAL(out.size(), chunk.offset);
+            out.insert(out.end(), d.payload.begin() + sizeof(chunk), d.payload.end());
+        }
+        return out;
+    }
+};
+
+static uint8_t* makeJpeg(uint16_t len) {
+    uint8_t* jpeg = (uint8_t*)malloc(len);
+    for (uint16_t i = 0; i < len; i++) {
+        jpeg[i] = (uint8_t)(i * 31 + (i >> 8));  // Zeros included: COBS has work to do
+    }
+    return jpeg;
+}
+
+static CaptureReport capture(uint32_t bytes) {
+    CaptureReport r = { bytes, 140, 0, 1 };
+    return r;
+}
+
+void setUp(void) {
+    fakeResetClock();
+}
+
+void tearDown(void) {}
+
+void test_cobs_round_trip(void) {
+    // Runs around the 254-byte block limit, with and without zeros
+    const size_t lens[] = { 0, 1, 253, 254, 255, 508, 600 };
+    for (size_t len : lens) {
+        for (int zeros = 0; zeros < 2; zeros++) {
+            std::vector<uint8_t> in(len);
+            for (size_t i = 0; i < len; i++) in[i] = zeros && i % 97 == 0 ? 0 : (uint8_t)(i % 255 + 1);
+            std::vector<uint8_t> enc(len + len / 254 + 1);
+            size_t n = cobsEncode(in.data(), len, enc.data());
+            TEST_ASSERT_LESS_OR_EQUAL(enc.size(), n);
+            for (size_t i = 0; i < n; i++) TEST_ASSERT_NOT_EQUAL(0, enc[i]);
+            std::vector<uint8_t> dec(len + 1);
+            TEST_ASSERT_EQUAL(len, cobsDecode(enc.data(), n, dec.data()));
+            if (len) TEST_ASSERT_EQUAL_MEMORY(in.data(), dec.data(), len);
+        }
+    }
+}
+
+void test_frame_round_trip_and_damage(void) {
+    uint8_t payload[UART_PAYLOAD_MAX];
+    for (int i = 0; i < UART_PAYLOAD_MAX; i++) payload[i] = (uint8_t)i;
+    uint8_t wire[UART_WIRE_MAX];
+    size_t n = uartEncode(wire, sizeof(wire), UART_THUMB_CHUNK, 200, UART_FLAG_RESYNC,
+                          0xCAFE0001, payload, UART_PAYLOAD_MAX);
+    TEST_ASSERT_GREATER_THAN(0, n);
+    TEST_ASSERT_EQUAL(0, wire[n - 1]);
+
+    std::vector<uint8_t> copy(wire, wire + n - 1);
+    UartFrameHeader h;
+    const uint8_t* p;
+    TEST_ASSERT_TRUE(uartDecode(copy.data(), copy.size(), h, &p));
+    TEST_ASSERT_EQUAL(200, h.seq);
+    TEST_ASSERT_EQUAL(UART_FLAG_RESYNC, h.flags);
+    TEST_ASSERT_EQUAL_UINT32(0xCAFE0001, h.incidentId);
+    TEST_ASSERT_EQUAL(UART_PAYLOAD_MAX, h.payloadLen);
+    TEST_ASSERT_EQUAL_MEMORY(payload, p, UART_PAYLOAD_MAX);
+
+    // Any single flipped byte is caught
+    for (size_t i = 0; i < n - 1; i += 7) {
+        std::vector<uint8_t> bad(wire, wire + n - 1);
+        bad[i] ^= 0x04;
+        if (bad[i] == 0) continue;  // Would be a delimiter, not damage
+        TEST_ASSERT_FALSE(uartDecode(bad.data(), bad.size(), h, &p));
+    }
+    // Oversized payloads are refused at the sender
+    TEST_ASSERT_EQUAL(0, uartEncode(wire, sizeof(wire), UART_THUMB_CHUNK, 0, 0, 0,
+                                    payload, UART_PAYLOAD_MAX + 1));
+}
+
+void test_reports_arrive_in_order_after_resync(void) {
+    Loopback lb;
+    lb.begin();
+    lb.expected = 77;  // Stale expectation from before the cam's reboot
+    lb.synced = true;
+
+    for (uint32_t i = 1; i <= 5; i++) {
+        TEST_ASSERT_TRUE(lb.link.sendCaptureReport(i, capture(20000 + i)));
+    }
+    UploadReport up = { UPLOAD_RESULT_OFFLINE, 3, 0 };
+    TEST_ASSERT_TRUE(lb.link.sendUploadReport(5, up));
+    TEST_ASSERT_TRUE(lb.runUntilIdle(200));
+
+    TEST_ASSERT_EQUAL(6, lb.delivered.size());
+    TEST_ASSERT_EQUAL(UART_FLAG_RESYNC, lb.delivered[0].header.flags);
+    for (uint32_t i = 0; i < 5; i++) {
+        CaptureReport r;
+        memcpy(&r, lb.delivered[i].payload.data(), sizeof(r));
+        TEST_ASSERT_EQUAL_UINT32(i + 1, lb.delivered[i].header.incidentId);
+        TEST_ASSERT_EQUAL_UINT32(20001 + i, r.jpegBytes);
+    }
+    TEST_ASSERT_EQUAL(UART_UPLOAD_REPORT, lb.delivered[5].header.type);
+    TEST_ASSERT_EQUAL(0, lb.link.getRetransmits());
+}
+
+void test_full_window_refuses_until_acked(void) {
+    Loopback lb;
+    lb.begin();
+    lb.ackLost = true;
+    for (int i = 0; i < UART_WINDOW; i++) {
+        TEST_ASSERT_TRUE(lb.link.sendCaptureReport(i + 1, capture(1)));
+    }
+    TEST_ASSERT_FALSE(lb.link.sendCaptureReport(99, capture(1)));
+    TEST_ASSERT_EQUAL(1, lb.link.getDropped());
+
+    lb.ackLost = false;
+    TEST_ASSERT_TRUE(lb.runUntilIdle(500));
+    TEST_ASSERT_TRUE(lb.link.sendCaptureReport(100, capture(1)));
+}
+
+void test_corrupted_frames_are_resent(void) {
+    Loopback lb;
+    lb.begin();
+    lb.corrupt = [](unsigned frame) { return frame == 1 || frame == 4; };
+    for (uint32_t i = 1; i <= 6; i++) {
+        lb.link.sendCaptureReport(i, capture(i));
+    }
+    TEST_ASSERT_TRUE(lb.runUntilIdle(1000));
+
+    TEST_ASSERT_EQUAL(6, lb.delivered.size());
+    for (uint32_t i = 0; i < 6; i++) {
+        TEST_ASSERT_EQUAL_UINT32(i + 1, lb.delivered[i].header.incidentId);
+    }
+    TEST_ASSERT_GREATER_OR_EQUAL(2, lb.badFrames);
+    TEST_ASSERT_GREATER_THAN(0, lb.link.getRetransmits());
+}
+
+void test_unheard_window_is_dropped_and_resynced(void) {
+    Loopback lb;
+    lb.begin();
+    lb.ackLost = true;
+    lb.link.sendCaptureReport(1, capture(1));
+    lb.link.sendCaptureReport(2, capture(2));
+    lb.run(UART_ACK_TIMEOUT_MS * (UART_MAX_SENDS + 1) + 50);
+    TEST_ASSERT_FALSE(lb.link.busy());
+    TEST_ASSERT_EQUAL(2, lb.link.getDropped());
+    TEST_ASSERT_EQUAL(2 * (UART_MAX_SENDS - 1), lb.link.getRetransmits());
+
+    // The receiver lost sync meanwhile; the next frame restarts it
+    lb.ackLost = false;
+    lb.synced = false;
+    size_t before = lb.delivered.size();
+    lb.link.sendCaptureReport(3, capture(3));
+    TEST_ASSERT_TRUE(lb.runUntilIdle(200));
+    TEST_ASSERT_EQUAL(before + 1, lb.delivered.size());
+    TEST_ASSERT_EQUAL(UART_FLAG_RESYNC, lb.delivered.back().header.flags);
+    TEST_ASSERT_EQUAL_UINT32(3, lb.delivered.back().header.incidentId);
+}
+
+void test_reports_interleave_with_a_thumbnail_stream(void) {
+    Loopback lb;
+    lb.begin();
+    const uint16_t len = 6000;
+    uint8_t* jpeg = makeJpeg(len);
+    std::vector<uint8_t> original(jpeg, jpeg + len);
+    lb.link.setThumbnail(42, jpeg, len);
+    lb.link.onThumbRequest(42);
+    lb.run(3);
+
+    // Streaming leaves report slots free
+    TEST_ASSERT_TRUE(lb.link.sendCaptureReport(43, capture(43)));
+    TEST_ASSERT_TRUE(lb.link.sendCaptureReport(44, capture(44)));
+    TEST_ASSERT_TRUE(lb.runUntilIdle(2000));
+
+    TEST_ASSERT_TRUE(original == lb.thumbnail(42));
+    int reports = 0;
+    for (const Delivered& d : lb.delivered) reports += d.header.type == UART_CAPTURE_REPORT;
+    TEST_ASSERT_EQUAL(2, reports);
+    TEST_ASSERT_EQUAL(0, lb.link.getDropped());
+}
+
+static void throughput(const char* label, std::function<bool(unsigned)> corrupt,
+                       unsigned long& ms, unsigned& retransmits) {
+    Loopback lb;
+    lb.begin();
+    lb.corrupt = corrupt;
+    const uint16_t len = 16000;
+    uint8_t* jpeg = makeJpeg(len);
+    std::vector<uint8_t> original(jpeg, jpeg + len);
+    lb.link.setThumbnail(7, jpeg, len);
+
+    unsigned long start = millis();
+    lb.link.onThumbRequest(7);
+    TEST_ASSERT_TRUE(lb.runUntilIdle(10000));
+    ms = millis() - start;
+    retransmits = lb.link.getRetransmits();
+    TEST_ASSERT_TRUE(original == lb.thumbnail(7));
+
+    double kbps = len / 1.024 / ms;
+    double lineKbps = UART_LINK_BAUD / 10.0 / 1024.0;
+    char msg[160];
+    snprintf(msg, sizeof(msg),
+             "%s: %u B thumbnail in %lu ms = %.1f KB/s (%.0f%% of %.1f KB/s line), "
+             "%lu wire bytes, %u retransmits, %u bad frames",
+             label, len, ms, kbps, 100 * kbps / lineKbps, lineKbps,
+             lb.wireBytes, retransmits, lb.badFrames);
+    TEST_MESSAGE(msg);
+}
+
+void test_benchmark_thumbnail_throughput(void) {
+    unsigned long cleanMs, lossyMs;
+    unsigned cleanRetx, lossyRetx;
+    throughput("clean", nullptr, cleanMs, cleanRetx);
+    throughput("1 in 20 frames damaged", [](unsigned f) { return f % 20 == 7; },
+               lossyMs, lossyRetx);
+
+    TEST_ASSERT_EQUAL(0, cleanRetx);
+    // Window minus report slots, paced by acks every MAIN_POLL_MS: the
+    // clean stream should run at over half the line rate
+    double lineBytesPerMs = UART_LINK_BAUD / 10.0 / 1000.0;
+    TEST_ASSERT_LESS_THAN((unsigned long)(2 * 16000 / lineBytesPerMs), cleanMs);
+    TEST_ASSERT_GREATER_THAN(0, lossyRetx);
+    TEST_ASSERT_GREATER_THAN(cleanMs, lossyMs);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_cobs_round_trip);
+    RUN_TEST(test_frame_round_trip_and_damage);
+    RUN_TEST(test_reports_arrive_in_order_after_resync);
+    RUN_TEST(test_full_window_refuses_until_acked);
+    RUN_TEST(test_corrupted_frames_are_resent);
+    RUN_TEST(test_unheard_window_is_dropped_and_resynced);
+    RUN_TEST(test_reports_interleave_with_a_thumbnail_stream);
+    RUN_TEST(test_benchmark_thumbnail_throughput);
+    return UNITY_END();
+}
@@ -0,0 +1,205 @@
+/**
+ * Queue drain: one request per image against batch uploads
+ * A backend stand-in behind the fake WiFi client charges each request
+ * a round trip and its own handling, each stored image a write, and each
+ * byte its airtime on the link, all in simulated time. The same queue of
+ * small images (below RESUMABLE_CHUNK_BYTES, so one POST each) is drained
+ * the way uploadQueuedImages() does it without batches and then with
+ * them; both times and request counts are reported.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include "config.h"
+#include "http_upload.h"
+#include "spiffs_manager.h"
+#include "fake_http_server.h"
+
+static const char* API = "/api/v1/burglary";
+static const int QUEUED = 20;
+static const size_t IMAGE_BYTES = 12 * 1024;
+
+static const unsigned long RTT_MS = 120;             // Device to backend and back
+static const unsigned long REQUEST_MS = 60;          // Auth, parsing, response per request
+static const unsigned long STORE_MS = 15;            // Object storage write per image
+static const unsigned long LINK_BYTES_PER_MS = 400;  // ~3 Mbit/s uplink
+
+class BackendStandIn : public FakeHttpServer {
+public:
+    bool batchEndpoint = true;
+    unsigned singlePosts = 0;
+    unsigned batchPosts = 0;
+    unsigned stored = 0;
+    size_t bytesIn = 0;
+
+    BackendStandIn() {
+        handler = [this](const FakeHttpRequest& r) { return handle(r); };
+    }
+
+    size_t write(const uint8_t* buf, size_t size) override {
+        size_t n = FakeHttpServer::write(buf, size);
+        bytesIn += n;
+        fakeAdvance(n / LINK_BYTES_PER_MS);
+        return n;
+    }
+    using FakeHttpServer::write;
+
+private:
+    FakeHttpReply handle(const FakeHttpRequest& r) {
+        // The 100 Continue of a large body costs a round trip of its own
+        fakeAdvance(RTT_MS + REQUEST_MS + (r.header("Expect").empty() ? 0 : RTT_MS));
+        FakeHttpReply out;
+        if (r.method == "POST" && r.path == std::string(API) + "/image/image") {
+            singlePosts++;
+            stored++;
+            fakeAdvance(STORE_MS);
+            out.status = 201;
+            return out;
+        }
+        if (r.method == "POST" && r.path == std::string(API) + "/image/batch" && batchEndpoint) {
+            batchPosts++;
+            out.status = 207;
+            out.body = "{\"results\":[";
+            for (size_t p = r.body.find("name=\"files\""); p != std::string::npos;
+                 p = r.body.find("name=\"files\"", p + 1)) {
+                out.body += out.body.back() == '[' ? "201" : ",201";
+                stored++;
+                fakeAdvance(STORE_MS);
+            }
+            out.body += "]}";
+            return out;
+        }
+        out.status = 404;
+        return out;
+    }
+};
+
+static BackendStandIn* server;
+static SPIFFSManager* store;
+static HTTPUploader* uploader;
+static uint8_t images[QUEUED][IMAGE_BYTES];
+static uint8_t* buffers[QUEUED];
+static QueuedImage queued[QUEUED];
+static char names[QUEUED][40];
+
+// As uploadQueuedImages() after the batch pass: one request per image
+static unsigned long drainOneByOne() {
+    unsigned long start = millis();
+    for (int i = 0; i < QUEUED; i++) {
+        TEST_ASSERT_TRUE(uploader->uploadResumable(*store, queued[i], buffers[i], IMAGE_BYTES));
+    }
+    return millis() - start;
+}
+
+// As uploadQueuedBatches(): up to BATCH_UPLOAD_MAX_IMAGES and
+// BATCH_UPLOAD_MAX_BYTES per request. Returns 0 if batches were refused.
+static unsigned long drainBatched() {
+    unsigned long start = millis();
+    for (int i = 0; i < QUEUED;) {
+        int n = 0;
+        size_t budget = 0;
+        while (i + n < QUEUED && n < BATCH_UPLOAD_MAX_IMAGES &&
+               budget + IMAGE_BYTES <= BATCH_UPLOAD_MAX_BYTES) {
+            budget += IMAGE_BYTES;
+            n++;
+        }
+        int results[BATCH_UPLOAD_MAX_IMAGES];
+        int got = uploader->uploadBatch(queued + i, buffers + i, n, results);
+        if (got < 0) {
+            return 0;
+        }
+        TEST_ASSERT_EQUAL(n, got);
+        for (int k = 0; k < got; k++) {
+            TEST_ASSERT_EQUAL(201, results[k]);
+        }
+        i += n;
+    }
+    return millis() - start;
+}
+
+void setUp(void) {
+    fakeResetClock();
+    fakeNvsErase();
+    fakeFsErase();
+    for (int i = 0; i < QUEUED; i++) {
+        for (size_t b = 0; b < IMAGE_BYTES; b++) images[i][b] = (uint8_t)(b * 31 + i * 7 + (b >> 9));
+        buffers[i] = images[i];
+        snprintf(names[i], sizeof(names[i]), "/img_%lu_%08X.jpg", 1700000000ul + i, 0xA100 + i);
+        queued[i].filename = names[i];
+        queued[i].timestamp = 1700000000ul + i;
+        queued[i].incidentId = 0xA100 + i;
+        queued[i].size = IMAGE_BYTES;
+    }
+
+    server = new BackendStandIn();
+    fakeWiFiServer = server;
+    store = new SPIFFSManager();
+    TEST_ASSERT_TRUE(store->begin());
+    WiFi.fakeReset();
+    WiFi.aps = { { WIFI_SSID, { 0x10, 0x20, 0x30, 0x40, 0x50, 0x60 }, 6, -58 } };
+    uploader = new HTTPUploader(BACKEND_URL, API_KEY);
+    uploader->begin(*store);
+    for (int i = 0; i < 200 && !uploader->isConnected(); i++) {
+        uploader->pollWiFi();
+        if (WiFi.beginCount > 0 && WiFi.state != WL_CONNECTED) {
+            WiFi.fakeJoin(0x2A01A8C0);
+        }
+        fakeAdvance(WIFI_ATTEMPT_POLL_MS);
+    }
+    TEST_ASSERT_TRUE(uploader->isConnected());
+}
+
+void tearDown(void) {
+    delete uploader;
+    delete store;
+    fakeWiFiServer = nullptr;
+    delete server;
+}
+
+void test_batches_drain_the_queue_faster(void) {
+    unsigned long single = drainOneByOne();
+    unsigned singleRequests = server->requests.size();
+    size_t singleBytes = server->bytesIn;
+    TEST_ASSERT_EQUAL(QUEUED, server->singlePosts);
+
+    server->requests.clear();
+    server->bytesIn = 0;
+    server->stored = 0;
+    unsigned long batched = drainBatched();
+    TEST_ASSERT_EQUAL(QUEUED, server->stored);
+    TEST_ASSERT_EQUAL(QUEUED, server->singlePosts);  // None during the batched pass
+
+    char msg[200];
+    snprintf(msg, sizeof(msg),
+             "%d queued %u KB images: one by one %lu ms in %u requests (%u KB sent), "
+             "batched %lu ms in %u requests (%u KB sent), %.1fx faster",
+             QUEUED, (unsigned)(IMAGE_BYTES / 1024), single, singleRequests,
+             (unsigned)(singleBytes / 1024), batched, (unsigned)server->requests.size(),
+             (unsigned)(server->bytesIn / 1024), batched ? (double)single / batched : 0.0);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_EQUAL((QUEUED + BATCH_UPLOAD_MAX_IMAGES - 1) / BATCH_UPLOAD_MAX_IMAGES,
+                      server->batchPosts);
+    TEST_ASSERT_LESS_THAN(single / 2, batched);
+}
+
+void test_backend_without_batches_falls_back_to_one_by_one(void) {
+    server->batchEndpoint = false;
+    TEST_ASSERT_EQUAL(0, drainBatched());
+    TEST_ASSERT_FALSE(uploader->batchEnabled());
+    TEST_ASSERT_EQUAL(0, server->stored);
+
+    // Later passes skip the batch request altogether
+    int results[BATCH_UPLOAD_MAX_IMAGES];
+    TEST_ASSERT_EQUAL(0, uploader->uploadBatch(queued, buffers, 2, results));
+    TEST_ASSERT_EQUAL(1, server->requests.size());
+
+    drainOneByOne();
+    TEST_ASSERT_EQUAL(QUEUED, server->stored);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_batches_drain_the_queue_faster);
+    RUN_TEST(test_backend_without_batches_falls_back_to_one_by_one);
+    return UNITY_END();
+}
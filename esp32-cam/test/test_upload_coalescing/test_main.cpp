@@ -0,0 +1,290 @@
+/**
+ * Upload write coalescing against a TLS stand-in
+ * The stand-in client turns every write() into one TLS record (split at
+ * the maximum fragment length), charges the CPU cost of each record and
+ * byte in simulated time, and sends it as its own TCP segments over a
+ * link with a fixed per-segment airtime. While more than a socket
+ * buffer is unsent it takes nothing (WANT_WRITE).
+ *
+ * The same multipart image upload goes out the old way (header lines
+ * and 1 KB JPEG chunks as separate writes) and through httpWriteSlices
+ * with record staging; records, wire bytes and KB/s are reported.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include "config.h"
+#include "http_request.h"
+
+static const unsigned long RECORD_US = 250;   // mbedTLS record setup + MAC finish
+static const unsigned long BYTE_NS = 120;     // Encrypt + MAC per byte
+static const size_t RECORD_OVERHEAD = 29;     // Header, explicit IV, tag
+static const size_t MSS = 1436;
+static const size_t SEGMENT_HEADERS = 40;     // IP + TCP
+static const unsigned long SEGMENT_US = 150;  // WiFi frame airtime overhead (preamble, ACK, backoff)
+static const unsigned long LINK_BYTES_PER_MS = 800;
+static const size_t SND_BUF = 5744;           // lwIP TCP_SND_BUF
+
+class TlsStandIn : public Client {
+public:
+    size_t maxFragment = 16384;
+    bool linkDown = false;      // Nothing drains: a stalled peer
+    bool open = true;
+
+    unsigned records = 0;
+    unsigned segments = 0;
+    unsigned refused = 0;       // WANT_WRITE answers
+    size_t payload = 0;
+    size_t wire = 0;
+    uint32_t sum = 0;
+    std::vector<size_t> recordSizes;
+
+    // When the last queued byte is on the air
+    uint64_t linkFreeAt = 0;
+
+    int connect(IPAddress ip, uint16_t port) override { return 1; }
+    int connect(const char* host, uint16_t port) override { return 1; }
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buf, size_t size) override {
+        if (!open) return 0;
+        if (backlogBytes() > SND_BUF || linkDown) {
+            refused++;
+            return 0;
+        }
+        size_t n = size < maxFragment ? size : maxFragment;
+        fakeAdvanceUs(RECORD_US + n * BYTE_NS / 1000);
+
+        size_t recordWire = n + RECORD_OVERHEAD;
+        unsigned segs = (recordWire + MSS - 1) / MSS;
+        size_t onAir = recordWire + segs * SEGMENT_HEADERS;
+        uint64_t start = linkFreeAt > fakeNowUs ? linkFreeAt : fakeNowUs;
+        linkFreeAt = start + onAir * 1000 / LINK_BYTES_PER_MS + segs * SEGMENT_US;
+
+        records++;
+        segments += segs;
+        payload += n;
+        wire += onAir;
+        recordSizes.push_back(n);
+        for (size_t i = 0; i < n; i++) sum += buf[i];
+        return n;
+    }
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int read(uint8_t* buf, size_t size) override { return -1; }
+    int peek() override { return -1; }
+    void stop() override { open = false; }
+    uint8_t connected() override { return open; }
+    using Print::write;
+
+private:
+    size_t backlogBytes() const {
+        if (linkFreeAt <= fakeNowUs) return 0;
+        return (linkFreeAt - fakeNowUs) * LINK_BYTES_PER_MS / 1000;
+    }
+};
+
+static const size_t JPEG_BYTES = 150 * 1024;
+static uint8_t jpeg[JPEG_BYTES];
+
+struct Upload {
+    char headers[6][96];
+    size_t headerLens[6];
+    char preamble[160];
+    size_t preambleLen;
+    const char* trailer = "\r\n------ESP32CAMBoundary--\r\n";
+
+    Upload() {
+        preambleLen = snprintf(preamble, sizeof(preamble),
+                               "------ESP32CAMBoundary\r\nContent-Disposition: form-data; "
+                               "name=\"image\"; filename=\"capture.jpg\"\r\n"
+                               "Content-Type: image/jpeg\r\n\r\n");
+        size_t bodyLen = preambleLen + JPEG_BYTES + strlen(trailer);
+        const char* lines[] = {
+            "POST /api/v1/burglary/image/image HTTP/1.1\r\nHost: backend.example\r\n",
+            "User-Agent: ESP32-CAM\r\n",
+            "X-API-Key: esp32_device_key_xyz789\r\n",
+            "Content-Type: multipart/form-data; boundary=----ESP32CAMBoundary\r\n",
+            nullptr,
+            "Connection: keep-alive\r\n\r\n",
+        };
+        for (int i = 0; i < 6; i++) {
+            if (lines[i]) {
+                headerLens[i] = snprintf(headers[i], sizeof(headers[i]), "%s", lines[i]);
+            } else {
+                headerLens[i] = snprintf(headers[i], sizeof(headers[i]),
+                                         "Content-Length: %u\r\n", (unsigned)bodyLen);
+            }
+        }
+    }
+
+    size_t bytes() const {
+        size_t n = preambleLen + JPEG_BYTES + strlen(trailer);
+        for (int i = 0; i < 6; i++) n += headerLens[i];
+        return n;
+    }
+
+    uint32_t sum() const {
+        uint32_t s = 0;
+        for (int i = 0; i < 6; i++) {
+            for (size_t j = 0; j < headerLens[i]; j++) s += (uint8_t)headers[i][j];
+        }
+        for (size_t j = 0; j < preambleLen; j++) s += (uint8_t)preamble[j];
+        for (size_t j = 0; j < JPEG_BYTES; j++) s += jpeg[j];
+        for (const char* p = trailer; *p; p++) s += (uint8_t)*p;
+        return s;
+    }
+};
+
+// One old-style print() or write(), retried until the client took it all
+static void put(TlsStandIn& tls, const uint8_t* p, size_t n) {
+    while (n > 0) {
+        size_t w = tls.write(p, n);
+        if (w == 0) delay(1);
+        p += w;
+        n -= w;
+    }
+}
+
+// What uploadImageFromBuffer used to do: print() per header, then the
+// JPEG in 1 KB write() calls
+static void sendOldWay(TlsStandIn& tls, const Upload& up) {
+    for (int i = 0; i < 6; i++) put(tls, (const uint8_t*)up.headers[i], up.headerLens[i]);
+    put(tls, (const uint8_t*)up.preamble, up.preambleLen);
+    for (size_t off = 0; off < JPEG_BYTES; off += 1024) {
+        put(tls, jpeg + off, JPEG_BYTES - off < 1024 ? JPEG_BYTES - off : 1024);
+    }
+    put(tls, (const uint8_t*)up.trailer, strlen(up.trailer));
+}
+
+static bool sendSlices(TlsStandIn& tls, const Upload& up, uint8_t* stage, size_t stageLen,
+                       HttpWriteStats* stats = nullptr, unsigned long stallMs = SERVER_TIMEOUT_MS) {
+    HttpSlice slices[9];
+    for (int i = 0; i < 6; i++) slices[i] = { (const uint8_t*)up.headers[i], up.headerLens[i] };
+    slices[6] = { (const uint8_t*)up.preamble, up.preambleLen };
+    slices[7] = { jpeg, JPEG_BYTES };
+    slices[8] = { (const uint8_t*)up.trailer, strlen(up.trailer) };
+    return httpWriteSlices(tls, slices, 9, stallMs, stage, stageLen, stats);
+}
+
+static void report(const char* what, const TlsStandIn& tls, unsigned long us) {
+    char msg[192];
+    snprintf(msg, sizeof(msg),
+             "%s: %u records, %u segments, %u B on the wire for %u B (+%.1f%%), "
+             "%lu ms, %.0f KB/s",
+             what, tls.records, tls.segments, (unsigned)tls.wire, (unsigned)tls.payload,
+             100.0 * (tls.wire - tls.payload) / tls.payload, us / 1000,
+             tls.payload / 1.024 / (us / 1000.0));
+    TEST_MESSAGE(msg);
+}
+
+// Until the last byte is on the air
+static unsigned long finish(TlsStandIn& tls, uint64_t startUs) {
+    uint64_t end = tls.linkFreeAt > fakeNowUs ? tls.linkFreeAt : fakeNowUs;
+    return (unsigned long)(end - startUs);
+}
+
+void setUp(void) {
+    fakeResetClock();
+    for (size_t i = 0; i < JPEG_BYTES; i++) jpeg[i] = (uint8_t)(i * 7 + (i >> 11));
+}
+
+void tearDown(void) {}
+
+void test_staged_records_are_full_size(void) {
+    static uint8_t stage[TLS_RECORD_BYTES];
+    TlsStandIn tls;
+    Upload up;
+    HttpWriteStats stats;
+    TEST_ASSERT_TRUE(sendSlices(tls, up, stage, sizeof(stage), &stats));
+
+    TEST_ASSERT_EQUAL(up.bytes(), tls.payload);
+    TEST_ASSERT_EQUAL_UINT32(up.sum(), tls.sum);
+    TEST_ASSERT_EQUAL(up.bytes(), stats.bytes);
+    TEST_ASSERT_EQUAL(tls.records, stats.writes);
+    for (size_t i = 0; i + 1 < tls.recordSizes.size(); i++) {
+        TEST_ASSERT_EQUAL(TLS_RECORD_BYTES, tls.recordSizes[i]);
+    }
+    TEST_ASSERT_GREATER_THAN(0, tls.refused);  // Partial progress was waited out
+}
+
+void test_writes_larger_than_a_fragment_are_finished(void) {
+    // Negotiated max fragment length below the staging size: each staged
+    // write is taken in parts, and every part is retried to the end
+    static uint8_t stage[TLS_RECORD_BYTES];
+    TlsStandIn tls;
+    tls.maxFragment = 1024;
+    Upload up;
+    TEST_ASSERT_TRUE(sendSlices(tls, up, stage, sizeof(stage)));
+    TEST_ASSERT_EQUAL(up.bytes(), tls.payload);
+    TEST_ASSERT_EQUAL_UINT32(up.sum(), tls.sum);
+}
+
+void test_stalled_link_gives_up_after_the_stall_time(void) {
+    static uint8_t stage[TLS_RECORD_BYTES];
+    TlsStandIn tls;
+    Upload up;
+    tls.linkDown = true;
+    unsigned long start = millis();
+    TEST_ASSERT_FALSE(sendSlices(tls, up, stage, sizeof(stage), nullptr, 2000));
+    unsigned long waited = millis() - start;
+    TEST_ASSERT_GREATER_OR_EQUAL(2000, waited);
+    TEST_ASSERT_LESS_THAN(2010, waited);
+    // One delay(1) per refusal: the task blocks and the watchdog is fed
+    TEST_ASSERT_GREATER_OR_EQUAL(waited - 1, tls.refused);
+}
+
+void test_dropped_connection_fails_at_once(void) {
+    static uint8_t stage[TLS_RECORD_BYTES];
+    TlsStandIn tls;
+    Upload up;
+    tls.open = false;
+    unsigned long start = millis();
+    TEST_ASSERT_FALSE(sendSlices(tls, up, stage, sizeof(stage)));
+    TEST_ASSERT_LESS_THAN(5, millis() - start);
+}
+
+void test_benchmark_old_writes_against_staged_records(void) {
+    Upload up;
+    uint64_t start;
+
+    TlsStandIn before;
+    start = fakeNowUs;
+    sendOldWay(before, up);
+    unsigned long beforeUs = finish(before, start);
+    report("print/1 KB writes", before, beforeUs);
+
+    TlsStandIn direct;
+    start = fakeNowUs;
+    TEST_ASSERT_TRUE(sendSlices(direct, up, nullptr, 0));
+    unsigned long directUs = finish(direct, start);
+    report("slices, no staging", direct, directUs);
+
+    static uint8_t stage[TLS_RECORD_BYTES];
+    TlsStandIn staged;
+    start = fakeNowUs;
+    TEST_ASSERT_TRUE(sendSlices(staged, up, stage, sizeof(stage)));
+    unsigned long stagedUs = finish(staged, start);
+    report("slices, 4 KB records", staged, stagedUs);
+
+    static uint8_t bigStage[16384];
+    TlsStandIn full;
+    start = fakeNowUs;
+    TEST_ASSERT_TRUE(sendSlices(full, up, bigStage, sizeof(bigStage)));
+    unsigned long fullUs = finish(full, start);
+    report("slices, 16 KB records", full, fullUs);
+
+    TEST_ASSERT_EQUAL(before.payload, staged.payload);
+    TEST_ASSERT_LESS_THAN(before.records / 4, staged.records);
+    TEST_ASSERT_LESS_THAN(before.wire, staged.wire);
+    TEST_ASSERT_LESS_THAN(beforeUs, stagedUs);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_staged_records_are_full_size);
+    RUN_TEST(test_writes_larger_than_a_fragment_are_finished);
+    RUN_TEST(test_stalled_link_gives_up_after_the_stall_time);
+    RUN_TEST(test_dropped_connection_fails_at_once);
+    RUN_TEST(test_benchmark_old_writes_against_staged_records);
+    return UNITY_END();
+}
@@ -0,0 +1,80 @@
+/**
+ * Alert Dispatcher Module
+ * Starts every alert channel at once and tracks each to its deadline
+ *
+ * Channel tasks report back with reportResult(); the sensing task calls
+ * poll() every tick to re-queue failed channels and expire overdue ones.
+ * Time-to-first-notification is the earliest SMS/backend completion.
+ */
+
+#ifndef ALERT_DISPATCHER_H
+#define ALERT_DISPATCHER_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "system_tasks.h"
+
+enum AlertChannel {
+    CH_CAMERA = 0,
+    CH_SMS,
+    CH_BACKEND,
+    CH_COUNT
+};
+
+enum ChannelState {
+    CH_STATE_IDLE,
+    CH_STATE_PENDING,    // Queued or running
+    CH_STATE_RETRY,      // Failed, waiting for retry slot
+    CH_STATE_DONE,
+    CH_STATE_FAILED,     // Out of attempts
+    CH_STATE_TIMED_OUT   // Deadline passed
+};
+
+struct ChannelPolicy {
+    unsigned long deadlineMs;  // Relative to detection
+    uint8_t maxAttempts;
+};
+
+struct ChannelStatus {
+    ChannelState state;
+    uint8_t attempts;
+    unsigned long completedAt;  // ms after detection, 0 if not done
+    unsigned long retryAt;      // millis() of next retry
+};
+
+struct IncidentStatus {
+    bool active;
+    AlertEvent event;
+    ChannelStatus channels[CH_COUNT];
+};
+
+class AlertDispatcher {
+private:
+    IncidentStatus incidents[DISPATCH_MAX_INCIDENTS];
+    int nextSlot;
+    portMUX_TYPE lock;
+
+    unsigned long lastTimeToFirstNotification;
+
+    static const ChannelPolicy policies[CH_COUNT];
+
+    IncidentStatus* findIncident(uint32_t sequence);
+    bool enqueue(AlertChannel channel, const AlertEvent& event);
+    bool isTerminal(ChannelState state) const;
+    void finishIncident(IncidentStatus& incident);
+
+public:
+    AlertDispatcher();
+
+    void dispatch(const AlertEvent& event);
+    // retryable=false ends the channel even if attempts remain (e.g. rate limited)
+    void reportResult(uint32_t sequence, AlertChannel channel, bool success, bool retryable = true);
+    void poll();
+
+    unsigned long getLastTimeToFirstNotification() const { return lastTimeToFirstNotification; }
+    static const char* channelName(AlertChannel channel);
+};
+
+extern AlertDispatcher dispatcher;
+
+#endif // ALERT_DISPATCHER_H
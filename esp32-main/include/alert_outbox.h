@@ -0,0 +1,71 @@
+/**
+ * Alert Outbox Module
+ * NVS-backed ring of alert records awaiting backend delivery
+ *
+ * Records are keyed by incident ID, which is also the basis of the
+ * idempotency key sent on every attempt so the backend can drop repeats.
+ */
+
+#ifndef ALERT_OUTBOX_H
+#define ALERT_OUTBOX_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include "config.h"
+
+#define PIR_MASK_LEFT 0x01
+#define PIR_MASK_MIDDLE 0x02
+#define PIR_MASK_RIGHT 0x04
+
+enum AlertNetwork : uint8_t {
+    ALERT_NET_ONLINE = 0,
+    ALERT_NET_GPRS = 1,
+    ALERT_NET_OFFLINE = 2  // No transport when detected
+};
+
+// 16 bytes on flash
+struct __attribute__((packed)) AlertRecord {
+    uint32_t id;          // Incident ID (see AlertEvent), never reused
+    uint32_t timestamp;   // Epoch seconds, 0 if clock not synced
+    uint32_t sequence;    // Detection sequence this boot (0 after reboot)
+    uint8_t confidence;   // Percent
+    uint8_t pirMask;      // PIR_MASK_*
+    uint8_t network;      // AlertNetwork at detection
+    uint8_t attempts;
+};
+
+class AlertOutbox {
+private:
+    struct __attribute__((packed)) Store {
+        uint8_t head;
+        uint8_t count;
+        AlertRecord records[ALERT_OUTBOX_CAPACITY];
+    };
+
+    Preferences prefs;
+    Store store;
+    uint32_t droppedCount;
+    bool storageReady;
+
+    void save();
+
+public:
+    AlertOutbox();
+
+    void begin();
+
+    // Persists rec (id set by the caller); drops the oldest record when full
+    bool push(const AlertRecord& rec);
+
+    // Copies up to max oldest records, returns how many
+    int peek(AlertRecord* out, int max) const;
+
+    void remove(uint32_t id);
+    void pop(int n);  // Drop the n oldest records (after a batch is accepted)
+    void markAttempt(uint32_t id);
+
+    int depth() const { return store.count; }
+    uint32_t getDroppedCount() const { return droppedCount; }
+};
+
+#endif // ALERT_OUTBOX_H
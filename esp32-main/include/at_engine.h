@@ -0,0 +1,158 @@
+/**
+ * AT Command Engine
+ * Non-blocking AT command queue and URC dispatcher for the SIM800L
+ *
+ * Bytes are tokenized into lines in a fixed buffer. Each queued command
+ * carries its own timeout and completion callback; lines that are not a
+ * response to the active command are matched against registered
+ * unsolicited result code (URC) prefixes. Call poll() regularly from the
+ * task that owns the modem - it never blocks.
+ *
+ * With setSleepAfter() the engine assumes the modem has dropped into
+ * slow-clock sleep once the UART has been quiet that long, and sends
+ * short "AT" probes until one is answered before writing the next
+ * command (the first characters after wake-up are lost). A modem that
+ * woke mid-probe may answer more than one of them, so the command only
+ * goes out once every probe is answered or the line has been quiet for
+ * AT_WAKE_SETTLE_MS; a late probe "OK" must not complete the command.
+ */
+
+#ifndef AT_ENGINE_H
+#define AT_ENGINE_H
+
+#include <Arduino.h>
+
+#define AT_LINE_MAX 128       // Longest line kept; excess bytes are dropped
+#define AT_CMD_MAX 64         // Command text incl. terminator
+#define AT_PREFIX_MAX 12      // Response prefix, e.g. "+CSQ:"
+#define AT_PAYLOAD_MAX 161    // Text sent after a '>' prompt (one SMS)
+#define AT_INFO_MAX 128       // Collected intermediate response lines
+#define AT_QUEUE_DEPTH 6
+#define AT_MAX_URC_HANDLERS 8
+#define AT_WAKE_PROBE_MS 100  // Wait per wake probe
+#define AT_WAKE_MAX_PROBES 10
+#define AT_WAKE_SETTLE_MS 50  // Quiet after the wake OK before the command goes out
+
+enum ATResultCode {
+    AT_RESULT_OK,
+    AT_RESULT_ERROR,     // ERROR, +CME ERROR or +CMS ERROR (text in info)
+    AT_RESULT_TIMEOUT
+};
+
+struct ATResponse {
+    ATResultCode code;
+    const char* info;          // Intermediate lines, '\n' separated
+    unsigned long elapsedMs;   // Send to final result
+};
+
+typedef void (*ATCallback)(const ATResponse& response, void* ctx);
+typedef void (*URCHandler)(const char* line, void* ctx);
+typedef void (*WakeHook)(void* ctx);
+
+class ATEngine {
+private:
+    struct ATCommand {
+        char command[AT_CMD_MAX];
+        char prefix[AT_PREFIX_MAX];
+        char payload[AT_PAYLOAD_MAX];  // Empty unless a '>' prompt is expected
+        unsigned long timeoutMs;
+        ATCallback callback;
+        void* ctx;
+    };
+
+    struct URCEntry {
+        const char* prefix;
+        URCHandler handler;
+        void* ctx;
+    };
+
+    Stream* stream;
+
+    char line[AT_LINE_MAX];
+    size_t lineLen;
+
+    ATCommand queue[AT_QUEUE_DEPTH];
+    uint8_t head;
+    uint8_t count;
+
+    bool active;              // queue[head] has been written to the modem
+    bool payloadSent;
+    unsigned long sentAt;
+    unsigned long startedAt;  // Includes any wake-up before sentAt
+    char info[AT_INFO_MAX];
+    size_t infoLen;
+
+    URCEntry urcs[AT_MAX_URC_HANDLERS];
+    uint8_t urcCount;
+
+    unsigned long commandsCompleted;
+    unsigned long commandsTimedOut;
+
+    // Sleep tracking
+    unsigned long sleepAfterMs;  // 0 = modem never sleeps
+    unsigned long lastTrafficAt;
+    bool waking;
+    uint8_t wakeProbes;
+    uint8_t wakeUnanswered;   // Probes sent minus OKs seen
+    bool wakeAnswered;        // Awake, waiting out the other probes
+    WakeHook wakeHook;
+    void* wakeCtx;
+    unsigned long wakeCount;
+    unsigned long lastWakeMs;
+    unsigned long lastPromptMs;
+    unsigned long lastPromptAt;
+    unsigned long asleepTotalMs;
+
+    void startNext();
+    void writeCommand();
+    void sendWakeProbe();
+    void endWake();
+    void finish(ATResultCode code);
+    void handleLine(const char* text);
+    bool dispatchURC(const char* text);
+    void appendInfo(const char* text);
+
+public:
+    ATEngine();
+
+    void begin(Stream* modemStream);
+
+    // Queue a command. prefix selects which intermediate lines belong to
+    // the response (e.g. "+CSQ:"); payload, if given, is written after the
+    // '>' prompt followed by Ctrl+Z. Returns false when the queue is full.
+    bool submit(const char* command, unsigned long timeoutMs,
+                ATCallback callback = nullptr, void* ctx = nullptr,
+                const char* prefix = nullptr, const char* payload = nullptr);
+
+    bool onURC(const char* prefix, URCHandler handler, void* ctx = nullptr);
+
+    // Read whatever is buffered, dispatch complete lines, expire timeouts
+    void poll();
+
+    // Blocking helper for boot-time setup only: submits and pumps poll()
+    // until the result arrives. infoOut may be nullptr.
+    ATResultCode execute(const char* command, unsigned long timeoutMs,
+                         const char* prefix = nullptr,
+                         char* infoOut = nullptr, size_t infoOutLen = 0);
+
+    // Drop any partial line and pending bytes (e.g. after modem power-up)
+    void flushInput();
+
+    // Modem sleeps after idleMs of UART silence; hook (optional) runs
+    // before the first wake probe, e.g. to pull DTR low
+    void setSleepAfter(unsigned long idleMs, WakeHook hook = nullptr, void* ctx = nullptr);
+    bool isLikelyAsleep() const;
+    unsigned long idleFor() const { return millis() - lastTrafficAt; }
+
+    bool isIdle() const { return count == 0; }
+    uint8_t pending() const { return count; }
+    unsigned long getCompletedCount() const { return commandsCompleted; }
+    unsigned long getTimeoutCount() const { return commandsTimedOut; }
+    unsigned long getWakeCount() const { return wakeCount; }
+    unsigned long getLastWakeMs() const { return lastWakeMs; }      // First probe to OK
+    unsigned long getLastPromptMs() const { return lastPromptMs; }  // Dequeue (incl. wake) to '>'
+    unsigned long getLastPromptAt() const { return lastPromptAt; }  // millis() of the last '>'
+    unsigned long getAsleepMs() const;  // Estimated time spent asleep
+};
+
+#endif // AT_ENGINE_H
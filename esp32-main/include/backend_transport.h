@@ -0,0 +1,116 @@
+/**
+ * Backend Transport Module
+ * Byte pipes BackendClient can POST through: WiFi or SIM800L GPRS
+ */
+
+#ifndef BACKEND_TRANSPORT_H
+#define BACKEND_TRANSPORT_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+#include <TinyGsmClient.h>
+#include "gsm_handler.h"
+#include "http_request.h"
+#include "liveness.h"
+#include "wire_format.h"
+
+class BackendTransport {
+protected:
+    unsigned long heartbeatMaxS;  // Last HEARTBEAT_MAX_HEADER, 0 = never
+    char acceptPost[HTTP_ACCEPT_POST_MAX];  // Last ACCEPT_POST_HEADER, "" = never
+
+    // One request/response on an open connection; closes it unless the
+    // server keeps it alive. Returns the status, negative on failure.
+    int exchange(Client& client, const HttpEndpoint& endpoint, const char* apiKey,
+                 const char* path, const char* contentType,
+                 const uint8_t* body, size_t length,
+                 const HttpHeader* headers, size_t headerCount);
+    // HEAD request on an open connection; same contract as exchange()
+    int head(Client& client, const HttpEndpoint& endpoint, const char* apiKey, const char* path);
+
+public:
+    BackendTransport() : heartbeatMaxS(0) { acceptPost[0] = '\0'; }
+    virtual ~BackendTransport() {}
+
+    virtual const char* name() const = 0;
+    virtual bool isAvailable() = 0;
+
+    // POST body to baseUrl + path with optional extra headers. Returns the
+    // HTTP status code, or a negative value on transport failure.
+    virtual int post(const char* path, const char* contentType,
+                     const uint8_t* body, size_t length,
+                     const HttpHeader* headers, size_t headerCount) = 0;
+
+    // Opens the connection ahead of a likely post (DNS, TCP and TLS), then
+    // HEADs headPath unless it is "". connectMs = time spent connecting,
+    // 0 if a kept-alive connection was already open. False if nothing
+    // could be opened; transports that cannot pre-warm always say so.
+    virtual bool prewarm(const char* headPath, unsigned long& connectMs) { return false; }
+    virtual bool isWarm() { return false; }  // Connection open right now
+    virtual void closeIdle() {}
+
+    unsigned long getHeartbeatMaxS() const { return heartbeatMaxS; }
+    const char* getAcceptPost() const { return acceptPost[0] ? acceptPost : nullptr; }
+};
+
+// Keeps one connection open so back-to-back posts (outbox replay, traces
+// after an alert) skip the TCP and TLS handshakes.
+class WiFiTransport : public BackendTransport {
+private:
+    HttpEndpoint endpoint;
+    const char* apiKey;
+    WiFiClientSecure secureClient;
+    WiFiClient plainClient;
+    Client* client;
+
+public:
+    WiFiTransport(const char* url, const char* key);
+
+    const char* name() const override { return "wifi"; }
+    bool isAvailable() override;
+    int post(const char* path, const char* contentType,
+             const uint8_t* body, size_t length,
+             const HttpHeader* headers, size_t headerCount) override;
+
+    bool prewarm(const char* headPath, unsigned long& connectMs) override;
+    bool isWarm() override { return client->connected(); }
+    void closeIdle() override { client->stop(); }
+};
+
+// Keeps the PDP context and the TCP/TLS connection open between posts so
+// only the first alert pays for GPRS attach and connect.
+class GprsTransport : public BackendTransport {
+private:
+    GSMHandler* gsm;
+    TinyGsm modem;
+    TinyGsmClientSecure secureClient;
+    TinyGsmClient plainClient;
+    Client* client;
+    uint8_t mux;               // TinyGSM socket of client
+    volatile bool peerClosed;  // Close URC seen by the GSM task, not yet acted on
+
+    HttpEndpoint endpoint;
+    const char* apiKey;
+
+    bool attached;
+    unsigned long lastAttachMs;
+    unsigned long lastConnectMs;
+
+    bool ensureSession();
+    static void onSocketClosed(uint8_t closedMux, void* ctx);
+
+public:
+    GprsTransport(GSMHandler* handler, const char* url, const char* key);
+
+    const char* name() const override { return "gprs"; }
+    bool isAvailable() override;
+    int post(const char* path, const char* contentType,
+             const uint8_t* body, size_t length,
+             const HttpHeader* headers, size_t headerCount) override;
+
+    unsigned long getLastAttachMs() const { return lastAttachMs; }
+    unsigned long getLastConnectMs() const { return lastConnectMs; }
+};
+
+#endif // BACKEND_TRANSPORT_H
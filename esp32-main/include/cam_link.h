@@ -0,0 +1,73 @@
+/**
+ * Camera Link Module
+ * ESP-NOW trigger delivery to the ESP32-CAM with acks and retransmits
+ *
+ * The cam answers every valid trigger with FRAME_ACK carrying the same
+ * seq. sendTrigger() retransmits the same seq until an ack arrives or the
+ * send budget is spent; the caller falls back to the wire pulse only then.
+ *
+ * The same peer carries the reverse path of the cam's UART link
+ * (cam_uart.h), the image relay (relay_receiver.h) and telemetry acks
+ * (cam_telemetry.h); those control frames are sent unacked.
+ */
+
+#ifndef CAM_LINK_H
+#define CAM_LINK_H
+
+#include <Arduino.h>
+#include <esp_now.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "espnow_protocol.h"
+
+struct CamLinkStats {
+    uint32_t triggers;     // sendTrigger() calls
+    uint32_t acked;
+    uint32_t retransmits;
+    uint32_t unacked;      // Gave up - wire fallback expected
+    uint32_t rttMinUs;
+    uint32_t rttMaxUs;
+    uint32_t rttLastUs;
+    uint64_t rttSumUs;     // / acked = mean
+};
+
+class CamLink {
+private:
+    uint8_t peer[6];
+    uint16_t nextSeq;
+    bool ready;
+
+    volatile TaskHandle_t waiter;
+    volatile uint16_t awaitedSeq;
+
+    CamLinkStats stats;
+    portMUX_TYPE statsLock;
+
+    static CamLink* instance;
+    static void onRecv(const uint8_t* mac, const uint8_t* data, int len);
+
+    void recordRtt(uint32_t rttUs);
+
+public:
+    CamLink();
+
+    // Initializes ESP-NOW and registers the cam as a peer
+    bool begin(const uint8_t* peerMac);
+
+    // Blocks the calling task until acked or ESPNOW_MAX_SENDS are used up
+    bool sendTrigger(uint32_t incidentId);
+
+    // Fire-and-forget control frames; safe from the ESP-NOW callback
+    bool sendControl(EspNowFrameType type, uint16_t seq, uint32_t incidentId,
+                     const void* payload = nullptr, uint8_t payloadLen = 0);
+    bool sendLinkAck(uint8_t nextSeq);
+    bool sendThumbRequest(uint32_t incidentId);
+
+    bool isReady() const { return ready; }
+    CamLinkStats getStats();
+    void printStats();
+};
+
+extern CamLink camLink;
+
+#endif // CAM_LINK_H
@@ -0,0 +1,59 @@
+/**
+ * Camera Telemetry Module
+ * Latest heartbeat the ESP32-CAM sent over ESP-NOW
+ *
+ * The cam no longer opens its own HTTPS connection for heartbeats. It
+ * sends FRAME_CAM_TELEMETRY every HEARTBEAT_INTERVAL_MS, the receive
+ * callback stores it and acks with whether the backend task will forward
+ * it, and the backend task adds it to the group heartbeat. The group
+ * heartbeat may stretch past CAM_TELEMETRY_STALE_MS while quiet, so a
+ * report acked as forwarded makes it due within CAM_TELEMETRY_FORWARD_MS.
+ */
+
+#ifndef CAM_TELEMETRY_H
+#define CAM_TELEMETRY_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include "espnow_protocol.h"
+#include "config.h"
+
+// What the group heartbeat needs about the cam
+struct CamHeartbeat {
+    CamTelemetry report;
+    uint32_t ageMs;         // Since the report arrived
+    uint8_t mac[6];
+};
+
+class CamTelemetryStore {
+private:
+    CamTelemetry latest;
+    uint8_t mac[6];
+    unsigned long receivedAt;
+    bool haveReport;
+    volatile bool forwarding;
+    bool pendingForward;         // Acked as forwarded, not posted yet
+    unsigned long pendingSince;  // Oldest such report
+    uint32_t reports;
+    portMUX_TYPE lock;
+
+public:
+    CamTelemetryStore();
+
+    // ESP-NOW receive callback context; acks the report
+    void onFrame(const uint8_t* senderMac, const EspNowHeader& header, const uint8_t* payload);
+
+    // Backend task: whether reports arriving now will be posted
+    void setForwarding(bool canForward) { forwarding = canForward; }
+
+    // False until a report arrives or once it is older than CAM_TELEMETRY_STALE_MS
+    bool get(CamHeartbeat& out);
+    // Until a report acked as forwarded must go out; ULONG_MAX if none
+    unsigned long msUntilForwardDue();
+    void markForwarded();  // Group heartbeat sent (or attempted)
+    uint32_t getReportCount() const { return reports; }
+};
+
+extern CamTelemetryStore camTelemetry;
+
+#endif // CAM_TELEMETRY_H
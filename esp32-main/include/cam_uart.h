@@ -0,0 +1,96 @@
+/**
+ * Camera UART Module
+ * Receiving end of the ESP32-CAM's framed status link (uart_protocol.h)
+ *
+ * The cam reports the outcome of every capture and upload. When it had no
+ * WiFi it also keeps a small thumbnail, which the main controller can pull
+ * over the same link and forward over GPRS. Acks and pull requests go back
+ * over ESP-NOW through camLink.
+ */
+
+#ifndef CAM_UART_H
+#define CAM_UART_H
+
+#include <Arduino.h>
+#include <HardwareSerial.h>
+#include <freertos/FreeRTOS.h>
+#include "uart_protocol.h"
+#include "config.h"
+
+struct CamStatus {
+    uint32_t captureIncident;
+    CaptureReport capture;
+    unsigned long captureAt;  // millis() at arrival, 0 = none yet
+    uint32_t uploadIncident;
+    UploadReport upload;
+    unsigned long uploadAt;
+};
+
+struct CamUartStats {
+    uint32_t frames;      // Accepted in order
+    uint32_t bytes;       // Raw bytes read
+    uint32_t badFrames;   // CRC, COBS or length errors - lower the baud if this climbs
+    uint32_t outOfOrder;  // Dropped; the cam resends from the gap
+    uint32_t duplicates;  // Resent after a lost ack
+};
+
+class CamUart {
+private:
+    enum ThumbState : uint8_t {
+        THUMB_IDLE,
+        THUMB_PULLING,
+        THUMB_READY
+    };
+
+    HardwareSerial* serial;
+    uint8_t rxBuf[UART_WIRE_MAX];
+    size_t rxLen;
+    bool rxOverflow;     // Discard until the next delimiter
+    uint8_t expectedSeq;
+    bool synced;
+    bool ackDue;
+
+    CamStatus status;
+    CamUartStats stats;
+    portMUX_TYPE lock;
+
+    // Thumbnail offered by the latest capture report
+    uint32_t offeredIncident;
+    bool offerPending;
+
+    // Pull in progress or finished; the buffer belongs to the backend
+    // task while READY
+    uint8_t thumb[CAM_THUMB_MAX];
+    uint32_t thumbIncident;
+    uint16_t thumbTotal;
+    uint16_t thumbReceived;
+    unsigned long thumbActivityAt;
+    volatile ThumbState thumbState;
+
+    void handleFrame(const UartFrameHeader& header, const uint8_t* payload);
+    void handleThumbChunk(uint32_t incidentId, const uint8_t* payload, uint16_t len);
+
+public:
+    CamUart(HardwareSerial* port);
+
+    void begin();
+
+    // Camera task: reads frames, sends the cumulative ack, expires a
+    // stalled pull
+    void poll();
+
+    CamStatus getStatus();
+    CamUartStats getStats();
+    void printStats();
+
+    // Thumbnail pull (camera task)
+    bool takeThumbnailOffer(uint32_t& incidentId);
+    bool requestThumbnail(uint32_t incidentId);
+    bool isPulling() const { return thumbState == THUMB_PULLING; }
+
+    // Forwarding (backend task): valid until releaseThumbnail()
+    bool getThumbnail(uint32_t& incidentId, const uint8_t*& data, size_t& len);
+    void releaseThumbnail();
+};
+
+#endif // CAM_UART_H
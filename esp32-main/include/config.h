@@ -18,6 +18,8 @@
 // Example: {0x24, 0x6F, 0x28, 0xAE, 0x12, 0x34}
 #define ESP32_CAM_MAC {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF} 
 #define USE_ESP_NOW true
+#define ESPNOW_ACK_TIMEOUT_MS 40  // Wait for the cam's ack per send
+#define ESPNOW_MAX_SENDS 4  // First send + retransmits before the wire pulse
 
 
 // ==================== GSM CONFIGURATION ====================
@@ -25,6 +27,16 @@
 extern const char* EMERGENCY_PHONES[];
 const int NUM_PHONES = 2;
 #define APN "your.apn.here"  // Your mobile operator's APN
+#define GPRS_MODEM_WAIT_MS 15000  // Max wait for pending AT/SMS traffic before a GPRS post
+#define GSM_HEALTH_POLL_MS 30000  // CSQ/CREG/COPS refresh when the modem is idle
+#define GSM_HEALTH_STALE_MS 120000  // Older readings count as unknown
+
+// SIM800L sleep: AT+CSCLK=2 lets the modem sleep whenever the UART is
+// quiet; with a DTR line wired, AT+CSCLK=1 and DTR high allow sleep instead
+#define GSM_SLEEP_ENABLED true
+#define GSM_DTR_PIN -1  // -1 = DTR not wired
+#define GSM_SLEEP_IDLE_MS 4000  // UART silence after which the modem is assumed asleep
+#define GSM_HEALTH_POLL_SLEEP_MS 300000  // Health refresh while sleep is enabled (each one wakes the modem)
 
 // ==================== PIN DEFINITIONS ====================
 // PIR Sensors
@@ -57,7 +69,8 @@ const int NUM_PHONES = 2;
 #define SIM_STATUS_LED_PIN 4
 
 // UART Backup to ESP32-CAM
-// RX Only - receive images/status from ESP32-CAM
+// RX Only - receive images/status from ESP32-CAM (GPIO 35 is input-only;
+// the link's acks go back over ESP-NOW)
 #define UART2_RX_PIN 35  // From ESP32-CAM TX backup
 
 // ==================== DETECTION PARAMETERS ====================
@@ -67,11 +80,116 @@ const int NUM_PHONES = 2;
 #define DEBOUNCE_DELAY_MS 50  // PIR debounce delay
 
 // ==================== TIMING CONFIGURATION ====================
-#define WIFI_CONNECT_TIMEOUT_MS 10000  // WiFi connection timeout
+#define WIFI_CONNECT_TIMEOUT_MS 10000  // WiFi connection timeout (per network after a scan)
 #define SERVER_TIMEOUT_MS 20000  // HTTP request timeout (backend may be slow/cold)
-#define HEARTBEAT_INTERVAL_MS 60000  // Status heartbeat interval
+#define TLS_RECORD_BYTES 4096  // Request bytes per write(); the core's mbedTLS output record size
+#define HEARTBEAT_INTERVAL_MS 60000  // Status heartbeat interval; grows while quiet (liveness.h)
+#define LIVENESS_FAST_MS 15000  // Heartbeat interval during an incident or degraded connectivity
+#define LIVENESS_MAX_MS 300000  // Longest quiet interval until the backend advertises X-Heartbeat-Max
+#define LIVENESS_INCIDENT_HOLD_MS 600000  // Fast heartbeats for this long after an alert
 #define SMS_RATE_LIMIT_MS 300000  // 5 minutes between SMS (cost control)
 
+// ==================== WIFI CONNECT ====================
+// Reconnects go straight to the cached access point; a scan is the fallback (wifi_connector.h)
+// Networks tried after a scan, strongest first: { { "ssid", "password" }, ... }
+#define WIFI_NETWORKS { { WIFI_SSID, WIFI_PASSWORD } }
+#define WIFI_FAST_CONNECT_TIMEOUT_MS 3000  // Directed attempt to the cached BSSID and channel
+#define WIFI_IP_REUSE_MS 3600000  // Reuse the last DHCP lease statically within this long (same boot only)
+#define WIFI_RETRY_BASE_MS 5000  // Wait after a failed connect round, doubles per failure; a drop retries at once
+#define WIFI_RETRY_MAX_MS 300000
+
+// ==================== SMS OUTBOX ====================
+// Alerts raised while a round is rate limited are coalesced into one summary SMS
+#define SMS_OUTBOX_SIZE 4  // Entries persisted in NVS
+#define SMS_MAX_RECIPIENT_ATTEMPTS 5
+#define SMS_RETRY_BASE_MS 15000  // First retry delay, doubles per attempt
+#define SMS_RETRY_MAX_MS 600000  // Backoff cap (10 minutes)
+
+// ==================== TASK CONFIGURATION ====================
+// Core 0 also runs the WiFi stack, so network-bound tasks live there and
+// sensing/camera trigger get core 1. Higher number = higher priority.
+#define SENSING_TASK_CORE 1
+#define SENSING_TASK_PRIORITY 5
+#define SENSING_TASK_STACK 4096
+#define SENSING_PERIOD_MS 20  // PIR sample period
+
+#define CAMERA_TASK_CORE 1
+#define CAMERA_TASK_PRIORITY 4
+#define CAMERA_TASK_STACK 4096
+
+#define INDICATOR_TASK_CORE 1
+#define INDICATOR_TASK_PRIORITY 1
+#define INDICATOR_TASK_STACK 3072
+
+#define GSM_TASK_CORE 0
+#define GSM_TASK_PRIORITY 3
+#define GSM_TASK_STACK 6144
+#define GSM_POLL_INTERVAL_MS 10  // AT engine poll period
+
+#define BACKEND_TASK_CORE 0
+#define BACKEND_TASK_PRIORITY 2
+#define BACKEND_TASK_STACK 8192
+
+#define ALERT_QUEUE_LENGTH 4  // Pending alerts per consumer task
+#define INDICATOR_QUEUE_LENGTH 8
+
+// ==================== ALERT DISPATCH ====================
+// Per-channel deadline (from detection) and attempt budget
+#define CAMERA_DEADLINE_MS 1000
+#define CAMERA_MAX_ATTEMPTS 2
+#define SMS_DEADLINE_MS 90000
+#define SMS_MAX_ATTEMPTS 1  // SMS outbox owns retries
+#define BACKEND_DEADLINE_MS 60000
+#define BACKEND_MAX_ATTEMPTS 1  // Alert outbox owns retries
+#define CHANNEL_RETRY_DELAY_MS 2000  // Gap before re-queuing a failed channel
+#define DISPATCH_MAX_INCIDENTS 4  // Incidents tracked concurrently
+
+// ==================== ALERT OUTBOX ====================
+// Alerts are persisted before posting and replayed in batches after outages
+#define ALERT_OUTBOX_CAPACITY 32  // Records kept in NVS (oldest dropped when full)
+#define ALERT_BATCH_SIZE 8  // Records per batch request
+#define ALERT_REPLAY_RETRY_MS 30000  // First replay retry, doubles per failure
+#define ALERT_REPLAY_RETRY_MAX_MS 300000
+#define ALERT_BREAKER_TRIP 6  // Failed replays in a row that open the breaker for ALERT_REPLAY_RETRY_MAX_MS
+
+// ==================== RETRY POLICY ====================
+// Backoff with jitter and a circuit breaker per backend endpoint (retry_policy.h)
+#define EXPECT_CONTINUE_MIN_BYTES 32768  // Bodies this large wait for 100 Continue before going out
+#define EXPECT_CONTINUE_WAIT_MS 1500  // Send the body anyway if the server stays silent this long
+#define IMAGE_RETRY_BASE_MS 5000  // Wait after a failed image post, doubles per failure
+#define IMAGE_RETRY_MAX_MS 300000
+#define IMAGE_BREAKER_TRIP 3  // Failed image posts in a row that open the breaker
+#define IMAGE_BREAKER_OPEN_MS 600000  // No image posts for this long, then one probe
+
+// ==================== CONNECTION PRE-WARM ====================
+// The first PIR edge opens the WiFi backend connection before detection is confirmed
+#define BACKEND_PREWARM true  // Comment out to connect only when the alert is posted
+#define PREWARM_HOLD_MS 5000  // Close it if no alert uses it by then (over DETECTION_WINDOW_MS)
+#define PREWARM_HEAD_PATH "/api/v1/burglary/alert/alert"  // HEAD once connected so a scaled-to-zero backend starts; "" = none
+
+// ==================== CAMERA UART LINK ====================
+// Status reports and thumbnails from the cam (uart_protocol.h)
+#define CAM_UART_BAUD 921600  // Must match the cam; lower it if "bad" frames climb
+#define CAM_UART_RX_BUFFER 4096  // Over UART_WINDOW wire frames (8 x 254 B)
+#define CAM_UART_POLL_MS 10  // Camera task read/ack period
+#define CAM_THUMB_MAX 16384  // Largest thumbnail accepted for GPRS forwarding
+#define CAM_THUMB_TIMEOUT_MS 5000  // Abandon a pull that stops making progress
+#define CAM_THUMB_FORWARD_POLL_MS 500  // Backend task check while a thumbnail pull or relay is running
+
+// ==================== IMAGE RELAY ====================
+// Cam images forwarded over ESP-NOW when only this controller has a link
+#define RELAY_MAX_BYTES 65536  // Largest full JPEG reassembled in RAM; bigger ones send the thumbnail
+#define RELAY_STALL_MS 15000  // Abandon a transfer this long without a new fragment (covers a capture on the cam)
+
+// ==================== CAM TELEMETRY ====================
+// The cam's heartbeat arrives over ESP-NOW and goes out with ours
+#define CAM_DEVICE_ID "ESP32_CAM"  // device_id the cam used for its own heartbeats
+#define CAM_TELEMETRY_STALE_MS 150000  // Older reports are left out of the group heartbeat (one lost report tolerated)
+#define CAM_TELEMETRY_FORWARD_MS 120000  // A report acked as forwarded brings the group heartbeat forward to this age
+
+// ==================== TRACING ====================
+#define TRACE_EXPORT_BATCH 32  // Trace records per export request (sent with the heartbeat)
+
 // ==================== BUZZER PATTERN ====================
 #define BUZZER_BEEPS 3
 #define BUZZER_ON_MS 200
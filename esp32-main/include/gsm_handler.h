@@ -1,6 +1,20 @@
 /**
  * GSM Handler Module
  * Manages SIM800L GSM module for SMS alerts
+ *
+ * All modem traffic goes through ATEngine; call poll() from the GSM task
+ * so command results and URCs (+CREG, +CMTI, RING) are delivered.
+ *
+ * The UART is shared with the GPRS data session (TinyGSM): whoever talks
+ * to the modem holds lockModem(); the data path uses acquireIdleModem()
+ * so it never interleaves with an AT command in flight, and never takes
+ * the modem while the SMS outbox has an alert round ready to send.
+ *
+ * Modem health (signal, registration, operator) is refreshed in the
+ * background by pollHealth() and read from the cache with getHealth().
+ *
+ * With GSM_SLEEP_ENABLED the modem runs in slow-clock mode between
+ * commands; the AT engine wakes it transparently before the next one.
  */
 
 #ifndef GSM_HANDLER_H
@@ -8,25 +22,117 @@
 
 #include <Arduino.h>
 #include <HardwareSerial.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "at_engine.h"
+
+// Cached modem health; *At fields are millis() of the last update, 0 = never
+struct GSMHealth {
+    int csq;            // 0-31, 99 = not detectable
+    int registration;   // +CREG <stat>, -1 = unknown
+    char operatorName[24];
+    unsigned long csqAt;
+    unsigned long registrationAt;
+    unsigned long operatorAt;
+};
+
+typedef void (*SMSCallback)(bool success, void* ctx);
+typedef void (*SignalCallback)(int csq, void* ctx);
+typedef void (*SocketClosedCallback)(uint8_t mux, void* ctx);
 
 class GSMHandler {
 private:
     HardwareSerial* gsmSerial;
+    ATEngine at;
     unsigned long lastSMSTime;
     bool initialized;
-    
-    bool waitForResponse(const char* expected, unsigned long timeout = 5000);
-    bool sendATCommand(const char* command, const char* expectedResponse = "OK", unsigned long timeout = 5000);
-    
+
+    GSMHealth health;
+    portMUX_TYPE healthLock;
+    uint8_t healthStep;  // 0 = idle, else next query in the refresh cycle
+    unsigned long nextHealthAt;
+    unsigned long incomingSmsCount;
+    unsigned long ringCount;
+
+    // One SMS in flight at a time
+    bool smsInFlight;
+    SMSCallback smsCallback;
+    void* smsCtx;
+    unsigned long smsStartedAt;
+    volatile bool smsAlertsDue;  // Set by the SMS outbox on the GSM task
+
+    SignalCallback signalCallback;
+    void* signalCtx;
+
+    // Data connections the server closed while the AT engine had the UART
+    SocketClosedCallback socketClosedCallback;
+    void* socketClosedCtx;
+
+    SemaphoreHandle_t modemMutex;
+    StaticSemaphore_t modemMutexBuf;
+
+    bool sleepEnabled;
+    bool dtrLow;  // DTR mode: low = modem kept awake
+
+    static void onCREG(const char* line, void* ctx);
+    static void onCMTI(const char* line, void* ctx);
+    static void onRING(const char* line, void* ctx);
+    static void nullURC(const char* line, void* ctx);
+    static void onCLOSED(const char* line, void* ctx);
+    static void onWake(void* ctx);
+    void enableSleep();
+    static void onSMSResult(const ATResponse& response, void* ctx);
+    static void onCSQResult(const ATResponse& response, void* ctx);
+    static void onHealthResult(const ATResponse& response, void* ctx);
+    void setRegistration(int stat);
+    void setSignal(int csq);
+    static int parseCREGStatus(const char* line);
+    static int parseCSQ(const char* info);
+    static bool parseCOPS(const char* info, char* out, size_t outLen);
+
 public:
     GSMHandler(HardwareSerial* serial);
-    
+
     bool begin();
+    void poll();
+
+    // Queue an SMS; the callback fires once +CMGS/ERROR/timeout arrives.
+    // Returns false if another SMS is in flight or rate limited.
+    bool sendSMSAsync(const char* phoneNumber, const char* message,
+                      SMSCallback callback, void* ctx, bool force = false);
+    bool requestSignalStrength(SignalCallback callback, void* ctx);
+    // "<mux>, CLOSED" URCs; called from the GSM task
+    void setSocketClosedHandler(SocketClosedCallback callback, void* ctx);
+
+    // Blocking wrappers (boot-time / debug use)
     bool sendSMS(const char* phoneNumber, const char* message, bool force = false);
     bool isNetworkRegistered();
-    bool isReady() const { return initialized; }
     int getSignalStrength();
+
+    // Low-priority refresh; only issues a query when no other AT command
+    // or SMS is pending. Call from the GSM task with the modem locked.
+    void pollHealth();
+    void refreshHealth() { nextHealthAt = millis(); }
+    GSMHealth getHealth();
+    // Registered and not known to be without signal. Stale or missing
+    // readings count as usable so an alert is never held back on a guess.
+    bool isNetworkUsable();
+
+    bool isSleepEnabled() const { return sleepEnabled; }
+
+    bool isReady() const { return initialized; }
+    bool isSMSInFlight() const { return smsInFlight; }
+    // SMS alerts go first: while set, acquireIdleModem() waits
+    void setSMSAlertsDue(bool due) { smsAlertsDue = due; }
+    int getRegistrationStatus() const { return health.registration; }
     bool canSendSMS();  // Rate limiting check
+    ATEngine& engine() { return at; }
+    HardwareSerial* serial() { return gsmSerial; }
+
+    // Modem ownership between the AT engine and the GPRS data session
+    bool lockModem(unsigned long timeoutMs);
+    void unlockModem();
+    bool acquireIdleModem(unsigned long timeoutMs);  // Locked + no AT command or SMS alert pending
 };
 
 #endif // GSM_HANDLER_H
@@ -1,6 +1,13 @@
 /**
  * HTTP Client Module
  * Handles communication with backend server
+ *
+ * Alerts go over WiFi when associated, otherwise over the optional
+ * fallback transport (SIM800L GPRS) with a compact payload.
+ *
+ * Every alert is written to the NVS outbox before the first attempt and
+ * removed once the backend accepts it; anything left over is replayed
+ * oldest-first in batches when a transport comes back.
  */
 
 #ifndef HTTP_CLIENT_H
@@ -8,26 +15,115 @@
 
 #include <Arduino.h>
 #include <WiFi.h>
-#include <HTTPClient.h>
+#include <ArduinoJson.h>
 #include "pir_detector.h"
+#include "backend_transport.h"
+#include "alert_outbox.h"
+#include "cam_telemetry.h"
+#include "liveness.h"
+#include "retry_policy.h"
+#include "wifi_connector.h"
 
 class BackendClient {
 private:
-    String apiKey;
-    String baseUrl;
-    HTTPClient http;
+    WiFiTransport wifi;
+    BackendTransport* fallback;
+    WiFiConnector wifiConnector;
     
-    int retryCount;
-    unsigned long lastRetryTime;
+    AlertOutbox outbox;
+    char deviceTag[7];  // Low MAC bytes, prefixes idempotency keys
+    RetryPolicy replayRetry;  // Alert replays; fresh alerts always go and report here
+    RetryPolicy imageRetry;   // Thumbnails and relayed images
+    bool batching;            // Cleared once the backend turns batches down
+    // No transport at offlineAt; not a backend failure, so it only holds
+    // replays back for ALERT_REPLAY_RETRY_MS (or until the link comes up)
+    bool offline;
+    unsigned long offlineAt;
+    float lastDrainRate;  // Alerts/s of the last completed replay
+    
+    // Connection opened on a first PIR edge, waiting for the alert
+    bool prewarmHeld;
+    unsigned long prewarmUntil;
+    unsigned long prewarmConnectMs;
+    uint32_t prewarms;
+    uint32_t prewarmsUsed;
+    uint32_t prewarmsExpired;
+    unsigned long prewarmSavedMs;  // Connect time alerts did not have to pay
+    LivenessScheduler liveness;
+    WireFormat wire;
+    
+    BackendTransport* selectTransport(bool& compact);
+    void formatKey(const AlertRecord& rec, char* out, size_t outLen);
+    void addAlertFields(JsonObject obj, const AlertRecord& rec, bool compact);
+    size_t buildAlertPayload(const AlertRecord& rec, bool compact, bool msgpack,
+                             char* out, size_t outLen);
+    size_t buildBatchPayload(const AlertRecord* recs, int count, bool compact, bool msgpack,
+                             char* out, size_t outLen);
+    void scheduleReplay(bool failed);
+    void noteOffline();
+    bool postJpeg(const char* path, uint32_t incidentId, const uint8_t* jpeg, size_t len);
+    // Every backend request goes through here so it counts for liveness
+    int exchange(BackendTransport* transport, const char* path, const char* contentType,
+                 const uint8_t* body, size_t length,
+                 const HttpHeader* headers = nullptr, size_t headerCount = 0);
+    void noteResponse(BackendTransport* transport, const char* contentType, int httpCode);
     
 public:
     BackendClient(const char* url, const char* key);
     
-    bool postAlert(HumanDetectionResult& detection, const char* networkStatus);
-    bool sendHeartbeat(const char* deviceId, const char* status, const char* ip, const char* version);
+    void begin();  // Restores the alert outbox
+    void setFallbackTransport(BackendTransport* transport) { fallback = transport; }
+    
+    // Persists the alert, then tries to deliver it. incidentId ties it to
+    // the camera's images; sequence is reported to the dispatcher if
+    // delivery only happens later, during replay.
+    bool postAlert(HumanDetectionResult& detection, const char* networkStatus,
+                   uint32_t incidentId, uint32_t sequence = 0);
+    
+    // First PIR edge: open the WiFi connection (and wake the backend)
+    // while the other sensors decide; closed again after PREWARM_HOLD_MS
+    // if no alert used it
+    void prewarm();
+    void expirePrewarm();
+    unsigned long msUntilPrewarmExpiry() const;
+    void printPrewarmStats() const;
+    
+    // Replays queued alerts if due; returns the number delivered
+    int drainOutbox();
+    unsigned long msUntilReplay() const;
+    // WiFi came back: replays and image posts may go right away
+    void noteLinkUp();
+    int getOutboxDepth() const { return outbox.depth(); }
+    float getLastDrainRate() const { return lastDrainRate; }
+    // False while image posts are backing off or the breaker is open;
+    // checked before pulling an image from the cam
+    bool canForwardImages() const { return imageRetry.msUntilReady() == 0; }
+    void printRetryStats() const;
+    
+    // Images from the cam while it had no WiFi (UART thumbnail pull or
+    // ESP-NOW relay); go over whichever transport is up
+    bool postThumbnail(uint32_t incidentId, const uint8_t* jpeg, size_t len);
+    bool postRelayedImage(uint32_t incidentId, const uint8_t* jpeg, size_t len);
+    
+    // Posts buffered trace records over WiFi; returns how many were sent
+    int exportTraces(const char* deviceId);
+    
+    // One post for the device group; cam is the ESP32-CAM's latest
+    // ESP-NOW report, left out when there is none
+    // Returns false without posting when WiFi is down; either way the
+    // liveness interval restarts
+    bool sendHeartbeat(const char* deviceId, const char* status, const char* ip, const char* version,
+                       const GSMHealth* gsmHealth = nullptr, const CamHeartbeat* cam = nullptr);
+    unsigned long msUntilHeartbeat();
+    void printLiveness() const { liveness.printStats("Backend"); }
+    void printWireStats() const { wire.printStats("Backend"); }
+    void printWiFiStats() const { wifiConnector.printStats("Backend"); }
+    // Setup only; later reconnects run in pollWiFi() without blocking
     bool connectWiFi();
-    bool isConnected();
-    void reconnect();
+    bool isConnected();  // Any task
+    WiFiLinkChange pollWiFi() { return wifiConnector.poll(); }
+    unsigned long msUntilWiFiPoll() const { return wifiConnector.msUntilPoll(); }
+    WiFiLinkSnapshot getWiFiLink() const { return wifiConnector.snapshot(); }
 };
 
 #endif // HTTP_CLIENT_H
@@ -15,6 +15,7 @@ struct HumanDetectionResult {
     bool pir_middle;
     bool pir_right;
     unsigned long timestamp;
+    unsigned long firstEdgeAt;  // millis() of the first PIR edge in the window
 };
 
 class PIRDetector {
@@ -28,6 +29,8 @@ private:
     bool triggered[3];  // left, middle, right
     
     unsigned long windowStart;
+    unsigned long firstEdgeTime;
+    bool edgePending;  // First edge of a window not yet taken
     
 public:
     PIRDetector(int left, int middle, int right);
@@ -35,6 +38,8 @@ public:
     void begin();
     void update();
     HumanDetectionResult detectHuman();
+    // True once per window, on its first PIR edge (before any detection)
+    bool takeFirstEdge();
     void reset();
 };
 
@@ -0,0 +1,90 @@
+/**
+ * Relay Receiver Module
+ * Reassembles images the ESP32-CAM relays over ESP-NOW for forwarding
+ *
+ * When the cam queues an image without WiFi it sends FRAME_RELAY_OFFER.
+ * If this controller can reach the backend (WiFi or GPRS) it asks for the
+ * full JPEG, or the thumbnail when the full image does not fit in
+ * RELAY_MAX_BYTES. Fragments are acked from the receive callback
+ * (espnow_protocol.h, "IMAGE RELAY"); the finished image is posted by the
+ * backend task and the result sent back so the cam can drop its copy.
+ */
+
+#ifndef RELAY_RECEIVER_H
+#define RELAY_RECEIVER_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include "espnow_protocol.h"
+#include "config.h"
+
+struct RelayStats {
+    uint32_t completed;
+    uint32_t abandoned;
+    uint32_t duplicates;       // Fragments received twice (lost ack)
+    uint32_t lastBytes;
+    uint32_t lastMs;           // Request to last fragment
+    uint32_t lastDuplicates;
+};
+
+class RelayReceiver {
+private:
+    enum State : uint8_t {
+        RELAY_IDLE,
+        RELAY_RECEIVING,
+        RELAY_READY     // Buffer belongs to the backend task
+    };
+
+    volatile State state;
+    portMUX_TYPE lock;
+
+    // Latest offer, from the receive callback
+    volatile bool offerPending;
+    uint32_t offerIncident;
+    RelayOffer offer;
+
+    uint32_t incidentId;
+    uint8_t kind;              // RelayKind
+    uint8_t* buffer;           // malloc'd for the transfer
+    uint32_t total;
+    uint16_t count;
+    uint16_t received;
+    uint16_t base;             // First missing fragment
+    uint8_t bitmap[(RELAY_MAX_BYTES / RELAY_FRAGMENT_DATA + 8) / 8];
+    unsigned long requestedAt;
+    unsigned long activityAt;
+    // Last transfer handed to the backend task; a late fragment of it
+    // still gets the full ack
+    uint32_t completedIncident;
+    uint16_t completedCount;
+
+    RelayStats stats;
+
+    bool hasFragment(uint16_t index) const { return bitmap[index >> 3] & (1 << (index & 7)); }
+    void handleFragment(uint32_t incident, const uint8_t* payload, uint8_t len);
+    void sendAck(uint32_t incident, bool complete, uint16_t fragments);
+    bool start(uint32_t incident, uint8_t requestKind, uint32_t bytes);
+    void reset();
+
+public:
+    RelayReceiver();
+
+    // ESP-NOW callback (via camLink)
+    void onFrame(const EspNowHeader& header, const uint8_t* payload);
+
+    // Camera task: answers offers when a backend transport is up and
+    // abandons stalled transfers
+    void poll(bool canForward);
+    bool isReceiving() const { return state == RELAY_RECEIVING; }
+
+    // Backend task: image valid until finish()
+    bool getImage(uint32_t& incident, uint8_t& imageKind, const uint8_t*& data, size_t& len);
+    void finish(bool forwarded);
+
+    RelayStats getStats();
+    void printStats();
+};
+
+extern RelayReceiver relayReceiver;
+
+#endif // RELAY_RECEIVER_H
@@ -0,0 +1,88 @@
+/**
+ * SMS Outbox Module
+ * NVS-backed queue of pending SMS with per-recipient retry state
+ *
+ * The GSM task adds alerts and calls poll(); one recipient is sent at a
+ * time as the modem finishes the previous one. Alerts arriving before a
+ * round has started (or while SMS_RATE_LIMIT_MS holds the next round
+ * back) are merged into a single summary message.
+ */
+
+#ifndef SMS_OUTBOX_H
+#define SMS_OUTBOX_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include "config.h"
+#include "gsm_handler.h"
+#include "system_tasks.h"
+
+enum SMSKind : uint8_t {
+    SMS_KIND_ALERT = 0,  // Highest priority
+    SMS_KIND_TEST = 1
+};
+
+enum SMSRecipientState : uint8_t {
+    SMS_RCPT_PENDING = 0,
+    SMS_RCPT_SENT,
+    SMS_RCPT_FAILED
+};
+
+// Persisted as-is; a layout change invalidates the stored blob
+struct SMSOutboxEntry {
+    uint8_t used;
+    uint8_t kind;
+    uint16_t alertCount;        // Alerts coalesced into this entry
+    uint32_t order;             // Insertion order, breaks priority ties
+    uint32_t firstSequence;     // Alert sequence range covered; 0 = previous boot
+    uint32_t lastSequence;
+    uint32_t firstIncidentId;   // Traced on first delivery
+    uint32_t firstAlertTime;    // Epoch seconds (uptime seconds if no NTP)
+    uint32_t lastAlertTime;
+    float maxConfidence;
+    uint8_t state[NUM_PHONES];
+    uint8_t attempts[NUM_PHONES];
+    uint32_t nextAttemptAt[NUM_PHONES];  // millis(); cleared on load
+};
+
+class SMSOutbox {
+private:
+    GSMHandler* gsm;
+    Preferences prefs;
+    SMSOutboxEntry entries[SMS_OUTBOX_SIZE];
+    uint32_t nextOrder;
+    bool storageReady;
+
+    int sendingEntry;        // -1 when idle
+    int sendingRecipient;
+    int roundEntry;          // Entry whose round last started
+    unsigned long roundStartedAt;
+    bool networkGated;       // Sends held back until the network looks usable
+
+    void load();
+    void save();
+    bool isStarted(const SMSOutboxEntry& entry) const;
+    bool isComplete(const SMSOutboxEntry& entry) const;
+    bool isRoundOpen(unsigned long now) const;
+    void publishAlertsDue(unsigned long now);
+    int findFree();
+    int pickNext(int& recipient, unsigned long now);
+    void formatMessage(const SMSOutboxEntry& entry, char* buf, size_t len) const;
+    void completeEntry(int index);
+    void reportSequences(const SMSOutboxEntry& entry, bool success, bool retryable);
+    void handleResult(bool success);
+
+    static void onSendResult(bool success, void* ctx);
+
+public:
+    SMSOutbox(GSMHandler* handler);
+
+    void begin();
+    bool addAlert(const AlertEvent& event, uint32_t alertTime);
+    bool addTest();
+    void poll();
+
+    int depth() const;
+};
+
+#endif // SMS_OUTBOX_H
@@ -0,0 +1,72 @@
+/**
+ * System Tasks Module
+ * FreeRTOS task layout for the main controller
+ *
+ * Sensing never waits on the slow channels: a detection is copied into
+ * one statically allocated queue per consumer (camera, GSM, backend,
+ * indicators) with a zero-tick send, so a 30 s SMS transaction only
+ * delays the GSM task while PIRs keep being sampled.
+ */
+
+#ifndef SYSTEM_TASKS_H
+#define SYSTEM_TASKS_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include "pir_detector.h"
+#include "gsm_handler.h"
+#include "buzzer.h"
+#include "http_client.h"
+#include "ntp_sync.h"
+#include "cam_uart.h"
+
+// Detection handed from the sensing task to every channel
+struct AlertEvent {
+    HumanDetectionResult detection;
+    uint32_t sequence;       // Increments per detection since boot; 0 = first PIR
+                             // edge only (backend queue: pre-warm the connection)
+    uint32_t incidentId;     // Boot counter << 16 | sequence; unique per device
+    unsigned long detectedAt;  // millis() at detection
+};
+
+enum GsmRequestType {
+    GSM_REQ_ALERT,
+    GSM_REQ_TEST_SMS,
+    GSM_REQ_SIGNAL
+};
+
+struct GsmRequest {
+    GsmRequestType type;
+    AlertEvent alert;
+};
+
+enum IndicatorCommand {
+    IND_ALERT,        // Buzzer alert pattern
+    IND_SMS_SENT,     // 5 quick blinks on SIM LED
+    IND_BACKEND_OK,   // 3 blinks on status LED
+    IND_BEEP          // Single confirmation beep
+};
+
+// Objects owned by main.cpp
+extern PIRDetector pirDetector;
+extern GSMHandler gsm;
+extern Buzzer buzzer;
+extern BackendClient backend;
+extern NTPSync ntpSync;
+extern CamUart camUart;
+extern uint8_t broadcastAddress[];
+
+// Queues (valid after startSystemTasks)
+extern QueueHandle_t cameraQueue;
+extern QueueHandle_t gsmQueue;
+extern QueueHandle_t backendQueue;
+extern QueueHandle_t indicatorQueue;
+
+void startSystemTasks();
+
+// Non-blocking helpers usable from any task
+bool postIndicator(IndicatorCommand cmd);
+bool postGsmRequest(GsmRequestType type);
+
+#endif // SYSTEM_TASKS_H
@@ -0,0 +1,215 @@
+/**
+ * Alert Dispatcher Implementation
+ * Concurrent fan-out with per-channel deadlines and retries
+ */
+
+#include "alert_dispatcher.h"
+
+AlertDispatcher dispatcher;
+
+const ChannelPolicy AlertDispatcher::policies[CH_COUNT] = {
+    { CAMERA_DEADLINE_MS, CAMERA_MAX_ATTEMPTS },   // CH_CAMERA
+    { SMS_DEADLINE_MS, SMS_MAX_ATTEMPTS },         // CH_SMS
+    { BACKEND_DEADLINE_MS, BACKEND_MAX_ATTEMPTS }  // CH_BACKEND
+};
+
+AlertDispatcher::AlertDispatcher()
+    : nextSlot(0), lastTimeToFirstNotification(0) {
+    lock = portMUX_INITIALIZER_UNLOCKED;
+    memset(incidents, 0, sizeof(incidents));
+}
+
+const char* AlertDispatcher::channelName(AlertChannel channel) {
+    switch (channel) {
+        case CH_CAMERA: return "camera";
+        case CH_SMS: return "sms";
+        case CH_BACKEND: return "backend";
+        default: return "?";
+    }
+}
+
+bool AlertDispatcher::isTerminal(ChannelState state) const {
+    return state == CH_STATE_DONE || state == CH_STATE_FAILED || state == CH_STATE_TIMED_OUT;
+}
+
+IncidentStatus* AlertDispatcher::findIncident(uint32_t sequence) {
+    for (int i = 0; i < DISPATCH_MAX_INCIDENTS; i++) {
+        if (incidents[i].active && incidents[i].event.sequence == sequence) {
+            return &incidents[i];
+        }
+    }
+    return nullptr;
+}
+
+bool AlertDispatcher::enqueue(AlertChannel channel, const AlertEvent& event) {
+    switch (channel) {
+        case CH_CAMERA:
+            return xQueueSend(cameraQueue, &event, 0) == pdTRUE;
+        case CH_SMS: {
+            GsmRequest req;
+            req.type = GSM_REQ_ALERT;
+            req.alert = event;
+            return xQueueSend(gsmQueue, &req, 0) == pdTRUE;
+        }
+        case CH_BACKEND:
+            return xQueueSend(backendQueue, &event, 0) == pdTRUE;
+        default:
+            return false;
+    }
+}
+
+void AlertDispatcher::dispatch(const AlertEvent& event) {
+    uint32_t evicted = 0;
+
+    portENTER_CRITICAL(&lock);
+    IncidentStatus& incident = incidents[nextSlot];
+    nextSlot = (nextSlot + 1) % DISPATCH_MAX_INCIDENTS;
+    if (incident.active) {
+        evicted = incident.event.sequence;
+    }
+    memset(&incident, 0, sizeof(incident));
+    incident.active = true;
+    incident.event = event;
+    for (int c = 0; c < CH_COUNT; c++) {
+        incident.channels[c].state = CH_STATE_PENDING;
+        incident.channels[c].attempts = 1;
+    }
+    portEXIT_CRITICAL(&lock);
+
+    if (evicted) {
+        Serial.printf("[DISPATCH] Dropping tracking for alert #%lu (slots full)\n",
+                      (unsigned long)evicted);
+    }
+
+    // All channels start together; queue sends happen outside the lock
+    for (int c = 0; c < CH_COUNT; c++) {
+        if (!enqueue((AlertChannel)c, event)) {
+            reportResult(event.sequence, (AlertChannel)c, false);
+        }
+    }
+}
+
+void AlertDispatcher::reportResult(uint32_t sequence, AlertChannel channel, bool success, bool retryable) {
+    unsigned long now = millis();
+    bool finished = false;
+    IncidentStatus snapshot;
+
+    portENTER_CRITICAL(&lock);
+    IncidentStatus* incident = findIncident(sequence);
+    if (incident && !isTerminal(incident->channels[channel].state)) {
+        ChannelStatus& ch = incident->channels[channel];
+        const ChannelPolicy& policy = policies[channel];
+
+        if (success) {
+            ch.state = CH_STATE_DONE;
+            ch.completedAt = now - incident->event.detectedAt;
+        } else if (retryable && ch.attempts < policy.maxAttempts &&
+                   now + CHANNEL_RETRY_DELAY_MS - incident->event.detectedAt < policy.deadlineMs) {
+            ch.state = CH_STATE_RETRY;
+            ch.retryAt = now + CHANNEL_RETRY_DELAY_MS;
+        } else {
+            ch.state = CH_STATE_FAILED;
+        }
+
+        finished = true;
+        for (int c = 0; c < CH_COUNT; c++) {
+            finished = finished && isTerminal(incident->channels[c].state);
+        }
+        if (finished) {
+            snapshot = *incident;
+            incident->active = false;
+        }
+    }
+    portEXIT_CRITICAL(&lock);
+
+    if (finished) {
+        finishIncident(snapshot);
+    }
+}
+
+void AlertDispatcher::poll() {
+    unsigned long now = millis();
+    AlertEvent retries[DISPATCH_MAX_INCIDENTS * CH_COUNT];
+    AlertChannel retryChannels[DISPATCH_MAX_INCIDENTS * CH_COUNT];
+    int retryCount = 0;
+    IncidentStatus finished[DISPATCH_MAX_INCIDENTS];
+    int finishedCount = 0;
+
+    portENTER_CRITICAL(&lock);
+    for (int i = 0; i < DISPATCH_MAX_INCIDENTS; i++) {
+        IncidentStatus& incident = incidents[i];
+        if (!incident.active) {
+            continue;
+        }
+
+        unsigned long age = now - incident.event.detectedAt;
+        bool allTerminal = true;
+
+        for (int c = 0; c < CH_COUNT; c++) {
+            ChannelStatus& ch = incident.channels[c];
+            if (isTerminal(ch.state)) {
+                continue;
+            }
+            if (age >= policies[c].deadlineMs) {
+                ch.state = CH_STATE_TIMED_OUT;
+                continue;
+            }
+            if (ch.state == CH_STATE_RETRY && (long)(now - ch.retryAt) >= 0) {
+                ch.state = CH_STATE_PENDING;
+                ch.attempts++;
+                retries[retryCount] = incident.event;
+                retryChannels[retryCount] = (AlertChannel)c;
+                retryCount++;
+            }
+            allTerminal = false;
+        }
+
+        if (allTerminal) {
+            finished[finishedCount++] = incident;
+            incident.active = false;
+        }
+    }
+    portEXIT_CRITICAL(&lock);
+
+    for (int i = 0; i < retryCount; i++) {
+        Serial.printf("[DISPATCH] Retrying %s for alert #%lu\n",
+                      channelName(retryChannels[i]), (unsigned long)retries[i].sequence);
+        if (!enqueue(retryChannels[i], retries[i])) {
+            reportResult(retries[i].sequence, retryChannels[i], false);
+        }
+    }
+
+    for (int i = 0; i < finishedCount; i++) {
+        finishIncident(finished[i]);
+    }
+}
+
+void AlertDispatcher::finishIncident(IncidentStatus& incident) {
+    static const char* stateNames[] = {
+        "idle", "pending", "retry", "done", "failed", "timed out"
+    };
+
+    // Time-to-first-notification: earliest channel that reaches a person
+    unsigned long ttfn = 0;
+    const AlertChannel notifyChannels[] = { CH_SMS, CH_BACKEND };
+    for (AlertChannel c : notifyChannels) {
+        const ChannelStatus& ch = incident.channels[c];
+        if (ch.state == CH_STATE_DONE && (ttfn == 0 || ch.completedAt < ttfn)) {
+            ttfn = ch.completedAt;
+        }
+    }
+    lastTimeToFirstNotification = ttfn;
+
+    Serial.printf("[DISPATCH] Alert #%lu summary:\n", (unsigned long)incident.event.sequence);
+    for (int c = 0; c < CH_COUNT; c++) {
+        const ChannelStatus& ch = incident.channels[c];
+        Serial.printf("  %-8s %-9s attempts=%u t=%lu ms\n",
+                      channelName((AlertChannel)c), stateNames[ch.state],
+                      ch.attempts, ch.completedAt);
+    }
+    if (ttfn > 0) {
+        Serial.printf("  Time to first notification: %lu ms\n", ttfn);
+    } else {
+        Serial.println("  No notification channel succeeded");
+    }
+}
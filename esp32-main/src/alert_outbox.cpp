@@ -0,0 +1,118 @@
+/**
+ * Alert Outbox Implementation
+ * Persistent FIFO of undelivered backend alerts
+ */
+
+#include "alert_outbox.h"
+
+static const char* PREFS_NAMESPACE = "alertbox";
+static const char* PREFS_KEY_RECORDS = "records";
+
+AlertOutbox::AlertOutbox()
+    : droppedCount(0), storageReady(false) {
+    memset(&store, 0, sizeof(store));
+}
+
+void AlertOutbox::begin() {
+    storageReady = prefs.begin(PREFS_NAMESPACE, false);
+    if (!storageReady) {
+        Serial.println("Alert outbox: NVS unavailable - queue is RAM only");
+        return;
+    }
+
+    if (prefs.getBytesLength(PREFS_KEY_RECORDS) == sizeof(store)) {
+        prefs.getBytes(PREFS_KEY_RECORDS, &store, sizeof(store));
+    }
+    if (store.head >= ALERT_OUTBOX_CAPACITY || store.count > ALERT_OUTBOX_CAPACITY) {
+        memset(&store, 0, sizeof(store));
+    }
+
+    // Detection sequences restart every boot; the records only keep their id
+    for (int i = 0; i < store.count; i++) {
+        store.records[(store.head + i) % ALERT_OUTBOX_CAPACITY].sequence = 0;
+    }
+
+    if (store.count > 0) {
+        Serial.printf("Alert outbox: %d undelivered alerts restored\n", store.count);
+    }
+}
+
+void AlertOutbox::save() {
+    if (storageReady) {
+        prefs.putBytes(PREFS_KEY_RECORDS, &store, sizeof(store));
+    }
+}
+
+bool AlertOutbox::push(const AlertRecord& rec) {
+    if (store.count == ALERT_OUTBOX_CAPACITY) {
+        Serial.printf("Alert outbox full - dropping oldest incident %08lX\n",
+                      (unsigned long)store.records[store.head].id);
+        store.head = (store.head + 1) % ALERT_OUTBOX_CAPACITY;
+        store.count--;
+        droppedCount++;
+    }
+
+    store.records[(store.head + store.count) % ALERT_OUTBOX_CAPACITY] = rec;
+    store.count++;
+    save();
+    return storageReady;
+}
+
+int AlertOutbox::peek(AlertRecord* out, int max) const {
+    int n = store.count < max ? store.count : max;
+    for (int i = 0; i < n; i++) {
+        out[i] = store.records[(store.head + i) % ALERT_OUTBOX_CAPACITY];
+    }
+    return n;
+}
+
+void AlertOutbox::remove(uint32_t id) {
+    int found = -1;
+    for (int i = 0; i < store.count; i++) {
+        if (store.records[(store.head + i) % ALERT_OUTBOX_CAPACITY].id == id) {
+            found = i;
+            break;
+        }
+    }
+    if (found < 0) {
+        return;
+    }
+
+    // Close the gap so the ring stays oldest-first
+    for (int i = found; i < store.count - 1; i++) {
+        store.records[(store.head + i) % ALERT_OUTBOX_CAPACITY] =
+            store.records[(store.head + i + 1) % ALERT_OUTBOX_CAPACITY];
+    }
+    store.count--;
+    if (store.count == 0) {
+        store.head = 0;
+    }
+    save();
+}
+
+void AlertOutbox::pop(int n) {
+    if (n > store.count) {
+        n = store.count;
+    }
+    if (n <= 0) {
+        return;
+    }
+    store.head = (store.head + n) % ALERT_OUTBOX_CAPACITY;
+    store.count -= n;
+    if (store.count == 0) {
+        store.head = 0;
+    }
+    save();
+}
+
+void AlertOutbox::markAttempt(uint32_t id) {
+    for (int i = 0; i < store.count; i++) {
+        AlertRecord& rec = store.records[(store.head + i) % ALERT_OUTBOX_CAPACITY];
+        if (rec.id == id) {
+            if (rec.attempts < 255) {
+                rec.attempts++;
+            }
+            return;  // RAM only - not worth a flash write per attempt
+        }
+    }
+}
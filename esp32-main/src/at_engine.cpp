@@ -0,0 +1,353 @@
+/**
+ * AT Command Engine Implementation
+ * Line tokenizer, command queue and URC dispatch
+ */
+
+#include "at_engine.h"
+
+static const char CTRL_Z = 26;
+static const char ESC = 27;
+
+ATEngine::ATEngine()
+    : stream(nullptr), lineLen(0), head(0), count(0),
+      active(false), payloadSent(false), sentAt(0), startedAt(0), infoLen(0), urcCount(0),
+      commandsCompleted(0), commandsTimedOut(0),
+      sleepAfterMs(0), lastTrafficAt(0), waking(false), wakeProbes(0),
+      wakeUnanswered(0), wakeAnswered(false),
+      wakeHook(nullptr), wakeCtx(nullptr), wakeCount(0), lastWakeMs(0),
+      lastPromptMs(0), lastPromptAt(0), asleepTotalMs(0) {
+    line[0] = '\0';
+    info[0] = '\0';
+}
+
+void ATEngine::begin(Stream* modemStream) {
+    stream = modemStream;
+    lastTrafficAt = millis();
+    flushInput();
+}
+
+void ATEngine::setSleepAfter(unsigned long idleMs, WakeHook hook, void* ctx) {
+    sleepAfterMs = idleMs;
+    wakeHook = hook;
+    wakeCtx = ctx;
+}
+
+bool ATEngine::isLikelyAsleep() const {
+    return sleepAfterMs > 0 && !active && millis() - lastTrafficAt >= sleepAfterMs;
+}
+
+unsigned long ATEngine::getAsleepMs() const {
+    return isLikelyAsleep() ? asleepTotalMs + (idleFor() - sleepAfterMs) : asleepTotalMs;
+}
+
+bool ATEngine::submit(const char* command, unsigned long timeoutMs,
+                      ATCallback callback, void* ctx,
+                      const char* prefix, const char* payload) {
+    if (count >= AT_QUEUE_DEPTH) {
+        return false;
+    }
+
+    ATCommand& cmd = queue[(head + count) % AT_QUEUE_DEPTH];
+    strncpy(cmd.command, command, sizeof(cmd.command) - 1);
+    cmd.command[sizeof(cmd.command) - 1] = '\0';
+    strncpy(cmd.prefix, prefix ? prefix : "", sizeof(cmd.prefix) - 1);
+    cmd.prefix[sizeof(cmd.prefix) - 1] = '\0';
+    strncpy(cmd.payload, payload ? payload : "", sizeof(cmd.payload) - 1);
+    cmd.payload[sizeof(cmd.payload) - 1] = '\0';
+    cmd.timeoutMs = timeoutMs;
+    cmd.callback = callback;
+    cmd.ctx = ctx;
+    count++;
+
+    if (!active) {
+        startNext();
+    }
+    return true;
+}
+
+bool ATEngine::onURC(const char* prefix, URCHandler handler, void* ctx) {
+    if (urcCount >= AT_MAX_URC_HANDLERS) {
+        return false;
+    }
+    urcs[urcCount].prefix = prefix;
+    urcs[urcCount].handler = handler;
+    urcs[urcCount].ctx = ctx;
+    urcCount++;
+    return true;
+}
+
+void ATEngine::startNext() {
+    if (active || count == 0 || !stream) {
+        return;
+    }
+
+    bool asleep = isLikelyAsleep();
+    if (asleep) {
+        asleepTotalMs += idleFor() - sleepAfterMs;
+    }
+
+    active = true;
+    payloadSent = false;
+    infoLen = 0;
+    info[0] = '\0';
+    startedAt = millis();
+
+    if (asleep) {
+        waking = true;
+        wakeProbes = 0;
+        wakeUnanswered = 0;
+        wakeAnswered = false;
+        if (wakeHook) {
+            wakeHook(wakeCtx);
+        }
+        sendWakeProbe();
+        return;
+    }
+    writeCommand();
+}
+
+void ATEngine::sendWakeProbe() {
+    wakeProbes++;
+    wakeUnanswered++;
+    sentAt = millis();
+    lastTrafficAt = sentAt;
+    stream->println("AT");
+}
+
+// Lines still buffered (URCs that came with the wake) are read on as
+// usual; a probe answer among them was already counted in handleLine()
+void ATEngine::endWake() {
+    waking = false;
+    writeCommand();
+}
+
+void ATEngine::writeCommand() {
+    sentAt = millis();
+    lastTrafficAt = sentAt;
+    stream->println(queue[head].command);
+}
+
+void ATEngine::finish(ATResultCode code) {
+    // Copies: a callback that submits more work starts the next command,
+    // which reuses the queue slot and clears info
+    ATCommand cmd = queue[head];
+    char infoCopy[AT_INFO_MAX];
+    memcpy(infoCopy, info, infoLen + 1);
+
+    ATResponse response;
+    response.code = code;
+    response.info = infoCopy;
+    response.elapsedMs = millis() - startedAt;
+
+    head = (head + 1) % AT_QUEUE_DEPTH;
+    count--;
+    active = false;
+
+    if (code == AT_RESULT_TIMEOUT) {
+        commandsTimedOut++;
+        if (cmd.payload[0]) {
+            // Abort a half-finished prompt so the modem leaves text mode
+            stream->write(ESC);
+        }
+    } else {
+        commandsCompleted++;
+    }
+
+    if (cmd.callback) {
+        cmd.callback(response, cmd.ctx);
+    }
+
+    startNext();
+}
+
+void ATEngine::appendInfo(const char* text) {
+    size_t len = strlen(text);
+    if (infoLen > 0 && infoLen < AT_INFO_MAX - 1) {
+        info[infoLen++] = '\n';
+    }
+    size_t room = AT_INFO_MAX - 1 - infoLen;
+    if (len > room) {
+        len = room;
+    }
+    memcpy(info + infoLen, text, len);
+    infoLen += len;
+    info[infoLen] = '\0';
+}
+
+bool ATEngine::dispatchURC(const char* text) {
+    for (uint8_t i = 0; i < urcCount; i++) {
+        if (strncmp(text, urcs[i].prefix, strlen(urcs[i].prefix)) == 0) {
+            urcs[i].handler(text, urcs[i].ctx);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ATEngine::handleLine(const char* text) {
+    while (*text == ' ') {
+        text++;
+    }
+    if (*text == '\0') {
+        return;
+    }
+
+    if (!active) {
+        dispatchURC(text);
+        return;
+    }
+
+    if (waking) {
+        if (strcmp(text, "OK") == 0) {
+            if (!wakeAnswered) {
+                wakeAnswered = true;
+                wakeCount++;
+                lastWakeMs = millis() - startedAt;
+            }
+            if (wakeUnanswered > 0) {
+                wakeUnanswered--;
+            }
+            if (wakeUnanswered == 0) {
+                endWake();  // Nothing more can arrive for the probes
+            }
+        } else {
+            dispatchURC(text);  // Whatever woke the modem may report now
+        }
+        return;
+    }
+
+    const ATCommand& cmd = queue[head];
+
+    if (strcmp(text, "OK") == 0) {
+        finish(AT_RESULT_OK);
+        return;
+    }
+
+    if (strcmp(text, "ERROR") == 0 ||
+        strncmp(text, "+CME ERROR", 10) == 0 ||
+        strncmp(text, "+CMS ERROR", 10) == 0) {
+        appendInfo(text);
+        finish(AT_RESULT_ERROR);
+        return;
+    }
+
+    if (cmd.prefix[0] && strncmp(text, cmd.prefix, strlen(cmd.prefix)) == 0) {
+        appendInfo(text);
+        return;
+    }
+
+    if (dispatchURC(text)) {
+        return;
+    }
+
+    // Commands without a prefix (e.g. AT+CCID) answer with a bare line;
+    // skip the echo in case ATE0 has not been applied yet
+    if (!cmd.prefix[0] && strcmp(text, cmd.command) != 0) {
+        appendInfo(text);
+    }
+}
+
+void ATEngine::poll() {
+    if (!stream) {
+        return;
+    }
+
+    while (stream->available()) {
+        int c = stream->read();
+        if (c < 0) {
+            break;
+        }
+        lastTrafficAt = millis();
+
+        if (c == '\r') {
+            continue;
+        }
+
+        if (c == '\n') {
+            line[lineLen] = '\0';
+            if (lineLen > 0) {
+                handleLine(line);
+            }
+            lineLen = 0;
+            continue;
+        }
+
+        // The SMS prompt is "> " with no line terminator
+        if (c == '>' && lineLen == 0 && active && !waking && !payloadSent && queue[head].payload[0]) {
+            lastPromptAt = millis();
+            lastPromptMs = lastPromptAt - startedAt;
+            stream->print(queue[head].payload);
+            stream->write(CTRL_Z);
+            payloadSent = true;
+            continue;
+        }
+
+        if (lineLen < AT_LINE_MAX - 1) {  // Keep the head of the line, drop the rest
+            line[lineLen++] = (char)c;
+        }
+    }
+
+    if (waking && wakeAnswered) {
+        // Awake; probes lost while it slept will never be answered
+        if (millis() - lastTrafficAt >= AT_WAKE_SETTLE_MS) {
+            endWake();
+        }
+        return;
+    }
+
+    if (waking && millis() - sentAt > AT_WAKE_PROBE_MS) {
+        if (wakeProbes < AT_WAKE_MAX_PROBES) {
+            sendWakeProbe();
+        } else {
+            // No answer: send the command anyway and let its timeout decide
+            endWake();
+        }
+        return;
+    }
+
+    if (active && millis() - sentAt > queue[head].timeoutMs) {
+        finish(AT_RESULT_TIMEOUT);
+    }
+}
+
+void ATEngine::flushInput() {
+    if (stream) {
+        while (stream->available()) {
+            stream->read();
+        }
+    }
+    lineLen = 0;
+}
+
+struct SyncResult {
+    bool done;
+    ATResultCode code;
+    char* out;
+    size_t outLen;
+};
+
+static void syncCallback(const ATResponse& response, void* ctx) {
+    SyncResult* result = (SyncResult*)ctx;
+    result->code = response.code;
+    if (result->out && result->outLen > 0) {
+        strncpy(result->out, response.info, result->outLen - 1);
+        result->out[result->outLen - 1] = '\0';
+    }
+    result->done = true;
+}
+
+ATResultCode ATEngine::execute(const char* command, unsigned long timeoutMs,
+                               const char* prefix, char* infoOut, size_t infoOutLen) {
+    SyncResult result = { false, AT_RESULT_ERROR, infoOut, infoOutLen };
+
+    if (!submit(command, timeoutMs, syncCallback, &result, prefix)) {
+        return AT_RESULT_ERROR;
+    }
+
+    while (!result.done) {
+        poll();
+        delay(5);
+    }
+
+    return result.code;
+}
@@ -0,0 +1,270 @@
+/**
+ * Backend Transport Implementation
+ * WiFi (WiFiClient) and GPRS (TinyGSM) POST paths
+ */
+
+#include "backend_transport.h"
+#include "config.h"
+
+// Both transports run on the backend task only
+static uint8_t stage[TLS_RECORD_BYTES];
+
+int BackendTransport::exchange(Client& client, const HttpEndpoint& endpoint, const char* apiKey,
+                               const char* path, const char* contentType,
+                               const uint8_t* body, size_t length,
+                               const HttpHeader* headers, size_t headerCount) {
+    char buf[384];
+    HttpRequestHead head(buf, sizeof(buf));
+    head.begin("POST", endpoint, endpoint.path, path);
+    head.header("X-API-Key", apiKey);
+    head.header("Content-Type", contentType);
+    head.header("Content-Length", (unsigned long)length);
+    head.header("Connection", "keep-alive");
+    // Large bodies (forwarded images) only go out once the server has
+    // accepted the headers
+    unsigned long continueWaitMs = 0;
+    if (length >= EXPECT_CONTINUE_MIN_BYTES) {
+        head.header("Expect", "100-continue");
+        continueWaitMs = EXPECT_CONTINUE_WAIT_MS;
+    }
+    for (size_t i = 0; i < headerCount; i++) {
+        head.header(headers[i].name, headers[i].value);
+    }
+    size_t headLen = head.finish();
+    if (headLen == 0) {
+        Serial.printf("HTTP: request head for %s too long\n", path);
+        return -1;
+    }
+
+    HttpSlice slices[] = { { head.data(), headLen }, { body, length } };
+    HttpExchange x{};
+    x.timeoutMs = SERVER_TIMEOUT_MS;
+    x.continueWaitMs = continueWaitMs;
+    x.stage = stage;
+    x.stageLen = sizeof(stage);
+    x.hasBody = true;
+    HttpResponse response;
+    bool ok = httpExchange(client, slices, 2, x, response);
+    if (x.bodySkipped) {
+        Serial.printf("HTTP: %s answered %d before the body - %u bytes not sent\n",
+                      path, response.status, (unsigned)length);
+    } else if (x.stats.bytes >= sizeof(stage)) {
+        Serial.printf("HTTP: sent %u bytes in %u writes, %lu ms (%.1f KB/s)\n",
+                      (unsigned)x.stats.bytes, x.stats.writes, x.stats.ms,
+                      x.stats.ms ? x.stats.bytes / 1.024f / x.stats.ms : 0.0f);
+    }
+    if (!ok) {
+        client.stop();  // Reconnect next time
+        return -1;
+    }
+
+    if (response.heartbeatMaxS > 0) {
+        heartbeatMaxS = response.heartbeatMaxS;
+    }
+    if (response.acceptPost[0]) {
+        memcpy(acceptPost, response.acceptPost, sizeof(acceptPost));
+    }
+    if (!response.keepAlive) {
+        client.stop();
+    }
+    return response.status;
+}
+
+int BackendTransport::head(Client& client, const HttpEndpoint& endpoint, const char* apiKey,
+                           const char* path) {
+    char buf[256];
+    HttpRequestHead request(buf, sizeof(buf));
+    request.begin("HEAD", endpoint, endpoint.path, path);
+    request.header("X-API-Key", apiKey);
+    request.header("Connection", "keep-alive");
+    size_t headLen = request.finish();
+    if (headLen == 0) {
+        return -1;
+    }
+
+    HttpSlice slice = { request.data(), headLen };
+    HttpExchange x{};
+    x.timeoutMs = SERVER_TIMEOUT_MS;
+    HttpResponse response;
+    if (!httpExchange(client, &slice, 1, x, response)) {
+        client.stop();
+        return -1;
+    }
+    if (!response.keepAlive) {
+        client.stop();
+    }
+    return response.status;
+}
+
+// ==================== WIFI ====================
+
+WiFiTransport::WiFiTransport(const char* url, const char* key)
+    : apiKey(key), client(nullptr) {
+    if (!httpParseEndpoint(url, endpoint)) {
+        Serial.printf("Backend URL does not fit: %s\n", url);
+    }
+    // Same trust model as before: encrypted, server not verified
+    secureClient.setInsecure();
+    client = endpoint.secure ? (Client*)&secureClient : (Client*)&plainClient;
+}
+
+bool WiFiTransport::isAvailable() {
+    return WiFi.status() == WL_CONNECTED;
+}
+
+int WiFiTransport::post(const char* path, const char* contentType,
+                        const uint8_t* body, size_t length,
+                        const HttpHeader* headers, size_t headerCount) {
+    int httpCode = -1;
+    // A kept-alive connection may have been closed by the server while
+    // idle; that shows up as a failed exchange, so try once more fresh
+    for (int attempt = 0; attempt < 2 && httpCode < 0; attempt++) {
+        bool reused = client->connected();
+        if (!reused && !client->connect(endpoint.host, endpoint.port)) {
+            Serial.printf("HTTP: connect to %s:%u failed\n", endpoint.host, endpoint.port);
+            return -1;
+        }
+        httpCode = exchange(*client, endpoint, apiKey, path, contentType,
+                            body, length, headers, headerCount);
+        if (!reused) {
+            break;
+        }
+    }
+
+    if (httpCode > 0) {
+        Serial.printf("HTTP Response code: %d\n", httpCode);
+    } else {
+        Serial.printf("HTTP POST %s failed\n", path);
+    }
+    return httpCode;
+}
+
+bool WiFiTransport::prewarm(const char* headPath, unsigned long& connectMs) {
+    connectMs = 0;
+    if (!isAvailable()) {
+        return false;
+    }
+    if (client->connected()) {
+        return true;  // Kept alive since the last post
+    }
+
+    unsigned long start = millis();
+    if (!client->connect(endpoint.host, endpoint.port)) {
+        Serial.printf("HTTP: pre-warm connect to %s:%u failed\n", endpoint.host, endpoint.port);
+        return false;
+    }
+    connectMs = millis() - start;
+
+    // Any answer will do: the point is a backend that is up when the alert comes
+    int status = headPath[0] ? head(*client, endpoint, apiKey, headPath) : 0;
+    Serial.printf("HTTP: pre-warmed %s:%u in %lu ms (HEAD %d after %lu ms)\n",
+                  endpoint.host, endpoint.port, connectMs, status, millis() - start);
+    return client->connected();
+}
+
+// ==================== GPRS ====================
+
+GprsTransport::GprsTransport(GSMHandler* handler, const char* url, const char* key)
+    : gsm(handler), modem(*handler->serial()),
+      secureClient(modem, 0), plainClient(modem, 1), client(nullptr), mux(0), peerClosed(false),
+      apiKey(key), attached(false), lastAttachMs(0), lastConnectMs(0) {
+    if (!httpParseEndpoint(url, endpoint)) {
+        Serial.printf("Backend URL does not fit: %s\n", url);
+    }
+
+    // SIM800 TLS is limited to older cipher suites; a plain-HTTP backend
+    // URL avoids that at the cost of sending the alert in clear
+    client = endpoint.secure ? (Client*)&secureClient : (Client*)&plainClient;
+    mux = endpoint.secure ? 0 : 1;
+    gsm->setSocketClosedHandler(onSocketClosed, this);
+}
+
+void GprsTransport::onSocketClosed(uint8_t closedMux, void* ctx) {
+    GprsTransport* self = (GprsTransport*)ctx;
+    if (closedMux == self->mux) {
+        self->peerClosed = true;
+    }
+}
+
+bool GprsTransport::isAvailable() {
+    int stat = gsm->getRegistrationStatus();
+    return gsm->isReady() && (stat == 1 || stat == 5);
+}
+
+bool GprsTransport::ensureSession() {
+    lastAttachMs = 0;
+    lastConnectMs = 0;
+
+    if (!attached || !modem.isGprsConnected()) {
+        unsigned long start = millis();
+        Serial.printf("GPRS: attaching (APN %s)...\n", APN);
+        attached = modem.gprsConnect(APN, "", "");
+        lastAttachMs = millis() - start;
+        if (!attached) {
+            Serial.println("GPRS: attach failed");
+            return false;
+        }
+        Serial.printf("GPRS: attached in %lu ms\n", lastAttachMs);
+    }
+
+    if (!client->connected()) {
+        unsigned long start = millis();
+        if (!client->connect(endpoint.host, endpoint.port)) {
+            Serial.printf("GPRS: connect to %s:%u failed\n", endpoint.host, endpoint.port);
+            return false;
+        }
+        lastConnectMs = millis() - start;
+        Serial.printf("GPRS: connected to %s in %lu ms\n", endpoint.host, lastConnectMs);
+    }
+
+    return true;
+}
+
+int GprsTransport::post(const char* path, const char* contentType,
+                        const uint8_t* body, size_t length,
+                        const HttpHeader* headers, size_t headerCount) {
+    unsigned long start = millis();
+
+    if (!gsm->acquireIdleModem(GPRS_MODEM_WAIT_MS)) {
+        Serial.println("GPRS: modem busy");
+        return -1;
+    }
+
+    int status = -1;
+    // As on WiFi, a reused connection may have died unnoticed; a failed
+    // exchange on it gets one retry on a fresh connection. The modem is
+    // handed back in between so a waiting SMS alert is not held up twice.
+    bool locked = true;
+    for (int attempt = 0; attempt < 2 && status < 0; attempt++) {
+        if (attempt > 0) {
+            gsm->unlockModem();
+            locked = gsm->acquireIdleModem(GPRS_MODEM_WAIT_MS);
+            if (!locked) {
+                Serial.println("GPRS: modem busy before the retry");
+                break;
+            }
+        }
+        // TinyGSM still thinks a connection the server closed while idle is open
+        if (peerClosed) {
+            peerClosed = false;
+            client->stop();
+        }
+        bool reused = client->connected();
+        if (!ensureSession()) {
+            break;
+        }
+        status = exchange(*client, endpoint, apiKey, path, contentType,
+                          body, length, headers, headerCount);
+        if (!reused) {
+            break;
+        }
+    }
+
+    if (locked) {
+        gsm->unlockModem();
+    }
+
+    Serial.printf("GPRS: POST %s -> %d in %lu ms (attach %lu ms, connect %lu ms)\n",
+                  path, status, millis() - start, lastAttachMs, lastConnectMs);
+    return status;
+}
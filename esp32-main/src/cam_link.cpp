@@ -0,0 +1,195 @@
+/**
+ * Camera Link Implementation
+ * Trigger frames, ack matching and RTT statistics
+ */
+
+#include "cam_link.h"
+#include "config.h"
+#include "trace.h"
+#include "relay_receiver.h"
+#include "cam_telemetry.h"
+
+CamLink camLink;
+CamLink* CamLink::instance = nullptr;
+
+CamLink::CamLink()
+    : nextSeq(1), ready(false), waiter(nullptr), awaitedSeq(0) {
+    memset(peer, 0, sizeof(peer));
+    memset(&stats, 0, sizeof(stats));
+    stats.rttMinUs = UINT32_MAX;
+    statsLock = portMUX_INITIALIZER_UNLOCKED;
+}
+
+bool CamLink::begin(const uint8_t* peerMac) {
+    memcpy(peer, peerMac, sizeof(peer));
+    instance = this;
+
+    if (esp_now_init() != ESP_OK) {
+        Serial.println("Error initializing ESP-NOW");
+        return false;
+    }
+    Serial.println("ESP-NOW Initialized");
+
+    esp_now_register_recv_cb(onRecv);
+
+    esp_now_peer_info_t peerInfo;
+    memset(&peerInfo, 0, sizeof(peerInfo));
+    memcpy(peerInfo.peer_addr, peer, 6);
+    peerInfo.channel = 0;
+    peerInfo.encrypt = false;
+
+    if (esp_now_add_peer(&peerInfo) != ESP_OK) {
+        Serial.println("Failed to add peer");
+        return false;
+    }
+    Serial.println("ESP-NOW Peer Added");
+
+    ready = true;
+    return true;
+}
+
+// WiFi task context: match the ack and wake the waiting sender
+void CamLink::onRecv(const uint8_t* mac, const uint8_t* data, int len) {
+    CamLink* self = instance;
+    EspNowHeader header;
+    if (!self || !espnowDecode(data, len, header)) {
+        return;
+    }
+
+    const uint8_t* payload = data + sizeof(EspNowHeader);
+    switch (header.type) {
+        case FRAME_ACK: {
+            TaskHandle_t task = self->waiter;
+            if (task && header.seq == self->awaitedSeq) {
+                xTaskNotify(task, header.seq, eSetValueWithOverwrite);
+            }
+            break;
+        }
+        case FRAME_RELAY_OFFER:
+        case FRAME_FRAGMENT:
+            relayReceiver.onFrame(header, payload);
+            break;
+        case FRAME_CAM_TELEMETRY:
+            camTelemetry.onFrame(mac, header, payload);
+            break;
+        default:
+            break;
+    }
+}
+
+void CamLink::recordRtt(uint32_t rttUs) {
+    portENTER_CRITICAL(&statsLock);
+    stats.acked++;
+    stats.rttLastUs = rttUs;
+    stats.rttSumUs += rttUs;
+    if (rttUs < stats.rttMinUs) {
+        stats.rttMinUs = rttUs;
+    }
+    if (rttUs > stats.rttMaxUs) {
+        stats.rttMaxUs = rttUs;
+    }
+    portEXIT_CRITICAL(&statsLock);
+}
+
+bool CamLink::sendTrigger(uint32_t incidentId) {
+    if (!ready) {
+        return false;
+    }
+
+    uint16_t seq = nextSeq++;
+    uint8_t frame[sizeof(EspNowHeader) + ESPNOW_CRC_SIZE];
+    size_t len = espnowEncode(frame, sizeof(frame), FRAME_TRIGGER, seq, incidentId);
+
+    portENTER_CRITICAL(&statsLock);
+    stats.triggers++;
+    portEXIT_CRITICAL(&statsLock);
+
+    // Clear any stale notification before arming
+    xTaskNotifyWait(0, UINT32_MAX, nullptr, 0);
+    awaitedSeq = seq;
+    waiter = xTaskGetCurrentTaskHandle();
+
+    bool acked = false;
+    for (int attempt = 0; attempt < ESPNOW_MAX_SENDS && !acked; attempt++) {
+        if (attempt > 0) {
+            portENTER_CRITICAL(&statsLock);
+            stats.retransmits++;
+            portEXIT_CRITICAL(&statsLock);
+        }
+
+        uint32_t sentAt = micros();
+        if (esp_now_send(peer, frame, len) != ESP_OK) {
+            vTaskDelay(pdMS_TO_TICKS(ESPNOW_ACK_TIMEOUT_MS));
+            continue;
+        }
+        if (attempt == 0) {
+            tracer.record(TP_ESPNOW_SEND, incidentId);
+        }
+
+        // Same seq on every retransmit, so any ack ends the wait
+        uint32_t value = 0;
+        unsigned long deadline = millis() + ESPNOW_ACK_TIMEOUT_MS;
+        long remaining;
+        while ((remaining = (long)(deadline - millis())) > 0) {
+            if (xTaskNotifyWait(0, UINT32_MAX, &value, pdMS_TO_TICKS(remaining)) == pdTRUE &&
+                (uint16_t)value == seq) {
+                recordRtt(micros() - sentAt);
+                tracer.record(TP_ESPNOW_ACK, incidentId);
+                acked = true;
+                break;
+            }
+        }
+    }
+
+    waiter = nullptr;
+
+    if (!acked) {
+        portENTER_CRITICAL(&statsLock);
+        stats.unacked++;
+        portEXIT_CRITICAL(&statsLock);
+    }
+    return acked;
+}
+
+bool CamLink::sendControl(EspNowFrameType type, uint16_t seq, uint32_t incidentId,
+                          const void* payload, uint8_t payloadLen) {
+    if (!ready) {
+        return false;
+    }
+    uint8_t frame[ESPNOW_FRAME_MAX];
+    size_t len = espnowEncode(frame, sizeof(frame), type, seq, incidentId,
+                              (const uint8_t*)payload, payloadLen);
+    return len > 0 && esp_now_send(peer, frame, len) == ESP_OK;
+}
+
+bool CamLink::sendLinkAck(uint8_t nextSeq) {
+    return sendControl(FRAME_LINK_ACK, nextSeq, 0);
+}
+
+bool CamLink::sendThumbRequest(uint32_t incidentId) {
+    // The cam keys on incidentId; seq is informational here
+    return sendControl(FRAME_THUMB_REQUEST, 0, incidentId);
+}
+
+CamLinkStats CamLink::getStats() {
+    CamLinkStats snapshot;
+    portENTER_CRITICAL(&statsLock);
+    snapshot = stats;
+    portEXIT_CRITICAL(&statsLock);
+    return snapshot;
+}
+
+void CamLink::printStats() {
+    CamLinkStats s = getStats();
+    if (s.acked == 0) {
+        Serial.printf("Cam link: %lu triggers, none acked (%lu unacked)\n",
+                      (unsigned long)s.triggers, (unsigned long)s.unacked);
+        return;
+    }
+    Serial.printf("Cam link: %lu triggers, %lu acked, %lu retransmits, %lu unacked, "
+                  "RTT min/avg/max/last %lu/%lu/%lu/%lu us\n",
+                  (unsigned long)s.triggers, (unsigned long)s.acked,
+                  (unsigned long)s.retransmits, (unsigned long)s.unacked,
+                  (unsigned long)s.rttMinUs, (unsigned long)(s.rttSumUs / s.acked),
+                  (unsigned long)s.rttMaxUs, (unsigned long)s.rttLastUs);
+}
@@ -0,0 +1,71 @@
+/**
+ * Camera Telemetry Implementation
+ */
+
+#include "cam_telemetry.h"
+#include "cam_link.h"
+#include <limits.h>
+
+CamTelemetryStore camTelemetry;
+
+CamTelemetryStore::CamTelemetryStore()
+    : receivedAt(0), haveReport(false), forwarding(false), pendingForward(false),
+      pendingSince(0), reports(0) {
+    memset(&latest, 0, sizeof(latest));
+    memset(mac, 0, sizeof(mac));
+    lock = portMUX_INITIALIZER_UNLOCKED;
+}
+
+void CamTelemetryStore::onFrame(const uint8_t* senderMac, const EspNowHeader& header,
+                                const uint8_t* payload) {
+    if (header.payloadLen < sizeof(CamTelemetry)) {
+        return;
+    }
+    portENTER_CRITICAL(&lock);
+    memcpy(&latest, payload, sizeof(latest));
+    latest.firmware[sizeof(latest.firmware) - 1] = '\0';
+    memcpy(mac, senderMac, sizeof(mac));
+    receivedAt = millis();
+    haveReport = true;
+    reports++;
+    bool willForward = forwarding;
+    if (willForward && !pendingForward) {
+        pendingForward = true;
+        pendingSince = receivedAt;
+    }
+    portEXIT_CRITICAL(&lock);
+
+    // Unacked, the cam posts its own heartbeat
+    TelemetryAck ack;
+    ack.forwarding = willForward ? 1 : 0;
+    camLink.sendControl(FRAME_TELEMETRY_ACK, header.seq, 0, &ack, sizeof(ack));
+}
+
+bool CamTelemetryStore::get(CamHeartbeat& out) {
+    portENTER_CRITICAL(&lock);
+    bool fresh = haveReport && millis() - receivedAt <= CAM_TELEMETRY_STALE_MS;
+    if (fresh) {
+        out.report = latest;
+        out.ageMs = millis() - receivedAt;
+        memcpy(out.mac, mac, sizeof(out.mac));
+    }
+    portEXIT_CRITICAL(&lock);
+    return fresh;
+}
+
+unsigned long CamTelemetryStore::msUntilForwardDue() {
+    portENTER_CRITICAL(&lock);
+    bool pending = pendingForward;
+    unsigned long age = millis() - pendingSince;
+    portEXIT_CRITICAL(&lock);
+    if (!pending) {
+        return ULONG_MAX;
+    }
+    return age >= CAM_TELEMETRY_FORWARD_MS ? 0 : CAM_TELEMETRY_FORWARD_MS - age;
+}
+
+void CamTelemetryStore::markForwarded() {
+    portENTER_CRITICAL(&lock);
+    pendingForward = false;
+    portEXIT_CRITICAL(&lock);
+}
@@ -0,0 +1,247 @@
+/**
+ * Camera UART Implementation
+ * Frame reassembly, in-order delivery, acks and thumbnail pulls
+ */
+
+#include "cam_uart.h"
+#include "cam_link.h"
+
+CamUart::CamUart(HardwareSerial* port)
+    : serial(port), rxLen(0), rxOverflow(false), expectedSeq(0), synced(false),
+      ackDue(false), offeredIncident(0), offerPending(false), thumbIncident(0),
+      thumbTotal(0), thumbReceived(0), thumbActivityAt(0), thumbState(THUMB_IDLE) {
+    memset(&status, 0, sizeof(status));
+    memset(&stats, 0, sizeof(stats));
+    lock = portMUX_INITIALIZER_UNLOCKED;
+}
+
+void CamUart::begin() {
+    // Large enough for a full window, so the camera task can sit in a
+    // trigger retransmit loop without losing bytes
+    serial->setRxBufferSize(CAM_UART_RX_BUFFER);
+    serial->begin(CAM_UART_BAUD, SERIAL_8N1, UART2_RX_PIN, -1);
+    Serial.printf("Cam UART link on GPIO %d at %d baud\n", UART2_RX_PIN, CAM_UART_BAUD);
+}
+
+void CamUart::poll() {
+    int c;
+    while ((c = serial->read()) >= 0) {
+        stats.bytes++;
+
+        if (c != 0) {
+            if (rxLen < sizeof(rxBuf)) {
+                rxBuf[rxLen++] = (uint8_t)c;
+            } else {
+                rxOverflow = true;
+            }
+            continue;
+        }
+
+        // Delimiter: a complete frame (or line noise) is buffered
+        if (rxLen > 0) {
+            UartFrameHeader header;
+            const uint8_t* payload = nullptr;
+            if (!rxOverflow && uartDecode(rxBuf, rxLen, header, &payload)) {
+                handleFrame(header, payload);
+            } else {
+                stats.badFrames++;
+            }
+        }
+        rxLen = 0;
+        rxOverflow = false;
+    }
+
+    // One cumulative ack per poll covers everything read above
+    if (ackDue) {
+        ackDue = false;
+        camLink.sendLinkAck(expectedSeq);
+    }
+
+    if (thumbState == THUMB_PULLING && millis() - thumbActivityAt > CAM_THUMB_TIMEOUT_MS) {
+        Serial.printf("[CAM] Thumbnail pull for %08lX stalled at %u/%u bytes\n",
+                      (unsigned long)thumbIncident, thumbReceived, thumbTotal);
+        thumbState = THUMB_IDLE;
+    }
+}
+
+void CamUart::handleFrame(const UartFrameHeader& header, const uint8_t* payload) {
+    // Frames we already delivered, resent because our ack was lost
+    bool behind = synced && (uint8_t)(expectedSeq - header.seq - 1) < UART_WINDOW;
+
+    if ((header.flags & UART_FLAG_RESYNC) && !behind) {
+        // Cam rebooted or gave up on frames we never acked. A resync frame
+        // resent with its window (seq up to UART_WINDOW behind) is a
+        // duplicate; taking it again would deliver the window twice.
+        expectedSeq = header.seq;
+        synced = true;
+    }
+
+    if (!synced || header.seq != expectedSeq) {
+        if (behind) {
+            stats.duplicates++;
+        } else {
+            stats.outOfOrder++;
+        }
+        ackDue = synced;
+        return;
+    }
+
+    expectedSeq++;
+    stats.frames++;
+    ackDue = true;
+
+    switch (header.type) {
+        case UART_CAPTURE_REPORT: {
+            if (header.payloadLen < sizeof(CaptureReport)) {
+                break;
+            }
+            CaptureReport report;
+            memcpy(&report, payload, sizeof(report));
+
+            portENTER_CRITICAL(&lock);
+            status.captureIncident = header.incidentId;
+            status.capture = report;
+            status.captureAt = millis();
+            portEXIT_CRITICAL(&lock);
+
+            Serial.printf("[CAM] Capture %08lX: %s, %lu bytes in %u ms%s\n",
+                          (unsigned long)header.incidentId, report.ok ? "ok" : "failed",
+                          (unsigned long)report.jpegBytes, report.captureMs,
+                          report.thumbBytes ? ", thumbnail held" : "");
+
+            if (report.thumbBytes > 0 && header.incidentId != 0) {
+                offeredIncident = header.incidentId;
+                offerPending = true;
+            }
+            break;
+        }
+
+        case UART_UPLOAD_REPORT: {
+            if (header.payloadLen < sizeof(UploadReport)) {
+                break;
+            }
+            UploadReport report;
+            memcpy(&report, payload, sizeof(report));
+
+            portENTER_CRITICAL(&lock);
+            status.uploadIncident = header.incidentId;
+            status.upload = report;
+            status.uploadAt = millis();
+            portEXIT_CRITICAL(&lock);
+
+            static const char* results[] = { "uploaded", "failed", "offline" };
+            Serial.printf("[CAM] Upload %08lX: %s in %lu ms, %u queued on cam\n",
+                          (unsigned long)header.incidentId,
+                          report.result <= UPLOAD_RESULT_OFFLINE ? results[report.result] : "?",
+                          (unsigned long)report.uploadMs, report.queued);
+            break;
+        }
+
+        case UART_THUMB_CHUNK:
+            handleThumbChunk(header.incidentId, payload, header.payloadLen);
+            break;
+    }
+}
+
+void CamUart::handleThumbChunk(uint32_t incidentId, const uint8_t* payload, uint16_t len) {
+    if (thumbState != THUMB_PULLING || incidentId != thumbIncident ||
+        len < sizeof(ThumbChunkHeader)) {
+        return;
+    }
+
+    ThumbChunkHeader chunk;
+    memcpy(&chunk, payload, sizeof(chunk));
+    uint16_t dataLen = len - sizeof(chunk);
+
+    // The link delivers in order, so anything but the next offset means
+    // the cam restarted the transfer
+    if (chunk.total > sizeof(thumb) || chunk.offset != thumbReceived ||
+        (uint32_t)chunk.offset + dataLen > chunk.total) {
+        Serial.printf("[CAM] Thumbnail chunk %u/%u rejected\n", chunk.offset, chunk.total);
+        thumbState = THUMB_IDLE;
+        return;
+    }
+
+    memcpy(thumb + chunk.offset, payload + sizeof(chunk), dataLen);
+    thumbTotal = chunk.total;
+    thumbReceived += dataLen;
+    thumbActivityAt = millis();
+
+    if (thumbReceived == thumbTotal) {
+        Serial.printf("[CAM] Thumbnail %08lX received: %u bytes\n",
+                      (unsigned long)thumbIncident, thumbTotal);
+        portENTER_CRITICAL(&lock);
+        thumbState = THUMB_READY;
+        portEXIT_CRITICAL(&lock);
+    }
+}
+
+bool CamUart::takeThumbnailOffer(uint32_t& incidentId) {
+    if (!offerPending) {
+        return false;
+    }
+    offerPending = false;
+    incidentId = offeredIncident;
+    return true;
+}
+
+bool CamUart::requestThumbnail(uint32_t incidentId) {
+    if (thumbState != THUMB_IDLE) {
+        return false;  // One at a time; the buffer may still be forwarding
+    }
+
+    thumbIncident = incidentId;
+    thumbTotal = 0;
+    thumbReceived = 0;
+    thumbActivityAt = millis();
+    thumbState = THUMB_PULLING;
+
+    if (!camLink.sendThumbRequest(incidentId)) {
+        thumbState = THUMB_IDLE;
+        return false;
+    }
+    Serial.printf("[CAM] Pulling thumbnail for %08lX\n", (unsigned long)incidentId);
+    return true;
+}
+
+bool CamUart::getThumbnail(uint32_t& incidentId, const uint8_t*& data, size_t& len) {
+    portENTER_CRITICAL(&lock);
+    bool ready = thumbState == THUMB_READY;
+    portEXIT_CRITICAL(&lock);
+    if (!ready) {
+        return false;
+    }
+    incidentId = thumbIncident;
+    data = thumb;
+    len = thumbTotal;
+    return true;
+}
+
+void CamUart::releaseThumbnail() {
+    portENTER_CRITICAL(&lock);
+    if (thumbState == THUMB_READY) {
+        thumbState = THUMB_IDLE;
+    }
+    portEXIT_CRITICAL(&lock);
+}
+
+CamStatus CamUart::getStatus() {
+    CamStatus snapshot;
+    portENTER_CRITICAL(&lock);
+    snapshot = status;
+    portEXIT_CRITICAL(&lock);
+    return snapshot;
+}
+
+CamUartStats CamUart::getStats() {
+    // Counters are only written by the camera task; a torn read here
+    // is off by one at worst
+    return stats;
+}
+
+void CamUart::printStats() {
+    CamUartStats s = getStats();
+    Serial.printf("Cam UART: %lu frames, %lu bytes, %lu bad, %lu out of order, %lu duplicates\n",
+                  (unsigned long)s.frames, (unsigned long)s.bytes, (unsigned long)s.badFrames,
+                  (unsigned long)s.outOfOrder, (unsigned long)s.duplicates);
+}
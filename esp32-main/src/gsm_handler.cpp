@@ -6,129 +6,370 @@
 #include "gsm_handler.h"
 #include "config.h"
 
-GSMHandler::GSMHandler(HardwareSerial* serial) 
-    : gsmSerial(serial), lastSMSTime(0), initialized(false) {
+static const unsigned long SMS_SEND_TIMEOUT_MS = 60000;  // Prompt + network submit
+
+GSMHandler::GSMHandler(HardwareSerial* serial)
+    : gsmSerial(serial), lastSMSTime(0), initialized(false),
+      healthStep(0), nextHealthAt(0), incomingSmsCount(0), ringCount(0),
+      smsInFlight(false), smsCallback(nullptr), smsCtx(nullptr), smsStartedAt(0),
+      smsAlertsDue(false),
+      signalCallback(nullptr), signalCtx(nullptr),
+      socketClosedCallback(nullptr), socketClosedCtx(nullptr), modemMutex(nullptr),
+      sleepEnabled(false), dtrLow(true) {
+    memset(&health, 0, sizeof(health));
+    health.csq = 99;
+    health.registration = -1;
+    healthLock = portMUX_INITIALIZER_UNLOCKED;
 }
 
 bool GSMHandler::begin() {
+    // Created first: tasks rely on it even if the modem never answers
+    modemMutex = xSemaphoreCreateMutexStatic(&modemMutexBuf);
+
+    if (GSM_DTR_PIN >= 0) {
+        pinMode(GSM_DTR_PIN, OUTPUT);
+        digitalWrite(GSM_DTR_PIN, LOW);  // Awake during setup
+    }
+
     gsmSerial->begin(9600, SERIAL_8N1, GSM_RX_PIN, GSM_TX_PIN);
     delay(3000);  // Give module time to start
 
     // Drain any garbage on the line (helps on 38-pin / noisy boards)
-    while (gsmSerial->available()) gsmSerial->read();
+    at.begin(gsmSerial);
     delay(200);
+    at.flushInput();
+
+    at.onURC("+CREG:", onCREG, this);
+    at.onURC("+CMTI:", onCMTI, this);
+    at.onURC("RING", onRING, this);
+    at.onURC("+CIPRXGET:", nullURC, this);  // Data-ready notices belong to the GPRS session
+    at.onURC("0, CLOSED", onCLOSED, this);   // TinyGSM data sockets (CIPMUX=1)
+    at.onURC("1, CLOSED", onCLOSED, this);
 
     Serial.println("Initializing GSM module...");
 
     // Test communication (retry once in case of cold start)
-    if (!sendATCommand("AT", "OK", 2000)) {
+    if (at.execute("AT", 2000) != AT_RESULT_OK) {
         delay(500);
-        while (gsmSerial->available()) gsmSerial->read();
-        if (!sendATCommand("AT", "OK", 3000)) {
+        at.flushInput();
+        if (at.execute("AT", 3000) != AT_RESULT_OK) {
             Serial.println("GSM: No response to AT - check wiring (TX/RX crossed?) and power (2A supply)");
             return false;
         }
     }
-    
+
     // Disable echo
-    sendATCommand("ATE0");
-    
+    at.execute("ATE0", 5000);
+
     // Set SMS mode to text
-    if (!sendATCommand("AT+CMGF=1", "OK")) {
+    if (at.execute("AT+CMGF=1", 5000) != AT_RESULT_OK) {
         Serial.println("GSM: Failed to set SMS text mode");
         return false;
     }
-    
+
+    // Report registration changes and new SMS as URCs
+    at.execute("AT+CREG=1", 5000);
+    at.execute("AT+CNMI=2,1,0,0,0", 5000);
+
     // Wait for network registration (up to 30 s)
     Serial.println("Waiting for network registration...");
     for (int i = 0; i < 30; i++) {
         if (isNetworkRegistered()) {
             initialized = true;
-            sendATCommand("AT+CNETLIGHT=1");
+            at.execute("AT+CNETLIGHT=1", 5000);
             Serial.println("GSM initialized successfully! (Netlight LED enabled)");
+            enableSleep();
             return true;
         }
         delay(1000);
     }
-    
+
     // No network yet - still mark ready so we attempt SMS on alert (may work if signal appears later)
     initialized = true;
     Serial.println("GSM: No network in 30s - module ready, SMS will be attempted on alert");
+    enableSleep();
     return true;
 }
 
-bool GSMHandler::sendATCommand(const char* command, const char* expectedResponse, unsigned long timeout) {
-    gsmSerial->println(command);
-    return waitForResponse(expectedResponse, timeout);
+// Enabled last so registration polling at boot never pays for wake-ups.
+// Incoming SMS and calls wake the modem on their own and their URCs reach
+// the always-listening UART; new SMS are also stored on the SIM (CNMI=2,1)
+// so a garbled +CMTI never loses the message itself.
+void GSMHandler::enableSleep() {
+    if (!GSM_SLEEP_ENABLED) {
+        return;
+    }
+    const char* cmd = GSM_DTR_PIN >= 0 ? "AT+CSCLK=1" : "AT+CSCLK=2";
+    if (at.execute(cmd, 2000) != AT_RESULT_OK) {
+        Serial.println("GSM: Slow clock not supported - modem stays awake");
+        return;
+    }
+    at.setSleepAfter(GSM_SLEEP_IDLE_MS, onWake, this);
+    sleepEnabled = true;
+    Serial.printf("GSM: Sleep enabled (%s)\n", cmd);
+}
+
+void GSMHandler::onWake(void* ctx) {
+    GSMHandler* self = (GSMHandler*)ctx;
+    if (GSM_DTR_PIN >= 0 && !self->dtrLow) {
+        digitalWrite(GSM_DTR_PIN, LOW);
+        self->dtrLow = true;
+    }
+    // URCs sent while the UART was asleep may have been cut short
+    self->refreshHealth();
+}
+
+void GSMHandler::poll() {
+    at.poll();
+
+    // DTR mode: let the modem sleep once the line has gone quiet
+    if (GSM_DTR_PIN >= 0 && sleepEnabled && dtrLow && at.isIdle() && !smsInFlight &&
+        at.idleFor() >= GSM_SLEEP_IDLE_MS) {
+        digitalWrite(GSM_DTR_PIN, HIGH);
+        dtrLow = false;
+    }
+}
+
+// +CREG: <stat> (URC) or +CREG: <n>,<stat> (query response)
+int GSMHandler::parseCREGStatus(const char* line) {
+    const char* p = strchr(line, ':');
+    if (!p) {
+        return -1;
+    }
+    int first = atoi(p + 1);
+    const char* comma = strchr(p, ',');
+    return comma ? atoi(comma + 1) : first;
+}
+
+void GSMHandler::setRegistration(int stat) {
+    int previous = health.registration;
+    portENTER_CRITICAL(&healthLock);
+    health.registration = stat;
+    health.registrationAt = millis();
+    portEXIT_CRITICAL(&healthLock);
+
+    if (stat != previous) {
+        Serial.printf("GSM: Registration status %d -> %d\n", previous, stat);
+    }
+}
+
+void GSMHandler::setSignal(int csq) {
+    portENTER_CRITICAL(&healthLock);
+    health.csq = csq;
+    health.csqAt = millis();
+    portEXIT_CRITICAL(&healthLock);
+}
+
+void GSMHandler::onCREG(const char* line, void* ctx) {
+    ((GSMHandler*)ctx)->setRegistration(parseCREGStatus(line));
+}
+
+void GSMHandler::onCMTI(const char* line, void* ctx) {
+    GSMHandler* self = (GSMHandler*)ctx;
+    self->incomingSmsCount++;
+    Serial.printf("GSM: Incoming SMS (%s)\n", line);
 }
 
-bool GSMHandler::waitForResponse(const char* expected, unsigned long timeout) {
+void GSMHandler::onRING(const char*, void* ctx) {
+    GSMHandler* self = (GSMHandler*)ctx;
+    self->ringCount++;
+    Serial.println("GSM: Incoming call");
+}
+
+void GSMHandler::nullURC(const char*, void*) {
+}
+
+// TinyGSM only sees the close when it reads the UART itself; between
+// posts the line is the AT engine's, so pass it on
+void GSMHandler::onCLOSED(const char* line, void* ctx) {
+    GSMHandler* self = (GSMHandler*)ctx;
+    uint8_t mux = line[0] - '0';
+    Serial.printf("GSM: Data connection %u closed by the server\n", mux);
+    if (self->socketClosedCallback) {
+        self->socketClosedCallback(mux, self->socketClosedCtx);
+    }
+}
+
+void GSMHandler::setSocketClosedHandler(SocketClosedCallback callback, void* ctx) {
+    socketClosedCallback = callback;
+    socketClosedCtx = ctx;
+}
+
+bool GSMHandler::lockModem(unsigned long timeoutMs) {
+    if (!modemMutex) {
+        return false;
+    }
+    return xSemaphoreTake(modemMutex, pdMS_TO_TICKS(timeoutMs)) == pdTRUE;
+}
+
+void GSMHandler::unlockModem() {
+    if (modemMutex) {
+        xSemaphoreGive(modemMutex);
+    }
+}
+
+bool GSMHandler::acquireIdleModem(unsigned long timeoutMs) {
     unsigned long start = millis();
-    String response = "";
-    
-    while (millis() - start < timeout) {
-        if (gsmSerial->available()) {
-            char c = gsmSerial->read();
-            response += c;
-            
-            if (response.indexOf(expected) >= 0) {
+    do {
+        unsigned long elapsed = millis() - start;
+        if (lockModem(timeoutMs > elapsed ? timeoutMs - elapsed : 0)) {
+            if (at.isIdle() && !smsInFlight && !smsAlertsDue) {
+                // TinyGSM writes straight to the UART - make sure it is heard
+                if (at.isLikelyAsleep()) {
+                    at.execute("AT", 1000);
+                }
                 return true;
             }
-            
-            if (response.indexOf("ERROR") >= 0) {
-                return false;
-            }
+            unlockModem();  // Let the GSM task finish its command or send the alert
         }
-        delay(10);
-    }
-    
+        delay(20);
+    } while (millis() - start < timeoutMs);
     return false;
 }
 
 bool GSMHandler::isNetworkRegistered() {
-    gsmSerial->println("AT+CREG?");
-    
-    unsigned long start = millis();
-    String response = "";
-    
-    while (millis() - start < 3000) {
-        if (gsmSerial->available()) {
-            response += (char)gsmSerial->read();
-            
-            // Check for registration status
-            // +CREG: 0,1 = registered on home network
-            // +CREG: 0,5 = registered on roaming network
-            if (response.indexOf("+CREG: 0,1") >= 0 || 
-                response.indexOf("+CREG: 0,5") >= 0) {
-                return true;
-            }
-        }
+    char info[AT_INFO_MAX];
+    if (at.execute("AT+CREG?", 3000, "+CREG:", info, sizeof(info)) == AT_RESULT_OK) {
+        setRegistration(parseCREGStatus(info));
     }
-    
-    return false;
+
+    // 1 = registered on home network, 5 = registered roaming
+    return health.registration == 1 || health.registration == 5;
+}
+
+// +CSQ: <rssi>,<ber>
+int GSMHandler::parseCSQ(const char* info) {
+    const char* p = strstr(info, "+CSQ:");
+    return p ? atoi(p + 5) : 0;
+}
+
+void GSMHandler::onCSQResult(const ATResponse& response, void* ctx) {
+    GSMHandler* self = (GSMHandler*)ctx;
+    int csq = response.code == AT_RESULT_OK ? parseCSQ(response.info) : 0;
+    if (response.code == AT_RESULT_OK) {
+        self->setSignal(csq);
+    }
+    if (self->signalCallback) {
+        SignalCallback cb = self->signalCallback;
+        self->signalCallback = nullptr;
+        cb(csq, self->signalCtx);
+    }
+}
+
+bool GSMHandler::requestSignalStrength(SignalCallback callback, void* ctx) {
+    if (signalCallback) {
+        return false;  // Previous request still outstanding
+    }
+    signalCallback = callback;
+    signalCtx = ctx;
+    if (!at.submit("AT+CSQ", 2000, onCSQResult, this, "+CSQ:")) {
+        signalCallback = nullptr;
+        return false;
+    }
+    return true;
 }
 
 int GSMHandler::getSignalStrength() {
-    gsmSerial->println("AT+CSQ");
-    
-    unsigned long start = millis();
-    String response = "";
-    
-    while (millis() - start < 2000) {
-        if (gsmSerial->available()) {
-            char c = gsmSerial->read();
-            response += c;
+    char info[AT_INFO_MAX];
+    if (at.execute("AT+CSQ", 2000, "+CSQ:", info, sizeof(info)) != AT_RESULT_OK) {
+        return 0;
+    }
+    int csq = parseCSQ(info);
+    setSignal(csq);
+    return csq;
+}
+
+// +COPS: <mode>[,<format>,"<oper>"]
+bool GSMHandler::parseCOPS(const char* info, char* out, size_t outLen) {
+    const char* start = strchr(info, '"');
+    if (!start) {
+        return false;
+    }
+    start++;
+    const char* end = strchr(start, '"');
+    size_t n = end ? (size_t)(end - start) : strlen(start);
+    if (n >= outLen) {
+        n = outLen - 1;
+    }
+    memcpy(out, start, n);
+    out[n] = '\0';
+    return true;
+}
+
+// Health refresh cycle: CSQ -> CREG? -> COPS?, one command at a time
+static const char* const HEALTH_COMMANDS[] = { "AT+CSQ", "AT+CREG?", "AT+COPS?" };
+static const char* const HEALTH_PREFIXES[] = { "+CSQ:", "+CREG:", "+COPS:" };
+static const uint8_t HEALTH_STEPS = 3;
+
+void GSMHandler::onHealthResult(const ATResponse& response, void* ctx) {
+    GSMHandler* self = (GSMHandler*)ctx;
+    uint8_t step = self->healthStep;
+
+    if (response.code == AT_RESULT_OK) {
+        if (step == 1) {
+            self->setSignal(parseCSQ(response.info));
+        } else if (step == 2) {
+            self->setRegistration(parseCREGStatus(response.info));
+        } else if (step == 3) {
+            char name[sizeof(self->health.operatorName)];
+            if (!parseCOPS(response.info, name, sizeof(name))) {
+                name[0] = '\0';  // Not registered: +COPS: 0
+            }
+            portENTER_CRITICAL(&self->healthLock);
+            memcpy(self->health.operatorName, name, sizeof(name));
+            self->health.operatorAt = millis();
+            portEXIT_CRITICAL(&self->healthLock);
         }
     }
-    
-    // Parse response: +CSQ: <rssi>,<ber>
-    int idx = response.indexOf("+CSQ:");
-    if (idx >= 0) {
-        int rssi = response.substring(idx + 6).toInt();
-        return rssi;
+
+    if (response.code != AT_RESULT_OK || step >= HEALTH_STEPS) {
+        self->healthStep = 0;
+        self->nextHealthAt = millis() +
+            (self->sleepEnabled ? GSM_HEALTH_POLL_SLEEP_MS : GSM_HEALTH_POLL_MS);
+    } else {
+        self->healthStep = step + 1;
+    }
+}
+
+void GSMHandler::pollHealth() {
+    if (healthStep == 0 && (long)(millis() - nextHealthAt) < 0) {
+        return;
+    }
+    // Yield to alert traffic: never queue behind or ahead of an SMS
+    if (!initialized || !at.isIdle() || smsInFlight) {
+        return;
+    }
+    if (healthStep == 0) {
+        healthStep = 1;
+    }
+    if (!at.submit(HEALTH_COMMANDS[healthStep - 1], 3000, onHealthResult, this,
+                   HEALTH_PREFIXES[healthStep - 1])) {
+        healthStep = 0;
+        nextHealthAt = millis() + GSM_HEALTH_POLL_MS;
+    }
+}
+
+GSMHealth GSMHandler::getHealth() {
+    GSMHealth snapshot;
+    portENTER_CRITICAL(&healthLock);
+    snapshot = health;
+    portEXIT_CRITICAL(&healthLock);
+    return snapshot;
+}
+
+bool GSMHandler::isNetworkUsable() {
+    GSMHealth h = getHealth();
+    unsigned long now = millis();
+
+    // CREG URCs keep registration current, so only a missing value is unknown
+    if (h.registrationAt != 0 && h.registration != 1 && h.registration != 5) {
+        return false;
+    }
+    bool signalFresh = h.csqAt != 0 && now - h.csqAt < GSM_HEALTH_STALE_MS;
+    if (signalFresh && (h.csq == 0 || h.csq == 99)) {
+        return false;
     }
-    
-    return 0;
+    return true;
 }
 
 bool GSMHandler::canSendSMS() {
@@ -141,71 +382,80 @@ bool GSMHandler::canSendSMS() {
     return true;
 }
 
-bool GSMHandler::sendSMS(const char* phoneNumber, const char* message, bool force) {
+void GSMHandler::onSMSResult(const ATResponse& response, void* ctx) {
+    GSMHandler* self = (GSMHandler*)ctx;
+    bool success = response.code == AT_RESULT_OK && strstr(response.info, "+CMGS:") != nullptr;
+
+    if (success) {
+        self->lastSMSTime = millis();
+        Serial.printf("SMS sent successfully! (%lu ms, '>' after %lu ms)\n",
+                      millis() - self->smsStartedAt, self->at.getLastPromptMs());
+    } else if (response.code == AT_RESULT_TIMEOUT) {
+        Serial.println("SMS: Timed out (try power/signal/wiring)");
+    } else {
+        Serial.printf("SMS send failed: %s\n", response.info);
+    }
+
+    self->smsInFlight = false;
+    if (self->smsCallback) {
+        self->smsCallback(success, self->smsCtx);
+    }
+}
+
+bool GSMHandler::sendSMSAsync(const char* phoneNumber, const char* message,
+                              SMSCallback callback, void* ctx, bool force) {
     if (!initialized && !force) {
         Serial.println("GSM not initialized");
         return false;
     }
-    
+
     if (!canSendSMS() && !force) {
         Serial.println("SMS rate limit active (use force to bypass)");
         return false;
     }
-    
-    Serial.printf("Sending SMS to %s\n", phoneNumber);
-    
-    char cmd[64];
-    sprintf(cmd, "AT+CMGS=\"%s\"", phoneNumber);
-    bool gotPrompt = false;
-    const int maxTries = 2;
-
-    for (int tryNum = 0; tryNum < maxTries && !gotPrompt; tryNum++) {
-        if (tryNum > 0) {
-            Serial.println("SMS: Retrying...");
-            delay(500);
-        }
-        // Drain RX so we don't see stale data
-        while (gsmSerial->available()) gsmSerial->read();
-        delay(50);
-
-        gsmSerial->println(cmd);
-        delay(800);  // Give module time to respond
-
-        unsigned long start = millis();
-        String line;
-        while (millis() - start < 8000) {
-            if (gsmSerial->available()) {
-                char c = gsmSerial->read();
-                if (c == '>') {
-                    gotPrompt = true;
-                    break;
-                }
-                line += c;
-                if (line.length() > 80) line = line.substring(line.length() - 80);
-                if (line.indexOf("ERROR") >= 0 || line.indexOf("CMS ERROR") >= 0) {
-                    Serial.println("SMS: Module error (check number/signal)");
-                    return false;
-                }
-            }
-            delay(10);
-        }
+
+    if (smsInFlight) {
+        return false;
     }
 
-    if (!gotPrompt) {
-        Serial.println("SMS: No prompt received (try power/signal/wiring)");
+    Serial.printf("Sending SMS to %s\n", phoneNumber);
+
+    char cmd[AT_CMD_MAX];
+    snprintf(cmd, sizeof(cmd), "AT+CMGS=\"%s\"", phoneNumber);
+
+    smsInFlight = true;
+    smsCallback = callback;
+    smsCtx = ctx;
+    smsStartedAt = millis();
+
+    // Message body goes out on the '>' prompt, followed by Ctrl+Z
+    if (!at.submit(cmd, SMS_SEND_TIMEOUT_MS, onSMSResult, this, "+CMGS:", message)) {
+        smsInFlight = false;
+        Serial.println("SMS: AT queue full");
         return false;
     }
+    return true;
+}
 
-    // Send message body then Ctrl+Z
-    gsmSerial->print(message);
-    delay(150);
-    gsmSerial->write(26);
+struct SyncSMS {
+    bool done;
+    bool success;
+};
+
+static void syncSMSCallback(bool success, void* ctx) {
+    SyncSMS* result = (SyncSMS*)ctx;
+    result->success = success;
+    result->done = true;
+}
 
-    if (waitForResponse("+CMGS:", 15000)) {
-        lastSMSTime = millis();
-        Serial.println("SMS sent successfully!");
-        return true;
+bool GSMHandler::sendSMS(const char* phoneNumber, const char* message, bool force) {
+    SyncSMS result = { false, false };
+    if (!sendSMSAsync(phoneNumber, message, syncSMSCallback, &result, force)) {
+        return false;
     }
-    Serial.println("SMS send failed");
-    return false;
+    while (!result.done) {
+        at.poll();
+        delay(5);
+    }
+    return result.success;
 }
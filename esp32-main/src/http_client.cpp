@@ -5,34 +5,47 @@
 
 #include "http_client.h"
 #include "config.h"
+#include "alert_dispatcher.h"
+#include "trace.h"
 #include <ArduinoJson.h>
+#include <HTTPClient.h>  // HTTP_CODE_* names
 #include <time.h>
+#include <limits.h>
+
+static const WiFiNetwork wifiNetworks[] = WIFI_NETWORKS;
 
 BackendClient::BackendClient(const char* url, const char* key) 
-    : baseUrl(url), apiKey(key), retryCount(0), lastRetryTime(0) {
+    : wifi(url, key), fallback(nullptr),
+      wifiConnector(wifiNetworks, sizeof(wifiNetworks) / sizeof(wifiNetworks[0]),
+                    { WIFI_FAST_CONNECT_TIMEOUT_MS, WIFI_CONNECT_TIMEOUT_MS, WIFI_IP_REUSE_MS,
+                      WIFI_RETRY_BASE_MS, WIFI_RETRY_MAX_MS }),
+      replayRetry("alerts", { ALERT_REPLAY_RETRY_MS, ALERT_REPLAY_RETRY_MAX_MS,
+                              ALERT_BREAKER_TRIP, ALERT_REPLAY_RETRY_MAX_MS }),
+      imageRetry("images", { IMAGE_RETRY_BASE_MS, IMAGE_RETRY_MAX_MS,
+                             IMAGE_BREAKER_TRIP, IMAGE_BREAKER_OPEN_MS }),
+      batching(true), offline(false), offlineAt(0), lastDrainRate(0),
+      prewarmHeld(false), prewarmUntil(0),
+      prewarmConnectMs(0), prewarms(0), prewarmsUsed(0), prewarmsExpired(0),
+      prewarmSavedMs(0),
+      liveness({ HEARTBEAT_INTERVAL_MS, LIVENESS_FAST_MS, LIVENESS_MAX_MS,
+                 LIVENESS_INCIDENT_HOLD_MS }) {
+    deviceTag[0] = '\0';
 }
 
 bool BackendClient::connectWiFi() {
-    if (WiFi.status() == WL_CONNECTED) {
+    if (wifiConnector.isUp()) {
         return true;
     }
     
     Serial.print("Connecting to WiFi: ");
     Serial.println(WIFI_SSID);
     
-    WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
-    
-    unsigned long start = millis();
-    while (WiFi.status() != WL_CONNECTED) {
-        if (millis() - start > WIFI_CONNECT_TIMEOUT_MS) {
-            Serial.println("\nWiFi connection failed!");
-            return false;
-        }
-        delay(500);
-        Serial.print(".");
+    if (!wifiConnector.connect()) {
+        Serial.println("WiFi connection failed!");
+        return false;
     }
     
-    Serial.println("\nWiFi connected!");
+    Serial.println("WiFi connected!");
     Serial.print("IP address: ");
     Serial.println(WiFi.localIP());
     
@@ -40,107 +53,551 @@ bool BackendClient::connectWiFi() {
 }
 
 bool BackendClient::isConnected() {
-    return WiFi.status() == WL_CONNECTED;
+    return wifiConnector.isUp();
 }
 
-void BackendClient::reconnect() {
-    WiFi.disconnect();
-    delay(1000);
-    connectWiFi();
+void BackendClient::begin() {
+    outbox.begin();
+    wifiConnector.begin();
+
+    uint8_t mac[6];
+    WiFi.macAddress(mac);
+    snprintf(deviceTag, sizeof(deviceTag), "%02X%02X%02X", mac[3], mac[4], mac[5]);
 }
 
-bool BackendClient::postAlert(HumanDetectionResult& detection, const char* networkStatus) {
-    if (!isConnected()) {
-        Serial.println("WiFi not connected, cannot post alert");
-        return false;
+BackendTransport* BackendClient::selectTransport(bool& compact) {
+    compact = false;
+    if (wifi.isAvailable()) {
+        return &wifi;
     }
-    
+    if (fallback && fallback->isAvailable()) {
+        compact = true;
+        return fallback;
+    }
+    return nullptr;
+}
+
+void BackendClient::formatKey(const AlertRecord& rec, char* out, size_t outLen) {
+    snprintf(out, outLen, "%s-%08lX", deviceTag, (unsigned long)rec.id);
+}
+
+static const char* networkName(uint8_t network) {
+    switch (network) {
+        case ALERT_NET_GPRS: return "gprs";
+        case ALERT_NET_OFFLINE: return "offline";
+        default: return "online";
+    }
+}
+
+void BackendClient::addAlertFields(JsonObject obj, const AlertRecord& rec, bool compact) {
+    char key[24];
+    formatKey(rec, key, sizeof(key));
+    char incident[9];
+    snprintf(incident, sizeof(incident), "%08lX", (unsigned long)rec.id);
+
+    if (compact) {
+        // Short keys for metered GPRS: seconds, confidence %, PIR bitmask (L=1, M=2, R=4)
+        obj["t"] = rec.timestamp;
+        obj["c"] = rec.confidence;
+        obj["p"] = rec.pirMask;
+        obj["n"] = networkName(rec.network);
+        obj["k"] = key;  // Copied by ArduinoJson (char array)
+        obj["i"] = incident;
+    } else {
+        obj["timestamp"] = (unsigned long long)rec.timestamp * 1000;
+        obj["detection_confidence"] = rec.confidence / 100.0f;
+        obj["pir_left"] = (rec.pirMask & PIR_MASK_LEFT) != 0;
+        obj["pir_middle"] = (rec.pirMask & PIR_MASK_MIDDLE) != 0;
+        obj["pir_right"] = (rec.pirMask & PIR_MASK_RIGHT) != 0;
+        obj["network_status"] = networkName(rec.network);
+        obj["idempotency_key"] = key;
+        obj["incident_id"] = incident;  // Same value the camera sends with its images
+    }
+}
+
+size_t BackendClient::buildAlertPayload(const AlertRecord& rec, bool compact, bool msgpack,
+                                        char* out, size_t outLen) {
+    StaticJsonDocument<512> doc;
+    addAlertFields(doc.to<JsonObject>(), rec, compact);
+    return wire.serialize(doc, msgpack, (uint8_t*)out, outLen);
+}
+
+size_t BackendClient::buildBatchPayload(const AlertRecord* recs, int count, bool compact,
+                                        bool msgpack, char* out, size_t outLen) {
+    StaticJsonDocument<2048> doc;
+    JsonArray alerts = doc.createNestedArray(compact ? "a" : "alerts");
+    for (int i = 0; i < count; i++) {
+        addAlertFields(alerts.createNestedObject(), recs[i], compact);
+    }
+    return wire.serialize(doc, msgpack, (uint8_t*)out, outLen);
+}
+
+void BackendClient::scheduleReplay(bool failed) {
+    if (failed) {
+        replayRetry.onFailure();
+    } else {
+        replayRetry.onSuccess();
+    }
+}
+
+void BackendClient::noteOffline() {
+    offline = true;
+    offlineAt = millis();
+}
+
+void BackendClient::noteLinkUp() {
+    offline = false;
+    replayRetry.reset();
+    imageRetry.reset();
+}
+
+unsigned long BackendClient::msUntilReplay() const {
+    if (outbox.depth() == 0) {
+        return ULONG_MAX;
+    }
+    unsigned long waitMs = replayRetry.msUntilReady();
+    unsigned long offlineMs = millis() - offlineAt;
+    if (offline && offlineMs < ALERT_REPLAY_RETRY_MS &&
+        ALERT_REPLAY_RETRY_MS - offlineMs > waitMs) {
+        waitMs = ALERT_REPLAY_RETRY_MS - offlineMs;
+    }
+    return waitMs;
+}
+
+void BackendClient::printRetryStats() const {
+    replayRetry.printStats();
+    imageRetry.printStats();
+}
+
+void BackendClient::prewarm() {
+    if (prewarmHeld) {
+        prewarmUntil = millis() + PREWARM_HOLD_MS;  // Still moving: keep it
+        return;
+    }
+    // A connection kept alive since the last post is warm already
+    unsigned long connectMs = 0;
+    if (!wifi.prewarm(PREWARM_HEAD_PATH, connectMs) || connectMs == 0) {
+        return;
+    }
+    prewarms++;
+    prewarmHeld = true;
+    prewarmConnectMs = connectMs;
+    prewarmUntil = millis() + PREWARM_HOLD_MS;
+}
+
+void BackendClient::expirePrewarm() {
+    if (!prewarmHeld || (long)(millis() - prewarmUntil) < 0) {
+        return;
+    }
+    prewarmHeld = false;
+    prewarmsExpired++;
+    // Not left for the server's idle timeout: no radio time or server
+    // socket spent on a connection nothing is going to use
+    wifi.closeIdle();
+    Serial.println("HTTP: no detection followed - pre-warmed connection closed");
+}
+
+unsigned long BackendClient::msUntilPrewarmExpiry() const {
+    if (!prewarmHeld) {
+        return ULONG_MAX;
+    }
+    long remaining = (long)(prewarmUntil - millis());
+    return remaining > 0 ? (unsigned long)remaining : 0;
+}
+
+void BackendClient::printPrewarmStats() const {
+    Serial.printf("Pre-warm: %lu opened, %lu used by an alert, %lu closed unused, "
+                  "%lu ms connect time saved (%lu ms per alert)\n",
+                  (unsigned long)prewarms, (unsigned long)prewarmsUsed,
+                  (unsigned long)prewarmsExpired, prewarmSavedMs,
+                  prewarmsUsed ? prewarmSavedMs / prewarmsUsed : 0UL);
+}
+
+bool BackendClient::postAlert(HumanDetectionResult& detection, const char* networkStatus,
+                              uint32_t incidentId, uint32_t sequence) {
+    liveness.noteIncident();
+    bool compact = false;
+    BackendTransport* transport = selectTransport(compact);
+
     // Use device time only if NTP synced (clock >= 2 days); else send 0 so backend uses server time
     time_t now = time(nullptr);
     const unsigned long twoDaysSec = 86400UL * 2;
-    unsigned long timestamp = ((unsigned long)now >= twoDaysSec)
-        ? (unsigned long)now * 1000
-        : 0;
 
-    // Prepare JSON payload
-    StaticJsonDocument<512> doc;
-    doc["timestamp"] = timestamp;
-    doc["detection_confidence"] = detection.confidence;
-    doc["pir_left"] = detection.pir_left;
-    doc["pir_middle"] = detection.pir_middle;
-    doc["pir_right"] = detection.pir_right;
-    doc["network_status"] = networkStatus;
-    
-    String payload;
-    serializeJson(doc, payload);
-    
-    // Prepare HTTP request
-    String url = String(baseUrl) + "/api/v1/burglary/alert/alert";
-    
-    Serial.println("Posting alert to backend:");
-    Serial.println(url);
-    Serial.println(payload);
-    
-    http.begin(url);
-    http.addHeader("Content-Type", "application/json");
-    http.addHeader("X-API-Key", apiKey);
-    http.setTimeout(SERVER_TIMEOUT_MS);
-    
-    int httpCode = http.POST(payload);
-    
-    if (httpCode > 0) {
-        Serial.printf("HTTP Response code: %d\n", httpCode);
-        
+    AlertRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.id = incidentId;
+    rec.timestamp = ((unsigned long)now >= twoDaysSec) ? (uint32_t)now : 0;
+    rec.sequence = sequence;
+    rec.confidence = (uint8_t)(detection.confidence * 100 + 0.5f);
+    rec.pirMask = (detection.pir_left ? PIR_MASK_LEFT : 0) |
+                  (detection.pir_middle ? PIR_MASK_MIDDLE : 0) |
+                  (detection.pir_right ? PIR_MASK_RIGHT : 0);
+    rec.network = !transport ? ALERT_NET_OFFLINE
+                : transport == fallback ? ALERT_NET_GPRS
+                : ALERT_NET_ONLINE;
+
+    // Durable before the first attempt: a reset mid-request still replays it
+    outbox.push(rec);
+
+    if (!transport) {
+        Serial.printf("No backend transport available - alert queued (outbox depth %d)\n",
+                      outbox.depth());
+        noteOffline();
+        return false;
+    }
+
+    bool msgpack = wire.useMsgPack();
+    char payload[256];
+    size_t len = buildAlertPayload(rec, compact, msgpack, payload, sizeof(payload));
+    char key[24];
+    formatKey(rec, key, sizeof(key));
+    HttpHeader headers[] = { { "Idempotency-Key", key } };
+    const char* path = "/api/v1/burglary/alert/alert";
+
+    if (msgpack) {
+        Serial.printf("Posting alert to backend via %s (%u-byte MessagePack)\n",
+                      transport->name(), (unsigned)len);
+    } else {
+        Serial.printf("Posting alert to backend via %s:\n", transport->name());
+        Serial.println(payload);
+    }
+
+    // The connect time the pre-warm paid is what this post saves
+    bool warm = prewarmHeld && transport == &wifi && wifi.isWarm();
+    prewarmHeld = false;
+
+    outbox.markAttempt(rec.id);
+    unsigned long postStart = millis();
+    int httpCode = exchange(transport, path, WireFormat::contentType(msgpack, compact),
+                            (const uint8_t*)payload, len, headers, 1);
+    if (warm) {
+        prewarmsUsed++;
+        prewarmSavedMs += prewarmConnectMs;
+        Serial.printf("Alert posted on the pre-warmed connection in %lu ms "
+                      "(%lu ms of connect and TLS paid at the first PIR edge)\n",
+                      millis() - postStart, prewarmConnectMs);
+    }
+
+    if (httpCode != HTTP_CODE_OK && httpCode != HTTP_CODE_CREATED) {
+        Serial.printf("Alert queued for replay (outbox depth %d)\n", outbox.depth());
+        scheduleReplay(true);
+        return false;
+    }
+
+    tracer.record(TP_BACKEND_2XX, rec.id);
+    outbox.remove(rec.id);
+    scheduleReplay(false);  // Link is back - flush any backlog next
+    return true;
+}
+
+bool BackendClient::postThumbnail(uint32_t incidentId, const uint8_t* jpeg, size_t len) {
+    return postJpeg("/api/v1/burglary/image/thumbnail", incidentId, jpeg, len);
+}
+
+bool BackendClient::postRelayedImage(uint32_t incidentId, const uint8_t* jpeg, size_t len) {
+    return postJpeg("/api/v1/burglary/image/relay", incidentId, jpeg, len);
+}
+
+// Raw image/jpeg body; the incident travels in a header so no multipart
+// copy of the image is needed
+bool BackendClient::postJpeg(const char* path, uint32_t incidentId,
+                             const uint8_t* jpeg, size_t len) {
+    bool compact = false;
+    BackendTransport* transport = selectTransport(compact);
+    if (!transport) {
+        return false;
+    }
+    // While the image endpoint is failing, don't spend the airtime (or
+    // GPRS data) on a body that will most likely be lost again
+    if (!imageRetry.ready()) {
+        imageRetry.noteShed();
+        Serial.printf("Image post to %s skipped - retry in %lu s\n",
+                      path, imageRetry.msUntilReady() / 1000);
+        return false;
+    }
+
+    char incident[9];
+    snprintf(incident, sizeof(incident), "%08lX", (unsigned long)incidentId);
+    HttpHeader headers[] = { { "X-Incident-Id", incident } };
+
+    Serial.printf("Posting %u-byte image for %s to %s via %s\n",
+                  (unsigned)len, incident, path, transport->name());
+    int httpCode = exchange(transport, path, "image/jpeg", jpeg, len, headers, 1);
+    imageRetry.noteResult(httpCode);
+    return httpCode == HTTP_CODE_OK || httpCode == HTTP_CODE_CREATED;
+}
+
+int BackendClient::drainOutbox() {
+    if (outbox.depth() == 0 || msUntilReplay() > 0) {
+        return 0;
+    }
+
+    // Checked first: ready() hands out the breaker probe
+    bool compact = false;
+    BackendTransport* transport = selectTransport(compact);
+    if (!transport) {
+        noteOffline();
+        return 0;
+    }
+    offline = false;
+    if (!replayRetry.ready()) {
+        return 0;
+    }
+
+    static char payload[1536];  // Backend task only
+    AlertRecord batch[ALERT_BATCH_SIZE];
+    unsigned long start = millis();
+    size_t totalBytes = 0;
+    int delivered = 0;
+    bool failed = false;
+
+    Serial.printf("Outbox: replaying %d alerts via %s\n", outbox.depth(), transport->name());
+
+    // One keep-alive connection for the whole pass
+    int singles = 0;  // Records of a refused batch still to send one by one
+    while (outbox.depth() > 0) {
+        bool single = !batching || singles > 0;
+        int count = outbox.peek(batch, single ? 1 : ALERT_BATCH_SIZE);
+        bool msgpack = wire.useMsgPack();
+        size_t len = single
+            ? buildAlertPayload(batch[0], compact, msgpack, payload, sizeof(payload))
+            : buildBatchPayload(batch, count, compact, msgpack, payload, sizeof(payload));
+        if (len == 0) {
+            failed = true;
+            break;
+        }
+
+        int httpCode;
+        if (single) {
+            char key[24];
+            formatKey(batch[0], key, sizeof(key));
+            HttpHeader headers[] = { { "Idempotency-Key", key } };
+            outbox.markAttempt(batch[0].id);
+            httpCode = exchange(transport, "/api/v1/burglary/alert/alert",
+                                WireFormat::contentType(msgpack, compact),
+                                (const uint8_t*)payload, len, headers, 1);
+        } else {
+            httpCode = exchange(transport, "/api/v1/burglary/alert/batch",
+                                WireFormat::contentType(msgpack, compact),
+                                (const uint8_t*)payload, len);
+        }
+
         if (httpCode == HTTP_CODE_OK || httpCode == HTTP_CODE_CREATED) {
-            String response = http.getString();
-            Serial.println("Server response:");
-            Serial.println(response);
-            http.end();
-            return true;
+            // Duplicates of earlier partial deliveries are dropped server-side by key
+            outbox.pop(count);
+            delivered += count;
+            totalBytes += len;
+            if (singles > 0) {
+                singles--;
+            }
+            for (int i = 0; i < count; i++) {
+                tracer.record(TP_BACKEND_2XX, batch[i].id);
+                if (batch[i].sequence) {
+                    dispatcher.reportResult(batch[i].sequence, CH_BACKEND, true);
+                }
+            }
+        } else if (!single && (httpCode == 404 || httpCode == 405 || httpCode == 501)) {
+            // Older backend: same records through the single-alert endpoint
+            Serial.printf("Outbox: no batch endpoint (%d) - replaying alerts one by one\n",
+                          httpCode);
+            batching = false;
+        } else if (!single && (httpCode == 400 || httpCode == 422)) {
+            // Refused as a whole; each record gets its own verdict
+            Serial.printf("Outbox: batch of %d refused (%d) - sending them one by one\n",
+                          count, httpCode);
+            singles = count;
+        } else if (single && (httpCode == 400 || httpCode == 422)) {
+            // This record itself is malformed; retrying would block the queue forever
+            Serial.printf("Outbox: alert %08lX rejected as malformed (%d) - dropped\n",
+                          (unsigned long)batch[0].id, httpCode);
+            outbox.pop(1);
+            if (singles > 0) {
+                singles--;
+            }
+        } else {
+            // Auth, missing endpoint, server trouble: keep everything for later
+            if (httpCode > 0) {
+                Serial.printf("Outbox: replay refused (%d) - %d alerts kept\n",
+                              httpCode, outbox.depth());
+            }
+            failed = true;
+            break;
         }
-    } else {
-        Serial.printf("HTTP POST failed: %s\n", http.errorToString(httpCode).c_str());
     }
-    
-    http.end();
-    return false;
+
+    unsigned long elapsed = millis() - start;
+    if (delivered > 0) {
+        lastDrainRate = delivered * 1000.0f / (elapsed > 0 ? elapsed : 1);
+        Serial.printf("Outbox: replayed %d alerts (%u bytes) in %lu ms - %.1f alerts/s, %lu B/s, depth %d\n",
+                      delivered, (unsigned)totalBytes, elapsed, lastDrainRate,
+                      (unsigned long)(totalBytes * 1000UL / (elapsed > 0 ? elapsed : 1)),
+                      outbox.depth());
+    }
+
+    scheduleReplay(failed);
+    return delivered;
 }
 
-bool BackendClient::sendHeartbeat(const char* deviceId, const char* status, const char* ip, const char* version) {
+bool BackendClient::sendHeartbeat(const char* deviceId, const char* status, const char* ip, const char* version,
+                                  const GSMHealth* gsmHealth, const CamHeartbeat* cam) {
     if (!isConnected()) {
+        liveness.noteSkipped();
         return false;
     }
     
-    // Prepare JSON payload
-    StaticJsonDocument<256> doc;
-    doc["device_id"] = deviceId;
-    doc["status"] = status;
-    doc["ip_address"] = ip;
-    doc["firmware_version"] = version;
+    // Backend task only; kept off its stack
+    static StaticJsonDocument<1536> doc;
+    static char payload[1024];
+    doc.clear();
     
-    String payload;
-    serializeJson(doc, payload);
+    // Devices are told apart by device_id; group_id ties them to this site
+    uint8_t ownMac[6];
+    char group[18];
+    WiFi.macAddress(ownMac);
+    snprintf(group, sizeof(group), "%02X:%02X:%02X:%02X:%02X:%02X",
+             ownMac[0], ownMac[1], ownMac[2], ownMac[3], ownMac[4], ownMac[5]);
+    doc["group_id"] = group;
+    JsonArray devices = doc.createNestedArray("devices");
+    
+    JsonObject mainObj = devices.createNestedObject();
+    mainObj["device_id"] = deviceId;
+    mainObj["status"] = status;
+    mainObj["ip_address"] = ip;
+    mainObj["firmware_version"] = version;
+    mainObj["outbox_depth"] = outbox.depth();
+    mainObj["outbox_drain_rate"] = lastDrainRate;
+    // Any request from us until then counts; offline after that (plus grace)
+    mainObj["next_heartbeat_s"] = liveness.nextIntervalMs() / 1000;
+    if (gsmHealth) {
+        // Ages in seconds so the backend can tell a stale reading from a bad one
+        unsigned long now = millis();
+        JsonObject gsmObj = mainObj.createNestedObject("gsm");
+        gsmObj["csq"] = gsmHealth->csq;
+        gsmObj["csq_age_s"] = gsmHealth->csqAt ? (long)((now - gsmHealth->csqAt) / 1000) : -1L;
+        gsmObj["creg"] = gsmHealth->registration;
+        gsmObj["creg_age_s"] = gsmHealth->registrationAt ? (long)((now - gsmHealth->registrationAt) / 1000) : -1L;
+        gsmObj["operator"] = gsmHealth->operatorName;
+    }
     
-    String url = String(baseUrl) + "/api/v1/burglary/device/heartbeat";
+    if (cam) {
+        const CamTelemetry& t = cam->report;
+        char mac[18];
+        snprintf(mac, sizeof(mac), "%02X:%02X:%02X:%02X:%02X:%02X",
+                 cam->mac[0], cam->mac[1], cam->mac[2], cam->mac[3], cam->mac[4], cam->mac[5]);
+        char camIp[16] = "";
+        if (t.ip) {
+            // As IPAddress(t.ip).toString(): first octet in the low byte
+            snprintf(camIp, sizeof(camIp), "%u.%u.%u.%u",
+                     (unsigned)(t.ip & 0xFF), (unsigned)((t.ip >> 8) & 0xFF),
+                     (unsigned)((t.ip >> 16) & 0xFF), (unsigned)(t.ip >> 24));
+        }
+        
+        JsonObject camObj = devices.createNestedObject();
+        camObj["device_id"] = CAM_DEVICE_ID;
+        camObj["status"] = "online";
+        camObj["via"] = "espnow";
+        camObj["mac"] = mac;
+        camObj["report_age_s"] = cam->ageMs / 1000;
+        camObj["ip_address"] = camIp;
+        camObj["firmware_version"] = t.firmware;
+        camObj["uptime_s"] = t.uptimeS;
+        camObj["rssi"] = t.rssi;
+        camObj["queue_depth"] = t.queueDepth;
+        camObj["free_heap"] = t.freeHeap;
+        camObj["captures"] = t.captures;
+        camObj["capture_failures"] = t.captureFailures;
+        camObj["uploads"] = t.uploads;
+        camObj["upload_failures"] = t.uploadFailures;
+        camObj["trace_dropped"] = t.traceDropped;
+        JsonObject linkObj = camObj.createNestedObject("status_link");
+        linkObj["frames"] = t.linkFrames;
+        linkObj["retransmits"] = t.linkRetransmits;
+        linkObj["dropped"] = t.linkDropped;
+    }
     
-    http.begin(url);
-    http.addHeader("Content-Type", "application/json");
-    http.addHeader("X-API-Key", apiKey);
-    http.setTimeout(SERVER_TIMEOUT_MS);
+    bool msgpack = wire.useMsgPack();
+    size_t len = wire.serialize(doc, msgpack, (uint8_t*)payload, sizeof(payload));
+    const char* contentType = WireFormat::contentType(msgpack);
     
-    int httpCode = http.POST(payload);
-    bool success = false;
+    int httpCode = wifi.post("/api/v1/burglary/device/heartbeat/group", contentType,
+                             (const uint8_t*)payload, len, nullptr, 0);
+    noteResponse(&wifi, contentType, httpCode);
     
-    if (httpCode > 0) {
-        if (httpCode == HTTP_CODE_OK) {
-            success = true;
-        } else {
-            Serial.printf("Heartbeat HTTP Error: %d\n", httpCode);
+    if (httpCode != HTTP_CODE_OK) {
+        Serial.printf("Heartbeat HTTP Error: %d\n", httpCode);
+        liveness.noteHeartbeat(false);
+        return false;
+    }
+    liveness.noteHeartbeat(true);
+    return true;
+}
+
+unsigned long BackendClient::msUntilHeartbeat() {
+    liveness.setLinkUp(isConnected());
+    return liveness.msUntilDue();
+}
+
+int BackendClient::exchange(BackendTransport* transport, const char* path, const char* contentType,
+                            const uint8_t* body, size_t length,
+                            const HttpHeader* headers, size_t headerCount) {
+    int httpCode = transport->post(path, contentType, body, length, headers, headerCount);
+    // A 4xx still reached the backend; 5xx and transport errors count
+    // as degraded connectivity
+    liveness.noteExchange(httpCode > 0 && httpCode < 500);
+    noteResponse(transport, contentType, httpCode);
+    return httpCode;
+}
+
+// What the backend advertised: heartbeat cap and accepted body types
+void BackendClient::noteResponse(BackendTransport* transport, const char* contentType,
+                                 int httpCode) {
+    if (httpCode <= 0) {
+        return;
+    }
+    if (transport->getHeartbeatMaxS() > 0) {
+        liveness.setServerMaxS(transport->getHeartbeatMaxS());
+    }
+    wire.noteResponse(transport->getAcceptPost(), httpCode, contentType);
+}
+
+int BackendClient::exportTraces(const char* deviceId) {
+    if (!isConnected()) {
+        return 0;  // Not worth GPRS bytes
+    }
+
+    // Backend task only; kept off its stack
+    static StaticJsonDocument<3072> doc;
+    static char payload[2048];
+    TraceRecord records[TRACE_EXPORT_BATCH];
+    int exported = 0;
+
+    while (tracer.depth() > 0) {
+        uint32_t startIndex;
+        int count = tracer.peek(records, TRACE_EXPORT_BATCH, startIndex);
+
+        doc.clear();
+        doc["device_id"] = deviceId;
+        doc["clock_synced"] = true;  // The main controller is the reference clock
+        doc["dropped"] = tracer.getDropped();
+        JsonArray spans = doc.createNestedArray("spans");
+        for (int i = 0; i < count; i++) {
+            char incident[9];
+            snprintf(incident, sizeof(incident), "%08lX", (unsigned long)records[i].incidentId);
+            JsonArray span = spans.createNestedArray();
+            span.add(incident);
+            span.add(Tracer::pointName(records[i].point));
+            span.add(records[i].timeMs);
         }
-    } else {
-        Serial.printf("Heartbeat Failed: %s\n", http.errorToString(httpCode).c_str());
+
+        bool msgpack = wire.useMsgPack();
+        size_t len = wire.serialize(doc, msgpack, (uint8_t*)payload, sizeof(payload));
+        int httpCode = exchange(&wifi, "/api/v1/burglary/trace/batch",
+                                WireFormat::contentType(msgpack), (const uint8_t*)payload, len);
+        if (httpCode != HTTP_CODE_OK && httpCode != HTTP_CODE_CREATED) {
+            break;  // Keep them for the next heartbeat
+        }
+        tracer.consume(startIndex + count);
+        exported += count;
     }
-    
-    http.end();
-    return success;
+    return exported;
 }
@@ -8,7 +8,8 @@
 
 PIRDetector::PIRDetector(int left, int middle, int right) 
     : pinLeft(left), pinMiddle(middle), pinRight(right),
-      lastTriggerTime(0), triggerCount(0), windowStart(0) {
+      lastTriggerTime(0), triggerCount(0), windowStart(0), firstEdgeTime(0),
+      edgePending(false) {
     triggered[0] = false;
     triggered[1] = false;
     triggered[2] = false;
@@ -39,6 +40,11 @@ void PIRDetector::update() {
         triggered[2] = false;
     }
     
+    if (triggerCount == 0 && (left || middle || right)) {
+        firstEdgeTime = now;
+        edgePending = true;
+    }
+
     // Update trigger states within window
     if (left && !triggered[0]) {
         triggered[0] = true;
@@ -65,6 +71,7 @@ HumanDetectionResult PIRDetector::detectHuman() {
     result.pir_middle = triggered[1];
     result.pir_right = triggered[2];
     result.timestamp = millis();
+    result.firstEdgeAt = firstEdgeTime;
     
     // Human detection logic
     // Require at least 2 PIR sensors triggered within window
@@ -90,6 +97,12 @@ HumanDetectionResult PIRDetector::detectHuman() {
     return result;
 }
 
+bool PIRDetector::takeFirstEdge() {
+    bool pending = edgePending;
+    edgePending = false;
+    return pending;
+}
+
 void PIRDetector::reset() {
     windowStart = 0;
     triggerCount = 0;
@@ -0,0 +1,245 @@
+/**
+ * Relay Receiver Implementation
+ * Offer handling, fragment reassembly and selective acks
+ */
+
+#include "relay_receiver.h"
+#include "cam_link.h"
+
+RelayReceiver relayReceiver;
+
+RelayReceiver::RelayReceiver()
+    : state(RELAY_IDLE), offerPending(false), offerIncident(0), incidentId(0),
+      kind(RELAY_FULL), buffer(nullptr), total(0), count(0), received(0), base(0),
+      requestedAt(0), activityAt(0), completedIncident(0), completedCount(0) {
+    memset(&offer, 0, sizeof(offer));
+    memset(bitmap, 0, sizeof(bitmap));
+    memset(&stats, 0, sizeof(stats));
+    lock = portMUX_INITIALIZER_UNLOCKED;
+}
+
+void RelayReceiver::onFrame(const EspNowHeader& header, const uint8_t* payload) {
+    if (header.type == FRAME_RELAY_OFFER && header.payloadLen >= sizeof(RelayOffer)) {
+        // Latest offer wins; the camera task decides whether to take it
+        portENTER_CRITICAL(&lock);
+        offerIncident = header.incidentId;
+        memcpy(&offer, payload, sizeof(offer));
+        offerPending = true;
+        portEXIT_CRITICAL(&lock);
+    } else if (header.type == FRAME_FRAGMENT) {
+        handleFragment(header.incidentId, payload, header.payloadLen);
+    }
+}
+
+void RelayReceiver::handleFragment(uint32_t incident, const uint8_t* payload, uint8_t len) {
+    if (len < sizeof(FragmentHeader)) {
+        return;
+    }
+    FragmentHeader frag;
+    memcpy(&frag, payload, sizeof(frag));
+    uint16_t dataLen = len - sizeof(frag);
+
+    bool ack = false;
+    bool complete = false;
+    uint16_t fragments = 0;
+    portENTER_CRITICAL(&lock);
+    if (state == RELAY_IDLE) {
+        // Abandoned or unknown transfers get nothing: a full ack would
+        // make the cam drop an image nobody has
+        if (incident != 0 && incident == completedIncident && frag.count == completedCount) {
+            ack = complete = true;
+            fragments = completedCount;
+        }
+    } else if (incident == incidentId && frag.count == count && frag.total == total &&
+               frag.index < count) {
+        if (state == RELAY_READY) {
+            // Already complete: the cam missed our final ack
+            ack = complete = true;
+            fragments = count;
+        } else {
+            uint32_t offset = (uint32_t)frag.index * RELAY_FRAGMENT_DATA;
+            uint32_t expected = frag.index == count - 1 ? total - offset : RELAY_FRAGMENT_DATA;
+            if (dataLen == expected) {
+                ack = true;
+                if (hasFragment(frag.index)) {
+                    stats.duplicates++;
+                    stats.lastDuplicates++;
+                } else {
+                    // Short copy; keeps poll() from freeing the buffer under us
+                    memcpy(buffer + offset, payload + sizeof(frag), dataLen);
+                    bitmap[frag.index >> 3] |= 1 << (frag.index & 7);
+                    received++;
+                    while (base < count && hasFragment(base)) {
+                        base++;
+                    }
+                    activityAt = millis();
+                    if (received == count) {
+                        stats.completed++;
+                        stats.lastBytes = total;
+                        stats.lastMs = activityAt - requestedAt;
+                        state = RELAY_READY;
+                        complete = true;
+                        fragments = count;
+                    }
+                }
+            }
+        }
+    }
+    portEXIT_CRITICAL(&lock);
+
+    if (ack) {
+        sendAck(incident, complete, fragments);
+    }
+}
+
+// Every fragment is acked: one 24-byte frame per 250-byte fragment, and a
+// lost ack is covered by the next one
+void RelayReceiver::sendAck(uint32_t incident, bool complete, uint16_t fragments) {
+    FragmentAck ack;
+    portENTER_CRITICAL(&lock);
+    if (!complete && state == RELAY_RECEIVING) {
+        ack.base = base;
+        ack.mask = 0;
+        for (int i = 0; i < 32; i++) {
+            uint32_t index = (uint32_t)base + 1 + i;
+            if (index < count && hasFragment(index)) {
+                ack.mask |= 1UL << i;
+            }
+        }
+    } else {
+        ack.base = fragments;
+        ack.mask = 0;
+    }
+    portEXIT_CRITICAL(&lock);
+
+    camLink.sendControl(FRAME_FRAGMENT_ACK, 0, incident, &ack, sizeof(ack));
+}
+
+bool RelayReceiver::start(uint32_t incident, uint8_t requestKind, uint32_t bytes) {
+    uint32_t fragments = (bytes + RELAY_FRAGMENT_DATA - 1) / RELAY_FRAGMENT_DATA;
+    if (bytes == 0 || bytes > RELAY_MAX_BYTES || fragments > sizeof(bitmap) * 8) {
+        return false;
+    }
+    uint8_t* buf = (uint8_t*)malloc(bytes);
+    if (!buf) {
+        return false;
+    }
+
+    portENTER_CRITICAL(&lock);
+    buffer = buf;
+    incidentId = incident;
+    kind = requestKind;
+    total = bytes;
+    count = fragments;
+    received = 0;
+    base = 0;
+    memset(bitmap, 0, sizeof(bitmap));
+    requestedAt = activityAt = millis();
+    completedIncident = 0;
+    stats.lastDuplicates = 0;
+    state = RELAY_RECEIVING;
+    portEXIT_CRITICAL(&lock);
+    return true;
+}
+
+void RelayReceiver::reset() {
+    portENTER_CRITICAL(&lock);
+    uint8_t* buf = buffer;
+    buffer = nullptr;
+    incidentId = 0;
+    total = 0;
+    count = 0;
+    state = RELAY_IDLE;
+    portEXIT_CRITICAL(&lock);
+    free(buf);
+}
+
+void RelayReceiver::poll(bool canForward) {
+    if (state == RELAY_RECEIVING && millis() - activityAt > RELAY_STALL_MS) {
+        Serial.printf("[RELAY] %08lX stalled at %u/%u fragments - abandoned\n",
+                      (unsigned long)incidentId, received, count);
+        stats.abandoned++;
+        reset();
+    }
+
+    if (!offerPending) {
+        return;
+    }
+    portENTER_CRITICAL(&lock);
+    uint32_t incident = offerIncident;
+    RelayOffer o = offer;
+    offerPending = false;
+    portEXIT_CRITICAL(&lock);
+
+    // Not now: the cam offers its queue again on its next check
+    if (!canForward || state != RELAY_IDLE || incident == 0) {
+        return;
+    }
+
+    // Full image if it fits, otherwise the thumbnail
+    RelayRequest req;
+    req.kind = RELAY_FULL;
+    bool started = start(incident, RELAY_FULL, o.fullBytes);
+    if (!started && o.thumbBytes > 0) {
+        req.kind = RELAY_THUMB;
+        started = start(incident, RELAY_THUMB, o.thumbBytes);
+    }
+    if (!started) {
+        Serial.printf("[RELAY] Cannot take %08lX (%lu bytes, thumbnail %u)\n",
+                      (unsigned long)incident, (unsigned long)o.fullBytes, o.thumbBytes);
+        return;
+    }
+
+    Serial.printf("[RELAY] Requesting %s image %08lX (%lu bytes)\n",
+                  req.kind == RELAY_FULL ? "full" : "thumbnail",
+                  (unsigned long)incident, (unsigned long)total);
+    if (!camLink.sendControl(FRAME_RELAY_REQUEST, 0, incident, &req, sizeof(req))) {
+        reset();
+    }
+}
+
+bool RelayReceiver::getImage(uint32_t& incident, uint8_t& imageKind,
+                             const uint8_t*& data, size_t& len) {
+    if (state != RELAY_READY) {
+        return false;
+    }
+    incident = incidentId;
+    imageKind = kind;
+    data = buffer;
+    len = total;
+    return true;
+}
+
+void RelayReceiver::finish(bool forwarded) {
+    if (state != RELAY_READY) {
+        return;
+    }
+    RelayResult result;
+    result.ok = forwarded ? 1 : 0;
+    camLink.sendControl(FRAME_RELAY_RESULT, 0, incidentId, &result, sizeof(result));
+    portENTER_CRITICAL(&lock);
+    completedIncident = incidentId;
+    completedCount = count;
+    portEXIT_CRITICAL(&lock);
+    reset();
+}
+
+RelayStats RelayReceiver::getStats() {
+    RelayStats snapshot;
+    portENTER_CRITICAL(&lock);
+    snapshot = stats;
+    portEXIT_CRITICAL(&lock);
+    return snapshot;
+}
+
+void RelayReceiver::printStats() {
+    RelayStats s = getStats();
+    if (s.completed == 0 && s.abandoned == 0) {
+        return;
+    }
+    Serial.printf("Image relay: %lu completed, %lu abandoned, %lu duplicate fragments; "
+                  "last %lu bytes in %lu ms\n",
+                  (unsigned long)s.completed, (unsigned long)s.abandoned,
+                  (unsigned long)s.duplicates, (unsigned long)s.lastBytes,
+                  (unsigned long)s.lastMs);
+}
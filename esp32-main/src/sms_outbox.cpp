@@ -0,0 +1,411 @@
+/**
+ * SMS Outbox Implementation
+ * Persistent per-recipient delivery with backoff and coalescing
+ */
+
+#include "sms_outbox.h"
+#include "alert_dispatcher.h"
+#include "trace.h"
+#include <time.h>
+
+static const char* PREFS_NAMESPACE = "smsbox";
+static const char* PREFS_KEY = "entries";
+
+SMSOutbox::SMSOutbox(GSMHandler* handler)
+    : gsm(handler), nextOrder(1), storageReady(false),
+      sendingEntry(-1), sendingRecipient(0), roundEntry(-1), roundStartedAt(0),
+      networkGated(false) {
+    memset(entries, 0, sizeof(entries));
+}
+
+void SMSOutbox::begin() {
+    storageReady = prefs.begin(PREFS_NAMESPACE, false);
+    if (!storageReady) {
+        Serial.println("SMS outbox: NVS unavailable - queue is RAM only");
+        return;
+    }
+    load();
+
+    int pending = depth();
+    if (pending > 0) {
+        Serial.printf("SMS outbox: %d pending entries restored\n", pending);
+    }
+}
+
+void SMSOutbox::load() {
+    if (prefs.getBytesLength(PREFS_KEY) != sizeof(entries)) {
+        memset(entries, 0, sizeof(entries));
+        return;
+    }
+    prefs.getBytes(PREFS_KEY, entries, sizeof(entries));
+
+    for (int i = 0; i < SMS_OUTBOX_SIZE; i++) {
+        if (!entries[i].used) {
+            continue;
+        }
+        // millis() deadlines do not survive a reboot - retry right away
+        for (int r = 0; r < NUM_PHONES; r++) {
+            entries[i].nextAttemptAt[r] = 0;
+        }
+        // Detection sequences restart every boot; the dispatcher never
+        // saw these alerts, so they are sent but not reported
+        entries[i].firstSequence = 0;
+        entries[i].lastSequence = 0;
+        if (entries[i].order >= nextOrder) {
+            nextOrder = entries[i].order + 1;
+        }
+    }
+}
+
+void SMSOutbox::save() {
+    if (storageReady) {
+        prefs.putBytes(PREFS_KEY, entries, sizeof(entries));
+    }
+}
+
+int SMSOutbox::depth() const {
+    int n = 0;
+    for (int i = 0; i < SMS_OUTBOX_SIZE; i++) {
+        if (entries[i].used) {
+            n++;
+        }
+    }
+    return n;
+}
+
+bool SMSOutbox::isStarted(const SMSOutboxEntry& entry) const {
+    for (int r = 0; r < NUM_PHONES; r++) {
+        if (entry.attempts[r] > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SMSOutbox::isComplete(const SMSOutboxEntry& entry) const {
+    for (int r = 0; r < NUM_PHONES; r++) {
+        if (entry.state[r] == SMS_RCPT_PENDING) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// A new alert round may start once SMS_RATE_LIMIT_MS has passed
+bool SMSOutbox::isRoundOpen(unsigned long now) const {
+    return roundEntry < 0 || now - roundStartedAt >= SMS_RATE_LIMIT_MS;
+}
+
+// Tells the GPRS data path to leave the modem alone while an alert SMS
+// could go out now; backoff waits and a dead network do not hold it
+void SMSOutbox::publishAlertsDue(unsigned long now) {
+    bool due = false;
+    bool roundOpen = isRoundOpen(now);
+    for (int i = 0; i < SMS_OUTBOX_SIZE && !due; i++) {
+        const SMSOutboxEntry& entry = entries[i];
+        if (!entry.used || entry.kind != SMS_KIND_ALERT || (!isStarted(entry) && !roundOpen)) {
+            continue;
+        }
+        for (int r = 0; r < NUM_PHONES; r++) {
+            if (entry.state[r] == SMS_RCPT_PENDING && (long)(now - entry.nextAttemptAt[r]) >= 0) {
+                due = true;
+                break;
+            }
+        }
+    }
+    gsm->setSMSAlertsDue(due && gsm->isNetworkUsable());
+}
+
+// When full, drops the oldest entry of the lowest priority (test
+// messages before alerts). A dropped alert nobody received is reported
+// as failed, so the dispatcher does not wait on it.
+int SMSOutbox::findFree() {
+    int victim = -1;
+    for (int i = 0; i < SMS_OUTBOX_SIZE; i++) {
+        const SMSOutboxEntry& entry = entries[i];
+        if (!entry.used) {
+            return i;
+        }
+        if (i == sendingEntry) {
+            continue;
+        }
+        if (victim < 0 ||
+            entry.kind > entries[victim].kind ||
+            (entry.kind == entries[victim].kind && entry.order < entries[victim].order)) {
+            victim = i;
+        }
+    }
+    if (victim < 0) {
+        return -1;
+    }
+
+    const SMSOutboxEntry& entry = entries[victim];
+    Serial.printf("SMS outbox full - dropping entry #%lu\n", (unsigned long)entry.order);
+    if (entry.kind == SMS_KIND_ALERT) {
+        bool delivered = false;
+        for (int r = 0; r < NUM_PHONES; r++) {
+            delivered = delivered || entry.state[r] == SMS_RCPT_SENT;
+        }
+        if (!delivered) {
+            reportSequences(entry, false, false);
+        }
+    }
+    return victim;
+}
+
+bool SMSOutbox::addAlert(const AlertEvent& event, uint32_t alertTime) {
+    // Merge into an alert nobody has been sent yet
+    for (int i = 0; i < SMS_OUTBOX_SIZE; i++) {
+        SMSOutboxEntry& entry = entries[i];
+        if (entry.used && entry.kind == SMS_KIND_ALERT && !isStarted(entry)) {
+            entry.alertCount++;
+            if (entry.firstSequence == 0) {
+                entry.firstSequence = event.sequence;  // Restored entry
+            }
+            entry.lastSequence = event.sequence;
+            entry.lastAlertTime = alertTime;
+            if (event.detection.confidence > entry.maxConfidence) {
+                entry.maxConfidence = event.detection.confidence;
+            }
+            save();
+            publishAlertsDue(millis());
+            Serial.printf("SMS outbox: alert #%lu coalesced (%u pending in summary)\n",
+                          (unsigned long)event.sequence, entry.alertCount);
+            return true;
+        }
+    }
+
+    int index = findFree();
+    if (index < 0) {
+        return false;
+    }
+
+    SMSOutboxEntry& entry = entries[index];
+    memset(&entry, 0, sizeof(entry));
+    entry.used = 1;
+    entry.kind = SMS_KIND_ALERT;
+    entry.alertCount = 1;
+    entry.order = nextOrder++;
+    entry.firstSequence = event.sequence;
+    entry.firstIncidentId = event.incidentId;
+    entry.lastSequence = event.sequence;
+    entry.firstAlertTime = alertTime;
+    entry.lastAlertTime = alertTime;
+    entry.maxConfidence = event.detection.confidence;
+    save();
+    publishAlertsDue(millis());
+    return true;
+}
+
+bool SMSOutbox::addTest() {
+    int index = findFree();
+    if (index < 0) {
+        return false;
+    }
+
+    SMSOutboxEntry& entry = entries[index];
+    memset(&entry, 0, sizeof(entry));
+    entry.used = 1;
+    entry.kind = SMS_KIND_TEST;
+    entry.order = nextOrder++;
+    save();
+    return true;
+}
+
+int SMSOutbox::pickNext(int& recipient, unsigned long now) {
+    bool roundOpen = isRoundOpen(now);
+    int best = -1;
+    int bestRecipient = 0;
+
+    for (int i = 0; i < SMS_OUTBOX_SIZE; i++) {
+        const SMSOutboxEntry& entry = entries[i];
+        if (!entry.used) {
+            continue;
+        }
+
+        // A new alert round waits for the rate limit; started rounds and
+        // test messages do not
+        if (entry.kind == SMS_KIND_ALERT && !isStarted(entry) && !roundOpen) {
+            continue;
+        }
+
+        for (int r = 0; r < NUM_PHONES; r++) {
+            if (entry.state[r] != SMS_RCPT_PENDING || (long)(now - entry.nextAttemptAt[r]) < 0) {
+                continue;
+            }
+            if (best < 0 ||
+                entry.kind < entries[best].kind ||
+                (entry.kind == entries[best].kind && entry.order < entries[best].order)) {
+                best = i;
+                bestRecipient = r;
+            }
+            break;
+        }
+    }
+
+    recipient = bestRecipient;
+    return best;
+}
+
+static void formatTime(uint32_t ts, char* buf, size_t len) {
+    struct tm timeinfo;
+    time_t t = ts;
+    localtime_r(&t, &timeinfo);
+    strftime(buf, len, "%H:%M:%S", &timeinfo);
+}
+
+void SMSOutbox::formatMessage(const SMSOutboxEntry& entry, char* buf, size_t len) const {
+    if (entry.kind == SMS_KIND_TEST) {
+        snprintf(buf, len, "TEST SMS: System is active and GSM is working.");
+        return;
+    }
+
+    char first[12];
+    formatTime(entry.firstAlertTime, first, sizeof(first));
+
+    if (entry.alertCount <= 1) {
+        snprintf(buf, len,
+                 "INTRUDER ALERT! Motion detected at %s. "
+                 "Confidence: %.0f%%.",
+                 first, entry.maxConfidence * 100);
+        return;
+    }
+
+    char last[12];
+    formatTime(entry.lastAlertTime, last, sizeof(last));
+    snprintf(buf, len,
+             "INTRUDER ALERT! %u detections between %s and %s. "
+             "Max confidence: %.0f%%.",
+             entry.alertCount, first, last, entry.maxConfidence * 100);
+}
+
+void SMSOutbox::poll() {
+    unsigned long now = millis();
+    publishAlertsDue(now);
+    if (sendingEntry >= 0 || gsm->isSMSInFlight()) {
+        return;
+    }
+
+    int recipient = 0;
+    int index = pickNext(recipient, now);
+    if (index < 0) {
+        return;
+    }
+
+    // Cached health only - holding the entry costs nothing, a send into a
+    // dead network costs an attempt and a backoff step
+    if (!gsm->isNetworkUsable()) {
+        if (!networkGated) {
+            Serial.println("SMS outbox: network not usable, holding messages");
+            networkGated = true;
+        }
+        return;
+    }
+    if (networkGated) {
+        Serial.println("SMS outbox: network usable again, resuming");
+        networkGated = false;
+    }
+
+    SMSOutboxEntry& entry = entries[index];
+    if (entry.kind == SMS_KIND_ALERT && !isStarted(entry)) {
+        roundEntry = index;
+        roundStartedAt = now;
+    }
+
+    char message[161];
+    formatMessage(entry, message, sizeof(message));
+
+    sendingEntry = index;
+    sendingRecipient = recipient;
+    entry.attempts[recipient]++;
+
+    // force=true: the outbox does its own rate limiting, and we try even
+    // if GSM init failed (e.g. network reg)
+    if (!gsm->sendSMSAsync(EMERGENCY_PHONES[recipient], message, onSendResult, this, true)) {
+        entry.attempts[recipient]--;
+        sendingEntry = -1;
+        return;
+    }
+    save();
+}
+
+void SMSOutbox::onSendResult(bool success, void* ctx) {
+    ((SMSOutbox*)ctx)->handleResult(success);
+}
+
+void SMSOutbox::handleResult(bool success) {
+    if (sendingEntry < 0) {
+        return;
+    }
+
+    SMSOutboxEntry& entry = entries[sendingEntry];
+    int r = sendingRecipient;
+    const char* phone = EMERGENCY_PHONES[r];
+
+    if (success) {
+        bool firstDelivery = true;
+        for (int i = 0; i < NUM_PHONES; i++) {
+            firstDelivery = firstDelivery && entry.state[i] != SMS_RCPT_SENT;
+        }
+        entry.state[r] = SMS_RCPT_SENT;
+        Serial.printf("[GSM] ✓ SMS sent to %s\n", phone);
+
+        if (firstDelivery && entry.kind == SMS_KIND_ALERT) {
+            tracer.recordAt(TP_SMS_PROMPT, entry.firstIncidentId, gsm->engine().getLastPromptAt());
+            tracer.record(TP_SMS_CONFIRM, entry.firstIncidentId);
+            reportSequences(entry, true, true);
+        }
+    } else if (entry.attempts[r] >= SMS_MAX_RECIPIENT_ATTEMPTS) {
+        entry.state[r] = SMS_RCPT_FAILED;
+        Serial.printf("[GSM] ✗ SMS to %s failed after %u attempts\n", phone, entry.attempts[r]);
+    } else {
+        unsigned long backoff = (unsigned long)SMS_RETRY_BASE_MS << (entry.attempts[r] - 1);
+        if (backoff > SMS_RETRY_MAX_MS) {
+            backoff = SMS_RETRY_MAX_MS;
+        }
+        entry.nextAttemptAt[r] = millis() + backoff;
+        Serial.printf("[GSM] ✗ SMS to %s failed, retry in %lu s\n", phone, backoff / 1000);
+    }
+
+    int index = sendingEntry;
+    sendingEntry = -1;
+
+    if (isComplete(entry)) {
+        completeEntry(index);
+    }
+    save();
+}
+
+void SMSOutbox::reportSequences(const SMSOutboxEntry& entry, bool success, bool retryable) {
+    if (entry.firstSequence == 0) {
+        return;  // Covers only alerts from before the reboot
+    }
+    for (uint32_t seq = entry.firstSequence; seq <= entry.lastSequence; seq++) {
+        dispatcher.reportResult(seq, CH_SMS, success, retryable);
+    }
+}
+
+void SMSOutbox::completeEntry(int index) {
+    SMSOutboxEntry& entry = entries[index];
+
+    int sent = 0;
+    for (int r = 0; r < NUM_PHONES; r++) {
+        if (entry.state[r] == SMS_RCPT_SENT) {
+            sent++;
+        }
+    }
+
+    Serial.printf("SMS outbox: entry #%lu done, %d/%d recipients\n",
+                  (unsigned long)entry.order, sent, NUM_PHONES);
+
+    if (sent > 0) {
+        if (entry.kind == SMS_KIND_TEST) {
+            postIndicator(IND_BEEP);
+        }
+        postIndicator(IND_SMS_SENT);
+    } else if (entry.kind == SMS_KIND_ALERT) {
+        reportSequences(entry, false, false);
+    }
+
+    memset(&entry, 0, sizeof(entry));
+}
@@ -0,0 +1,506 @@
+/**
+ * System Tasks Implementation
+ * Sensing, camera trigger, GSM, backend and indicator tasks
+ */
+
+#include "system_tasks.h"
+#include "alert_dispatcher.h"
+#include "cam_link.h"
+#include "relay_receiver.h"
+#include "cam_telemetry.h"
+#include "sms_outbox.h"
+#include "trace.h"
+#include "config.h"
+#include <esp_now.h>
+#include <esp_system.h>
+#include <WiFi.h>
+#include <Preferences.h>
+#include <freertos/task.h>
+#include <time.h>
+
+static const unsigned long DETECTION_COOLDOWN = 10000;  // 10 seconds between detections
+static const unsigned long SIM_LED_HEARTBEAT_MS = 2000;  // SIM status LED blink interval when GSM ready
+
+QueueHandle_t cameraQueue = nullptr;
+QueueHandle_t gsmQueue = nullptr;
+QueueHandle_t backendQueue = nullptr;
+QueueHandle_t indicatorQueue = nullptr;
+
+// ==================== STATIC STORAGE ====================
+static StaticQueue_t cameraQueueCtrl;
+static StaticQueue_t gsmQueueCtrl;
+static StaticQueue_t backendQueueCtrl;
+static StaticQueue_t indicatorQueueCtrl;
+static uint8_t cameraQueueBuf[ALERT_QUEUE_LENGTH * sizeof(AlertEvent)];
+static uint8_t gsmQueueBuf[ALERT_QUEUE_LENGTH * sizeof(GsmRequest)];
+static uint8_t backendQueueBuf[ALERT_QUEUE_LENGTH * sizeof(AlertEvent)];
+static uint8_t indicatorQueueBuf[INDICATOR_QUEUE_LENGTH * sizeof(IndicatorCommand)];
+
+static StaticTask_t sensingTaskCtrl;
+static StaticTask_t cameraTaskCtrl;
+static StaticTask_t indicatorTaskCtrl;
+static StaticTask_t gsmTaskCtrl;
+static StaticTask_t backendTaskCtrl;
+static StackType_t sensingStack[SENSING_TASK_STACK];
+static StackType_t cameraStack[CAMERA_TASK_STACK];
+static StackType_t indicatorStack[INDICATOR_TASK_STACK];
+static StackType_t gsmStack[GSM_TASK_STACK];
+static StackType_t backendStack[BACKEND_TASK_STACK];
+static TaskHandle_t sensingTaskHandle = nullptr;
+static TaskHandle_t gsmTaskHandle = nullptr;
+static TaskHandle_t backendTaskHandle = nullptr;
+
+static uint16_t bootId = 0;  // Upper half of every incident ID this boot
+
+// ==================== HELPERS ====================
+
+bool postIndicator(IndicatorCommand cmd) {
+    return indicatorQueue && xQueueSend(indicatorQueue, &cmd, 0) == pdTRUE;
+}
+
+bool postGsmRequest(GsmRequestType type) {
+    if (!gsmQueue) {
+        return false;
+    }
+    GsmRequest req = {};
+    req.type = type;
+    return xQueueSend(gsmQueue, &req, 0) == pdTRUE;
+}
+
+static void blinkPin(int pin, int times, int onMs, int offMs, bool activeLow = false) {
+    for (int i = 0; i < times; i++) {
+        digitalWrite(pin, activeLow ? LOW : HIGH);
+        vTaskDelay(pdMS_TO_TICKS(onMs));
+        digitalWrite(pin, activeLow ? HIGH : LOW);
+        vTaskDelay(pdMS_TO_TICKS(offMs));
+    }
+}
+
+// ==================== SENSING TASK ====================
+
+static void sensingTask(void* arg) {
+    TickType_t lastWake = xTaskGetTickCount();
+    unsigned long lastDetectionTime = 0;
+    uint32_t sequence = 0;
+
+    for (;;) {
+        vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(SENSING_PERIOD_MS));
+
+        pirDetector.update();
+        dispatcher.poll();
+
+        unsigned long now = millis();
+        // Taken every period, so an edge from a cooldown window is not
+        // reported later
+#ifdef BACKEND_PREWARM
+        bool firstEdge = pirDetector.takeFirstEdge();
+#else
+        pirDetector.takeFirstEdge();
+#endif
+        if (lastDetectionTime > 0 && now - lastDetectionTime < DETECTION_COOLDOWN) {
+            continue;
+        }
+
+#ifdef BACKEND_PREWARM
+        // The backend task connects while the other sensors confirm; the
+        // TLS handshake is then off the alert's path. Only into an empty
+        // queue, so a busy backend task never has an alert crowded out.
+        if (firstEdge && uxQueueMessagesWaiting(backendQueue) == 0) {
+            AlertEvent warm = {};
+            warm.detectedAt = now;
+            xQueueSend(backendQueue, &warm, 0);
+        }
+#endif
+
+        HumanDetectionResult detection = pirDetector.detectHuman();
+        if (!detection.detected) {
+            continue;
+        }
+
+        lastDetectionTime = now;
+
+        AlertEvent event;
+        event.detection = detection;
+        event.sequence = ++sequence;
+        event.incidentId = ((uint32_t)bootId << 16) | (event.sequence & 0xFFFF);
+        event.detectedAt = now;
+
+        tracer.recordAt(TP_PIR_EDGE, event.incidentId, detection.firstEdgeAt);
+        tracer.recordAt(TP_DETECTION, event.incidentId, now);
+
+        // Zero-tick sends: a full queue fails that channel (and schedules
+        // a retry) rather than stalling detection
+        dispatcher.dispatch(event);
+        postIndicator(IND_ALERT);
+
+        Serial.println("\n========== INTRUDER DETECTED ==========");
+        Serial.printf("Alert #%lu (incident %08lX) - Confidence: %.2f%%\n",
+                      (unsigned long)event.sequence, (unsigned long)event.incidentId,
+                      detection.confidence * 100);
+        Serial.printf("PIR Sensors - Left: %d, Middle: %d, Right: %d\n",
+                      detection.pir_left, detection.pir_middle, detection.pir_right);
+        Serial.println("======================================\n");
+
+        pirDetector.reset();
+    }
+}
+
+// ==================== CAMERA TRIGGER TASK ====================
+
+static void triggerCamera(const AlertEvent& event) {
+    Serial.printf("[CAM] Triggering ESP32-CAM for alert #%lu\n", (unsigned long)event.sequence);
+    bool acked = false;
+
+#ifdef USE_ESP_NOW
+    acked = camLink.sendTrigger(event.incidentId);
+    if (acked) {
+        Serial.printf("[CAM] ESP-NOW trigger acked (RTT %lu us)\n",
+                      (unsigned long)camLink.getStats().rttLastUs);
+    } else {
+        Serial.println("[CAM] No ESP-NOW ack from camera");
+    }
+#endif
+
+    if (!acked) {
+        Serial.println("[CAM] Using Physical Wire Fallback...");
+        digitalWrite(CAM_TRIGGER_PIN, HIGH);
+        vTaskDelay(pdMS_TO_TICKS(TRIGGER_PULSE_MS));
+        digitalWrite(CAM_TRIGGER_PIN, LOW);
+        Serial.println("[CAM] Physical trigger pulse sent");
+    }
+
+    Serial.printf("[CAM] Trigger latency: %lu ms\n", millis() - event.detectedAt);
+    dispatcher.reportResult(event.sequence, CH_CAMERA, true);
+}
+
+static void cameraTask(void* arg) {
+    AlertEvent event;
+
+    for (;;) {
+        // The short wait doubles as the cam UART poll interval
+        if (xQueueReceive(cameraQueue, &event, pdMS_TO_TICKS(CAM_UART_POLL_MS)) == pdTRUE) {
+            triggerCamera(event);
+        }
+
+        camUart.poll();
+
+        // The cam only keeps a thumbnail when it had no WiFi; pull it if
+        // we cannot reach the backend over WiFi either but GPRS is up
+        uint32_t offered;
+        if (camUart.takeThumbnailOffer(offered) && !backend.isConnected() &&
+            gsm.isNetworkUsable() && backend.canForwardImages()) {
+            camUart.requestThumbnail(offered);
+        }
+
+        // Nor while image posts are backing off: the cam keeps its copy
+        relayReceiver.poll((backend.isConnected() || gsm.isNetworkUsable()) &&
+                           backend.canForwardImages());
+    }
+}
+
+// ==================== INDICATOR TASK ====================
+
+static void indicatorTask(void* arg) {
+    IndicatorCommand cmd;
+    unsigned long lastSimLedTime = 0;
+    bool simLedOn = false;
+
+    for (;;) {
+        if (xQueueReceive(indicatorQueue, &cmd, pdMS_TO_TICKS(SIM_LED_HEARTBEAT_MS)) == pdTRUE) {
+            switch (cmd) {
+                case IND_ALERT:
+                    buzzer.playAlertPattern();
+                    break;
+                case IND_SMS_SENT:
+                    blinkPin(SIM_STATUS_LED_PIN, 5, 80, 80);
+                    break;
+                case IND_BACKEND_OK:
+                    // Status LED is normally on (WiFi connected) - blink it off
+                    blinkPin(STATUS_LED_PIN, 3, 100, 100, true);
+                    break;
+                case IND_BEEP:
+                    buzzer.beep(200);
+                    break;
+            }
+        }
+
+        // SIM status LED heartbeat - blink when GSM is ready (shows "SIM is working")
+        unsigned long now = millis();
+        if (gsm.isReady() && (now - lastSimLedTime >= SIM_LED_HEARTBEAT_MS)) {
+            lastSimLedTime = now;
+            simLedOn = !simLedOn;
+            digitalWrite(SIM_STATUS_LED_PIN, simLedOn ? HIGH : LOW);
+        }
+    }
+}
+
+// ==================== GSM TASK ====================
+
+// Pending SMS live in NVS so a reboot mid-alert does not lose them
+static SMSOutbox smsOutbox(&gsm);
+
+static void queueAlertSMS(const AlertEvent& event) {
+    // Get proper timestamp
+    uint32_t timestamp = ntpSync.isSynchronized()
+        ? ntpSync.getCurrentTimestamp()
+        : event.detectedAt / 1000;
+
+    if (!smsOutbox.addAlert(event, timestamp)) {
+        dispatcher.reportResult(event.sequence, CH_SMS, false, false);
+    }
+}
+
+static void printGsmHealth() {
+    GSMHealth h = gsm.getHealth();
+    unsigned long now = millis();
+    Serial.printf("GSM: CSQ %d (%lus ago), CREG %d (%lus ago), operator \"%s\" (%lus ago)\n",
+                  h.csq, h.csqAt ? (now - h.csqAt) / 1000 : 0,
+                  h.registration, h.registrationAt ? (now - h.registrationAt) / 1000 : 0,
+                  h.operatorName, h.operatorAt ? (now - h.operatorAt) / 1000 : 0);
+
+    if (gsm.isSleepEnabled()) {
+        ATEngine& at = gsm.engine();
+        Serial.printf("GSM sleep: ~%lu%% of uptime asleep, %lu wakes, last wake %lu ms, last '>' %lu ms\n",
+                      (unsigned long)((uint64_t)at.getAsleepMs() * 100 / (now ? now : 1)),
+                      at.getWakeCount(), at.getLastWakeMs(), at.getLastPromptMs());
+    }
+}
+
+static void gsmTask(void* arg) {
+    GsmRequest req;
+
+    smsOutbox.begin();
+
+    for (;;) {
+        // The short wait doubles as the AT engine poll interval
+        if (xQueueReceive(gsmQueue, &req, pdMS_TO_TICKS(GSM_POLL_INTERVAL_MS)) == pdTRUE) {
+            switch (req.type) {
+                case GSM_REQ_ALERT:
+                    queueAlertSMS(req.alert);
+                    break;
+                case GSM_REQ_TEST_SMS:
+                    Serial.println("\n[DEBUG] FORCE SENDING SMS...");
+                    smsOutbox.addTest();
+                    break;
+                case GSM_REQ_SIGNAL:
+                    printGsmHealth();  // Cached; the refresh below updates it
+                    gsm.refreshHealth();
+                    break;
+            }
+        }
+
+        // The backend task may be holding the modem for a GPRS post; the
+        // outbox keeps accepting alerts meanwhile
+        if (gsm.lockModem(0)) {
+            gsm.poll();
+            smsOutbox.poll();
+            gsm.pollHealth();  // After the outbox so alerts go first
+            gsm.unlockModem();
+        }
+    }
+}
+
+// ==================== BACKEND TASK ====================
+
+static void sendHeartbeat() {
+    Serial.println("--- System Heartbeat ---");
+    Serial.printf("WiFi: %s\n", backend.isConnected() ? "Connected" : "Disconnected");
+    Serial.printf("Uptime: %lu seconds\n", millis() / 1000);
+    Serial.printf("Alert outbox: %d queued, last replay %.1f alerts/s\n",
+                  backend.getOutboxDepth(), backend.getLastDrainRate());
+    printGsmHealth();
+    camLink.printStats();
+    camUart.printStats();
+    relayReceiver.printStats();
+    Serial.printf("Cam telemetry: %lu reports received\n",
+                  (unsigned long)camTelemetry.getReportCount());
+    backend.printLiveness();
+    backend.printWireStats();
+    backend.printWiFiStats();
+    backend.printRetryStats();
+    backend.printPrewarmStats();
+    Serial.printf("Stack headroom - sensing: %u, gsm: %u, backend: %u\n",
+                  uxTaskGetStackHighWaterMark(sensingTaskHandle),
+                  uxTaskGetStackHighWaterMark(gsmTaskHandle),
+                  uxTaskGetStackHighWaterMark(backendTaskHandle));
+
+    // Also restarts the liveness interval when WiFi is down
+    GSMHealth health = gsm.getHealth();
+    CamHeartbeat cam;
+    bool haveCam = camTelemetry.get(cam);
+    uint32_t ownIp = WiFi.localIP();
+    char ip[16];
+    snprintf(ip, sizeof(ip), "%u.%u.%u.%u", (unsigned)(ownIp & 0xFF), (unsigned)((ownIp >> 8) & 0xFF),
+             (unsigned)((ownIp >> 16) & 0xFF), (unsigned)(ownIp >> 24));
+    backend.sendHeartbeat("ESP32_MAIN", "online", ip, "v2.0",
+                          &health, haveCam ? &cam : nullptr);
+    camTelemetry.markForwarded();
+
+    // Reconnects run from the backend task loop (pollWiFi)
+    if (backend.isConnected()) {
+        int traced = backend.exportTraces("ESP32_MAIN");
+        if (traced > 0) {
+            Serial.printf("Exported %d trace records\n", traced);
+        }
+    }
+}
+
+static void backendTask(void* arg) {
+    AlertEvent event;
+
+    for (;;) {
+        // WiFi events only set flags; connect rounds advance here without blocking
+        switch (backend.pollWiFi()) {
+            case WIFI_LINK_UP:
+                Serial.println("[BACKEND] WiFi link up");
+                backend.noteLinkUp();
+                break;
+            case WIFI_LINK_DOWN:
+                Serial.println("[BACKEND] WiFi link down - alerts fall back to GPRS");
+                break;
+            default:
+                break;
+        }
+
+        // Other backend traffic pushes the heartbeat back (liveness.h)
+        unsigned long waitMs = backend.msUntilHeartbeat();
+        unsigned long replayMs = backend.msUntilReplay();
+        if (replayMs < waitMs) {
+            waitMs = replayMs;
+        }
+        unsigned long prewarmMs = backend.msUntilPrewarmExpiry();
+        if (prewarmMs < waitMs) {
+            waitMs = prewarmMs;
+        }
+        unsigned long wifiMs = backend.msUntilWiFiPoll();
+        if (wifiMs < waitMs) {
+            waitMs = wifiMs;
+        }
+        unsigned long camMs = camTelemetry.msUntilForwardDue();
+        if (camMs < waitMs) {
+            waitMs = camMs;
+        }
+        if ((camUart.isPulling() || relayReceiver.isReceiving()) &&
+            waitMs > CAM_THUMB_FORWARD_POLL_MS) {
+            waitMs = CAM_THUMB_FORWARD_POLL_MS;
+        }
+
+        // Cam reports acked while we are offline are posted by the cam itself
+        camTelemetry.setForwarding(backend.isConnected());
+
+        if (xQueueReceive(backendQueue, &event, pdMS_TO_TICKS(waitMs)) == pdTRUE) {
+            if (event.sequence == 0) {
+                backend.prewarm();
+                continue;
+            }
+            // Falls back to GPRS when WiFi is down, else stays in the outbox
+            Serial.println("[BACKEND] Posting to backend...");
+            if (backend.postAlert(event.detection, "online", event.incidentId, event.sequence)) {
+                Serial.printf("[BACKEND] ✓ Alert posted (%lu ms after detection)\n",
+                              millis() - event.detectedAt);
+                postIndicator(IND_BACKEND_OK);
+                dispatcher.reportResult(event.sequence, CH_BACKEND, true);
+            } else {
+                // Left pending: a replay inside the deadline still counts
+                Serial.println("[BACKEND] ✗ Backend post failed - queued for replay");
+            }
+            continue;
+        }
+
+        backend.expirePrewarm();
+
+        if (backend.drainOutbox() > 0) {
+            postIndicator(IND_BACKEND_OK);
+        }
+
+        uint32_t thumbIncident;
+        const uint8_t* thumbData;
+        size_t thumbLen;
+        if (camUart.getThumbnail(thumbIncident, thumbData, thumbLen)) {
+            // One attempt: the full image is still queued on the cam
+            if (backend.postThumbnail(thumbIncident, thumbData, thumbLen)) {
+                Serial.printf("[BACKEND] ✓ Thumbnail %08lX forwarded\n",
+                              (unsigned long)thumbIncident);
+            } else {
+                Serial.printf("[BACKEND] ✗ Thumbnail %08lX not forwarded\n",
+                              (unsigned long)thumbIncident);
+            }
+            camUart.releaseThumbnail();
+        }
+
+        uint8_t relayKind;
+        if (relayReceiver.getImage(thumbIncident, relayKind, thumbData, thumbLen)) {
+            RelayStats rs = relayReceiver.getStats();
+            Serial.printf("[BACKEND] Relayed image %08lX: %u bytes over ESP-NOW in %lu ms "
+                          "(%.1f KB/s, %lu duplicate fragments)\n",
+                          (unsigned long)thumbIncident, (unsigned)thumbLen,
+                          (unsigned long)rs.lastMs,
+                          rs.lastMs ? thumbLen / 1.024f / rs.lastMs : 0.0f,
+                          (unsigned long)rs.lastDuplicates);
+            bool forwarded = relayKind == RELAY_FULL
+                ? backend.postRelayedImage(thumbIncident, thumbData, thumbLen)
+                : backend.postThumbnail(thumbIncident, thumbData, thumbLen);
+            Serial.printf("[BACKEND] %s relayed image %08lX\n",
+                          forwarded ? "✓ Forwarded" : "✗ Could not forward",
+                          (unsigned long)thumbIncident);
+            relayReceiver.finish(forwarded);
+        }
+
+        // The cam was told its report goes out with ours
+        if (backend.msUntilHeartbeat() == 0 || camTelemetry.msUntilForwardDue() == 0) {
+            sendHeartbeat();
+        }
+    }
+}
+
+// ==================== STARTUP ====================
+
+void startSystemTasks() {
+    // Incident IDs must not repeat across reboots: the backend and the
+    // camera join on them. The 16-bit boot half counts up from an offset
+    // drawn when the namespace is created, so an erased NVS does not
+    // replay the IDs of earlier boots; without NVS it is random.
+    uint32_t offset = esp_random();
+    uint32_t boots = 0;
+    Preferences prefs;
+    if (prefs.begin("incident", false)) {
+        if (!prefs.isKey("offset")) {
+            // A counter from before the offset carries on where it was
+            prefs.putULong("offset", prefs.isKey("boot") ? 0 : offset);
+        }
+        offset = prefs.getULong("offset", offset);
+        boots = prefs.getULong("boots", prefs.getUShort("boot", 0)) + 1;
+        prefs.putULong("boots", boots);
+        prefs.end();
+    }
+    bootId = (uint16_t)(offset + boots);
+    Serial.printf("Incident IDs this boot: %04X....\n", bootId);
+
+    cameraQueue = xQueueCreateStatic(ALERT_QUEUE_LENGTH, sizeof(AlertEvent),
+                                     cameraQueueBuf, &cameraQueueCtrl);
+    gsmQueue = xQueueCreateStatic(ALERT_QUEUE_LENGTH, sizeof(GsmRequest),
+                                  gsmQueueBuf, &gsmQueueCtrl);
+    backendQueue = xQueueCreateStatic(ALERT_QUEUE_LENGTH, sizeof(AlertEvent),
+                                      backendQueueBuf, &backendQueueCtrl);
+    indicatorQueue = xQueueCreateStatic(INDICATOR_QUEUE_LENGTH, sizeof(IndicatorCommand),
+                                        indicatorQueueBuf, &indicatorQueueCtrl);
+
+    // Consumers first so the first detection always finds a reader
+    xTaskCreateStaticPinnedToCore(indicatorTask, "indicators", INDICATOR_TASK_STACK, nullptr,
+                                  INDICATOR_TASK_PRIORITY, indicatorStack, &indicatorTaskCtrl,
+                                  INDICATOR_TASK_CORE);
+    backendTaskHandle = xTaskCreateStaticPinnedToCore(backendTask, "backend", BACKEND_TASK_STACK, nullptr,
+                                  BACKEND_TASK_PRIORITY, backendStack, &backendTaskCtrl,
+                                  BACKEND_TASK_CORE);
+    gsmTaskHandle = xTaskCreateStaticPinnedToCore(gsmTask, "gsm", GSM_TASK_STACK, nullptr,
+                                  GSM_TASK_PRIORITY, gsmStack, &gsmTaskCtrl,
+                                  GSM_TASK_CORE);
+    xTaskCreateStaticPinnedToCore(cameraTask, "camera", CAMERA_TASK_STACK, nullptr,
+                                  CAMERA_TASK_PRIORITY, cameraStack, &cameraTaskCtrl,
+                                  CAMERA_TASK_CORE);
+    sensingTaskHandle = xTaskCreateStaticPinnedToCore(sensingTask, "sensing", SENSING_TASK_STACK, nullptr,
+                                  SENSING_TASK_PRIORITY, sensingStack, &sensingTaskCtrl,
+                                  SENSING_TASK_CORE);
+
+    Serial.println("System tasks started");
+}
@@ -0,0 +1,152 @@
+/**
+ * SIM800L Emulator (native tests)
+ * Answers AT commands on a fake UART in simulated time
+ *
+ * Replies are scheduled at millis() + their delay and only become
+ * readable once the clock gets there, so a 30 s "+CMGS" really takes
+ * 30 s of the test's time. Every command line is kept in commands.
+ * A test can take over any command with the handler hook and inject
+ * URCs with urc().
+ */
+
+#ifndef MODEM_EMULATOR_H
+#define MODEM_EMULATOR_H
+
+#include <Arduino.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+#define MODEM_CTRL_Z 0x1A
+#define MODEM_ESC 0x1B
+
+class ModemEmulator : public HardwareSerial {
+public:
+    // Return true if the command was handled; false = default reply
+    typedef std::function<bool(ModemEmulator& modem, const std::string& command)> Handler;
+
+    unsigned long replyDelayMs = 20;     // Command to OK
+    unsigned long promptDelayMs = 80;    // AT+CMGS to '>'
+    unsigned long cmgsDelayMs = 3000;    // Ctrl+Z to +CMGS (network submit)
+    bool cmgsFails = false;              // +CMS ERROR instead of +CMGS
+    Handler handler;
+
+    std::vector<std::string> commands;   // Every command line, in order
+    std::vector<std::string> payloads;   // Text sent after each '>'
+    unsigned long smsSubmittedAt = 0;    // millis() of the last Ctrl+Z
+    unsigned cancelled = 0;              // ESC after a prompt
+
+    ModemEmulator() : HardwareSerial(1) {}
+
+    // Bytes the modem sends afterMs from now
+    void reply(const std::string& text, unsigned long afterMs) {
+        Pending p = { millis() + afterMs, text };
+        size_t i = pending.size();
+        while (i > 0 && pending[i - 1].due > p.due) i--;
+        pending.insert(pending.begin() + i, p);
+    }
+    void ok(unsigned long afterMs) { reply("\r\nOK\r\n", afterMs); }
+    void urc(const std::string& line) { reply("\r\n" + line + "\r\n", 0); }
+
+    unsigned count(const char* prefix) const {
+        unsigned n = 0;
+        for (const std::string& c : commands) {
+            if (c.compare(0, strlen(prefix), prefix) == 0) n++;
+        }
+        return n;
+    }
+    bool idle() const { return pending.empty() && !inPayload; }
+
+    int available() override {
+        release();
+        return HardwareSerial::available();
+    }
+    int read() override {
+        release();
+        return HardwareSerial::read();
+    }
+    int peek() override {
+        release();
+        return HardwareSerial::peek();
+    }
+    size_t write(const uint8_t* buf, size_t size) override {
+        for (size_t i = 0; i < size; i++) take(buf[i]);
+        return size;
+    }
+    using HardwareSerial::write;
+
+private:
+    struct Pending {
+        unsigned long due;
+        std::string text;
+    };
+    std::vector<Pending> pending;
+    std::string line;
+    std::string payload;
+    bool inPayload = false;
+    bool afterCr = false;
+
+    void release() {
+        unsigned long now = millis();
+        while (!pending.empty() && (long)(now - pending.front().due) >= 0) {
+            inject(pending.front().text.c_str());
+            pending.erase(pending.begin());
+        }
+    }
+
+    void take(uint8_t c) {
+        // "\r\n" ends a command once; the '\n' is not payload
+        bool lf = c == '\n' && afterCr;
+        afterCr = c == '\r';
+        if (lf) {
+            return;
+        }
+        if (inPayload) {
+            if (c == MODEM_CTRL_Z) {
+                inPayload = false;
+                payloads.push_back(payload);
+                smsSubmittedAt = millis();
+                reply(cmgsFails ? "\r\n+CMS ERROR: 500\r\n" : "\r\n+CMGS: 42\r\n\r\nOK\r\n",
+                      cmgsDelayMs);
+            } else if (c == MODEM_ESC) {
+                inPayload = false;
+                cancelled++;
+                ok(replyDelayMs);
+            } else {
+                payload += (char)c;
+            }
+            return;
+        }
+        if (c != '\r' && c != '\n') {
+            line += (char)c;
+            return;
+        }
+        if (line.empty()) {
+            return;
+        }
+        std::string command;
+        command.swap(line);
+        commands.push_back(command);
+        if (!handler || !handler(*this, command)) {
+            answer(command);
+        }
+    }
+
+    void answer(const std::string& command) {
+        if (command.compare(0, 8, "AT+CMGS=") == 0) {
+            payload.clear();
+            inPayload = true;
+            reply("\r\n> ", promptDelayMs);
+        } else if (command == "AT+CSQ") {
+            reply("\r\n+CSQ: 18,0\r\n\r\nOK\r\n", replyDelayMs);
+        } else if (command == "AT+CREG?") {
+            reply("\r\n+CREG: 1,1\r\n\r\nOK\r\n", replyDelayMs);
+        } else if (command == "AT+COPS?") {
+            reply("\r\n+COPS: 0,0,\"TESTNET\"\r\n\r\nOK\r\n", replyDelayMs);
+        } else {
+            ok(replyDelayMs);
+        }
+    }
+};
+
+#endif // MODEM_EMULATOR_H
@@ -0,0 +1,165 @@
+/**
+ * Alert outbox persistence
+ * Records survive a reboot (a new outbox over the same NVS), stay
+ * oldest-first through drops and removals, and cost one flash write per
+ * change
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include "config.h"
+#include "alert_outbox.h"
+
+static AlertRecord record(uint32_t id) {
+    AlertRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.id = id;
+    rec.timestamp = 1700000000 + id;
+    rec.sequence = id;
+    rec.confidence = 80;
+    rec.pirMask = PIR_MASK_LEFT | PIR_MASK_MIDDLE;
+    rec.network = ALERT_NET_OFFLINE;
+    return rec;
+}
+
+static void assertIds(AlertOutbox& box, const uint32_t* ids, int n) {
+    AlertRecord out[ALERT_OUTBOX_CAPACITY];
+    TEST_ASSERT_EQUAL(n, box.depth());
+    TEST_ASSERT_EQUAL(n, box.peek(out, ALERT_OUTBOX_CAPACITY));
+    for (int i = 0; i < n; i++) {
+        TEST_ASSERT_EQUAL_UINT32(ids[i], out[i].id);
+    }
+}
+
+void setUp(void) {
+    fakeNvsErase();
+    fakeNvsWrites = 0;
+}
+
+void tearDown(void) {}
+
+void test_record_is_16_bytes(void) {
+    TEST_ASSERT_EQUAL(16, sizeof(AlertRecord));
+}
+
+void test_records_survive_a_reboot(void) {
+    {
+        AlertOutbox box;
+        box.begin();
+        for (uint32_t id = 1; id <= 3; id++) {
+            TEST_ASSERT_TRUE(box.push(record(id)));
+        }
+        box.markAttempt(2);
+    }
+
+    AlertOutbox rebooted;
+    rebooted.begin();
+    const uint32_t ids[] = { 1, 2, 3 };
+    assertIds(rebooted, ids, 3);
+
+    AlertRecord out[3];
+    rebooted.peek(out, 3);
+    TEST_ASSERT_EQUAL_UINT32(1700000002, out[1].timestamp);
+    TEST_ASSERT_EQUAL(80, out[1].confidence);
+    TEST_ASSERT_EQUAL(PIR_MASK_LEFT | PIR_MASK_MIDDLE, out[1].pirMask);
+    // This boot's sequence numbers mean nothing for old records
+    TEST_ASSERT_EQUAL_UINT32(0, out[1].sequence);
+    // Attempts are RAM only
+    TEST_ASSERT_EQUAL(0, out[1].attempts);
+}
+
+void test_full_outbox_drops_the_oldest(void) {
+    AlertOutbox box;
+    box.begin();
+    for (uint32_t id = 1; id <= ALERT_OUTBOX_CAPACITY + 5; id++) {
+        box.push(record(id));
+    }
+    TEST_ASSERT_EQUAL(ALERT_OUTBOX_CAPACITY, box.depth());
+    TEST_ASSERT_EQUAL_UINT32(5, box.getDroppedCount());
+
+    AlertRecord out[ALERT_OUTBOX_CAPACITY];
+    box.peek(out, ALERT_OUTBOX_CAPACITY);
+    for (int i = 0; i < ALERT_OUTBOX_CAPACITY; i++) {
+        TEST_ASSERT_EQUAL_UINT32(6 + i, out[i].id);
+    }
+
+    // The wrapped ring restores in the same order
+    AlertOutbox rebooted;
+    rebooted.begin();
+    AlertRecord again[ALERT_OUTBOX_CAPACITY];
+    TEST_ASSERT_EQUAL(ALERT_OUTBOX_CAPACITY, rebooted.peek(again, ALERT_OUTBOX_CAPACITY));
+    TEST_ASSERT_EQUAL_UINT32(6, again[0].id);
+    TEST_ASSERT_EQUAL_UINT32(ALERT_OUTBOX_CAPACITY + 5, again[ALERT_OUTBOX_CAPACITY - 1].id);
+}
+
+void test_batch_pop_and_single_remove(void) {
+    AlertOutbox box;
+    box.begin();
+    for (uint32_t id = 1; id <= 6; id++) {
+        box.push(record(id));
+    }
+
+    box.pop(2);  // A batch of two was accepted
+    const uint32_t afterPop[] = { 3, 4, 5, 6 };
+    assertIds(box, afterPop, 4);
+
+    box.remove(5);  // Delivered on its own
+    box.remove(99);  // Unknown: nothing happens
+    const uint32_t afterRemove[] = { 3, 4, 6 };
+    assertIds(box, afterRemove, 3);
+
+    box.pop(10);
+    TEST_ASSERT_EQUAL(0, box.depth());
+    box.push(record(7));
+    const uint32_t fresh[] = { 7 };
+    assertIds(box, fresh, 1);
+
+    AlertOutbox rebooted;
+    rebooted.begin();
+    assertIds(rebooted, fresh, 1);
+}
+
+void test_one_flash_write_per_change(void) {
+    AlertOutbox box;
+    box.begin();
+    fakeNvsWrites = 0;
+    box.push(record(1));
+    box.push(record(2));
+    TEST_ASSERT_EQUAL(2, fakeNvsWrites);
+    box.markAttempt(1);
+    box.markAttempt(1);
+    TEST_ASSERT_EQUAL(2, fakeNvsWrites);
+    box.pop(1);
+    box.remove(2);
+    TEST_ASSERT_EQUAL(4, fakeNvsWrites);
+    box.remove(3);
+    TEST_ASSERT_EQUAL(4, fakeNvsWrites);
+}
+
+void test_corrupt_store_starts_empty(void) {
+    {
+        AlertOutbox box;
+        box.begin();
+        box.push(record(1));
+    }
+    // Head byte out of range, as after a layout change
+    fakeNvs["alertbox"]["records"][0] = 0xFF;
+
+    AlertOutbox box;
+    box.begin();
+    TEST_ASSERT_EQUAL(0, box.depth());
+    box.push(record(2));
+    const uint32_t ids[] = { 2 };
+    assertIds(box, ids, 1);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_record_is_16_bytes);
+    RUN_TEST(test_records_survive_a_reboot);
+    RUN_TEST(test_full_outbox_drops_the_oldest);
+    RUN_TEST(test_batch_pop_and_single_remove);
+    RUN_TEST(test_one_flash_write_per_change);
+    RUN_TEST(test_corrupt_store_starts_empty);
+    return UNITY_END();
+}
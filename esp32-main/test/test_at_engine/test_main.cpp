@@ -0,0 +1,336 @@
+/**
+ * ATEngine against the SIM800L emulator
+ * Queueing, URCs, prompts, timeouts, sleep wake-up and throughput
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include <chrono>
+#include "config.h"
+#include "at_engine.h"
+#include "modem_emulator.h"
+
+static ModemEmulator* modem;
+static ATEngine* at;
+
+struct Result {
+    int calls = 0;
+    ATResultCode code = AT_RESULT_ERROR;
+    char info[AT_INFO_MAX] = "";
+    unsigned long at = 0;
+};
+
+static void record(const ATResponse& response, void* ctx) {
+    Result* r = (Result*)ctx;
+    r->calls++;
+    r->code = response.code;
+    strncpy(r->info, response.info, sizeof(r->info) - 1);
+    r->at = millis();
+}
+
+struct URCLog {
+    std::vector<std::string> lines;
+};
+
+static void logURC(const char* line, void* ctx) {
+    ((URCLog*)ctx)->lines.push_back(line);
+}
+
+// The GSM task's loop: poll every GSM_POLL_INTERVAL_MS
+static void runFor(unsigned long ms) {
+    unsigned long end = millis() + ms;
+    while ((long)(millis() - end) < 0) {
+        at->poll();
+        fakeAdvance(GSM_POLL_INTERVAL_MS);
+    }
+    at->poll();
+}
+
+static void runUntil(const Result& r, unsigned long limitMs) {
+    unsigned long end = millis() + limitMs;
+    while (r.calls == 0 && (long)(millis() - end) < 0) {
+        at->poll();
+        fakeAdvance(1);
+    }
+}
+
+void setUp(void) {
+    fakeResetClock();
+    modem = new ModemEmulator();
+    at = new ATEngine();
+    at->begin(modem);
+}
+
+void tearDown(void) {
+    delete at;
+    delete modem;
+}
+
+void test_commands_run_in_order_with_their_own_info(void) {
+    Result csq, creg, plain;
+    TEST_ASSERT_TRUE(at->submit("AT+CSQ", 1000, record, &csq, "+CSQ:"));
+    TEST_ASSERT_TRUE(at->submit("AT+CREG?", 1000, record, &creg, "+CREG:"));
+    TEST_ASSERT_TRUE(at->submit("ATE0", 1000, record, &plain));
+    TEST_ASSERT_EQUAL(3, at->pending());
+    // Only the head is on the wire
+    TEST_ASSERT_EQUAL(1, modem->commands.size());
+
+    runFor(500);
+
+    TEST_ASSERT_EQUAL(3, modem->commands.size());
+    TEST_ASSERT_EQUAL_STRING("AT+CREG?", modem->commands[1].c_str());
+    TEST_ASSERT_EQUAL(AT_RESULT_OK, csq.code);
+    TEST_ASSERT_EQUAL_STRING("+CSQ: 18,0", csq.info);
+    TEST_ASSERT_EQUAL_STRING("+CREG: 1,1", creg.info);
+    TEST_ASSERT_EQUAL_STRING("", plain.info);
+    TEST_ASSERT_LESS_THAN(creg.at, csq.at);
+    TEST_ASSERT_LESS_THAN(plain.at, creg.at);
+    TEST_ASSERT_TRUE(at->isIdle());
+    TEST_ASSERT_EQUAL(3, at->getCompletedCount());
+}
+
+void test_queue_full_is_refused(void) {
+    for (int i = 0; i < AT_QUEUE_DEPTH; i++) {
+        TEST_ASSERT_TRUE(at->submit("AT", 1000));
+    }
+    TEST_ASSERT_FALSE(at->submit("AT", 1000));
+    runFor(1000);
+    TEST_ASSERT_TRUE(at->isIdle());
+    TEST_ASSERT_TRUE(at->submit("AT", 1000));
+}
+
+void test_urcs_are_dispatched_during_a_command(void) {
+    URCLog log;
+    at->onURC("+CMTI:", logURC, &log);
+    at->onURC("RING", logURC, &log);
+    at->onURC("+CREG:", logURC, &log);
+
+    // The modem reports a new SMS and a call before answering
+    modem->handler = [](ModemEmulator& m, const std::string& cmd) {
+        if (cmd != "AT+CSQ") return false;
+        m.reply("\r\n+CMTI: \"SM\",3\r\n\r\nRING\r\n", 5);
+        m.reply("\r\n+CSQ: 21,0\r\n\r\nOK\r\n", 30);
+        return true;
+    };
+    Result csq;
+    at->submit("AT+CSQ", 1000, record, &csq, "+CSQ:");
+    runFor(100);
+
+    TEST_ASSERT_EQUAL_STRING("+CSQ: 21,0", csq.info);
+    TEST_ASSERT_EQUAL(2, log.lines.size());
+    TEST_ASSERT_EQUAL_STRING("+CMTI: \"SM\",3", log.lines[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("RING", log.lines[1].c_str());
+
+    // Idle URCs too; a +CREG query answer with the prefix is the command's
+    modem->urc("+CREG: 5");
+    runFor(20);
+    TEST_ASSERT_EQUAL(3, log.lines.size());
+    TEST_ASSERT_EQUAL_STRING("+CREG: 5", log.lines[2].c_str());
+}
+
+void test_sms_payload_goes_out_on_the_prompt(void) {
+    Result sms;
+    modem->cmgsDelayMs = 4000;
+    at->submit("AT+CMGS=\"+15550100\"", 60000, record, &sms, "+CMGS:", "Alarm: front door");
+    runFor(1000);
+    TEST_ASSERT_EQUAL(0, sms.calls);
+    TEST_ASSERT_EQUAL(1, modem->payloads.size());
+    TEST_ASSERT_EQUAL_STRING("Alarm: front door", modem->payloads[0].c_str());
+    TEST_ASSERT_GREATER_OR_EQUAL(modem->promptDelayMs, at->getLastPromptMs());
+
+    runUntil(sms, 5000);
+    TEST_ASSERT_EQUAL(AT_RESULT_OK, sms.code);
+    TEST_ASSERT_EQUAL_STRING("+CMGS: 42", sms.info);
+}
+
+void test_error_result_carries_the_error_text(void) {
+    Result sms;
+    modem->cmgsFails = true;
+    at->submit("AT+CMGS=\"+15550100\"", 60000, record, &sms, "+CMGS:", "x");
+    runUntil(sms, 10000);
+    TEST_ASSERT_EQUAL(AT_RESULT_ERROR, sms.code);
+    TEST_ASSERT_EQUAL_STRING("+CMS ERROR: 500", sms.info);
+}
+
+void test_timeout_aborts_a_pending_prompt(void) {
+    Result sms, next;
+    modem->promptDelayMs = 120000;  // '>' never shows up in time
+    at->submit("AT+CMGS=\"+15550100\"", 5000, record, &sms, "+CMGS:", "x");
+    at->submit("AT+CSQ", 1000, record, &next, "+CSQ:");
+    runFor(5100);
+    TEST_ASSERT_EQUAL(AT_RESULT_TIMEOUT, sms.code);
+    TEST_ASSERT_EQUAL(1, at->getTimeoutCount());
+    TEST_ASSERT_EQUAL(1, modem->cancelled);  // ESC sent
+    runFor(200);
+    TEST_ASSERT_EQUAL(AT_RESULT_OK, next.code);
+}
+
+void test_overlong_line_keeps_its_head(void) {
+    modem->handler = [](ModemEmulator& m, const std::string& cmd) {
+        if (cmd != "AT+CCID") return false;
+        m.reply("\r\n" + std::string(300, '8') + "\r\n\r\nOK\r\n", 10);
+        return true;
+    };
+    Result r;
+    at->submit("AT+CCID", 1000, record, &r);
+    runFor(100);
+    TEST_ASSERT_EQUAL(AT_RESULT_OK, r.code);
+    TEST_ASSERT_EQUAL(AT_LINE_MAX - 1, strlen(r.info));
+}
+
+// Review regression: the callback submits the next command, which
+// clears the engine's info buffer; the response must still hold its own
+static Result chained;
+static char infoAfterSubmit[AT_INFO_MAX];
+
+static void submitFromCallback(const ATResponse& response, void* ctx) {
+    at->submit("AT+CREG?", 1000, record, &chained, "+CREG:");
+    strncpy(infoAfterSubmit, response.info, sizeof(infoAfterSubmit) - 1);
+}
+
+void test_callback_may_submit_without_losing_its_info(void) {
+    chained = Result();
+    infoAfterSubmit[0] = '\0';
+    at->submit("AT+CSQ", 1000, submitFromCallback, nullptr, "+CSQ:");
+    runFor(200);
+    TEST_ASSERT_EQUAL_STRING("+CSQ: 18,0", infoAfterSubmit);
+    TEST_ASSERT_EQUAL_STRING("+CREG: 1,1", chained.info);
+}
+
+// Modem in slow-clock sleep: the characters that wake it are lost
+void test_wake_probe_answered_after_a_lost_one(void) {
+    at->setSleepAfter(GSM_SLEEP_IDLE_MS);
+    runFor(GSM_SLEEP_IDLE_MS + 1000);
+    TEST_ASSERT_TRUE(at->isLikelyAsleep());
+
+    // Probe 1 only wakes the modem; probe 2 is answered
+    static unsigned probes;
+    static unsigned long okAt, csqAt;
+    probes = 0;
+    modem->handler = [](ModemEmulator& m, const std::string& cmd) {
+        if (cmd == "AT+CSQ") csqAt = millis();
+        if (cmd != "AT") return false;
+        if (++probes > 1) {
+            okAt = millis() + 5;
+            m.ok(5);
+        }
+        return true;
+    };
+    Result csq;
+    at->submit("AT+CSQ", 1000, record, &csq, "+CSQ:");
+    runUntil(csq, 2000);
+
+    TEST_ASSERT_EQUAL(AT_RESULT_OK, csq.code);
+    TEST_ASSERT_EQUAL_STRING("+CSQ: 18,0", csq.info);
+    TEST_ASSERT_EQUAL(2, probes);
+    TEST_ASSERT_EQUAL(1, at->getWakeCount());
+    // The lost probe's answer is waited out for AT_WAKE_SETTLE_MS, no longer
+    TEST_ASSERT_GREATER_OR_EQUAL(okAt + AT_WAKE_SETTLE_MS, csqAt);
+    TEST_ASSERT_LESS_OR_EQUAL(okAt + AT_WAKE_SETTLE_MS + 2, csqAt);
+}
+
+// Review regression: a modem that woke mid-probe answers both probes,
+// the first one late. That second OK must not complete the command.
+void test_second_wake_ok_does_not_complete_the_command(void) {
+    at->setSleepAfter(GSM_SLEEP_IDLE_MS);
+    runFor(GSM_SLEEP_IDLE_MS + 1000);
+
+    modem->cmgsDelayMs = 2000;
+    static unsigned probes;
+    probes = 0;
+    modem->handler = [](ModemEmulator& m, const std::string& cmd) {
+        if (cmd != "AT") return false;
+        // Probe 1 (t=0) answered at t=AT_WAKE_PROBE_MS+20, after probe 2
+        // went out; probe 2 answered 10 ms after that
+        m.ok(++probes == 1 ? AT_WAKE_PROBE_MS + 20 : 30);
+        return true;
+    };
+    Result sms;
+    at->submit("AT+CMGS=\"+15550100\"", 60000, record, &sms, "+CMGS:", "Alarm");
+    runUntil(sms, 10000);
+
+    TEST_ASSERT_EQUAL(2, probes);
+    TEST_ASSERT_EQUAL(AT_RESULT_OK, sms.code);
+    TEST_ASSERT_EQUAL_STRING("+CMGS: 42", sms.info);
+    TEST_ASSERT_EQUAL(1, modem->payloads.size());
+    TEST_ASSERT_GREATER_OR_EQUAL(modem->smsSubmittedAt + modem->cmgsDelayMs, sms.at);
+}
+
+// Review regression: URCs that arrive with the wake OK, before the
+// queued command goes out, reach their handlers
+void test_urc_after_the_wake_ok_is_not_lost(void) {
+    URCLog log;
+    at->onURC("+CMTI:", logURC, &log);
+    at->setSleepAfter(GSM_SLEEP_IDLE_MS);
+    runFor(GSM_SLEEP_IDLE_MS + 1000);
+
+    modem->handler = [](ModemEmulator& m, const std::string& cmd) {
+        if (cmd != "AT") return false;
+        m.reply("\r\nOK\r\n\r\n+CMTI: \"SM\",3\r\n", 5);
+        return true;
+    };
+    Result csq;
+    at->submit("AT+CSQ", 1000, record, &csq, "+CSQ:");
+    runUntil(csq, 2000);
+
+    TEST_ASSERT_EQUAL(AT_RESULT_OK, csq.code);
+    TEST_ASSERT_EQUAL_STRING("+CSQ: 18,0", csq.info);
+    TEST_ASSERT_EQUAL(1, log.lines.size());
+    TEST_ASSERT_EQUAL_STRING("+CMTI: \"SM\",3", log.lines[0].c_str());
+}
+
+void test_benchmark_command_throughput(void) {
+    const int N = 500;
+    int done = 0;
+    auto counter = [](const ATResponse& response, void* ctx) {
+        if (response.code == AT_RESULT_OK) (*(int*)ctx)++;
+    };
+
+    unsigned long start = millis();
+    auto wallStart = std::chrono::steady_clock::now();
+    unsigned long polls = 0;
+    int submitted = 0;
+    while (done < N && millis() - start < 60000) {
+        while (submitted < N && at->pending() < AT_QUEUE_DEPTH) {
+            at->submit("AT+CSQ", 1000, counter, &done, "+CSQ:");
+            submitted++;
+        }
+        at->poll();
+        polls++;
+        fakeAdvance(1);
+    }
+    double wallUs = std::chrono::duration<double, std::micro>(
+                        std::chrono::steady_clock::now() - wallStart).count();
+    unsigned long simMs = millis() - start;
+
+    TEST_ASSERT_EQUAL(N, done);
+    TEST_ASSERT_EQUAL(0, at->getTimeoutCount());
+    // Back to back, each command costs the modem's reply delay plus at
+    // most one poll period
+    double perCommandMs = (double)simMs / N;
+    TEST_ASSERT_TRUE(perCommandMs <= modem->replyDelayMs + 2);
+
+    char msg[160];
+    snprintf(msg, sizeof(msg),
+             "%d commands: %.1f cmd/s simulated (%.1f ms each, modem %lu ms), "
+             "%.2f us host CPU per poll",
+             N, N * 1000.0 / simMs, perCommandMs, modem->replyDelayMs, wallUs / polls);
+    TEST_MESSAGE(msg);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_commands_run_in_order_with_their_own_info);
+    RUN_TEST(test_queue_full_is_refused);
+    RUN_TEST(test_urcs_are_dispatched_during_a_command);
+    RUN_TEST(test_sms_payload_goes_out_on_the_prompt);
+    RUN_TEST(test_error_result_carries_the_error_text);
+    RUN_TEST(test_timeout_aborts_a_pending_prompt);
+    RUN_TEST(test_overlong_line_keeps_its_head);
+    RUN_TEST(test_callback_may_submit_without_losing_its_info);
+    RUN_TEST(test_wake_probe_answered_after_a_lost_one);
+    RUN_TEST(test_second_wake_ok_does_not_complete_the_command);
+    RUN_TEST(test_urc_after_the_wake_ok_is_not_lost);
+    RUN_TEST(test_benchmark_command_throughput);
+    return UNITY_END();
+}
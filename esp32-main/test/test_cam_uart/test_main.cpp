@@ -0,0 +1,257 @@
+/**
+ * Cam UART receiver
+ * Frames built with uartEncode() are fed in as the cam would send them,
+ * whole, split, damaged, repeated or out of order; acks and thumbnail
+ * requests are read back from the ESP-NOW sends.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include "config.h"
+#include "cam_uart.h"
+#include "cam_link.h"
+#include "espnow_protocol.h"
+
+static const uint8_t CAM_MAC[6] = { 0x24, 0x6F, 0x28, 0xCA, 0x00, 0x01 };
+
+static HardwareSerial* port;
+static CamUart* cam;
+
+static std::string frame(UartFrameType type, uint8_t seq, uint8_t flags, uint32_t incidentId,
+                         const void* payload = nullptr, uint16_t len = 0) {
+    uint8_t wire[UART_WIRE_MAX];
+    size_t n = uartEncode(wire, sizeof(wire), type, seq, flags, incidentId,
+                          (const uint8_t*)payload, len);
+    TEST_ASSERT_GREATER_THAN(0, n);
+    return std::string((const char*)wire, n);
+}
+
+static std::string captureFrame(uint8_t seq, uint32_t incidentId, uint16_t thumbBytes = 0,
+                                uint8_t flags = 0) {
+    CaptureReport r = { 48000, 130, thumbBytes, 1 };
+    return frame(UART_CAPTURE_REPORT, seq, flags, incidentId, &r, sizeof(r));
+}
+
+static std::string chunkFrame(uint8_t seq, uint32_t incidentId, uint16_t offset, uint16_t total,
+                              const uint8_t* data, uint16_t len) {
+    uint8_t payload[UART_PAYLOAD_MAX];
+    ThumbChunkHeader chunk = { offset, total };
+    memcpy(payload, &chunk, sizeof(chunk));
+    memcpy(payload + sizeof(chunk), data, len);
+    return frame(UART_THUMB_CHUNK, seq, 0, incidentId, payload, sizeof(chunk) + len);
+}
+
+static void feed(const std::string& bytes) {
+    port->inject((const uint8_t*)bytes.data(), bytes.size());
+}
+
+// ESP-NOW frames of one type sent since the last call
+static std::vector<EspNowHeader> sent(EspNowFrameType type) {
+    std::vector<EspNowHeader> out;
+    for (const FakeEspNowFrame& f : fakeEspNowSent) {
+        EspNowHeader h;
+        TEST_ASSERT_TRUE(espnowDecode(f.data.data(), f.data.size(), h));
+        TEST_ASSERT_EQUAL_MEMORY(CAM_MAC, f.mac, 6);
+        if (h.type == type) out.push_back(h);
+    }
+    fakeEspNowSent.clear();
+    return out;
+}
+
+static void assertAck(uint8_t nextExpected) {
+    std::vector<EspNowHeader> acks = sent(FRAME_LINK_ACK);
+    TEST_ASSERT_EQUAL(1, acks.size());
+    TEST_ASSERT_EQUAL(nextExpected, (uint8_t)acks[0].seq);
+}
+
+void setUp(void) {
+    fakeResetClock();
+    fakeEspNowReset();
+    TEST_ASSERT_TRUE(camLink.begin(CAM_MAC));
+    port = new HardwareSerial(2);
+    cam = new CamUart(port);
+    cam->begin();
+}
+
+void tearDown(void) {
+    delete cam;
+    delete port;
+}
+
+void test_begin_sizes_the_rx_buffer(void) {
+    TEST_ASSERT_EQUAL(CAM_UART_BAUD, port->baud);
+    TEST_ASSERT_GREATER_OR_EQUAL(UART_WINDOW * UART_WIRE_MAX, port->rxBufferSize);
+}
+
+void test_resync_frame_starts_delivery_and_is_acked_once(void) {
+    feed(captureFrame(200, 0x1001, 0, UART_FLAG_RESYNC));
+    feed(captureFrame(201, 0x1002));
+    UploadReport up = { UPLOAD_RESULT_OK, 0, 2100 };
+    feed(frame(UART_UPLOAD_REPORT, 202, 0, 0x1002, &up, sizeof(up)));
+    cam->poll();
+
+    assertAck(203);  // One cumulative ack for all three
+    CamStatus s = cam->getStatus();
+    TEST_ASSERT_EQUAL_UINT32(0x1002, s.captureIncident);
+    TEST_ASSERT_EQUAL_UINT32(48000, s.capture.jpegBytes);
+    TEST_ASSERT_EQUAL_UINT32(0x1002, s.uploadIncident);
+    TEST_ASSERT_EQUAL_UINT32(2100, s.upload.uploadMs);
+    TEST_ASSERT_EQUAL(3, cam->getStats().frames);
+
+    cam->poll();
+    TEST_ASSERT_EQUAL(0, sent(FRAME_LINK_ACK).size());  // Nothing new, no ack
+}
+
+void test_frames_before_sync_are_not_acked(void) {
+    feed(captureFrame(5, 0x2001));
+    cam->poll();
+    TEST_ASSERT_EQUAL(0, sent(FRAME_LINK_ACK).size());
+    TEST_ASSERT_EQUAL(1, cam->getStats().outOfOrder);
+    TEST_ASSERT_EQUAL(0, cam->getStatus().captureAt);
+}
+
+void test_frame_split_across_polls(void) {
+    std::string f = captureFrame(10, 0x3001, 0, UART_FLAG_RESYNC);
+    feed(f.substr(0, 7));
+    cam->poll();
+    TEST_ASSERT_EQUAL(0, cam->getStats().frames);
+    feed(f.substr(7));
+    cam->poll();
+    TEST_ASSERT_EQUAL(1, cam->getStats().frames);
+    assertAck(11);
+}
+
+void test_damaged_frame_is_dropped_and_the_resend_taken(void) {
+    feed(captureFrame(0, 0x4001, 0, UART_FLAG_RESYNC));
+    std::string bad = captureFrame(1, 0x4002);
+    bad[bad.size() / 2] ^= 0x20;
+    feed(bad);
+    feed(captureFrame(2, 0x4003));  // Behind the gap: go-back-N resends it
+    cam->poll();
+    assertAck(1);
+    TEST_ASSERT_EQUAL(1, cam->getStats().badFrames);
+    TEST_ASSERT_EQUAL(1, cam->getStats().outOfOrder);
+
+    feed(captureFrame(1, 0x4002));
+    feed(captureFrame(2, 0x4003));
+    cam->poll();
+    assertAck(3);
+    TEST_ASSERT_EQUAL_UINT32(0x4003, cam->getStatus().captureIncident);
+}
+
+void test_resend_after_a_lost_ack_is_a_duplicate(void) {
+    feed(captureFrame(50, 0x5001, 0, UART_FLAG_RESYNC));
+    feed(captureFrame(51, 0x5002));
+    cam->poll();
+    assertAck(52);
+
+    // Our ack never arrived; the cam resends its window, resync flag included
+    feed(captureFrame(50, 0x5001, 0, UART_FLAG_RESYNC));
+    feed(captureFrame(51, 0x5002));
+    cam->poll();
+    assertAck(52);
+    CamUartStats st = cam->getStats();
+    TEST_ASSERT_EQUAL(2, st.frames);
+    TEST_ASSERT_EQUAL(2, st.duplicates);
+}
+
+void test_noise_and_overlong_runs_resynchronize(void) {
+    std::string noise(UART_WIRE_MAX + 40, '\x7E');  // No delimiter for too long
+    feed(noise + std::string(1, '\0'));
+    feed(std::string("\x01\x02\x03", 3) + std::string(1, '\0'));
+    feed(captureFrame(9, 0x6001, 0, UART_FLAG_RESYNC));
+    cam->poll();
+    TEST_ASSERT_EQUAL(2, cam->getStats().badFrames);
+    TEST_ASSERT_EQUAL(1, cam->getStats().frames);
+    assertAck(10);
+}
+
+void test_thumbnail_offer_and_pull(void) {
+    const uint16_t total = 1000;
+    uint8_t jpeg[total];
+    for (int i = 0; i < total; i++) jpeg[i] = (uint8_t)(i * 7);
+
+    feed(captureFrame(0, 0x7001, total, UART_FLAG_RESYNC));
+    cam->poll();
+    sent(FRAME_LINK_ACK);
+
+    uint32_t offered = 0;
+    TEST_ASSERT_TRUE(cam->takeThumbnailOffer(offered));
+    TEST_ASSERT_EQUAL_UINT32(0x7001, offered);
+    TEST_ASSERT_FALSE(cam->takeThumbnailOffer(offered));
+
+    TEST_ASSERT_TRUE(cam->requestThumbnail(offered));
+    std::vector<EspNowHeader> req = sent(FRAME_THUMB_REQUEST);
+    TEST_ASSERT_EQUAL(1, req.size());
+    TEST_ASSERT_EQUAL_UINT32(0x7001, req[0].incidentId);
+    TEST_ASSERT_TRUE(cam->isPulling());
+    TEST_ASSERT_FALSE(cam->requestThumbnail(0x7002));  // One at a time
+
+    uint8_t seq = 1;
+    // A chunk for another incident is not ours
+    feed(chunkFrame(seq++, 0x7999, 0, total, jpeg, 100));
+    for (uint16_t off = 0; off < total; off += UART_THUMB_CHUNK_MAX) {
+        uint16_t n = total - off < UART_THUMB_CHUNK_MAX ? total - off : UART_THUMB_CHUNK_MAX;
+        feed(chunkFrame(seq++, 0x7001, off, total, jpeg + off, n));
+        cam->poll();
+    }
+
+    uint32_t incident;
+    const uint8_t* data;
+    size_t len;
+    TEST_ASSERT_TRUE(cam->getThumbnail(incident, data, len));
+    TEST_ASSERT_EQUAL_UINT32(0x7001, incident);
+    TEST_ASSERT_EQUAL(total, len);
+    TEST_ASSERT_EQUAL_MEMORY(jpeg, data, total);
+
+    cam->releaseThumbnail();
+    TEST_ASSERT_FALSE(cam->getThumbnail(incident, data, len));
+    TEST_ASSERT_TRUE(cam->requestThumbnail(0x7002));
+}
+
+void test_restarted_stream_abandons_the_pull(void) {
+    uint8_t jpeg[600] = { 0 };
+    feed(captureFrame(0, 0x8001, 600, UART_FLAG_RESYNC));
+    cam->poll();
+    TEST_ASSERT_TRUE(cam->requestThumbnail(0x8001));
+    feed(chunkFrame(1, 0x8001, 0, 600, jpeg, UART_THUMB_CHUNK_MAX));
+    feed(chunkFrame(2, 0x8001, 0, 600, jpeg, UART_THUMB_CHUNK_MAX));  // Offset went back
+    cam->poll();
+    TEST_ASSERT_FALSE(cam->isPulling());
+    uint32_t incident;
+    const uint8_t* data;
+    size_t len;
+    TEST_ASSERT_FALSE(cam->getThumbnail(incident, data, len));
+}
+
+void test_stalled_pull_expires(void) {
+    uint8_t jpeg[600] = { 0 };
+    feed(captureFrame(0, 0x9001, 600, UART_FLAG_RESYNC));
+    cam->poll();
+    TEST_ASSERT_TRUE(cam->requestThumbnail(0x9001));
+    feed(chunkFrame(1, 0x9001, 0, 600, jpeg, UART_THUMB_CHUNK_MAX));
+    cam->poll();
+
+    fakeAdvance(CAM_THUMB_TIMEOUT_MS - CAM_UART_POLL_MS);
+    cam->poll();
+    TEST_ASSERT_TRUE(cam->isPulling());
+    fakeAdvance(2 * CAM_UART_POLL_MS);
+    cam->poll();
+    TEST_ASSERT_FALSE(cam->isPulling());
+    TEST_ASSERT_TRUE(cam->requestThumbnail(0x9001));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_begin_sizes_the_rx_buffer);
+    RUN_TEST(test_resync_frame_starts_delivery_and_is_acked_once);
+    RUN_TEST(test_frames_before_sync_are_not_acked);
+    RUN_TEST(test_frame_split_across_polls);
+    RUN_TEST(test_damaged_frame_is_dropped_and_the_resend_taken);
+    RUN_TEST(test_resend_after_a_lost_ack_is_a_duplicate);
+    RUN_TEST(test_noise_and_overlong_runs_resynchronize);
+    RUN_TEST(test_thumbnail_offer_and_pull);
+    RUN_TEST(test_restarted_stream_abandons_the_pull);
+    RUN_TEST(test_stalled_pull_expires);
+    return UNITY_END();
+}
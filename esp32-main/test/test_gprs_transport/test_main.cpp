@@ -0,0 +1,227 @@
+/**
+ * GPRS fallback transport against the modem emulator
+ * Attach and connect costs, session reuse across alerts, and recovery
+ * from connections the server closed while idle
+ *
+ * Attach and TCP connect take ATTACH_MS and CONNECT_MS of simulated
+ * time (typical SIM800L figures); post latencies are reported.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include <TinyGsmClient.h>
+#include "config.h"
+#include "gsm_handler.h"
+#include "backend_transport.h"
+#include "modem_emulator.h"
+#include "fake_http_server.h"
+
+static const unsigned long ATTACH_MS = 3500;
+static const unsigned long CONNECT_MS = 1800;
+static const char* ALERT_PATH = "/api/v1/burglary/alert/alert";
+static const char BODY[] = "{\"c\":87,\"p\":3}";
+
+static ModemEmulator* modem;
+static GSMHandler* gsm;
+static GprsTransport* gprs;
+static FakeHttpServer* server;
+
+static int post(unsigned long* ms = nullptr) {
+    unsigned long start = millis();
+    int status = gprs->post(ALERT_PATH, "application/json", (const uint8_t*)BODY, strlen(BODY),
+                            nullptr, 0);
+    if (ms) *ms = millis() - start;
+    return status;
+}
+
+static void report(const char* what, unsigned long ms) {
+    char msg[96];
+    snprintf(msg, sizeof(msg), "%s: %lu ms (attach %lu, connect %lu)",
+             what, ms, gprs->getLastAttachMs(), gprs->getLastConnectMs());
+    TEST_MESSAGE(msg);
+}
+
+void setUp(void) {
+    fakeResetClock();
+    fakeGprs = FakeGprs();
+    fakeGprs.attachMs = ATTACH_MS;
+    fakeGprs.connectMs = CONNECT_MS;
+    server = new FakeHttpServer();
+    fakeGsmServer = server;
+    modem = new ModemEmulator();
+    gsm = new GSMHandler(modem);
+    TEST_ASSERT_TRUE(gsm->begin());
+    gprs = new GprsTransport(gsm, "http://backend.example:8080/", "secret");
+}
+
+void tearDown(void) {
+    delete gprs;
+    delete gsm;
+    delete modem;
+    fakeGsmServer = nullptr;
+    delete server;
+}
+
+void test_available_once_registered(void) {
+    TEST_ASSERT_TRUE(gprs->isAvailable());
+}
+
+void test_second_alert_skips_attach_and_connect(void) {
+    unsigned long coldMs, warmMs;
+    TEST_ASSERT_EQUAL(200, post(&coldMs));
+    report("cold post", coldMs);
+    TEST_ASSERT_EQUAL(ATTACH_MS, gprs->getLastAttachMs());
+    TEST_ASSERT_EQUAL(CONNECT_MS, gprs->getLastConnectMs());
+    TEST_ASSERT_GREATER_OR_EQUAL(ATTACH_MS + CONNECT_MS, coldMs);
+
+    TEST_ASSERT_EQUAL(200, post(&warmMs));
+    report("warm post", warmMs);
+    TEST_ASSERT_EQUAL(0, gprs->getLastAttachMs());
+    TEST_ASSERT_EQUAL(0, gprs->getLastConnectMs());
+    TEST_ASSERT_LESS_THAN(CONNECT_MS, warmMs);
+
+    TEST_ASSERT_EQUAL(1, fakeGprs.attaches);
+    TEST_ASSERT_EQUAL(1, server->connections);
+    TEST_ASSERT_EQUAL(2, server->requests.size());
+    const FakeHttpRequest& r = server->requests[1];
+    TEST_ASSERT_EQUAL_STRING("POST", r.method.c_str());
+    TEST_ASSERT_EQUAL_STRING(ALERT_PATH, r.path.c_str());
+    TEST_ASSERT_EQUAL_STRING("secret", r.header("X-API-Key").c_str());
+    TEST_ASSERT_EQUAL_STRING("keep-alive", r.header("Connection").c_str());
+    TEST_ASSERT_EQUAL_STRING(BODY, r.body.c_str());
+}
+
+void test_dropped_bearer_is_attached_again(void) {
+    TEST_ASSERT_EQUAL(200, post());
+    fakeGprs.attached = false;
+    server->closeIdle();
+    TEST_ASSERT_EQUAL(200, post());
+    TEST_ASSERT_EQUAL(2, fakeGprs.attaches);
+    TEST_ASSERT_EQUAL(ATTACH_MS, gprs->getLastAttachMs());
+}
+
+void test_attach_failure_fails_fast_and_recovers(void) {
+    fakeGprs.attachFails = true;
+    TEST_ASSERT_EQUAL(-1, post());
+    TEST_ASSERT_EQUAL(0, server->connections);
+    // Not held: the GSM task gets the modem back
+    TEST_ASSERT_TRUE(gsm->lockModem(0));
+    gsm->unlockModem();
+
+    fakeGprs.attachFails = false;
+    TEST_ASSERT_EQUAL(200, post());
+}
+
+void test_server_close_urc_reconnects_without_a_timeout(void) {
+    TEST_ASSERT_EQUAL(200, post());
+    // The backend closes the idle connection; only the modem notices
+    server->vanish();
+    modem->urc("1, CLOSED");
+    for (int i = 0; i < 5; i++) {
+        gsm->poll();
+        fakeAdvance(GSM_POLL_INTERVAL_MS);
+    }
+
+    unsigned long ms;
+    TEST_ASSERT_EQUAL(200, post(&ms));
+    report("post after CLOSED", ms);
+    TEST_ASSERT_EQUAL(2, server->connections);
+    TEST_ASSERT_EQUAL(CONNECT_MS, gprs->getLastConnectMs());
+    TEST_ASSERT_LESS_THAN(CONNECT_MS + 1000, ms);
+}
+
+void test_close_urc_for_the_other_socket_is_ignored(void) {
+    TEST_ASSERT_EQUAL(200, post());
+    modem->urc("0, CLOSED");  // mux 0 is the TLS client, unused for http://
+    for (int i = 0; i < 5; i++) {
+        gsm->poll();
+        fakeAdvance(GSM_POLL_INTERVAL_MS);
+    }
+    TEST_ASSERT_EQUAL(200, post());
+    TEST_ASSERT_EQUAL(1, server->connections);
+}
+
+void test_silently_dead_connection_is_retried_once(void) {
+    TEST_ASSERT_EQUAL(200, post());
+    server->vanish();  // No URC either
+
+    unsigned long ms;
+    TEST_ASSERT_EQUAL(200, post(&ms));
+    report("post on a dead connection", ms);
+    TEST_ASSERT_EQUAL(2, server->connections);
+    TEST_ASSERT_EQUAL(2, server->requests.size());
+    TEST_ASSERT_GREATER_OR_EQUAL(SERVER_TIMEOUT_MS, ms);
+}
+
+void test_fresh_connection_failure_is_not_retried(void) {
+    server->handler = [](const FakeHttpRequest& r) {
+        FakeHttpReply reply;
+        reply.silent = true;
+        return reply;
+    };
+    TEST_ASSERT_EQUAL(-1, post());
+    TEST_ASSERT_EQUAL(1, server->connections);
+    TEST_ASSERT_EQUAL(1, server->requests.size());
+}
+
+// Review regression: SMS alerts go first, so a post does not take the
+// modem while the outbox has an alert round ready to send
+void test_due_sms_alert_keeps_the_modem(void) {
+    gsm->setSMSAlertsDue(true);
+    unsigned long ms;
+    TEST_ASSERT_EQUAL(-1, post(&ms));
+    TEST_ASSERT_EQUAL(0, server->connections);
+    TEST_ASSERT_GREATER_OR_EQUAL(GPRS_MODEM_WAIT_MS, ms);
+
+    gsm->setSMSAlertsDue(false);
+    TEST_ASSERT_EQUAL(200, post());
+}
+
+// An alert that comes due while the first try sits on a dead connection
+// gets the modem before the retry
+struct AlertDuringPost : FakeHttpServer {
+    GSMHandler* gsm = nullptr;
+    bool armed = false;
+    size_t write(const uint8_t* buf, size_t size) override {
+        if (armed) {
+            armed = false;
+            gsm->setSMSAlertsDue(true);
+        }
+        return FakeHttpServer::write(buf, size);
+    }
+    using FakeHttpServer::write;
+};
+
+void test_modem_is_handed_back_between_tries(void) {
+    AlertDuringPost* alerting = new AlertDuringPost();
+    alerting->gsm = gsm;
+    fakeGsmServer = alerting;
+    TEST_ASSERT_EQUAL(200, post());
+    alerting->vanish();
+    alerting->armed = true;
+
+    TEST_ASSERT_EQUAL(-1, post());
+    TEST_ASSERT_EQUAL(1, alerting->connections);  // No retry ahead of the SMS
+    TEST_ASSERT_TRUE(gsm->lockModem(0));
+    gsm->unlockModem();
+
+    gsm->setSMSAlertsDue(false);
+    TEST_ASSERT_EQUAL(200, post());
+    fakeGsmServer = server;
+    delete alerting;
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_available_once_registered);
+    RUN_TEST(test_second_alert_skips_attach_and_connect);
+    RUN_TEST(test_dropped_bearer_is_attached_again);
+    RUN_TEST(test_attach_failure_fails_fast_and_recovers);
+    RUN_TEST(test_server_close_urc_reconnects_without_a_timeout);
+    RUN_TEST(test_close_urc_for_the_other_socket_is_ignored);
+    RUN_TEST(test_silently_dead_connection_is_retried_once);
+    RUN_TEST(test_fresh_connection_failure_is_not_retried);
+    RUN_TEST(test_due_sms_alert_keeps_the_modem);
+    RUN_TEST(test_modem_is_handed_back_between_tries);
+    return UNITY_END();
+}
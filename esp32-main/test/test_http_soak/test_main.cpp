@@ -0,0 +1,336 @@
+/**
+ * Request path heap soak
+ * Tens of thousands of backend posts (alerts, heartbeats, forwarded
+ * images) and multipart uploads go through the real request code with
+ * operator new counted. The server end is allocation-free too, so any
+ * count is the request path's own. The same head built the old way with
+ * String concatenation is counted for comparison.
+ *
+ * Heartbeats go through BackendClient, which reports to the alert
+ * dispatcher and so to the task queues of system_tasks.cpp. Neither is
+ * in the native build; this suite compiles the two sources itself with
+ * the queues left empty.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include <new>
+#include "config.h"
+#include "http_request.h"
+#include "backend_transport.h"
+#include "../../src/alert_dispatcher.cpp"
+#include "../../src/http_client.cpp"
+
+QueueHandle_t cameraQueue = nullptr;
+QueueHandle_t gsmQueue = nullptr;
+QueueHandle_t backendQueue = nullptr;
+
+static bool counting = false;
+static unsigned long allocations = 0;
+
+void* operator new(size_t n) {
+    if (counting) allocations++;
+    void* p = malloc(n ? n : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+void* operator new[](size_t n) { return operator new(n); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+// Keep-alive server with fixed buffers: takes a head and a Content-Length
+// body, sums the body, answers 200 with a 2-byte body
+class CannedServer : public Client {
+public:
+    unsigned requests = 0;
+    unsigned connections = 0;
+    uint32_t bodySum = 0;
+    size_t bodyBytes = 0;
+
+    int connect(IPAddress ip, uint16_t port) override { return connect("", port); }
+    int connect(const char* host, uint16_t port) override {
+        connections++;
+        open = true;
+        headLen = 0;
+        bodyLeft = 0;
+        inBody = false;
+        outLen = outPos = 0;
+        return 1;
+    }
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buf, size_t size) override {
+        if (!open) return 0;
+        for (size_t i = 0; i < size; i++) take(buf[i]);
+        return size;
+    }
+    int available() override { return (int)(outLen - outPos); }
+    int read() override { return outPos < outLen ? (uint8_t)out[outPos++] : -1; }
+    int read(uint8_t* buf, size_t size) override {
+        size_t n = outLen - outPos < size ? outLen - outPos : size;
+        memcpy(buf, out + outPos, n);
+        outPos += n;
+        return n ? (int)n : -1;
+    }
+    int peek() override { return outPos < outLen ? (uint8_t)out[outPos] : -1; }
+    void stop() override { open = false; }
+    uint8_t connected() override { return open; }
+    using Print::write;
+
+private:
+    bool open = false;
+    char head[1024];
+    size_t headLen = 0;
+    bool inBody = false;
+    size_t bodyLeft = 0;
+    char out[128];
+    size_t outLen = 0;
+    size_t outPos = 0;
+
+    void reply(const char* text) {
+        if (outPos == outLen) outLen = outPos = 0;
+        size_t n = strlen(text);
+        memcpy(out + outLen, text, n);
+        outLen += n;
+    }
+
+    void take(uint8_t c) {
+        if (inBody) {
+            bodySum += c;
+            bodyBytes++;
+            if (--bodyLeft == 0) done();
+            return;
+        }
+        if (headLen < sizeof(head) - 1) head[headLen++] = (char)c;
+        head[headLen] = '\0';
+        if (headLen < 4 || strcmp(head + headLen - 4, "\r\n\r\n") != 0) return;
+
+        const char* cl = strstr(head, "\r\nContent-Length: ");
+        bodyLeft = cl ? strtoul(cl + 18, nullptr, 10) : 0;
+        if (bodyLeft > 0 && strstr(head, "\r\nExpect: 100-continue\r\n")) {
+            reply("HTTP/1.1 100 Continue\r\n\r\n");
+        }
+        headLen = 0;
+        if (bodyLeft > 0) {
+            inBody = true;
+        } else {
+            done();
+        }
+    }
+
+    void done() {
+        inBody = false;
+        requests++;
+        reply("HTTP/1.1 200 OK\r\nContent-Length: 2\r\nAccept-Post: application/msgpack\r\n\r\nok");
+    }
+};
+
+static CannedServer* server;
+static uint8_t body[64 * 1024];
+
+static uint32_t sum(const uint8_t* p, size_t n) {
+    uint32_t s = 0;
+    for (size_t i = 0; i < n; i++) s += p[i];
+    return s;
+}
+
+void setUp(void) {
+    fakeResetClock();
+    server = new CannedServer();
+    fakeWiFiServer = server;
+    for (size_t i = 0; i < sizeof(body); i++) body[i] = (uint8_t)(i * 31 + (i >> 8));
+}
+
+void tearDown(void) {
+    counting = false;
+    fakeWiFiServer = nullptr;
+    delete server;
+}
+
+void test_allocation_counter_sees_string_building(void) {
+    // The head as the firmware used to build it
+    const char* host = "backend.example";
+    const char* path = "/api/v1/burglary/alert/alert";
+    allocations = 0;
+    counting = true;
+    String request = String("POST ") + path + " HTTP/1.1\r\n";
+    request += "Host: " + String(host) + "\r\n";
+    request += "X-API-Key: " + String(API_KEY) + "\r\n";
+    request += "Content-Type: application/json\r\n";
+    request += "Content-Length: " + String(180) + "\r\n\r\n";
+    counting = false;
+
+    char msg[96];
+    snprintf(msg, sizeof(msg), "String-built alert head: %lu allocations", allocations);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_GREATER_THAN(0, allocations);
+}
+
+void test_soak_backend_posts_allocate_nothing(void) {
+    // Endpoints are parsed here, once; nothing after this may allocate
+    WiFiTransport wifi("http://backend.example:8080/", API_KEY);
+    const char* paths[] = {
+        "/api/v1/burglary/alert/alert",
+        "/api/v1/burglary/alert/batch",
+        "/api/v1/burglary/device/heartbeat/group",
+        "/api/v1/burglary/device/trace",
+    };
+    const char* types[] = { "application/json", "application/msgpack" };
+    const unsigned rounds = 20000;
+
+    uint32_t expectedSum = 0;
+    size_t expectedBytes = 0;
+    allocations = 0;
+    counting = true;
+    for (unsigned i = 0; i < rounds; i++) {
+        // Mostly small bodies; every 100th a forwarded image that goes
+        // through Expect: 100-continue and the record staging
+        size_t len = i % 100 == 99 ? 40000 + i % 7000 : 20 + (i * 37) % 1500;
+        const uint8_t* p = body + i % 97;
+        char key[24];
+        snprintf(key, sizeof(key), "main-%08X", i);
+        HttpHeader headers[] = { { "Idempotency-Key", key } };
+        int status = wifi.post(paths[i % 4], types[i % 2], p, len, headers, i % 3 ? 1 : 0);
+        if (status != 200) {
+            counting = false;
+            TEST_ASSERT_EQUAL(200, status);
+        }
+        expectedSum += sum(p, len);
+        expectedBytes += len;
+    }
+    counting = false;
+
+    char msg[128];
+    snprintf(msg, sizeof(msg), "%u posts, %.1f MB of bodies, %lu allocations, %u connection(s)",
+             rounds, expectedBytes / 1048576.0, allocations, server->connections);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_EQUAL(0, allocations);
+    TEST_ASSERT_EQUAL(rounds, server->requests);
+    TEST_ASSERT_EQUAL(1, server->connections);  // Kept alive throughout
+    TEST_ASSERT_EQUAL(expectedBytes, server->bodyBytes);
+    TEST_ASSERT_EQUAL_UINT32(expectedSum, server->bodySum);
+    TEST_ASSERT_EQUAL_STRING("application/msgpack", wifi.getAcceptPost());
+}
+
+void test_soak_multipart_uploads_allocate_nothing(void) {
+    // The cam's image upload: head, multipart preamble, JPEG, trailer,
+    // written as slices through a record-sized staging buffer
+    static uint8_t stage[TLS_RECORD_BYTES];
+    HttpEndpoint endpoint;
+    TEST_ASSERT_TRUE(httpParseEndpoint("http://backend.example:8080/api/v1/burglary", endpoint));
+    WiFiClient client;
+    TEST_ASSERT_TRUE(client.connect(endpoint.host, endpoint.port));
+
+    const char* boundary = "----ESP32CAMBoundary";
+    const unsigned rounds = 2000;
+    size_t expectedBytes = 0;
+    allocations = 0;
+    counting = true;
+    for (unsigned i = 0; i < rounds; i++) {
+        char preamble[192];
+        int preambleLen = snprintf(preamble, sizeof(preamble),
+                                   "--%s\r\nContent-Disposition: form-data; name=\"image\"; "
+                                   "filename=\"%08X.jpg\"\r\nContent-Type: image/jpeg\r\n\r\n",
+                                   boundary, i);
+        char trailer[48];
+        int trailerLen = snprintf(trailer, sizeof(trailer), "\r\n--%s--\r\n", boundary);
+        size_t jpegLen = 8000 + (i * 131) % 50000;
+
+        char buf[384];
+        HttpRequestHead head(buf, sizeof(buf));
+        head.begin("POST", endpoint, endpoint.path, "/image/upload");
+        head.header("X-API-Key", API_KEY);
+        char type[64];
+        snprintf(type, sizeof(type), "multipart/form-data; boundary=%s", boundary);
+        head.header("Content-Type", type);
+        head.header("Content-Length", (unsigned long)(preambleLen + jpegLen + trailerLen));
+        head.header("Connection", "keep-alive");
+        size_t headLen = head.finish();
+
+        HttpSlice slices[] = {
+            { head.data(), headLen },
+            { (const uint8_t*)preamble, (size_t)preambleLen },
+            { body + i % 89, jpegLen },
+            { (const uint8_t*)trailer, (size_t)trailerLen },
+        };
+        HttpExchange x{};
+        x.timeoutMs = SERVER_TIMEOUT_MS;
+        x.stage = stage;
+        x.stageLen = sizeof(stage);
+        x.hasBody = true;
+        HttpResponse response;
+        if (headLen == 0 || !httpExchange(client, slices, 4, x, response) ||
+            response.status != 200 || !response.keepAlive) {
+            counting = false;
+            TEST_FAIL_MESSAGE("upload failed");
+        }
+        expectedBytes += preambleLen + jpegLen + trailerLen;
+    }
+    counting = false;
+
+    char msg[96];
+    snprintf(msg, sizeof(msg), "%u uploads, %.1f MB, %lu allocations",
+             rounds, expectedBytes / 1048576.0, allocations);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_EQUAL(0, allocations);
+    TEST_ASSERT_EQUAL(rounds, server->requests);
+    TEST_ASSERT_EQUAL(expectedBytes, server->bodyBytes);
+}
+
+void test_soak_heartbeats_with_the_cam_allocate_nothing(void) {
+    fakeNvsErase();
+    WiFi.fakeReset();
+    WiFi.aps = { { WIFI_SSID, { 0x10, 0x20, 0x30, 0x40, 0x50, 0x60 }, 6, -58 } };
+    BackendClient* client = new BackendClient("http://backend.example:8080/", API_KEY);
+    client->begin();
+    for (int i = 0; i < 200 && !client->isConnected(); i++) {
+        client->pollWiFi();
+        if (WiFi.beginCount > 0 && WiFi.state != WL_CONNECTED) {
+            WiFi.fakeJoin(0x2A01A8C0);
+        }
+        fakeAdvance(WIFI_ATTEMPT_POLL_MS);
+    }
+    TEST_ASSERT_TRUE(client->isConnected());
+
+    GSMHealth health = { 18, 1, "Operator", 1, 1, 1 };
+    CamHeartbeat cam;
+    memset(&cam, 0, sizeof(cam));
+    cam.report.ip = 0x3701A8C0;
+    strncpy(cam.report.firmware, "v1.4", sizeof(cam.report.firmware));
+    cam.report.uptimeS = 86400;
+    cam.report.rssi = -61;
+    const uint8_t camMac[6] = { 0x24, 0x6F, 0x28, 0xAA, 0xBB, 0xCC };
+    memcpy(cam.mac, camMac, sizeof(cam.mac));
+
+    const unsigned rounds = 2000;
+    allocations = 0;
+    counting = true;
+    for (unsigned i = 0; i < rounds; i++) {
+        cam.ageMs = i * 1000;
+        cam.report.queueDepth = i % 5;
+        if (!client->sendHeartbeat("ESP32_MAIN", "online", "192.168.1.42", "v2.0",
+                                   &health, &cam)) {
+            counting = false;
+            TEST_FAIL_MESSAGE("heartbeat failed");
+        }
+    }
+    counting = false;
+
+    char msg[96];
+    snprintf(msg, sizeof(msg), "%u heartbeats with the cam attached, %lu allocations",
+             rounds, allocations);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_EQUAL(0, allocations);
+    TEST_ASSERT_EQUAL(rounds, server->requests);
+    delete client;
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_allocation_counter_sees_string_building);
+    RUN_TEST(test_soak_backend_posts_allocate_nothing);
+    RUN_TEST(test_soak_multipart_uploads_allocate_nothing);
+    RUN_TEST(test_soak_heartbeats_with_the_cam_allocate_nothing);
+    return UNITY_END();
+}
@@ -0,0 +1,268 @@
+/**
+ * Image relay receiver
+ * The test plays the cam: offers and fragments go in through CamLink's
+ * ESP-NOW receive callback, lost, reordered and repeated at will, and
+ * the requests, acks and results come back out of esp_now_send.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include <algorithm>
+#include "config.h"
+#include "cam_link.h"
+#include "relay_receiver.h"
+#include "espnow_protocol.h"
+
+static const uint8_t CAM_MAC[6] = { 0x24, 0x6F, 0x28, 0xCA, 0x00, 0x01 };
+
+static uint16_t camSeq;
+static std::vector<uint8_t> image;
+
+static void deliver(EspNowFrameType type, uint32_t incident, const void* payload, uint8_t len) {
+    uint8_t frame[ESPNOW_FRAME_MAX];
+    size_t n = espnowEncode(frame, sizeof(frame), type, camSeq++, incident,
+                            (const uint8_t*)payload, len);
+    TEST_ASSERT_GREATER_THAN(0, n);
+    fakeEspNowDeliver(CAM_MAC, frame, n);
+}
+
+static void offer(uint32_t incident, uint32_t fullBytes, uint16_t thumbBytes) {
+    RelayOffer o = { fullBytes, thumbBytes };
+    deliver(FRAME_RELAY_OFFER, incident, &o, sizeof(o));
+}
+
+static uint16_t fragments(uint32_t total) {
+    return (total + RELAY_FRAGMENT_DATA - 1) / RELAY_FRAGMENT_DATA;
+}
+
+static void fragment(uint32_t incident, uint16_t index, uint32_t total = 0) {
+    if (total == 0) total = image.size();
+    uint8_t payload[ESPNOW_PAYLOAD_MAX];
+    FragmentHeader h = { index, fragments(total), total };
+    uint32_t offset = (uint32_t)index * RELAY_FRAGMENT_DATA;
+    uint32_t n = std::min<uint32_t>(RELAY_FRAGMENT_DATA, total - offset);
+    memcpy(payload, &h, sizeof(h));
+    memcpy(payload + sizeof(h), image.data() + offset, n);
+    deliver(FRAME_FRAGMENT, incident, payload, sizeof(h) + n);
+}
+
+struct Sent {
+    EspNowHeader header;
+    std::vector<uint8_t> payload;
+};
+
+// Frames sent to the cam since the last call
+static std::vector<Sent> sent(EspNowFrameType type) {
+    std::vector<Sent> out;
+    for (const FakeEspNowFrame& f : fakeEspNowSent) {
+        EspNowHeader h;
+        const uint8_t* p;
+        TEST_ASSERT_TRUE(espnowDecode(f.data.data(), f.data.size(), h, &p));
+        if (h.type == type) out.push_back({ h, std::vector<uint8_t>(p, p + h.payloadLen) });
+    }
+    fakeEspNowSent.clear();
+    return out;
+}
+
+static FragmentAck lastAck() {
+    std::vector<Sent> acks = sent(FRAME_FRAGMENT_ACK);
+    TEST_ASSERT_GREATER_THAN(0, acks.size());
+    FragmentAck ack;
+    memcpy(&ack, acks.back().payload.data(), sizeof(ack));
+    return ack;
+}
+
+static void makeImage(uint32_t len) {
+    image.resize(len);
+    for (uint32_t i = 0; i < len; i++) image[i] = (uint8_t)(i * 13 + (i >> 9));
+}
+
+static void requestFull(uint32_t incident) {
+    offer(incident, image.size(), 2000);
+    relayReceiver.poll(true);
+    std::vector<Sent> req = sent(FRAME_RELAY_REQUEST);
+    TEST_ASSERT_EQUAL(1, req.size());
+    TEST_ASSERT_EQUAL_UINT32(incident, req[0].header.incidentId);
+    TEST_ASSERT_EQUAL(RELAY_FULL, req[0].payload[0]);
+}
+
+void setUp(void) {
+    fakeEspNowReset();
+    TEST_ASSERT_TRUE(camLink.begin(CAM_MAC));
+    // The receiver is a global: leave it idle whatever the last test did.
+    // The clock keeps running so its stall timer sees the gap.
+    relayReceiver.finish(false);
+    fakeAdvance(RELAY_STALL_MS + 1);
+    relayReceiver.poll(false);
+    fakeEspNowSent.clear();
+}
+
+void tearDown(void) {}
+
+void test_offer_waits_for_a_transport(void) {
+    makeImage(5000);
+    offer(0xA001, 5000, 0);
+    relayReceiver.poll(false);
+    TEST_ASSERT_EQUAL(0, sent(FRAME_RELAY_REQUEST).size());
+    TEST_ASSERT_FALSE(relayReceiver.isReceiving());
+
+    // The offer was consumed; the cam offers again later
+    relayReceiver.poll(true);
+    TEST_ASSERT_EQUAL(0, sent(FRAME_RELAY_REQUEST).size());
+    offer(0xA001, 5000, 0);
+    relayReceiver.poll(true);
+    TEST_ASSERT_EQUAL(1, sent(FRAME_RELAY_REQUEST).size());
+    TEST_ASSERT_TRUE(relayReceiver.isReceiving());
+}
+
+void test_oversized_image_asks_for_the_thumbnail(void) {
+    offer(0xA002, RELAY_MAX_BYTES + 1, 3000);
+    relayReceiver.poll(true);
+    std::vector<Sent> req = sent(FRAME_RELAY_REQUEST);
+    TEST_ASSERT_EQUAL(1, req.size());
+    TEST_ASSERT_EQUAL(RELAY_THUMB, req[0].payload[0]);
+}
+
+void test_selective_acks_through_loss_and_reordering(void) {
+    makeImage(20 * RELAY_FRAGMENT_DATA + 17);
+    uint16_t count = fragments(image.size());
+    requestFull(0xB001);
+
+    // 0, 1, 3, 4 arrive; 2 is lost
+    fragment(0xB001, 0);
+    fragment(0xB001, 1);
+    fragment(0xB001, 3);
+    fragment(0xB001, 4);
+    FragmentAck ack = lastAck();
+    TEST_ASSERT_EQUAL(2, ack.base);
+    TEST_ASSERT_EQUAL_HEX32(0x3, ack.mask);  // 3 and 4
+
+    // Resent 3 (our ack was lost) is a duplicate, still acked
+    fragment(0xB001, 3);
+    TEST_ASSERT_EQUAL(2, lastAck().base);
+    TEST_ASSERT_EQUAL(1, relayReceiver.getStats().lastDuplicates);
+
+    fragment(0xB001, 2);
+    TEST_ASSERT_EQUAL(5, lastAck().base);
+
+    // The rest backwards
+    for (int i = count - 1; i >= 5; i--) fragment(0xB001, i);
+    ack = lastAck();
+    TEST_ASSERT_EQUAL(count, ack.base);
+    TEST_ASSERT_EQUAL_HEX32(0, ack.mask);
+
+    uint32_t incident;
+    uint8_t kind;
+    const uint8_t* data;
+    size_t len;
+    TEST_ASSERT_TRUE(relayReceiver.getImage(incident, kind, data, len));
+    TEST_ASSERT_EQUAL_UINT32(0xB001, incident);
+    TEST_ASSERT_EQUAL(RELAY_FULL, kind);
+    TEST_ASSERT_EQUAL(image.size(), len);
+    TEST_ASSERT_EQUAL_MEMORY(image.data(), data, len);
+
+    // The cam missed the final ack: any fragment gets it again
+    fragment(0xB001, 7);
+    TEST_ASSERT_EQUAL(count, lastAck().base);
+
+    relayReceiver.finish(true);
+    std::vector<Sent> result = sent(FRAME_RELAY_RESULT);
+    TEST_ASSERT_EQUAL(1, result.size());
+    TEST_ASSERT_EQUAL(1, result[0].payload[0]);
+    TEST_ASSERT_FALSE(relayReceiver.getImage(incident, kind, data, len));
+
+    // Still full-acked after the buffer is gone
+    fragment(0xB001, count - 1);
+    TEST_ASSERT_EQUAL(count, lastAck().base);
+}
+
+void test_mismatched_fragments_are_ignored(void) {
+    makeImage(3000);
+    requestFull(0xC001);
+    fragment(0xC002, 0);  // Another incident
+    uint8_t payload[ESPNOW_PAYLOAD_MAX] = { 0 };
+    FragmentHeader h = { 0, fragments(3000), 3000 };
+    memcpy(payload, &h, sizeof(h));
+    deliver(FRAME_FRAGMENT, 0xC001, payload, sizeof(h) + 10);  // Short
+    TEST_ASSERT_EQUAL(0, sent(FRAME_FRAGMENT_ACK).size());
+}
+
+// Review regression: fragments of a transfer abandoned here must not be
+// full-acked, or the cam drops an image nobody forwarded
+void test_abandoned_transfer_gets_no_ack(void) {
+    makeImage(4000);
+    requestFull(0xD001);
+    fragment(0xD001, 0);
+    sent(FRAME_FRAGMENT_ACK);
+
+    uint32_t abandoned = relayReceiver.getStats().abandoned;
+    fakeAdvance(RELAY_STALL_MS + 1);
+    relayReceiver.poll(true);
+    TEST_ASSERT_FALSE(relayReceiver.isReceiving());
+    TEST_ASSERT_EQUAL(abandoned + 1, relayReceiver.getStats().abandoned);
+
+    for (uint16_t i = 0; i < fragments(image.size()); i++) fragment(0xD001, i);
+    TEST_ASSERT_EQUAL(0, sent(FRAME_FRAGMENT_ACK).size());
+}
+
+void test_simulated_lossy_transfer(void) {
+    // 60 KB over a channel that loses 15% of fragments and 15% of acks;
+    // the cam side resends what the acks do not cover
+    makeImage(60000);
+    uint16_t count = fragments(image.size());
+    requestFull(0xE001);
+
+    uint32_t rng = 12345;
+    auto lost = [&rng]() {
+        rng = rng * 1103515245u + 12345u;
+        return (rng >> 16) % 100 < 15;
+    };
+
+    std::vector<bool> acked(count, false);
+    uint16_t base = 0;
+    unsigned sends = 0;
+    while (base < count) {
+        // One window of unacked fragments, then read the ack
+        for (uint16_t i = base, n = 0; i < count && n < RELAY_WINDOW; i++) {
+            if (acked[i]) continue;
+            n++;
+            sends++;
+            if (!lost()) fragment(0xE001, i);
+            fakeAdvance(3);
+        }
+        std::vector<Sent> acks = sent(FRAME_FRAGMENT_ACK);
+        if (acks.empty() || lost()) continue;
+        FragmentAck ack;
+        memcpy(&ack, acks.back().payload.data(), sizeof(ack));
+        for (uint16_t i = 0; i < ack.base; i++) acked[i] = true;
+        for (int b = 0; b < 32; b++) {
+            if ((ack.mask >> b) & 1) acked[ack.base + 1 + b] = true;
+        }
+        base = ack.base;
+    }
+
+    uint32_t incident;
+    uint8_t kind;
+    const uint8_t* data;
+    size_t len;
+    TEST_ASSERT_TRUE(relayReceiver.getImage(incident, kind, data, len));
+    TEST_ASSERT_EQUAL_MEMORY(image.data(), data, image.size());
+
+    RelayStats st = relayReceiver.getStats();
+    char msg[128];
+    snprintf(msg, sizeof(msg), "%u fragments, %u sends (%.0f%% overhead), %lu duplicates",
+             count, sends, 100.0 * (sends - count) / count, (unsigned long)st.lastDuplicates);
+    TEST_MESSAGE(msg);
+    relayReceiver.finish(true);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_offer_waits_for_a_transport);
+    RUN_TEST(test_oversized_image_asks_for_the_thumbnail);
+    RUN_TEST(test_selective_acks_through_loss_and_reordering);
+    RUN_TEST(test_mismatched_fragments_are_ignored);
+    RUN_TEST(test_abandoned_transfer_gets_no_ack);
+    RUN_TEST(test_simulated_lossy_transfer);
+    return UNITY_END();
+}
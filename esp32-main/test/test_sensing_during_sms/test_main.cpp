@@ -0,0 +1,170 @@
+/**
+ * Sensing keeps running while the GSM task is in a long SMS transaction
+ *
+ * The sensing and GSM tasks are stepped in simulated time at their own
+ * periods (SENSING_PERIOD_MS, GSM_POLL_INTERVAL_MS), as on two cores.
+ * A GSM step that blocked would show up as time spent inside poll() and
+ * as a gap in the PIR samples.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include "config.h"
+#include "gsm_handler.h"
+#include "pir_detector.h"
+#include "modem_emulator.h"
+
+static const unsigned long COOLDOWN_MS = 10000;  // DETECTION_COOLDOWN in system_tasks.cpp
+
+struct Detection {
+    unsigned long at;
+    bool left, middle, right;
+};
+
+struct Rig {
+    ModemEmulator modem;
+    GSMHandler gsm;
+    PIRDetector pir;
+
+    unsigned long nextSenseAt = 0;
+    unsigned long nextGsmAt = 0;
+    unsigned long lastSenseAt = 0;
+    unsigned long maxSenseGapMs = 0;
+    unsigned long maxPollMs = 0;
+    unsigned long samples = 0;
+    std::vector<Detection> detections;
+
+    bool smsDone = false;
+    bool smsOk = false;
+    unsigned long smsDoneAt = 0;
+
+    Rig() : gsm(&modem), pir(PIR_LEFT_PIN, PIR_MIDDLE_PIN, PIR_RIGHT_PIN) {}
+
+    static void onSms(bool success, void* ctx) {
+        Rig* self = (Rig*)ctx;
+        self->smsDone = true;
+        self->smsOk = success;
+        self->smsDoneAt = millis();
+    }
+
+    // One sensing task period, as in sensingTask() (cooldown included)
+    void sense() {
+        unsigned long now = millis();
+        if (lastSenseAt && now - lastSenseAt > maxSenseGapMs) {
+            maxSenseGapMs = now - lastSenseAt;
+        }
+        lastSenseAt = now;
+        samples++;
+        pir.update();
+        HumanDetectionResult r = pir.detectHuman();
+        if (r.detected && (detections.empty() || now - detections.back().at >= COOLDOWN_MS)) {
+            detections.push_back({ now, r.pir_left, r.pir_middle, r.pir_right });
+        }
+    }
+
+    // One GSM task period, as in gsmTask()
+    void gsmStep() {
+        unsigned long before = millis();
+        gsm.poll();
+        gsm.pollHealth();
+        if (millis() - before > maxPollMs) {
+            maxPollMs = millis() - before;
+        }
+    }
+
+    void run(unsigned long ms, unsigned long stimulusBase = 0) {
+        unsigned long end = millis() + ms;
+        while ((long)(millis() - end) < 0) {
+            unsigned long now = millis();
+            if (stimulusBase) {
+                stimulus(now - stimulusBase);
+            }
+            if ((long)(now - nextSenseAt) >= 0) {
+                nextSenseAt = now + SENSING_PERIOD_MS;
+                sense();
+            }
+            if ((long)(millis() - nextGsmAt) >= 0) {
+                nextGsmAt = millis() + GSM_POLL_INTERVAL_MS;
+                gsmStep();
+            }
+            fakeAdvance(1);
+        }
+    }
+
+    // Two intrusions while the SMS is in flight: left+middle at 5 s,
+    // middle+right at 20 s, each held for 400 ms
+    static void stimulus(unsigned long t) {
+        bool first = t >= 5000 && t < 5400;
+        bool second = t >= 20000 && t < 20400;
+        digitalWrite(PIR_LEFT_PIN, first ? HIGH : LOW);
+        digitalWrite(PIR_MIDDLE_PIN, first || second ? HIGH : LOW);
+        digitalWrite(PIR_RIGHT_PIN, second ? HIGH : LOW);
+    }
+};
+
+void setUp(void) {
+    fakeResetClock();
+    digitalWrite(PIR_LEFT_PIN, LOW);
+    digitalWrite(PIR_MIDDLE_PIN, LOW);
+    digitalWrite(PIR_RIGHT_PIN, LOW);
+}
+
+void tearDown(void) {}
+
+void test_pir_detections_during_30s_sms(void) {
+    Rig rig;
+    rig.modem.cmgsDelayMs = 30000;
+    TEST_ASSERT_TRUE(rig.gsm.begin());
+    rig.pir.begin();
+    rig.run(1000);  // Settle; health refresh goes out
+
+    unsigned long start = millis();
+    TEST_ASSERT_TRUE(rig.gsm.sendSMSAsync("+15550100", "INTRUDER ALERT", Rig::onSms, &rig, true));
+    rig.run(35000, start);
+
+    TEST_ASSERT_TRUE(rig.smsDone);
+    TEST_ASSERT_TRUE(rig.smsOk);
+    TEST_ASSERT_GREATER_OR_EQUAL(30000, rig.smsDoneAt - start);
+    TEST_ASSERT_EQUAL_STRING("INTRUDER ALERT", rig.modem.payloads.back().c_str());
+
+    // Both intrusions seen while the SMS was still waiting for +CMGS
+    TEST_ASSERT_EQUAL(2, rig.detections.size());
+    TEST_ASSERT_LESS_OR_EQUAL(start + 5000 + 2 * SENSING_PERIOD_MS, rig.detections[0].at);
+    TEST_ASSERT_TRUE(rig.detections[0].left && rig.detections[0].middle);
+    TEST_ASSERT_LESS_OR_EQUAL(start + 20000 + 2 * SENSING_PERIOD_MS, rig.detections[1].at);
+    TEST_ASSERT_TRUE(rig.detections[1].middle && rig.detections[1].right);
+    TEST_ASSERT_LESS_THAN(rig.smsDoneAt, rig.detections[1].at);
+
+    // No GSM step took any time, and PIR sampling never skipped a period
+    TEST_ASSERT_EQUAL(0, rig.maxPollMs);
+    TEST_ASSERT_LESS_OR_EQUAL(SENSING_PERIOD_MS, rig.maxSenseGapMs);
+}
+
+void test_sensing_continues_while_modem_never_answers(void) {
+    Rig rig;
+    TEST_ASSERT_TRUE(rig.gsm.begin());
+    rig.pir.begin();
+    // The network never confirms the submit: the engine times the SMS out
+    rig.modem.cmgsDelayMs = 10UL * 60 * 1000;
+    rig.run(1000);
+
+    unsigned long start = millis();
+    TEST_ASSERT_TRUE(rig.gsm.sendSMSAsync("+15550100", "INTRUDER ALERT", Rig::onSms, &rig, true));
+    unsigned long samplesBefore = rig.samples;
+    rig.run(65000, start);
+
+    TEST_ASSERT_TRUE(rig.smsDone);
+    TEST_ASSERT_FALSE(rig.smsOk);
+    TEST_ASSERT_FALSE(rig.gsm.isSMSInFlight());
+    TEST_ASSERT_EQUAL(2, rig.detections.size());
+    TEST_ASSERT_GREATER_OR_EQUAL(65000 / SENSING_PERIOD_MS - 1, rig.samples - samplesBefore);
+    TEST_ASSERT_EQUAL(0, rig.maxPollMs);
+    TEST_ASSERT_LESS_OR_EQUAL(SENSING_PERIOD_MS, rig.maxSenseGapMs);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_pir_detections_during_30s_sms);
+    RUN_TEST(test_sensing_continues_while_modem_never_answers);
+    return UNITY_END();
+}
@@ -0,0 +1,384 @@
+/**
+ * WiFi connector against a scripted radio
+ * The fake station's events are driven like the real ones: an access
+ * point in range answers begin() after ASSOC_MS (plus DHCP_MS without a
+ * static address), one out of range or with the wrong password refuses
+ * it after REFUSE_MS, a scan takes SCAN_MS and DHCP renews a lease
+ * DHCP_MS after it is asked. The owner polls on msUntilPoll(); every
+ * poll() is checked not to advance the clock. Directed reconnect and
+ * scan round times are reported.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include <set>
+#include "wifi_connector.h"
+
+static const unsigned long ASSOC_MS = 250;
+static const unsigned long DHCP_MS = 700;
+static const unsigned long REFUSE_MS = 400;
+static const unsigned long SCAN_MS = 1560;  // 13 channels at the connector's 120 ms dwell
+static const unsigned long STEP_MS = 10;
+
+static const uint32_t LEASE_IP = 0x2A01A8C0;   // 192.168.1.42
+static const uint32_t OTHER_IP = 0x3701A8C0;   // 192.168.1.55
+
+static const WiFiNetwork NETWORKS[] = { { "home", "secret1" }, { "office", "secret2" } };
+static const WiFiConnectConfig CONFIG = { 3000, 10000, 60000, 5000, 300000 };
+
+static const FakeAccessPoint HOME = { "home", { 0x10, 0x20, 0x30, 0x40, 0x50, 0x01 }, 1, -70 };
+static const FakeAccessPoint OFFICE = { "office", { 0x10, 0x20, 0x30, 0x40, 0x50, 0x02 }, 11, -50 };
+static const FakeAccessPoint NEIGHBOUR = { "neighbour", { 0x10, 0x20, 0x30, 0x40, 0x50, 0x03 }, 6, -30 };
+
+// Access points and DHCP answering the station
+struct Radio {
+    std::set<std::string> silent;    // In range but never answer
+    std::set<std::string> refusing;  // In range but turn the station away (bad password)
+    bool dhcpAnswers = true;
+    uint32_t leaseIp = LEASE_IP;
+
+    unsigned seenBegin = 0;
+    unsigned seenDisconnect = 0;
+    unsigned seenConfig = 0;
+    unsigned long answerAt = 0;
+    bool answerPending = false;
+    bool joins = false;
+    uint8_t refuseReason = 0;
+    unsigned long leaseAt = 0;
+    bool leasePending = false;
+
+    void reset() {
+        seenBegin = WiFi.beginCount;
+        seenDisconnect = WiFi.disconnectCount;
+        seenConfig = WiFi.configCount;
+        answerPending = leasePending = false;
+    }
+
+    bool inRange(const std::string& ssid) const {
+        for (const FakeAccessPoint& a : WiFi.aps) {
+            if (ssid == a.ssid) return true;
+        }
+        return false;
+    }
+
+    void step() {
+        unsigned long now = millis();
+        if (WiFi.disconnectCount != seenDisconnect) {
+            seenDisconnect = WiFi.disconnectCount;
+            answerPending = leasePending = false;  // Attempt abandoned
+        }
+        if (WiFi.beginCount != seenBegin) {
+            seenBegin = WiFi.beginCount;
+            leasePending = false;
+            if (!silent.count(WiFi.beginSsid)) {
+                joins = inRange(WiFi.beginSsid) && !refusing.count(WiFi.beginSsid);
+                refuseReason = inRange(WiFi.beginSsid) ? 15 : 201;  // Bad password, no AP found
+                answerPending = true;
+                answerAt = now + (joins ? ASSOC_MS + (WiFi.staticIp ? 0 : DHCP_MS) : REFUSE_MS);
+            } else {
+                answerPending = false;
+            }
+        }
+        // Back to DHCP while associated: a lease renewal
+        if (WiFi.configCount != seenConfig) {
+            seenConfig = WiFi.configCount;
+            if (WiFi.state == WL_CONNECTED && WiFi.staticIp == 0 && dhcpAnswers) {
+                leasePending = true;
+                leaseAt = now + DHCP_MS;
+            }
+        }
+        if (answerPending && (long)(now - answerAt) >= 0) {
+            answerPending = false;
+            if (joins) {
+                WiFi.fakeJoin(leaseIp);
+            } else {
+                WiFi.fakeRefuse(refuseReason);
+            }
+        }
+        if (leasePending && (long)(now - leaseAt) >= 0) {
+            leasePending = false;
+            WiFi.fakeLease(leaseIp);
+        }
+    }
+};
+
+static Radio radio;
+static WiFiConnector* conn;
+static unsigned long nextPollAt;
+
+static void boot() {
+    delete conn;
+    std::vector<FakeAccessPoint> aps = WiFi.aps;
+    WiFi.fakeReset();
+    WiFi.aps = aps;
+    WiFi.scanPolls = SCAN_MS / WIFI_ATTEMPT_POLL_MS;
+    radio.reset();
+    conn = new WiFiConnector(NETWORKS, 2, CONFIG);
+    conn->begin();
+    nextPollAt = millis();
+}
+
+static WiFiLinkChange pollNow() {
+    unsigned long before = millis();
+    WiFiLinkChange change = conn->poll();
+    TEST_ASSERT_EQUAL_MESSAGE(before, millis(), "poll() blocked");
+    unsigned long wait = conn->msUntilPoll();
+    nextPollAt = millis() + (wait < WIFI_SNAPSHOT_MS ? wait : WIFI_SNAPSHOT_MS);
+    return change;
+}
+
+// The owner's loop for up to ms; stops at the first link change
+static WiFiLinkChange run(unsigned long ms) {
+    unsigned long end = millis() + ms;
+    while ((long)(millis() - end) < 0) {
+        radio.step();
+        if ((long)(millis() - nextPollAt) >= 0) {
+            WiFiLinkChange change = pollNow();
+            if (change != WIFI_NO_CHANGE) return change;
+        }
+        fakeAdvance(STEP_MS);
+    }
+    return WIFI_NO_CHANGE;
+}
+
+static void assertUpOn(const FakeAccessPoint& ap, uint32_t ip) {
+    WiFiLinkSnapshot s = conn->snapshot();
+    TEST_ASSERT_TRUE(conn->isUp());
+    TEST_ASSERT_EQUAL(WIFI_UP, s.state);
+    TEST_ASSERT_EQUAL(ap.channel, s.channel);
+    TEST_ASSERT_EQUAL(ap.rssi, s.rssi);
+    TEST_ASSERT_EQUAL_UINT32(ip, s.ip);
+}
+
+// First boot on an empty cache: scan, join, cached
+static void firstConnect() {
+    TEST_ASSERT_EQUAL(WIFI_LINK_UP, run(20000));
+    TEST_ASSERT_EQUAL(1, WiFi.scanCount);
+}
+
+void setUp(void) {
+    fakeResetClock();
+    fakeNvsErase();
+    WiFi.aps = { NEIGHBOUR, HOME, OFFICE };
+    radio = Radio();
+    conn = nullptr;
+    boot();
+}
+
+void tearDown(void) {
+    delete conn;
+    conn = nullptr;
+}
+
+void test_first_boot_scans_and_joins_the_strongest_configured_network(void) {
+    firstConnect();
+    // The neighbour is stronger but not configured
+    TEST_ASSERT_EQUAL_STRING("office", WiFi.beginSsid.c_str());
+    TEST_ASSERT_EQUAL(OFFICE.channel, WiFi.beginChannel);
+    TEST_ASSERT_TRUE(WiFi.beginDirected);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(OFFICE.bssid, WiFi.beginBssid, 6);
+    TEST_ASSERT_EQUAL_UINT32(0, WiFi.staticIp);  // DHCP
+    assertUpOn(OFFICE, LEASE_IP);
+}
+
+void test_reboot_goes_straight_to_the_cached_access_point(void) {
+    firstConnect();
+    unsigned long writes = fakeNvsWrites;
+    boot();
+    unsigned long start = millis();
+    TEST_ASSERT_EQUAL(WIFI_LINK_UP, run(20000));
+    TEST_ASSERT_EQUAL(0, WiFi.scanCount);
+    TEST_ASSERT_EQUAL(1, WiFi.beginCount);
+    TEST_ASSERT_EQUAL_STRING("office", WiFi.beginSsid.c_str());
+    TEST_ASSERT_EQUAL(OFFICE.channel, WiFi.beginChannel);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(OFFICE.bssid, WiFi.beginBssid, 6);
+    // An address from before the reboot may have been handed out since
+    TEST_ASSERT_EQUAL_UINT32(0, WiFi.staticIp);
+    TEST_ASSERT_LESS_THAN(ASSOC_MS + DHCP_MS + 2 * WIFI_ATTEMPT_POLL_MS, millis() - start);
+    TEST_ASSERT_EQUAL(writes, fakeNvsWrites);  // Same AP and lease: flash untouched
+    assertUpOn(OFFICE, LEASE_IP);
+}
+
+void test_drop_reconnects_at_once_on_the_cached_ip_and_renews_the_lease(void) {
+    firstConnect();
+    run(20000);  // Settle
+
+    WiFi.fakeDrop(200);  // Beacon timeout
+    // Other tasks see the loss before the owner polls
+    TEST_ASSERT_FALSE(conn->snapshot().up);
+    TEST_ASSERT_EQUAL(0, conn->snapshot().ip);
+    unsigned begins = WiFi.beginCount;
+    TEST_ASSERT_EQUAL(WIFI_LINK_DOWN, pollNow());
+    TEST_ASSERT_EQUAL(begins + 1, WiFi.beginCount);  // No backoff after a drop
+    TEST_ASSERT_EQUAL(WIFI_CONNECTING, conn->snapshot().state);
+    TEST_ASSERT_EQUAL_UINT32(LEASE_IP, WiFi.staticIp);
+    TEST_ASSERT_EQUAL(1, conn->snapshot().drops);
+
+    unsigned long start = millis();
+    TEST_ASSERT_EQUAL(WIFI_LINK_UP, run(20000));
+    TEST_ASSERT_LESS_THAN(ASSOC_MS + 2 * WIFI_ATTEMPT_POLL_MS, millis() - start);  // No DHCP wait
+    TEST_ASSERT_EQUAL(1, WiFi.scanCount);
+    assertUpOn(OFFICE, LEASE_IP);
+
+    // DHCP restarts behind the link and the lease comes back different
+    TEST_ASSERT_EQUAL_UINT32(0, WiFi.staticIp);
+    radio.leaseIp = OTHER_IP;
+    WiFi.fakeLease(OTHER_IP);
+    TEST_ASSERT_EQUAL(WIFI_NO_CHANGE, pollNow());
+    assertUpOn(OFFICE, OTHER_IP);
+
+    // The next drop reuses the renewed address
+    WiFi.fakeDrop(200);
+    TEST_ASSERT_EQUAL(WIFI_LINK_DOWN, pollNow());
+    TEST_ASSERT_EQUAL_UINT32(OTHER_IP, WiFi.staticIp);
+}
+
+void test_cached_ip_without_a_lease_is_given_up(void) {
+    firstConnect();
+    unsigned long leasedAt = millis();
+    run(20000);
+    WiFi.fakeDrop(200);
+    radio.dhcpAnswers = false;
+    TEST_ASSERT_EQUAL(WIFI_LINK_DOWN, run(1000));
+    TEST_ASSERT_EQUAL(WIFI_LINK_UP, run(1000));
+    TEST_ASSERT_EQUAL_UINT32(0, WiFi.staticIp);  // Renewal asked for
+
+    // Up on the cached address until reuseIpMs after the last lease
+    unsigned disconnects = WiFi.disconnectCount;
+    TEST_ASSERT_EQUAL(WIFI_LINK_DOWN, run(CONFIG.reuseIpMs));
+    TEST_ASSERT_GREATER_OR_EQUAL(CONFIG.reuseIpMs, millis() - leasedAt);
+    TEST_ASSERT_LESS_THAN(CONFIG.reuseIpMs + WIFI_SNAPSHOT_MS + STEP_MS, millis() - leasedAt);
+    TEST_ASSERT_EQUAL(disconnects + 1, WiFi.disconnectCount);
+
+    // Rejoined with DHCP
+    TEST_ASSERT_EQUAL_UINT32(0, WiFi.staticIp);
+    radio.dhcpAnswers = true;
+    TEST_ASSERT_EQUAL(WIFI_LINK_UP, run(5000));
+    assertUpOn(OFFICE, LEASE_IP);
+}
+
+void test_stale_cached_ip_is_not_reused(void) {
+    firstConnect();
+    run(CONFIG.reuseIpMs + 1000);  // No renewal: the lease was DHCP's own
+    WiFi.fakeDrop(200);
+    TEST_ASSERT_EQUAL(WIFI_LINK_DOWN, pollNow());
+    TEST_ASSERT_TRUE(WiFi.beginDirected);
+    TEST_ASSERT_EQUAL_UINT32(0, WiFi.staticIp);
+}
+
+void test_silent_cached_access_point_falls_back_to_a_scan(void) {
+    firstConnect();
+    boot();
+    radio.silent.insert("office");
+    unsigned long start = millis();
+    run(CONFIG.fastTimeoutMs - 100);
+    TEST_ASSERT_EQUAL(0, WiFi.scanCount);  // Still waiting on the directed attempt
+    TEST_ASSERT_EQUAL(WIFI_CONNECTING, conn->snapshot().state);
+
+    // Timed out, scanned, office still silent, then home
+    TEST_ASSERT_EQUAL(WIFI_LINK_UP, run(30000));
+    TEST_ASSERT_EQUAL(1, WiFi.scanCount);
+    TEST_ASSERT_EQUAL_STRING("home", WiFi.beginSsid.c_str());
+    TEST_ASSERT_GREATER_OR_EQUAL(CONFIG.fastTimeoutMs + SCAN_MS + CONFIG.scanTimeoutMs,
+                                 millis() - start);
+    assertUpOn(HOME, LEASE_IP);
+
+    // Home is cached now
+    boot();
+    TEST_ASSERT_EQUAL(WIFI_LINK_UP, run(5000));
+    TEST_ASSERT_EQUAL(0, WiFi.scanCount);
+    TEST_ASSERT_EQUAL_STRING("home", WiFi.beginSsid.c_str());
+}
+
+void test_refusals_move_to_the_next_network_then_back_off(void) {
+    radio.refusing = { "office", "home" };
+    WiFi.scanPolls = 0;
+    // Refusals end attempts early, well inside scanTimeoutMs
+    TEST_ASSERT_EQUAL(WIFI_NO_CHANGE, run(2 * REFUSE_MS + 4 * WIFI_ATTEMPT_POLL_MS));
+    TEST_ASSERT_EQUAL(WIFI_BACKOFF, conn->snapshot().state);
+    TEST_ASSERT_EQUAL(1, WiFi.scanCount);
+    TEST_ASSERT_EQUAL(2, WiFi.beginCount);  // office, then home, each refused once
+    TEST_ASSERT_EQUAL_STRING("home", WiFi.beginSsid.c_str());
+
+    // Backoff: jittered into the upper half of the base wait, then doubled
+    unsigned long wait = conn->msUntilPoll();
+    TEST_ASSERT_GREATER_OR_EQUAL(CONFIG.retryBaseMs / 2, wait);
+    TEST_ASSERT_LESS_OR_EQUAL(CONFIG.retryBaseMs, wait);
+    fakeAdvance(wait - 1);
+    TEST_ASSERT_EQUAL(WIFI_NO_CHANGE, pollNow());
+    TEST_ASSERT_EQUAL(1, WiFi.scanCount);
+    WiFi.aps = { NEIGHBOUR };  // Nothing configured in range now
+    fakeAdvance(1);
+    TEST_ASSERT_EQUAL(WIFI_NO_CHANGE, pollNow());
+    TEST_ASSERT_EQUAL(2, WiFi.scanCount);
+    TEST_ASSERT_EQUAL(WIFI_NO_CHANGE, run(4 * WIFI_ATTEMPT_POLL_MS));
+    TEST_ASSERT_EQUAL(WIFI_BACKOFF, conn->snapshot().state);
+    TEST_ASSERT_EQUAL(2, WiFi.beginCount);
+    TEST_ASSERT_GREATER_OR_EQUAL(CONFIG.retryBaseMs, conn->msUntilPoll());
+
+    // Home comes back with the right password: the next round connects
+    WiFi.aps = { HOME };
+    radio.refusing.clear();
+    TEST_ASSERT_EQUAL(WIFI_LINK_UP, run(CONFIG.retryBaseMs * 2 + 5000));
+    assertUpOn(HOME, LEASE_IP);
+}
+
+void test_scan_that_cannot_start_backs_off(void) {
+    WiFi.scanFails = true;
+    TEST_ASSERT_FALSE(conn->connect());  // Setup's blocking round ends
+    TEST_ASSERT_EQUAL(WIFI_BACKOFF, conn->snapshot().state);
+    TEST_ASSERT_EQUAL(0, WiFi.beginCount);
+    TEST_ASSERT_GREATER_THAN(0, conn->msUntilPoll());
+
+    WiFi.scanFails = false;
+    TEST_ASSERT_EQUAL(WIFI_LINK_UP, run(CONFIG.retryBaseMs + 5000));
+    assertUpOn(OFFICE, LEASE_IP);
+}
+
+void test_benchmark_directed_reconnect_against_a_scan(void) {
+    firstConnect();
+    const int rounds = 20;
+    unsigned long directedMs = 0;
+    unsigned long scanMs = 0;
+    for (int i = 0; i < rounds; i++) {
+        run(5000);
+        WiFi.fakeDrop(200);
+        unsigned long start = millis();
+        TEST_ASSERT_EQUAL(WIFI_LINK_DOWN, run(1000));
+        TEST_ASSERT_EQUAL(WIFI_LINK_UP, run(30000));
+        directedMs += millis() - start;
+    }
+    TEST_ASSERT_EQUAL(1, WiFi.scanCount);
+    for (int i = 0; i < rounds; i++) {
+        run(5000);
+        conn->forget();
+        WiFi.scanPolls = SCAN_MS / WIFI_ATTEMPT_POLL_MS;
+        WiFi.fakeDrop(200);
+        unsigned long start = millis();
+        TEST_ASSERT_EQUAL(WIFI_LINK_DOWN, run(1000));
+        TEST_ASSERT_EQUAL(WIFI_LINK_UP, run(30000));
+        scanMs += millis() - start;
+    }
+    TEST_ASSERT_EQUAL(1 + rounds, WiFi.scanCount);
+
+    char msg[128];
+    snprintf(msg, sizeof(msg),
+             "Reconnect after a drop: directed on the cached IP %lu ms, scan with DHCP %lu ms",
+             directedMs / rounds, scanMs / rounds);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_LESS_THAN(scanMs / 4, directedMs);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_first_boot_scans_and_joins_the_strongest_configured_network);
+    RUN_TEST(test_reboot_goes_straight_to_the_cached_access_point);
+    RUN_TEST(test_drop_reconnects_at_once_on_the_cached_ip_and_renews_the_lease);
+    RUN_TEST(test_cached_ip_without_a_lease_is_given_up);
+    RUN_TEST(test_stale_cached_ip_is_not_reused);
+    RUN_TEST(test_silent_cached_access_point_falls_back_to_a_scan);
+    RUN_TEST(test_refusals_move_to_the_next_network_then_back_off);
+    RUN_TEST(test_scan_that_cannot_start_backs_off);
+    RUN_TEST(test_benchmark_directed_reconnect_against_a_scan);
+    return UNITY_END();
+}
@@ -0,0 +1,283 @@
+/**
+ * MessagePack wire format conformance
+ * Encoder output against byte vectors from the MessagePack spec, the
+ * decoder against encodings other implementations produce, round trips
+ * of alert and heartbeat shaped bodies, and the Accept-Post / 415
+ * negotiation. Body sizes and host serialization times of both
+ * encodings are reported.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "wire_format.h"
+
+static std::vector<uint8_t> encode(const JsonDocument& doc) {
+    WireFormat wire;
+    uint8_t out[1024];
+    size_t n = wire.serialize(doc, true, out, sizeof(out));
+    TEST_ASSERT_GREATER_THAN(0, n);
+    return std::vector<uint8_t>(out, out + n);
+}
+
+static void assertBytes(const std::vector<uint8_t>& expected, const std::vector<uint8_t>& actual,
+                        const char* what) {
+    TEST_ASSERT_EQUAL_MESSAGE(expected.size(), actual.size(), what);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY_MESSAGE(expected.data(), actual.data(), expected.size(), what);
+}
+
+template <typename T>
+static void assertValue(T value, std::vector<uint8_t> expected, const char* what) {
+    StaticJsonDocument<64> doc;
+    doc.set(value);
+    assertBytes(expected, encode(doc), what);
+}
+
+static void assertString(size_t len, std::vector<uint8_t> header) {
+    std::string s(len, 'x');
+    DynamicJsonDocument doc(len + 64);
+    doc.set(s.c_str());
+    std::vector<uint8_t> out = encode(doc);
+    TEST_ASSERT_EQUAL(header.size() + len, out.size());
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(header.data(), out.data(), header.size());
+}
+
+static void alertDoc(JsonDocument& doc, bool compact) {
+    JsonObject obj = doc.to<JsonObject>();
+    if (compact) {
+        obj["t"] = 1760781600UL;
+        obj["c"] = 87;
+        obj["p"] = 3;
+        obj["n"] = "gprs";
+        obj["k"] = "main-0000A1F3";
+        obj["i"] = "0000A1F3";
+    } else {
+        obj["timestamp"] = 1760781600ULL * 1000;
+        obj["detection_confidence"] = 87 / 100.0f;
+        obj["pir_left"] = true;
+        obj["pir_middle"] = true;
+        obj["pir_right"] = false;
+        obj["network_status"] = "online";
+        obj["idempotency_key"] = "main-0000A1F3";
+        obj["incident_id"] = "0000A1F3";
+    }
+}
+
+static void heartbeatDoc(JsonDocument& doc) {
+    doc.clear();
+    doc["group_id"] = "24:6F:28:11:22:33";
+    JsonArray devices = doc.createNestedArray("devices");
+    JsonObject mainObj = devices.createNestedObject();
+    mainObj["device_id"] = "ESP32-MAIN-001";
+    mainObj["status"] = "online";
+    mainObj["ip_address"] = "192.168.1.40";
+    mainObj["firmware_version"] = "1.4.0";
+    mainObj["outbox_depth"] = 0;
+    mainObj["outbox_drain_rate"] = 0;
+    mainObj["next_heartbeat_s"] = 60;
+    JsonObject gsmObj = mainObj.createNestedObject("gsm");
+    gsmObj["csq"] = 17;
+    gsmObj["csq_age_s"] = 12;
+    gsmObj["creg"] = 1;
+    gsmObj["creg_age_s"] = 12;
+    gsmObj["operator"] = "Vodafone";
+    JsonObject camObj = devices.createNestedObject();
+    camObj["device_id"] = "ESP32-CAM-001";
+    camObj["status"] = "online";
+    camObj["via"] = "espnow";
+    camObj["mac"] = "24:6F:28:CA:00:01";
+    camObj["report_age_s"] = 4;
+    camObj["ip_address"] = "192.168.1.41";
+    camObj["firmware_version"] = "1.4.0";
+    camObj["uptime_s"] = 86400;
+    camObj["rssi"] = -61;
+    camObj["queue_depth"] = 0;
+    camObj["free_heap"] = 142336;
+    camObj["captures"] = 12;
+    camObj["capture_failures"] = 0;
+    camObj["uploads"] = 12;
+    camObj["upload_failures"] = 1;
+    camObj["trace_dropped"] = 0;
+    JsonObject linkObj = camObj.createNestedObject("status_link");
+    linkObj["frames"] = 311;
+    linkObj["retransmits"] = 2;
+    linkObj["dropped"] = 0;
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_encoder_matches_spec_vectors(void) {
+    assertValue(0, { 0x00 }, "positive fixint 0");
+    assertValue(127, { 0x7F }, "positive fixint 127");
+    assertValue(128, { 0xCC, 0x80 }, "uint8");
+    assertValue(256, { 0xCD, 0x01, 0x00 }, "uint16");
+    assertValue(65536, { 0xCE, 0x00, 0x01, 0x00, 0x00 }, "uint32");
+    assertValue(-1, { 0xFF }, "negative fixint -1");
+    assertValue(-32, { 0xE0 }, "negative fixint -32");
+    assertValue(-33, { 0xD0, 0xDF }, "int8");
+    assertValue(-129, { 0xD1, 0xFF, 0x7F }, "int16");
+    assertValue(-32769, { 0xD2, 0xFF, 0xFF, 0x7F, 0xFF }, "int32");
+    assertValue(true, { 0xC3 }, "true");
+    assertValue(false, { 0xC2 }, "false");
+    assertValue(1.5, { 0xCA, 0x3F, 0xC0, 0x00, 0x00 }, "float32 when exact");
+    assertValue(0.1, { 0xCB, 0x3F, 0xB9, 0x99, 0x99, 0x99, 0x99, 0x99, 0x9A }, "float64");
+
+    StaticJsonDocument<64> nullDoc;
+    assertBytes({ 0xC0 }, encode(nullDoc), "nil");
+
+    assertString(3, { 0xA3 });
+    assertString(31, { 0xBF });
+    assertString(32, { 0xD9, 0x20 });
+    assertString(256, { 0xDA, 0x01, 0x00 });
+
+    StaticJsonDocument<64> map;
+    map["a"] = 1;
+    assertBytes({ 0x81, 0xA1, 'a', 0x01 }, encode(map), "fixmap");
+
+    DynamicJsonDocument big(2048);
+    JsonArray arr = big.to<JsonArray>();
+    for (int i = 0; i < 16; i++) arr.add(i);
+    std::vector<uint8_t> out = encode(big);
+    TEST_ASSERT_EQUAL(3 + 16, out.size());
+    TEST_ASSERT_EQUAL_HEX8(0xDC, out[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x10, out[2]);
+
+    big.clear();
+    JsonObject obj = big.to<JsonObject>();
+    char keys[16][4];
+    for (int i = 0; i < 16; i++) {
+        snprintf(keys[i], sizeof(keys[i]), "k%d", i);
+        obj[(const char*)keys[i]] = i;
+    }
+    out = encode(big);
+    TEST_ASSERT_EQUAL_HEX8(0xDE, out[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x10, out[2]);
+}
+
+void test_decoder_accepts_non_minimal_encodings(void) {
+    // What other encoders (the backend's) may send: wide ints for small
+    // values, str8 for short strings, float64, map16 and array16
+    const uint8_t bytes[] = {
+        0xDE, 0x00, 0x05,
+        0xA1, 'u', 0xCD, 0x00, 0x05,
+        0xA1, 'i', 0xD2, 0xFF, 0xFF, 0xFF, 0xFB,
+        0xD9, 0x01, 's', 0xD9, 0x02, 'o', 'k',
+        0xA1, 'f', 0xCB, 0x3F, 0xF8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0xA1, 'a', 0xDC, 0x00, 0x02, 0xC0, 0xC3,
+    };
+    StaticJsonDocument<256> doc;
+    TEST_ASSERT_FALSE(deserializeMsgPack(doc, bytes, sizeof(bytes)));
+    TEST_ASSERT_EQUAL(5, doc["u"].as<int>());
+    TEST_ASSERT_EQUAL(-5, doc["i"].as<int>());
+    TEST_ASSERT_EQUAL_STRING("ok", doc["s"].as<const char*>());
+    TEST_ASSERT_EQUAL_FLOAT(1.5f, doc["f"].as<float>());
+    TEST_ASSERT_EQUAL(2, doc["a"].size());
+    TEST_ASSERT_TRUE(doc["a"][0].isNull());
+    TEST_ASSERT_TRUE(doc["a"][1].as<bool>());
+
+    // Cut short: an error, not a partial document taken as whole
+    TEST_ASSERT_TRUE(deserializeMsgPack(doc, bytes, sizeof(bytes) - 3));
+}
+
+void test_bodies_round_trip_both_encodings(void) {
+    StaticJsonDocument<2048> docs[3];
+    alertDoc(docs[0], false);
+    alertDoc(docs[1], true);
+    heartbeatDoc(docs[2]);
+    const char* names[] = { "alert", "compact alert", "heartbeat" };
+
+    for (int i = 0; i < 3; i++) {
+        std::vector<uint8_t> packed = encode(docs[i]);
+        StaticJsonDocument<2048> back;
+        TEST_ASSERT_FALSE(deserializeMsgPack(back, packed.data(), packed.size()));
+        std::string expected, actual;
+        serializeJson(docs[i], expected);
+        serializeJson(back, actual);
+        TEST_ASSERT_EQUAL_STRING_MESSAGE(expected.c_str(), actual.c_str(), names[i]);
+    }
+}
+
+void test_oversized_body_is_refused(void) {
+    StaticJsonDocument<2048> doc;
+    heartbeatDoc(doc);
+    WireFormat wire;
+    uint8_t out[2048];
+    size_t len = wire.serialize(doc, true, out, sizeof(out));
+    TEST_ASSERT_GREATER_THAN(0, len);
+    TEST_ASSERT_EQUAL(0, wire.serialize(doc, true, out, len));      // Would fill the buffer
+    TEST_ASSERT_EQUAL(0, wire.serialize(doc, true, out, len / 2));  // Cut
+    TEST_ASSERT_EQUAL(1, wire.getStats().bodies);
+}
+
+void test_negotiation(void) {
+    WireFormat wire;
+    TEST_ASSERT_FALSE(wire.useMsgPack());
+    wire.noteResponse(nullptr, 200, "application/json");
+    TEST_ASSERT_FALSE(wire.useMsgPack());
+    wire.noteResponse("application/json, application/msgpack", 200, "application/json");
+    TEST_ASSERT_TRUE(wire.useMsgPack());
+    TEST_ASSERT_EQUAL_STRING("application/msgpack", WireFormat::contentType(true));
+    TEST_ASSERT_EQUAL_STRING("application/msgpack; profile=compact",
+                             WireFormat::contentType(true, true));
+
+    // A 415 to a JSON body says nothing about MessagePack
+    wire.noteResponse("application/msgpack", 415, "application/json");
+    TEST_ASSERT_TRUE(wire.useMsgPack());
+
+    // A 415 to MessagePack sticks, whatever later responses advertise
+    wire.noteResponse("application/msgpack", 415, "application/msgpack; profile=compact");
+    TEST_ASSERT_FALSE(wire.useMsgPack());
+    wire.noteResponse("application/msgpack", 200, "application/json");
+    TEST_ASSERT_FALSE(wire.useMsgPack());
+}
+
+void test_benchmark_json_against_msgpack(void) {
+    StaticJsonDocument<2048> docs[3];
+    alertDoc(docs[0], false);
+    alertDoc(docs[1], true);
+    heartbeatDoc(docs[2]);
+    const char* names[] = { "alert", "compact alert", "heartbeat" };
+    const int rounds = 20000;
+
+    for (int i = 0; i < 3; i++) {
+        WireFormat wire;
+        uint8_t out[1024];
+        double ns[2];
+        size_t bytes[2];
+        for (int msgpack = 0; msgpack < 2; msgpack++) {
+            auto start = std::chrono::steady_clock::now();
+            for (int r = 0; r < rounds; r++) {
+                bytes[msgpack] = wire.serialize(docs[i], msgpack, out, sizeof(out));
+            }
+            auto end = std::chrono::steady_clock::now();
+            ns[msgpack] = std::chrono::duration<double, std::nano>(end - start).count() / rounds;
+        }
+        // Each body also measures the other encoding; the totals agree
+        WireStats st = wire.getStats();
+        TEST_ASSERT_EQUAL_UINT32((uint32_t)rounds * 2 * bytes[0], st.jsonBytes);
+        TEST_ASSERT_EQUAL_UINT32((uint32_t)rounds * 2 * bytes[1], st.msgpackBytes);
+        TEST_ASSERT_LESS_THAN(bytes[0], bytes[1]);
+
+        char msg[160];
+        snprintf(msg, sizeof(msg), "%s: JSON %u B, MessagePack %u B (%.0f%%); host serialize "
+                 "(with the other encoding measured) %.0f ns vs %.0f ns",
+                 names[i], (unsigned)bytes[0], (unsigned)bytes[1], 100.0 * bytes[1] / bytes[0],
+                 ns[0], ns[1]);
+        TEST_MESSAGE(msg);
+    }
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_encoder_matches_spec_vectors);
+    RUN_TEST(test_decoder_accepts_non_minimal_encodings);
+    RUN_TEST(test_bodies_round_trip_both_encodings);
+    RUN_TEST(test_oversized_body_is_refused);
+    RUN_TEST(test_negotiation);
+    RUN_TEST(test_benchmark_json_against_msgpack);
+    return UNITY_END();
+}
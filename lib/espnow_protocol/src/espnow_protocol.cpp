@@ -0,0 +1,72 @@
+/**
+ * ESP-NOW Protocol Implementation
+ * Frame encode/decode and CRC
+ */
+
+#include "espnow_protocol.h"
+
+// CRC-16/CCITT-FALSE: poly 0x1021, init 0xFFFF
+uint16_t espnowCrc16(const uint8_t* data, size_t len) {
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+size_t espnowEncode(uint8_t* out, size_t outLen, EspNowFrameType type, uint16_t seq,
+                    uint32_t incidentId, const uint8_t* payload, uint8_t payloadLen) {
+    size_t total = sizeof(EspNowHeader) + payloadLen + ESPNOW_CRC_SIZE;
+    if (total > outLen || total > ESPNOW_FRAME_MAX) {
+        return 0;
+    }
+
+    EspNowHeader header;
+    header.magic = ESPNOW_MAGIC;
+    header.version = ESPNOW_VERSION;
+    header.type = type;
+    header.seq = seq;
+    header.payloadLen = payloadLen;
+    header.flags = 0;
+    header.incidentId = incidentId;
+    header.timestamp = millis();
+
+    memcpy(out, &header, sizeof(header));
+    if (payloadLen > 0) {
+        memcpy(out + sizeof(header), payload, payloadLen);
+    }
+
+    size_t crcOffset = sizeof(header) + payloadLen;
+    uint16_t crc = espnowCrc16(out, crcOffset);
+    out[crcOffset] = crc & 0xFF;
+    out[crcOffset + 1] = crc >> 8;
+    return total;
+}
+
+bool espnowDecode(const uint8_t* data, int len, EspNowHeader& header,
+                  const uint8_t** payload) {
+    if (len < (int)(sizeof(EspNowHeader) + ESPNOW_CRC_SIZE)) {
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+
+    if (header.magic != ESPNOW_MAGIC || header.version != ESPNOW_VERSION) {
+        return false;
+    }
+    size_t crcOffset = sizeof(header) + header.payloadLen;
+    if ((size_t)len != crcOffset + ESPNOW_CRC_SIZE) {
+        return false;
+    }
+    uint16_t crc = data[crcOffset] | (data[crcOffset + 1] << 8);
+    if (crc != espnowCrc16(data, crcOffset)) {
+        return false;
+    }
+
+    if (payload) {
+        *payload = data + sizeof(header);
+    }
+    return true;
+}
@@ -0,0 +1,124 @@
+/**
+ * ESP-NOW Protocol
+ * Versioned binary frame shared by the main controller and the ESP32-CAM
+ *
+ * Frame: 16-byte header, optional payload, CRC-16/CCITT of everything
+ * before it (little endian). Receivers drop frames with a bad magic,
+ * unknown version or CRC mismatch.
+ */
+
+#ifndef ESPNOW_PROTOCOL_H
+#define ESPNOW_PROTOCOL_H
+
+#include <Arduino.h>
+
+#define ESPNOW_MAGIC 0xA1B7
+#define ESPNOW_VERSION 1
+#define ESPNOW_FRAME_MAX 250  // ESP_NOW_MAX_DATA_LEN
+#define ESPNOW_CRC_SIZE 2
+
+enum EspNowFrameType : uint8_t {
+    FRAME_TRIGGER = 1,        // main -> cam: capture for incidentId
+    FRAME_ACK = 2,            // cam -> main: seq echoes the acknowledged frame
+    FRAME_LINK_ACK = 3,       // main -> cam: seq = next UART frame seq expected
+    FRAME_THUMB_REQUEST = 4,  // main -> cam: stream incidentId's thumbnail over UART
+    FRAME_RELAY_OFFER = 5,    // cam -> main: RelayOffer, image queued for incidentId
+    FRAME_RELAY_REQUEST = 6,  // main -> cam: RelayRequest, start sending fragments
+    FRAME_FRAGMENT = 7,       // cam -> main: FragmentHeader + image bytes
+    FRAME_FRAGMENT_ACK = 8,   // main -> cam: FragmentAck
+    FRAME_RELAY_RESULT = 9,   // main -> cam: RelayResult after forwarding
+    FRAME_CAM_TELEMETRY = 10, // cam -> main: CamTelemetry for the group heartbeat
+    FRAME_TELEMETRY_ACK = 11  // main -> cam: TelemetryAck, seq echoes the report
+};
+
+struct __attribute__((packed)) EspNowHeader {
+    uint16_t magic;
+    uint8_t version;
+    uint8_t type;         // EspNowFrameType
+    uint16_t seq;         // Per-sender, wraps
+    uint8_t payloadLen;
+    uint8_t flags;        // Reserved, 0
+    uint32_t incidentId;  // 0 = not tied to an alert
+    uint32_t timestamp;   // Sender millis() when the frame was built
+};
+
+#define ESPNOW_PAYLOAD_MAX (ESPNOW_FRAME_MAX - sizeof(EspNowHeader) - ESPNOW_CRC_SIZE)
+
+// ==================== IMAGE RELAY ====================
+// Cam -> main image transfer when only the main controller can reach the
+// backend. Fragments are selectively repeated: the receiver acks the
+// first missing index plus a bitmap of the RELAY_WINDOW after it, and
+// the sender resends only fragments that stay unacked.
+
+#define RELAY_WINDOW 16  // Fragments in flight (<= 32, the ack bitmap width)
+
+enum RelayKind : uint8_t {
+    RELAY_FULL = 0,   // JPEG from the SPIFFS queue
+    RELAY_THUMB = 1   // Thumbnail kept at capture
+};
+
+struct __attribute__((packed)) RelayOffer {
+    uint32_t fullBytes;
+    uint16_t thumbBytes;  // 0 = no thumbnail
+};
+
+struct __attribute__((packed)) RelayRequest {
+    uint8_t kind;  // RelayKind
+};
+
+struct __attribute__((packed)) FragmentHeader {
+    uint16_t index;
+    uint16_t count;
+    uint32_t total;  // Image bytes
+};
+
+struct __attribute__((packed)) FragmentAck {
+    uint16_t base;   // All fragments before base received; base == count when done
+    uint32_t mask;   // Bit i set = fragment base + 1 + i received
+};
+
+struct __attribute__((packed)) RelayResult {
+    uint8_t ok;  // Backend accepted the image
+};
+
+#define RELAY_FRAGMENT_DATA (ESPNOW_PAYLOAD_MAX - sizeof(FragmentHeader))
+
+// ==================== TELEMETRY ====================
+// The cam's heartbeat rides to the main controller, which posts one
+// heartbeat for both devices. The cam posts its own only when the ack
+// says the main controller cannot.
+
+struct __attribute__((packed)) CamTelemetry {
+    uint32_t uptimeS;
+    uint32_t ip;              // IPv4 as WiFi.localIP(), 0 = no WiFi
+    int8_t rssi;              // 0 = no WiFi
+    uint8_t queueDepth;       // Images waiting in SPIFFS
+    uint16_t reserved;
+    uint32_t freeHeap;
+    uint32_t captures;
+    uint32_t captureFailures;
+    uint32_t uploads;
+    uint32_t uploadFailures;
+    uint32_t linkFrames;      // UART status link
+    uint32_t linkRetransmits;
+    uint32_t linkDropped;
+    uint32_t traceDropped;
+    char firmware[8];         // NUL-padded
+};
+
+struct __attribute__((packed)) TelemetryAck {
+    uint8_t forwarding;  // Main controller will post it with its heartbeat
+};
+
+uint16_t espnowCrc16(const uint8_t* data, size_t len);
+
+// Builds a frame into out; returns its length, 0 if it does not fit
+size_t espnowEncode(uint8_t* out, size_t outLen, EspNowFrameType type, uint16_t seq,
+                    uint32_t incidentId, const uint8_t* payload = nullptr,
+                    uint8_t payloadLen = 0);
+
+// Validates a received frame; payload points into data
+bool espnowDecode(const uint8_t* data, int len, EspNowHeader& header,
+                  const uint8_t** payload = nullptr);
+
+#endif // ESPNOW_PROTOCOL_H
@@ -0,0 +1,360 @@
+/**
+ * HTTP Request Implementation
+ */
+
+#include "http_request.h"
+#include <stdarg.h>
+
+bool httpParseEndpoint(const char* url, HttpEndpoint& out) {
+    const char* p = strstr(url, "://");
+    out.secure = true;
+    if (p) {
+        out.secure = strncmp(url, "https", 5) == 0;
+        p += 3;
+    } else {
+        p = url;
+    }
+    out.port = out.secure ? 443 : 80;
+
+    size_t n = strcspn(p, ":/");
+    if (n >= sizeof(out.host)) {
+        return false;
+    }
+    memcpy(out.host, p, n);
+    out.host[n] = '\0';
+    p += n;
+    if (*p == ':') {
+        out.port = atoi(p + 1);
+        p += strcspn(p, "/");
+    }
+
+    n = strlen(p);
+    while (n > 0 && p[n - 1] == '/') {
+        n--;
+    }
+    if (n >= sizeof(out.path)) {
+        return false;
+    }
+    memcpy(out.path, p, n);
+    out.path[n] = '\0';
+    return true;
+}
+
+HttpRequestHead::HttpRequestHead(char* buffer, size_t capacity)
+    : buf(buffer), cap(capacity), len(0), overflow(false) {
+}
+
+void HttpRequestHead::append(const char* fmt, ...) {
+    if (overflow) {
+        return;
+    }
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(buf + len, cap - len, fmt, args);
+    va_end(args);
+    if (n < 0 || (size_t)n >= cap - len) {
+        overflow = true;
+        return;
+    }
+    len += n;
+}
+
+void HttpRequestHead::begin(const char* method, const HttpEndpoint& endpoint,
+                            const char* prefix, const char* path) {
+    len = 0;
+    overflow = false;
+    append("%s %s%s HTTP/1.1\r\nHost: %s\r\n", method, prefix, path, endpoint.host);
+}
+
+void HttpRequestHead::header(const char* name, const char* value) {
+    append("%s: %s\r\n", name, value);
+}
+
+void HttpRequestHead::header(const char* name, unsigned long value) {
+    append("%s: %lu\r\n", name, value);
+}
+
+size_t HttpRequestHead::finish() {
+    append("\r\n");
+    return overflow ? 0 : len;
+}
+
+// One buffer out, however many write() calls the client needs for it
+static bool writeAll(Client& client, const uint8_t* p, size_t left,
+                     unsigned long stallMs, HttpWriteStats& stats) {
+    unsigned long progressAt = millis();
+    while (left > 0) {
+        size_t n = client.write(p, left);
+        if (n > 0) {
+            p += n;
+            left -= n;
+            stats.bytes += n;
+            stats.writes++;
+            progressAt = millis();
+            continue;
+        }
+        if (!client.connected() || millis() - progressAt > stallMs) {
+            return false;
+        }
+        // Socket buffer full. Blocking here lets the WiFi task drain it
+        // and the idle task feed the watchdog; yield() would do neither.
+        delay(1);
+    }
+    return true;
+}
+
+bool httpWriteSlices(Client& client, const HttpSlice* slices, size_t count,
+                     unsigned long stallMs, uint8_t* stage, size_t stageLen,
+                     HttpWriteStats* stats) {
+    HttpWriteStats local = { 0, 0, 0 };
+    unsigned long start = millis();
+    size_t fill = 0;
+    bool ok = true;
+
+    for (size_t i = 0; i < count && ok; i++) {
+        const uint8_t* p = slices[i].data;
+        size_t left = slices[i].len;
+        while (left > 0 && ok) {
+            if (stageLen == 0) {
+                ok = writeAll(client, p, left, stallMs, local);
+                break;
+            }
+            if (fill == 0 && left >= stageLen) {
+                ok = writeAll(client, p, stageLen, stallMs, local);
+                p += stageLen;
+                left -= stageLen;
+                continue;
+            }
+            size_t n = stageLen - fill;
+            if (n > left) {
+                n = left;
+            }
+            memcpy(stage + fill, p, n);
+            fill += n;
+            p += n;
+            left -= n;
+            if (fill == stageLen) {
+                ok = writeAll(client, stage, fill, stallMs, local);
+                fill = 0;
+            }
+        }
+    }
+    if (ok && fill > 0) {
+        ok = writeAll(client, stage, fill, stallMs, local);
+    }
+
+    local.ms = millis() - start;
+    if (stats) {
+        *stats = local;
+    }
+    return ok;
+}
+
+static bool readLine(Client& client, char* buf, size_t len, unsigned long deadline) {
+    size_t n = 0;
+    while ((long)(millis() - deadline) < 0) {
+        if (!client.available()) {
+            if (!client.connected()) {
+                return false;
+            }
+            delay(5);
+            continue;
+        }
+        int c = client.read();
+        if (c < 0) {
+            continue;
+        }
+        if (c == '\n') {
+            buf[n] = '\0';
+            return true;
+        }
+        if (c != '\r' && n < len - 1) {
+            buf[n++] = (char)c;
+        }
+    }
+    return false;
+}
+
+static const char* headerValue(const char* line, const char* name) {
+    size_t n = strlen(name);
+    if (strncasecmp(line, name, n) != 0 || line[n] != ':') {
+        return nullptr;
+    }
+    const char* v = line + n + 1;
+    while (*v == ' ') {
+        v++;
+    }
+    return v;
+}
+
+// Status line and headers of one response, interim or final
+static bool readHead(Client& client, unsigned long deadline, HttpResponse& out,
+                     bool& close, bool& chunked) {
+    out.status = -1;
+    out.contentLength = -1;
+    out.keepAlive = false;
+    close = false;
+    chunked = false;
+
+    char line[192];  // Fits a Location with HTTP_HOST_MAX and HTTP_PATH_MAX
+    if (!readLine(client, line, sizeof(line), deadline)) {
+        return false;
+    }
+    // HTTP/1.1 200 OK
+    if (strncmp(line, "HTTP/", 5) != 0) {
+        return false;
+    }
+    const char* sp = strchr(line, ' ');
+    out.status = sp ? atoi(sp + 1) : 0;
+
+    const char* v;
+    while (readLine(client, line, sizeof(line), deadline)) {
+        if (line[0] == '\0') {
+            break;
+        }
+        if ((v = headerValue(line, "Content-Length")) != nullptr) {
+            out.contentLength = atol(v);
+        } else if ((v = headerValue(line, "Connection")) != nullptr) {
+            close = strncasecmp(v, "close", 5) == 0;
+        } else if ((v = headerValue(line, "Transfer-Encoding")) != nullptr) {
+            chunked = true;  // Not parsed; the connection is not reused
+        } else if ((v = headerValue(line, HEARTBEAT_MAX_HEADER)) != nullptr) {
+            out.heartbeatMaxS = strtoul(v, nullptr, 10);
+        } else if ((v = headerValue(line, ACCEPT_POST_HEADER)) != nullptr) {
+            snprintf(out.acceptPost, sizeof(out.acceptPost), "%s", v);
+        } else if ((v = headerValue(line, UPLOAD_OFFSET_HEADER)) != nullptr) {
+            out.uploadOffset = atol(v);
+        } else if ((v = headerValue(line, "Location")) != nullptr) {
+            // Absolute or relative; requests go to our own host either way
+            const char* scheme = strstr(v, "://");
+            if (scheme) {
+                v = strchr(scheme + 3, '/');
+            }
+            snprintf(out.location, sizeof(out.location), "%s", v ? v : "");
+        }
+    }
+    return true;
+}
+
+static void resetResponse(HttpResponse& out, char* body, size_t bodyCap) {
+    out.status = -1;
+    out.contentLength = -1;
+    out.keepAlive = false;
+    out.heartbeatMaxS = 0;
+    out.acceptPost[0] = '\0';
+    out.uploadOffset = -1;
+    out.location[0] = '\0';
+    out.bodyLen = 0;
+    if (body && bodyCap > 0) {
+        body[0] = '\0';
+    }
+}
+
+// Keep what fits in the caller's buffer; drain the rest so a kept-alive
+// connection starts clean
+static void readBody(Client& client, unsigned long deadline, HttpResponse& out,
+                     bool close, bool chunked, bool hasBody, char* body, size_t bodyCap) {
+    if (!hasBody) {
+        out.keepAlive = !close && !chunked;
+        return;
+    }
+
+    long left = out.contentLength;
+    uint8_t scratch[64];
+    while (left > 0 && (long)(millis() - deadline) < 0) {
+        int avail = client.available();
+        if (avail <= 0) {
+            if (!client.connected()) {
+                break;
+            }
+            delay(5);
+            continue;
+        }
+        int n = client.read(scratch, left < (long)sizeof(scratch) ? left : sizeof(scratch));
+        if (n > 0) {
+            left -= n;
+            size_t keep = 0;
+            if (body && out.bodyLen + 1 < bodyCap) {
+                keep = bodyCap - 1 - out.bodyLen;
+                keep = keep < (size_t)n ? keep : n;
+                memcpy(body + out.bodyLen, scratch, keep);
+                out.bodyLen += keep;
+                body[out.bodyLen] = '\0';
+            }
+        }
+    }
+
+    out.keepAlive = !close && !chunked && out.contentLength >= 0 && left == 0;
+}
+
+bool httpReadResponse(Client& client, unsigned long timeoutMs, HttpResponse& out,
+                      bool hasBody, char* body, size_t bodyCap) {
+    resetResponse(out, body, bodyCap);
+
+    unsigned long deadline = millis() + timeoutMs;
+    bool close;
+    bool chunked;
+    do {
+        if (!readHead(client, deadline, out, close, chunked)) {
+            return false;
+        }
+    } while (out.status >= 100 && out.status < 200);
+
+    readBody(client, deadline, out, close, chunked, hasBody, body, bodyCap);
+    return true;
+}
+
+static void addStats(HttpWriteStats& total, const HttpWriteStats& part) {
+    total.bytes += part.bytes;
+    total.writes += part.writes;
+    total.ms += part.ms;
+}
+
+bool httpExchange(Client& client, const HttpSlice* slices, size_t count,
+                  HttpExchange& x, HttpResponse& out) {
+    HttpWriteStats part;
+    x.stats = { 0, 0, 0 };
+    x.sent = false;
+    x.bodySkipped = false;
+    resetResponse(out, x.body, x.bodyCap);
+
+    size_t first = 0;
+    if (x.continueWaitMs > 0 && count > 1) {
+        bool ok = httpWriteSlices(client, slices, 1, x.timeoutMs, nullptr, 0, &part);
+        addStats(x.stats, part);
+        if (!ok) {
+            return false;
+        }
+        first = 1;
+
+        unsigned long waitStart = millis();
+        while (!client.available() && client.connected() &&
+               millis() - waitStart < x.continueWaitMs) {
+            delay(5);
+        }
+        if (client.available()) {
+            unsigned long deadline = millis() + x.timeoutMs;
+            bool close;
+            bool chunked;
+            if (!readHead(client, deadline, out, close, chunked)) {
+                return false;
+            }
+            if (out.status >= 200) {
+                readBody(client, deadline, out, close, chunked, x.hasBody, x.body, x.bodyCap);
+                out.keepAlive = false;
+                x.bodySkipped = true;
+                return true;
+            }
+            // 100 Continue; the final response follows the body
+        }
+    }
+
+    bool ok = httpWriteSlices(client, slices + first, count - first, x.timeoutMs,
+                              x.stage, x.stageLen, &part);
+    addStats(x.stats, part);
+    if (!ok) {
+        return false;
+    }
+    x.sent = true;
+    return httpReadResponse(client, x.timeoutMs, out, x.hasBody, x.body, x.bodyCap);
+}
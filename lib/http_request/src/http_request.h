@@ -0,0 +1,134 @@
+/**
+ * HTTP Request Module
+ * Allocation-free HTTP/1.1 request writing and response reading
+ *
+ * Endpoints are split once, when a client is constructed. Each request
+ * renders its request line and headers into a caller-supplied buffer,
+ * then goes out as a list of slices (head, preamble, body, trailer)
+ * without being copied into one buffer. Responses are read line by line
+ * into a fixed buffer, and only the headers the firmware acts on are
+ * kept. Nothing here touches the heap.
+ */
+
+#ifndef HTTP_REQUEST_H
+#define HTTP_REQUEST_H
+
+#include <Arduino.h>
+#include <Client.h>
+
+#define HTTP_HOST_MAX 64
+#define HTTP_PATH_MAX 96
+#define HTTP_ACCEPT_POST_MAX 64
+
+// Response headers picked out by httpReadResponse()
+// Longest heartbeat interval the backend accepts, in seconds (liveness.h)
+#define HEARTBEAT_MAX_HEADER "X-Heartbeat-Max"
+// Body types the backend takes (wire_format.h)
+#define ACCEPT_POST_HEADER "Accept-Post"
+// Resumable uploads: bytes the server has committed to a session
+#define UPLOAD_OFFSET_HEADER "Upload-Offset"
+
+struct HttpHeader {
+    const char* name;
+    const char* value;
+};
+
+struct HttpEndpoint {
+    char host[HTTP_HOST_MAX];
+    uint16_t port;
+    bool secure;
+    char path[HTTP_PATH_MAX];  // Without a trailing '/', "" for the root
+};
+
+// Splits scheme://host[:port][/path]; false if a part does not fit
+bool httpParseEndpoint(const char* url, HttpEndpoint& out);
+
+class HttpRequestHead {
+private:
+    char* buf;
+    size_t cap;
+    size_t len;
+    bool overflow;
+
+    void append(const char* fmt, ...);
+
+public:
+    HttpRequestHead(char* buffer, size_t capacity);
+
+    // Request line (prefix + path) and Host
+    void begin(const char* method, const HttpEndpoint& endpoint,
+               const char* prefix, const char* path);
+    void header(const char* name, const char* value);
+    void header(const char* name, unsigned long value);
+    // Adds the blank line; returns the head length, 0 if it overflowed
+    size_t finish();
+    const uint8_t* data() const { return (const uint8_t*)buf; }
+};
+
+struct HttpSlice {
+    const uint8_t* data;
+    size_t len;
+};
+
+struct HttpWriteStats {
+    size_t bytes;
+    uint16_t writes;        // write() calls that took data (~TLS records)
+    unsigned long ms;
+};
+
+// Writes every slice in order, retrying partial writes. Fails if the
+// connection drops or makes no progress for stallMs.
+//
+// With a staging buffer, small slices and slice edges are packed into
+// it so every write() but the last hands the client exactly stageLen
+// bytes; over TLS that is one full record each, instead of one short
+// record (and often one TCP segment) per header, preamble and chunk.
+// Slice data that starts a full record is written from where it is.
+bool httpWriteSlices(Client& client, const HttpSlice* slices, size_t count,
+                     unsigned long stallMs, uint8_t* stage = nullptr, size_t stageLen = 0,
+                     HttpWriteStats* stats = nullptr);
+
+struct HttpResponse {
+    int status;              // -1 = no reply in time
+    long contentLength;      // -1 = not given
+    bool keepAlive;          // Body fully read and the server did not close
+    unsigned long heartbeatMaxS;  // HEARTBEAT_MAX_HEADER, 0 = absent
+    char acceptPost[HTTP_ACCEPT_POST_MAX];  // ACCEPT_POST_HEADER, "" = absent
+    long uploadOffset;       // UPLOAD_OFFSET_HEADER, -1 = absent
+    char location[HTTP_PATH_MAX];  // Path part of Location, "" = absent
+    size_t bodyLen;          // Bytes kept in the caller's body buffer
+};
+
+// Reads the status line and headers, then drains a Content-Length body,
+// keeping its start (NUL-terminated) in body if one is given. hasBody =
+// false for replies to HEAD, whose Content-Length has no body. Interim
+// (1xx) responses before the final one are skipped.
+bool httpReadResponse(Client& client, unsigned long timeoutMs, HttpResponse& out,
+                      bool hasBody = true, char* body = nullptr, size_t bodyCap = 0);
+
+struct HttpExchange {
+    unsigned long timeoutMs;
+    // > 0: the head (slice 0) carries "Expect: 100-continue" and goes out
+    // alone; the rest waits up to this long for 100 Continue
+    unsigned long continueWaitMs;
+    uint8_t* stage;          // httpWriteSlices staging, optional
+    size_t stageLen;
+    bool hasBody;            // false for HEAD
+    char* body;              // httpReadResponse body buffer, optional
+    size_t bodyCap;
+
+    HttpWriteStats stats;    // Out: head and body writes
+    bool sent;               // Out: the whole request went out
+    bool bodySkipped;        // Out: final status came before the body was sent
+};
+
+// Writes the request and reads its response. With continueWaitMs, a
+// final status sent in answer to the head alone (503 from a cold or
+// overloaded backend, 401, 413) is returned without the body ever
+// leaving the device; the connection is then not reused, since the
+// server may still be expecting the body. Servers that ignore Expect
+// stay silent, and the body follows after the wait.
+bool httpExchange(Client& client, const HttpSlice* slices, size_t count,
+                  HttpExchange& x, HttpResponse& out);
+
+#endif // HTTP_REQUEST_H
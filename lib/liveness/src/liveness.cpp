@@ -0,0 +1,104 @@
+/**
+ * Liveness Scheduler Implementation
+ */
+
+#include "liveness.h"
+
+LivenessScheduler::LivenessScheduler(const LivenessConfig& cfg)
+    : config(cfg), intervalMs(cfg.baseMs), serverMaxMs(0), lastContactAt(0),
+      lastAttemptAt(0), incidentAt(0), incident(false), degraded(false), linkUp(true),
+      explicitBeats(0), implicitBeats(0) {
+}
+
+unsigned long LivenessScheduler::capMs() const {
+    unsigned long cap = serverMaxMs ? serverMaxMs : config.maxMs;
+    return cap < config.baseMs ? config.baseMs : cap;
+}
+
+bool LivenessScheduler::fast() const {
+    bool inIncident = incident && millis() - incidentAt < config.incidentHoldMs;
+    return inIncident || degraded;
+}
+
+void LivenessScheduler::noteExchange(bool answered) {
+    if (!answered) {
+        degraded = true;
+        intervalMs = config.baseMs;
+        return;
+    }
+    implicitBeats++;
+    degraded = false;
+    lastContactAt = millis();
+}
+
+void LivenessScheduler::noteHeartbeat(bool answered) {
+    unsigned long now = millis();
+    lastAttemptAt = now;
+    if (!answered) {
+        degraded = true;
+        intervalMs = config.baseMs;
+        return;
+    }
+    explicitBeats++;
+    degraded = false;
+    lastContactAt = now;
+    if (!fast()) {
+        intervalMs = nextIntervalMs();
+    }
+}
+
+void LivenessScheduler::noteSkipped() {
+    lastAttemptAt = millis();
+}
+
+void LivenessScheduler::noteIncident() {
+    incident = true;
+    incidentAt = millis();
+    intervalMs = config.baseMs;
+}
+
+void LivenessScheduler::setServerMaxS(unsigned long seconds) {
+    serverMaxMs = seconds * 1000UL;
+    if (intervalMs > capMs()) {
+        intervalMs = capMs();
+    }
+}
+
+unsigned long LivenessScheduler::currentIntervalMs() const {
+    if (fast() && config.fastMs < intervalMs) {
+        return config.fastMs;
+    }
+    // No link: the caller's reconnect attempts keep the base pace
+    if (!linkUp && config.baseMs < intervalMs) {
+        return config.baseMs;
+    }
+    return intervalMs;
+}
+
+unsigned long LivenessScheduler::nextIntervalMs() const {
+    if (fast()) {
+        return currentIntervalMs();
+    }
+    unsigned long next = intervalMs + intervalMs / 2;
+    return next > capMs() ? capMs() : next;
+}
+
+unsigned long LivenessScheduler::msUntilDue() const {
+    // From whichever came last: a heartbeat attempt must not repeat at
+    // once just because it failed
+    unsigned long anchor = lastContactAt;
+    if ((long)(lastAttemptAt - anchor) > 0) {
+        anchor = lastAttemptAt;
+    }
+    unsigned long since = millis() - anchor;
+    unsigned long interval = currentIntervalMs();
+    return since >= interval ? 0 : interval - since;
+}
+
+void LivenessScheduler::printStats(const char* label) const {
+    Serial.printf("%s liveness: interval %lu s%s (cap %lu s%s), %lu heartbeats, "
+                  "%lu other exchanges\n",
+                  label, currentIntervalMs() / 1000, fast() ? " [fast]" : "",
+                  capMs() / 1000, serverMaxMs ? " from backend" : "",
+                  (unsigned long)explicitBeats, (unsigned long)implicitBeats);
+}
@@ -0,0 +1,64 @@
+/**
+ * Liveness Scheduler
+ * Decides when a device owes the backend an explicit heartbeat
+ *
+ * Any request that reaches the backend (alert, image, replay, trace
+ * batch) already proves the device is alive, so a heartbeat is only due
+ * once nothing has been exchanged for the current interval. Each
+ * heartbeat in a quiet, healthy period stretches the interval by half,
+ * up to the backend's advertised maximum (X-Heartbeat-Max, seconds) or
+ * the local cap. An incident or a failed exchange drops it to the fast
+ * interval so the backend hears from us when it matters; with no link at
+ * all it falls back to the base interval.
+ */
+
+#ifndef LIVENESS_H
+#define LIVENESS_H
+
+#include <Arduino.h>
+
+struct LivenessConfig {
+    unsigned long baseMs;          // First interval, and after any trouble
+    unsigned long fastMs;          // During an incident or while degraded
+    unsigned long maxMs;           // Cap until the backend advertises one
+    unsigned long incidentHoldMs;  // Fast interval lasts this long after an incident
+};
+
+class LivenessScheduler {
+private:
+    LivenessConfig config;
+    unsigned long intervalMs;      // Quiet-period interval, grows
+    unsigned long serverMaxMs;     // 0 = not advertised
+    unsigned long lastContactAt;   // Any exchange the backend answered
+    unsigned long lastAttemptAt;   // Last heartbeat attempt, answered or not
+    unsigned long incidentAt;
+    bool incident;
+    bool degraded;                 // Last exchange failed
+    bool linkUp;
+
+    uint32_t explicitBeats;
+    uint32_t implicitBeats;        // Answered non-heartbeat exchanges
+
+    unsigned long capMs() const;
+    bool fast() const;
+
+public:
+    LivenessScheduler(const LivenessConfig& cfg);
+
+    void noteExchange(bool answered);  // Any non-heartbeat request
+    void noteHeartbeat(bool answered);
+    void noteSkipped();  // Heartbeat due but no link to send it on
+    void noteIncident();
+    void setLinkUp(bool up) { linkUp = up; }
+    void setServerMaxS(unsigned long seconds);
+
+    unsigned long currentIntervalMs() const;
+    // Interval promised to the backend if the heartbeat being sent lands
+    unsigned long nextIntervalMs() const;
+    unsigned long msUntilDue() const;
+    bool isDue() const { return msUntilDue() == 0; }
+
+    void printStats(const char* label) const;
+};
+
+#endif // LIVENESS_H
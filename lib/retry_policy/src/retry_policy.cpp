@@ -0,0 +1,109 @@
+/**
+ * Retry Policy Implementation
+ */
+
+#include "retry_policy.h"
+#include <esp_system.h>
+
+RetryPolicy::RetryPolicy(const char* endpointName, const RetryConfig& cfg)
+    : name(endpointName), config(cfg), failures(0), nextAt(0), open(false),
+      probing(false), probeAt(0), attempts(0), failed(0), trips(0), shed(0) {
+}
+
+bool RetryPolicy::isFailure(int httpStatus) {
+    return httpStatus <= 0 || httpStatus == 408 || httpStatus == 429 || httpStatus >= 500;
+}
+
+// Upper half of the range: at least ms/2, never more than ms
+unsigned long RetryPolicy::jittered(unsigned long ms) const {
+    return ms / 2 + esp_random() % (ms / 2 + 1);
+}
+
+bool RetryPolicy::ready() {
+    unsigned long now = millis();
+    if (probing) {
+        // A caller that never reported back must not hold the breaker
+        if (now - probeAt < config.maxMs) {
+            return false;
+        }
+        probing = false;
+    }
+    if ((long)(now - nextAt) < 0) {
+        return false;
+    }
+    if (open) {
+        probing = true;
+        probeAt = now;
+    }
+    attempts++;
+    return true;
+}
+
+unsigned long RetryPolicy::msUntilReady() const {
+    if (probing) {
+        unsigned long held = millis() - probeAt;
+        return held < config.maxMs ? config.maxMs - held : 0;
+    }
+    long remaining = (long)(nextAt - millis());
+    return remaining > 0 ? (unsigned long)remaining : 0;
+}
+
+void RetryPolicy::noteResult(int httpStatus) {
+    if (isFailure(httpStatus)) {
+        onFailure();
+    } else {
+        onSuccess();
+    }
+}
+
+void RetryPolicy::onSuccess() {
+    if (open) {
+        Serial.printf("[RETRY] %s: probe succeeded - breaker closed\n", name);
+    }
+    failures = 0;
+    open = false;
+    probing = false;
+    nextAt = millis();
+}
+
+void RetryPolicy::onFailure() {
+    failed++;
+    probing = false;
+    if (failures < 255) {
+        failures++;
+    }
+
+    if (config.tripAfter > 0 && failures >= config.tripAfter) {
+        if (!open) {
+            trips++;
+            Serial.printf("[RETRY] %s: %u failures in a row - breaker open for %lu s\n",
+                          name, failures, config.openMs / 1000);
+        }
+        open = true;
+        nextAt = millis() + jittered(config.openMs);
+        return;
+    }
+
+    unsigned long wait = config.baseMs;
+    for (uint8_t i = 1; i < failures && wait < config.maxMs; i++) {
+        wait *= 2;
+    }
+    if (wait > config.maxMs) {
+        wait = config.maxMs;
+    }
+    nextAt = millis() + jittered(wait);
+}
+
+void RetryPolicy::reset() {
+    if (!open) {
+        nextAt = millis();
+    }
+}
+
+void RetryPolicy::printStats() const {
+    Serial.printf("Retry %s: %s, %u failing, next in %lu s; %lu attempts, %lu failed, "
+                  "%lu trips, %lu skipped\n",
+                  name, open ? (probing ? "probing" : "OPEN") : "closed", failures,
+                  msUntilReady() / 1000, (unsigned long)attempts, (unsigned long)failed,
+                  (unsigned long)trips, (unsigned long)shed);
+}
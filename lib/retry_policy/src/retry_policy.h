@@ -0,0 +1,65 @@
+/**
+ * Retry Policy
+ * Exponential backoff with jitter and a circuit breaker, per endpoint
+ *
+ * Each failure doubles the wait before the next attempt, up to maxMs.
+ * The actual wait is drawn from the upper half of that range, so devices
+ * that failed together do not all retry at the same moment. After
+ * tripAfter consecutive failures the breaker opens. No request is sent
+ * for openMs, then a single probe is let through. If the probe succeeds
+ * the breaker closes. If it fails, the breaker opens again.
+ *
+ * Only trouble on the way or on the server counts as a failure: no
+ * reply, 408, 429 and 5xx. Any other answer, a 4xx included, shows the
+ * endpoint is up.
+ */
+
+#ifndef RETRY_POLICY_H
+#define RETRY_POLICY_H
+
+#include <Arduino.h>
+
+struct RetryConfig {
+    unsigned long baseMs;   // Wait after the first failure
+    unsigned long maxMs;    // Longest backoff wait
+    uint8_t tripAfter;      // Consecutive failures that open the breaker, 0 = never
+    unsigned long openMs;   // Breaker open time before a probe
+};
+
+class RetryPolicy {
+private:
+    const char* name;
+    RetryConfig config;
+    uint8_t failures;       // Consecutive
+    unsigned long nextAt;   // No attempt before this
+    bool open;
+    bool probing;           // Half-open probe handed out, no result yet
+    unsigned long probeAt;
+
+    uint32_t attempts;
+    uint32_t failed;
+    uint32_t trips;
+    uint32_t shed;          // Sends skipped while waiting
+
+    unsigned long jittered(unsigned long ms) const;
+
+public:
+    RetryPolicy(const char* endpointName, const RetryConfig& cfg);
+
+    static bool isFailure(int httpStatus);
+
+    // True if an attempt may go now; while open, true once for the probe
+    bool ready();
+    unsigned long msUntilReady() const;
+    bool isOpen() const { return open; }
+
+    void noteResult(int httpStatus);
+    void onSuccess();
+    void onFailure();
+    void noteShed() { shed++; }
+    void reset();  // Link came back: allow an attempt now, keep the breaker
+
+    void printStats() const;
+};
+
+#endif // RETRY_POLICY_H
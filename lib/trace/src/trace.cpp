@@ -0,0 +1,78 @@
+/**
+ * Trace Implementation
+ * Ring buffer and clock offset
+ */
+
+#include "trace.h"
+
+Tracer tracer;
+
+static const char* const POINT_NAMES[TP_COUNT] = {
+    "unknown", "pir_edge", "detection", "espnow_send", "espnow_recv", "espnow_ack",
+    "shutter", "jpeg_ready", "upload_start", "upload_end", "sms_prompt",
+    "sms_confirm", "backend_2xx"
+};
+
+Tracer::Tracer()
+    : head(0), count(0), baseIndex(0), dropped(0), offsetMs(0), clockSynced(false) {
+    lock = portMUX_INITIALIZER_UNLOCKED;
+}
+
+void Tracer::record(TracePoint point, uint32_t incidentId) {
+    recordAt(point, incidentId, millis());
+}
+
+void Tracer::recordAt(TracePoint point, uint32_t incidentId, unsigned long localMs) {
+    if (incidentId == 0) {
+        return;
+    }
+
+    portENTER_CRITICAL(&lock);
+    if (count == TRACE_BUFFER_SIZE) {
+        head = (head + 1) % TRACE_BUFFER_SIZE;
+        count--;
+        baseIndex++;
+        dropped++;
+    }
+    TraceRecord& rec = ring[(head + count) % TRACE_BUFFER_SIZE];
+    rec.incidentId = incidentId;
+    rec.timeMs = (uint32_t)(localMs + offsetMs);
+    rec.point = point;
+    count++;
+    portEXIT_CRITICAL(&lock);
+}
+
+void Tracer::setClockOffset(int32_t offset) {
+    portENTER_CRITICAL(&lock);
+    offsetMs = offset;
+    clockSynced = true;
+    portEXIT_CRITICAL(&lock);
+}
+
+int Tracer::peek(TraceRecord* out, int max, uint32_t& startIndex) {
+    portENTER_CRITICAL(&lock);
+    startIndex = baseIndex;
+    int n = count < max ? count : max;
+    for (int i = 0; i < n; i++) {
+        out[i] = ring[(head + i) % TRACE_BUFFER_SIZE];
+    }
+    portEXIT_CRITICAL(&lock);
+    return n;
+}
+
+void Tracer::consume(uint32_t endIndex) {
+    portENTER_CRITICAL(&lock);
+    // Records overwritten since peek() already moved baseIndex forward
+    uint32_t n = (int32_t)(endIndex - baseIndex) > 0 ? endIndex - baseIndex : 0;
+    if (n > count) {
+        n = count;
+    }
+    head = (head + n) % TRACE_BUFFER_SIZE;
+    count -= n;
+    baseIndex += n;
+    portEXIT_CRITICAL(&lock);
+}
+
+const char* Tracer::pointName(uint8_t point) {
+    return point < TP_COUNT ? POINT_NAMES[point] : POINT_NAMES[0];
+}
@@ -0,0 +1,77 @@
+/**
+ * Trace Module
+ * Fixed-size in-RAM buffer of alert pipeline timestamps
+ *
+ * Times are kept on the main controller's millis() clock: the main
+ * controller's offset is 0; the camera sets its offset from the sender
+ * timestamp of each ESP-NOW trigger. Records without an incident ID are
+ * not stored. When full, the oldest record is overwritten.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+
+#ifndef TRACE_BUFFER_SIZE
+#define TRACE_BUFFER_SIZE 64
+#endif
+
+enum TracePoint : uint8_t {
+    TP_PIR_EDGE = 1,    // main: first PIR rising edge of the detection window
+    TP_DETECTION,       // main: detection confirmed
+    TP_ESPNOW_SEND,     // main: first trigger frame sent
+    TP_ESPNOW_RECV,     // cam: trigger frame received
+    TP_ESPNOW_ACK,      // main: ack received
+    TP_SHUTTER,         // cam: frame grab started
+    TP_JPEG_READY,      // cam: JPEG frame buffer returned
+    TP_UPLOAD_START,    // cam: image upload started
+    TP_UPLOAD_END,      // cam: image upload got 2xx
+    TP_SMS_PROMPT,      // main: '>' prompt for the first alert SMS
+    TP_SMS_CONFIRM,     // main: +CMGS received
+    TP_BACKEND_2XX,     // main: alert accepted by the backend
+    TP_COUNT
+};
+
+struct __attribute__((packed)) TraceRecord {
+    uint32_t incidentId;
+    uint32_t timeMs;    // Main controller clock
+    uint8_t point;      // TracePoint
+};
+
+class Tracer {
+private:
+    TraceRecord ring[TRACE_BUFFER_SIZE];
+    uint16_t head;
+    uint16_t count;
+    uint32_t baseIndex;  // Absolute index of ring[head]
+    uint32_t dropped;
+    int32_t offsetMs;
+    bool clockSynced;
+    portMUX_TYPE lock;
+
+public:
+    Tracer();
+
+    // Safe from any task or callback
+    void record(TracePoint point, uint32_t incidentId);
+    void recordAt(TracePoint point, uint32_t incidentId, unsigned long localMs);
+
+    void setClockOffset(int32_t offset);
+    bool isClockSynced() const { return clockSynced; }
+
+    // Oldest first. startIndex receives the absolute index of out[0];
+    // after a successful export call consume(startIndex + n).
+    int peek(TraceRecord* out, int max, uint32_t& startIndex);
+    void consume(uint32_t endIndex);
+
+    int depth() const { return count; }
+    uint32_t getDropped() const { return dropped; }
+
+    static const char* pointName(uint8_t point);
+};
+
+extern Tracer tracer;
+
+#endif // TRACE_H
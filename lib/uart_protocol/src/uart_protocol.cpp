@@ -0,0 +1,103 @@
+/**
+ * UART Protocol Implementation
+ * COBS framing and frame encode/decode
+ */
+
+#include "uart_protocol.h"
+#include "espnow_protocol.h"
+
+size_t cobsEncode(const uint8_t* in, size_t len, uint8_t* out) {
+    size_t codeAt = 0;
+    size_t o = 1;
+    uint8_t code = 1;
+
+    for (size_t i = 0; i < len; i++) {
+        if (in[i] == 0) {
+            out[codeAt] = code;
+            codeAt = o++;
+            code = 1;
+            continue;
+        }
+        out[o++] = in[i];
+        if (++code == 0xFF) {
+            out[codeAt] = code;
+            codeAt = o++;
+            code = 1;
+        }
+    }
+    out[codeAt] = code;
+    return o;
+}
+
+size_t cobsDecode(const uint8_t* in, size_t len, uint8_t* out) {
+    size_t i = 0;
+    size_t o = 0;
+
+    while (i < len) {
+        uint8_t code = in[i++];
+        if (code == 0 || i + code - 1 > len) {
+            return 0;
+        }
+        for (uint8_t k = 1; k < code; k++) {
+            out[o++] = in[i++];
+        }
+        if (code < 0xFF && i < len) {
+            out[o++] = 0;
+        }
+    }
+    return o;
+}
+
+size_t uartEncode(uint8_t* out, size_t outLen, UartFrameType type, uint8_t seq,
+                  uint8_t flags, uint32_t incidentId,
+                  const uint8_t* payload, uint16_t payloadLen) {
+    if (payloadLen > UART_PAYLOAD_MAX || outLen < UART_WIRE_MAX) {
+        return 0;
+    }
+
+    uint8_t raw[UART_FRAME_RAW_MAX];
+    UartFrameHeader header;
+    header.version = UART_PROTOCOL_VERSION;
+    header.type = type;
+    header.seq = seq;
+    header.flags = flags;
+    header.incidentId = incidentId;
+    header.payloadLen = payloadLen;
+
+    memcpy(raw, &header, sizeof(header));
+    if (payloadLen > 0) {
+        memcpy(raw + sizeof(header), payload, payloadLen);
+    }
+    size_t crcOffset = sizeof(header) + payloadLen;
+    uint16_t crc = espnowCrc16(raw, crcOffset);
+    raw[crcOffset] = crc & 0xFF;
+    raw[crcOffset + 1] = crc >> 8;
+
+    size_t n = cobsEncode(raw, crcOffset + 2, out);
+    out[n++] = 0;
+    return n;
+}
+
+bool uartDecode(uint8_t* buf, size_t len, UartFrameHeader& header,
+                const uint8_t** payload) {
+    size_t n = cobsDecode(buf, len, buf);
+    if (n < sizeof(UartFrameHeader) + 2) {
+        return false;
+    }
+    memcpy(&header, buf, sizeof(header));
+
+    if (header.version != UART_PROTOCOL_VERSION ||
+        n != sizeof(header) + header.payloadLen + 2) {
+        return false;
+    }
+    size_t crcOffset = sizeof(header) + header.payloadLen;
+    uint16_t crc = buf[crcOffset] | (buf[crcOffset + 1] << 8);
+    if (crc != espnowCrc16(buf, crcOffset)) {
+        return false;
+    }
+
+    if (payload) {
+        *payload = buf + sizeof(header);
+    }
+    return true;
+}
@@ -0,0 +1,89 @@
+/**
+ * UART Protocol
+ * Framed binary link from the ESP32-CAM (TX) to the main controller (RX)
+ *
+ * Wire format: COBS(header, payload, CRC-16/CCITT) followed by a 0x00
+ * delimiter, so a receiver that joins mid-stream resynchronizes at the
+ * next zero byte. The UART is one-way (main GPIO35 is input-only);
+ * cumulative acks and thumbnail requests travel back over ESP-NOW
+ * (FRAME_LINK_ACK, FRAME_THUMB_REQUEST in espnow_protocol.h).
+ *
+ * The sender keeps up to UART_WINDOW unacked frames and resends them all
+ * (go-back-N) when the oldest is not acked in time. The receiver only
+ * accepts the next expected seq. UART_FLAG_RESYNC on a frame tells the
+ * receiver to take its seq as the new starting point (sender boot, or
+ * after the sender gave up on unacked frames).
+ */
+
+#ifndef UART_PROTOCOL_H
+#define UART_PROTOCOL_H
+
+#include <Arduino.h>
+
+#define UART_PROTOCOL_VERSION 1
+#define UART_PAYLOAD_MAX 240
+#define UART_WINDOW 8  // Unacked frames in flight
+
+// Wire size: header + payload + CRC, COBS adds 1 byte per 254, plus delimiter
+#define UART_FRAME_RAW_MAX (sizeof(UartFrameHeader) + UART_PAYLOAD_MAX + 2)
+#define UART_WIRE_MAX (UART_FRAME_RAW_MAX + UART_FRAME_RAW_MAX / 254 + 2)
+
+#define UART_FLAG_RESYNC 0x01
+
+enum UartFrameType : uint8_t {
+    UART_CAPTURE_REPORT = 1,  // CaptureReport
+    UART_UPLOAD_REPORT = 2,   // UploadReport
+    UART_THUMB_CHUNK = 3      // ThumbChunkHeader + JPEG bytes
+};
+
+struct __attribute__((packed)) UartFrameHeader {
+    uint8_t version;
+    uint8_t type;         // UartFrameType
+    uint8_t seq;          // Wraps; window arithmetic is mod 256
+    uint8_t flags;        // UART_FLAG_*
+    uint32_t incidentId;  // 0 = not tied to an alert
+    uint16_t payloadLen;
+};
+
+struct __attribute__((packed)) CaptureReport {
+    uint32_t jpegBytes;   // 0 if the capture failed
+    uint16_t captureMs;
+    uint16_t thumbBytes;  // Thumbnail held for a pull, 0 = none
+    uint8_t ok;
+};
+
+enum UploadResult : uint8_t {
+    UPLOAD_RESULT_OK = 0,
+    UPLOAD_RESULT_FAILED = 1,   // Backend or connection error; queued
+    UPLOAD_RESULT_OFFLINE = 2   // No WiFi; queued
+};
+
+struct __attribute__((packed)) UploadReport {
+    uint8_t result;       // UploadResult
+    uint8_t queued;       // Images waiting in SPIFFS afterwards
+    uint32_t uploadMs;
+};
+
+struct __attribute__((packed)) ThumbChunkHeader {
+    uint16_t offset;
+    uint16_t total;       // Whole thumbnail size
+};
+
+#define UART_THUMB_CHUNK_MAX (UART_PAYLOAD_MAX - sizeof(ThumbChunkHeader))
+
+// COBS without the delimiter; out needs len + len / 254 + 1 bytes
+size_t cobsEncode(const uint8_t* in, size_t len, uint8_t* out);
+// out may equal in (decoding in place); returns 0 on malformed input
+size_t cobsDecode(const uint8_t* in, size_t len, uint8_t* out);
+
+// Builds the wire bytes, delimiter included; returns 0 if it does not fit
+size_t uartEncode(uint8_t* out, size_t outLen, UartFrameType type, uint8_t seq,
+                  uint8_t flags, uint32_t incidentId,
+                  const uint8_t* payload = nullptr, uint16_t payloadLen = 0);
+
+// Decodes one delimited frame (without the 0x00) in place; payload
+// points into buf
+bool uartDecode(uint8_t* buf, size_t len, UartFrameHeader& header,
+                const uint8_t** payload = nullptr);
+
+#endif // UART_PROTOCOL_H
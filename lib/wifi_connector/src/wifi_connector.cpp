@@ -0,0 +1,421 @@
+/**
+ * WiFi Connector Implementation
+ */
+
+#include "wifi_connector.h"
+#include <limits.h>
+
+#define WIFI_CACHE_MAGIC 0x57464331  // "WFC1"
+#define WIFI_REASON_ASSOC_LEAVE 8    // Our own disconnect(), not a failed attempt
+
+WiFiConnector* WiFiConnector::instance = nullptr;
+
+static const char* stateName(WiFiLinkState state) {
+    switch (state) {
+        case WIFI_IDLE: return "idle";
+        case WIFI_CONNECTING: return "connecting";
+        case WIFI_SCANNING: return "scanning";
+        case WIFI_JOINING: return "joining";
+        case WIFI_UP: return "up";
+        case WIFI_BACKOFF: return "backing off";
+    }
+    return "?";
+}
+
+WiFiConnector::WiFiConnector(const WiFiNetwork* nets, size_t count,
+                             const WiFiConnectConfig& cfg)
+    : networks(nets), networkCount(count), config(cfg), cacheValid(false), leaseAt(0),
+      retry("wifi", { cfg.retryBaseMs, cfg.retryMaxMs, 0, 0 }), state(WIFI_IDLE),
+      roundAt(0), stateAt(0), staticIp(false), candidateCount(0), candidateNext(0),
+      refreshedAt(0), gotIp(false), dropped(false), dropReason(0),
+      sampleCount(0), sampleNext(0), fastOk(0), fastFailed(0), scanOk(0), scanFailed(0) {
+    memset(&cache, 0, sizeof(cache));
+    memset(&link, 0, sizeof(link));
+    lock = portMUX_INITIALIZER_UNLOCKED;
+}
+
+void WiFiConnector::begin() {
+    instance = this;
+    WiFi.setAutoReconnect(false);  // Rounds are driven from poll()
+    WiFi.onEvent(onEvent, ARDUINO_EVENT_WIFI_STA_GOT_IP);
+    WiFi.onEvent(onEvent, ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+    WiFi.onEvent(onEvent, ARDUINO_EVENT_WIFI_STA_LOST_IP);
+    setState(WIFI_BACKOFF);  // Nothing to wait for yet: the first poll() starts a round
+
+    if (!prefs.begin("wifi", false)) {
+        return;
+    }
+    cacheValid = prefs.getBytes("ap", &cache, sizeof(cache)) == sizeof(cache) &&
+                 cache.magic == WIFI_CACHE_MAGIC && findNetwork(cache.ssid) != nullptr;
+    if (cacheValid) {
+        Serial.printf("WiFi: cached access point %s on channel %u\n", cache.ssid, cache.channel);
+    }
+}
+
+// WiFi task context
+void WiFiConnector::onEvent(arduino_event_id_t event, arduino_event_info_t info) {
+    WiFiConnector* self = instance;
+    if (!self) {
+        return;
+    }
+    portENTER_CRITICAL(&self->lock);
+    if (event == ARDUINO_EVENT_WIFI_STA_GOT_IP) {
+        self->gotIp = true;
+    } else {
+        if (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED) {
+            self->dropReason = info.wifi_sta_disconnected.reason;
+        }
+        self->dropped = true;
+        // Readers on other tasks see the loss before the next poll()
+        self->link.up = false;
+        self->link.rssi = 0;
+        self->link.ip = 0;
+    }
+    portEXIT_CRITICAL(&self->lock);
+}
+
+const WiFiNetwork* WiFiConnector::findNetwork(const char* ssid) const {
+    for (size_t i = 0; i < networkCount; i++) {
+        if (strcmp(networks[i].ssid, ssid) == 0) {
+            return &networks[i];
+        }
+    }
+    return nullptr;
+}
+
+void WiFiConnector::setState(WiFiLinkState next) {
+    state = next;
+    stateAt = millis();
+    portENTER_CRITICAL(&lock);
+    link.state = next;
+    portEXIT_CRITICAL(&lock);
+}
+
+void WiFiConnector::startRound() {
+    roundAt = millis();
+    const WiFiNetwork* net = cacheValid ? findNetwork(cache.ssid) : nullptr;
+    if (!net) {
+        startScan();
+        return;
+    }
+    bool reuseIp = config.reuseIpMs > 0 && leaseAt != 0 && cache.ip != 0 &&
+                   millis() - leaseAt < config.reuseIpMs;
+    setState(WIFI_CONNECTING);
+    startAttempt(net, cache.channel, cache.bssid, reuseIp);
+}
+
+void WiFiConnector::startAttempt(const WiFiNetwork* net, uint8_t channel, const uint8_t* bssid,
+                                 bool useCachedIp) {
+    staticIp = useCachedIp;
+    if (staticIp) {
+        WiFi.config(IPAddress(cache.ip), IPAddress(cache.gateway), IPAddress(cache.subnet),
+                    IPAddress(cache.dns));
+    } else {
+        // All zero: back to DHCP
+        WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0), IPAddress((uint32_t)0));
+    }
+
+    // Events from an earlier attempt say nothing about this one
+    portENTER_CRITICAL(&lock);
+    gotIp = false;
+    dropped = false;
+    portEXIT_CRITICAL(&lock);
+
+    WiFi.begin(net->ssid, net->password, channel, bssid);
+}
+
+void WiFiConnector::startScan() {
+    WiFi.scanDelete();
+    setState(WIFI_SCANNING);
+    // Active scan with a short dwell per channel; results come in poll()
+    if (WiFi.scanNetworks(true, false, false, 120) == WIFI_SCAN_FAILED) {
+        Serial.println("WiFi: scan could not start");
+        scanFailed++;
+        roundFailed();
+    }
+}
+
+void WiFiConnector::takeScan(int found) {
+    // Configured networks in range, strongest first
+    candidateCount = 0;
+    candidateNext = 0;
+    for (int i = 0; i < found; i++) {
+        const WiFiNetwork* net = findNetwork(WiFi.SSID(i).c_str());
+        int8_t rssi = WiFi.RSSI(i);
+        if (!net || (candidateCount == WIFI_MAX_CANDIDATES &&
+                     rssi <= candidates[candidateCount - 1].rssi)) {
+            continue;
+        }
+        int j = candidateCount < WIFI_MAX_CANDIDATES ? candidateCount++ : candidateCount - 1;
+        while (j > 0 && candidates[j - 1].rssi < rssi) {
+            candidates[j] = candidates[j - 1];
+            j--;
+        }
+        candidates[j].net = net;
+        memcpy(candidates[j].bssid, WiFi.BSSID(i), sizeof(candidates[j].bssid));
+        candidates[j].channel = WiFi.channel(i);
+        candidates[j].rssi = rssi;
+    }
+    WiFi.scanDelete();
+
+    if (candidateCount == 0) {
+        Serial.printf("WiFi: none of %u configured networks in range (%d found)\n",
+                      (unsigned)networkCount, found > 0 ? found : 0);
+        scanFailed++;
+        roundFailed();
+        return;
+    }
+    nextCandidate();
+}
+
+void WiFiConnector::nextCandidate() {
+    if (candidateNext >= candidateCount) {
+        Serial.printf("WiFi: none of %u networks in range connected\n", candidateCount);
+        scanFailed++;
+        roundFailed();
+        return;
+    }
+    const Candidate& c = candidates[candidateNext++];
+    Serial.printf("WiFi: trying %s (%d dBm, channel %u)\n", c.net->ssid, c.rssi, c.channel);
+    setState(WIFI_JOINING);
+    startAttempt(c.net, c.channel, c.bssid, false);
+}
+
+void WiFiConnector::roundFailed() {
+    retry.onFailure();
+    setState(WIFI_BACKOFF);
+    Serial.printf("WiFi: next attempt in %lu s\n", retry.msUntilReady() / 1000);
+}
+
+WiFiLinkChange WiFiConnector::linkUp() {
+    unsigned long ms = millis() - roundAt;
+    noteSample(ms);
+    if (state == WIFI_CONNECTING) {
+        fastOk++;
+    } else {
+        scanOk++;
+    }
+    Serial.printf("WiFi: %s to %s (channel %d%s) in %lu ms\n",
+                  state == WIFI_CONNECTING ? "directed connect" : "connected after scan",
+                  WiFi.SSID().c_str(), (int)WiFi.channel(), staticIp ? ", cached IP" : "", ms);
+    remember(!staticIp);
+    retry.onSuccess();
+    setState(WIFI_UP);
+    publish(true, true);
+    if (staticIp) {
+        renewLease();
+    }
+    return WIFI_LINK_UP;
+}
+
+// The link stays up on the cached address while DHCP runs; the lease
+// shows up as another got-IP event
+void WiFiConnector::renewLease() {
+    WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0), IPAddress((uint32_t)0));
+}
+
+WiFiLinkChange WiFiConnector::linkLost(const char* why, uint8_t reason) {
+    Serial.printf("WiFi: %s (reason %u) - reconnecting\n", why, reason);
+    publish(false, true);
+    retry.reset();  // First attempt at once
+    startRound();
+    return WIFI_LINK_DOWN;
+}
+
+void WiFiConnector::publish(bool up, bool changed) {
+    int8_t rssi = up ? WiFi.RSSI() : 0;
+    uint8_t channel = up ? WiFi.channel() : 0;
+    uint32_t ip = up ? (uint32_t)WiFi.localIP() : 0;
+    refreshedAt = millis();
+
+    portENTER_CRITICAL(&lock);
+    link.up = up;
+    link.rssi = rssi;
+    link.channel = channel;
+    link.ip = ip;
+    if (changed) {
+        link.changedAt = refreshedAt;
+        if (!up) {
+            link.drops++;
+        }
+    }
+    portEXIT_CRITICAL(&lock);
+}
+
+WiFiLinkChange WiFiConnector::poll() {
+    portENTER_CRITICAL(&lock);
+    bool ip = gotIp;
+    bool drop = dropped;
+    uint8_t reason = dropReason;
+    gotIp = false;
+    dropped = false;
+    portEXIT_CRITICAL(&lock);
+
+    unsigned long now = millis();
+    switch (state) {
+        case WIFI_IDLE:
+            break;
+
+        case WIFI_UP:
+            if (drop || WiFi.status() != WL_CONNECTED) {
+                return linkLost("link lost", reason);
+            }
+            if (staticIp && ip) {
+                uint32_t cachedIp = cache.ip;
+                staticIp = false;
+                remember(true);
+                Serial.printf("WiFi: DHCP lease renewed%s\n",
+                              cache.ip == cachedIp ? "" : " - address changed");
+                publish(true, false);
+            } else if (staticIp && now - leaseAt >= config.reuseIpMs) {
+                // The cached address may be handed out again from now on
+                WiFi.disconnect();
+                return linkLost("no DHCP lease for the cached IP", 0);
+            }
+            if (now - refreshedAt >= WIFI_SNAPSHOT_MS) {
+                publish(true, false);
+            }
+            break;
+
+        case WIFI_CONNECTING:
+        case WIFI_JOINING: {
+            if (ip && WiFi.status() == WL_CONNECTED) {
+                return linkUp();
+            }
+            // No AP, wrong password and the like end the attempt early
+            bool refused = drop && reason != WIFI_REASON_ASSOC_LEAVE;
+            unsigned long timeoutMs = state == WIFI_CONNECTING ? config.fastTimeoutMs
+                                                               : config.scanTimeoutMs;
+            if (!refused && now - stateAt < timeoutMs) {
+                break;
+            }
+            WiFi.disconnect();  // A scan cannot run while the station is connecting
+            if (state == WIFI_CONNECTING) {
+                fastFailed++;
+                Serial.printf("WiFi: directed connect to %s failed (reason %u) - scanning\n",
+                              cache.ssid, refused ? reason : 0);
+                startScan();
+            } else {
+                nextCandidate();
+            }
+            break;
+        }
+
+        case WIFI_SCANNING: {
+            int found = WiFi.scanComplete();
+            if (found == WIFI_SCAN_RUNNING && now - stateAt < config.scanTimeoutMs) {
+                break;
+            }
+            takeScan(found);
+            break;
+        }
+
+        case WIFI_BACKOFF:
+            if (retry.ready()) {
+                startRound();
+            }
+            break;
+    }
+    return WIFI_NO_CHANGE;
+}
+
+unsigned long WiFiConnector::msUntilPoll() const {
+    switch (state) {
+        case WIFI_IDLE:
+            return ULONG_MAX;
+        case WIFI_UP:
+            return WIFI_SNAPSHOT_MS;
+        case WIFI_BACKOFF:
+            return retry.msUntilReady();
+        default:
+            return WIFI_ATTEMPT_POLL_MS;
+    }
+}
+
+bool WiFiConnector::connect() {
+    if (state == WIFI_UP) {
+        return true;
+    }
+    if (state == WIFI_BACKOFF || state == WIFI_IDLE) {
+        startRound();
+    }
+    while (state != WIFI_UP && state != WIFI_BACKOFF) {
+        poll();
+        delay(20);
+    }
+    return state == WIFI_UP;
+}
+
+void WiFiConnector::forget() {
+    cacheValid = false;
+    leaseAt = 0;
+    prefs.remove("ap");
+}
+
+WiFiLinkSnapshot WiFiConnector::snapshot() const {
+    portENTER_CRITICAL(&lock);
+    WiFiLinkSnapshot copy = link;
+    portEXIT_CRITICAL(&lock);
+    return copy;
+}
+
+void WiFiConnector::remember(bool usedDhcp) {
+    WiFiCache fresh;
+    memset(&fresh, 0, sizeof(fresh));
+    fresh.magic = WIFI_CACHE_MAGIC;
+    snprintf(fresh.ssid, sizeof(fresh.ssid), "%s", WiFi.SSID().c_str());
+    memcpy(fresh.bssid, WiFi.BSSID(), sizeof(fresh.bssid));
+    fresh.channel = WiFi.channel();
+    fresh.ip = WiFi.localIP();
+    fresh.gateway = WiFi.gatewayIP();
+    fresh.subnet = WiFi.subnetMask();
+    fresh.dns = WiFi.dnsIP();
+    if (usedDhcp) {
+        leaseAt = millis();
+    }
+
+    // Flash is only written when the access point or lease changed
+    if (!cacheValid || memcmp(&fresh, &cache, sizeof(fresh)) != 0) {
+        cache = fresh;
+        prefs.putBytes("ap", &cache, sizeof(cache));
+    }
+    cacheValid = true;
+}
+
+void WiFiConnector::noteSample(unsigned long ms) {
+    samples[sampleNext] = ms > 0xFFFF ? 0xFFFF : ms;
+    sampleNext = (sampleNext + 1) % WIFI_CONNECT_SAMPLES;
+    if (sampleCount < WIFI_CONNECT_SAMPLES) {
+        sampleCount++;
+    }
+}
+
+void WiFiConnector::printStats(const char* label) const {
+    WiFiLinkSnapshot s = snapshot();
+    Serial.printf("%s WiFi: %s, %d dBm, channel %u, %lu s since last change, %lu drops\n",
+                  label, stateName(s.state), s.rssi, s.channel,
+                  (millis() - s.changedAt) / 1000, (unsigned long)s.drops);
+    retry.printStats();
+
+    if (sampleCount == 0) {
+        Serial.printf("%s WiFi connects: none yet (%lu directed, %lu scans failed)\n", label,
+                      (unsigned long)fastFailed, (unsigned long)scanFailed);
+        return;
+    }
+    uint16_t sorted[WIFI_CONNECT_SAMPLES];
+    memcpy(sorted, samples, sampleCount * sizeof(uint16_t));
+    for (uint8_t i = 1; i < sampleCount; i++) {
+        uint16_t v = sorted[i];
+        int j = i;
+        while (j > 0 && sorted[j - 1] > v) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = v;
+    }
+    Serial.printf("%s WiFi connects (last %u): p50 %u ms, p90 %u ms, max %u ms; "
+                  "directed %lu ok / %lu failed, after scan %lu ok / %lu failed\n",
+                  label, sampleCount, sorted[sampleCount / 2], sorted[sampleCount * 9 / 10],
+                  sorted[sampleCount - 1], (unsigned long)fastOk, (unsigned long)fastFailed,
+                  (unsigned long)scanOk, (unsigned long)scanFailed);
+}
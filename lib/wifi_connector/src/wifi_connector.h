@@ -0,0 +1,176 @@
+/**
+ * WiFi Connector
+ * Event-driven station link: directed reconnects, scan as the fallback
+ *
+ * After every successful connect the SSID, BSSID and channel are stored
+ * in NVS, so the next attempt (after a drop or a reboot) goes straight to
+ * that access point on that channel with no scan. The IP settings are
+ * kept too. They are reused as a static configuration, skipping DHCP,
+ * but only on reconnects within reuseIpMs of the last DHCP lease in this
+ * boot. An address left over from before a reboot or a long outage may
+ * have been handed to another device by then. Once a static reconnect is
+ * up, DHCP restarts in the background to renew the lease; if no lease
+ * arrives by reuseIpMs after the last one, the link is dropped and
+ * rejoined with DHCP rather than keep an address that may be reassigned.
+ *
+ * If the directed attempt fails, the connector scans and tries the
+ * configured networks it can see, strongest first, with DHCP. When all
+ * of them fail it backs off (retry_policy.h) before the next round. A
+ * drop starts a new round at once.
+ *
+ * Nothing here waits on the radio. WiFi events (got IP, disconnected)
+ * arrive on the WiFi task and only set flags; the owner calls poll()
+ * from its own loop, which advances the state machine and never blocks.
+ * The link snapshot may be read from any task.
+ */
+
+#ifndef WIFI_CONNECTOR_H
+#define WIFI_CONNECTOR_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <Preferences.h>
+#include <freertos/FreeRTOS.h>
+#include "retry_policy.h"
+
+// Connect times kept for the percentiles
+#define WIFI_CONNECT_SAMPLES 32
+// Scanned access points tried per round
+#define WIFI_MAX_CANDIDATES 8
+// RSSI refresh in the snapshot while the link is up
+#define WIFI_SNAPSHOT_MS 1000
+// poll() interval the owner should keep while an attempt is running
+#define WIFI_ATTEMPT_POLL_MS 50
+
+struct WiFiNetwork {
+    const char* ssid;
+    const char* password;
+};
+
+struct WiFiConnectConfig {
+    unsigned long fastTimeoutMs;   // Directed attempt to the cached access point
+    unsigned long scanTimeoutMs;   // Each attempt after a scan
+    unsigned long reuseIpMs;       // Static IP from the last lease this young, 0 = never
+    unsigned long retryBaseMs;     // Wait after a failed round, doubles per failure
+    unsigned long retryMaxMs;
+};
+
+enum WiFiLinkState : uint8_t {
+    WIFI_IDLE,         // begin() not called
+    WIFI_CONNECTING,   // Directed attempt to the cached access point
+    WIFI_SCANNING,
+    WIFI_JOINING,      // Attempt at a scanned access point
+    WIFI_UP,
+    WIFI_BACKOFF,      // Round failed, waiting for the next one
+};
+
+// What a poll() changed, for the owner's side effects
+enum WiFiLinkChange : uint8_t {
+    WIFI_NO_CHANGE,
+    WIFI_LINK_UP,
+    WIFI_LINK_DOWN,
+};
+
+struct WiFiLinkSnapshot {
+    WiFiLinkState state;
+    bool up;
+    int8_t rssi;               // dBm, 0 while down
+    uint8_t channel;
+    uint32_t ip;               // As WiFi.localIP(), 0 while down
+    unsigned long changedAt;   // millis() of the last up/down change
+    uint32_t drops;
+};
+
+class WiFiConnector {
+private:
+    // NVS blob
+    struct WiFiCache {
+        uint32_t magic;
+        char ssid[33];
+        uint8_t bssid[6];
+        uint8_t channel;
+        uint32_t ip;
+        uint32_t gateway;
+        uint32_t subnet;
+        uint32_t dns;
+    };
+
+    // Scan result kept after scanDelete()
+    struct Candidate {
+        const WiFiNetwork* net;
+        uint8_t bssid[6];
+        uint8_t channel;
+        int8_t rssi;
+    };
+
+    const WiFiNetwork* networks;
+    size_t networkCount;
+    WiFiConnectConfig config;
+    Preferences prefs;
+    WiFiCache cache;
+    bool cacheValid;
+    unsigned long leaseAt;         // DHCP lease seen this boot, 0 = none
+    RetryPolicy retry;             // Between failed rounds
+
+    WiFiLinkState state;
+    unsigned long roundAt;         // Connect times count from here
+    unsigned long stateAt;         // Current attempt or scan started
+    bool staticIp;                 // Link runs on the cached IP, no lease yet
+    Candidate candidates[WIFI_MAX_CANDIDATES];
+    uint8_t candidateCount;
+    uint8_t candidateNext;
+    unsigned long refreshedAt;
+
+    // Set from WiFi events; snapshot also read by other tasks
+    static WiFiConnector* instance;
+    mutable portMUX_TYPE lock;
+    volatile bool gotIp;
+    volatile bool dropped;
+    uint8_t dropReason;
+    WiFiLinkSnapshot link;
+
+    uint16_t samples[WIFI_CONNECT_SAMPLES];  // ms, ring
+    uint8_t sampleCount;
+    uint8_t sampleNext;
+    uint32_t fastOk;
+    uint32_t fastFailed;
+    uint32_t scanOk;
+    uint32_t scanFailed;
+
+    static void onEvent(arduino_event_id_t event, arduino_event_info_t info);
+
+    const WiFiNetwork* findNetwork(const char* ssid) const;
+    void setState(WiFiLinkState next);
+    void startRound();
+    void startAttempt(const WiFiNetwork* net, uint8_t channel, const uint8_t* bssid,
+                      bool useCachedIp);
+    void startScan();
+    void takeScan(int found);
+    void nextCandidate();
+    void roundFailed();
+    WiFiLinkChange linkUp();
+    WiFiLinkChange linkLost(const char* why, uint8_t reason);
+    void renewLease();
+    void publish(bool up, bool changed);
+    void remember(bool usedDhcp);
+    void noteSample(unsigned long ms);
+
+public:
+    WiFiConnector(const WiFiNetwork* nets, size_t count, const WiFiConnectConfig& cfg);
+
+    // Loads the cache from NVS and hooks the WiFi events; connecting
+    // starts with connect() or the first poll()
+    void begin();
+    // Owner's loop: advances the state machine, never blocks
+    WiFiLinkChange poll();
+    unsigned long msUntilPoll() const;
+    // Setup only: one full round, blocking until it ends
+    bool connect();
+    void forget();  // Drop the cache; next round scans
+
+    bool isUp() const { return link.up; }
+    WiFiLinkSnapshot snapshot() const;
+    void printStats(const char* label) const;
+};
+
+#endif // WIFI_CONNECTOR_H
@@ -0,0 +1,83 @@
+/**
+ * Wire Format Implementation
+ */
+
+#include "wire_format.h"
+
+WireFormat::WireFormat() : offered(false), rejected(false) {
+    memset(&stats, 0, sizeof(stats));
+}
+
+bool WireFormat::isMsgPack(const char* contentType) {
+    return contentType &&
+           strncmp(contentType, MSGPACK_CONTENT_TYPE, sizeof(MSGPACK_CONTENT_TYPE) - 1) == 0;
+}
+
+void WireFormat::noteResponse(const char* acceptPost, int httpCode, const char* sentContentType) {
+    if (httpCode == HTTP_UNSUPPORTED_MEDIA_TYPE && isMsgPack(sentContentType)) {
+        if (!rejected) {
+            Serial.println("Backend refused MessagePack - back to JSON");
+        }
+        rejected = true;
+        return;
+    }
+    if (acceptPost && strstr(acceptPost, MSGPACK_CONTENT_TYPE) && !offered) {
+        offered = true;
+        if (!rejected) {
+            Serial.println("Backend accepts MessagePack - switching wire format");
+        }
+    }
+}
+
+size_t WireFormat::serialize(const JsonDocument& doc, bool msgpack, uint8_t* out, size_t outLen) {
+    // The measure pass walks the document like a real serialization, so
+    // its time stands in for the encoding we did not send
+    uint32_t start = micros();
+    size_t len = msgpack ? serializeMsgPack(doc, out, outLen) : serializeJson(doc, out, outLen);
+    uint32_t sentUs = micros() - start;
+
+    start = micros();
+    size_t otherLen = msgpack ? measureJson(doc) : measureMsgPack(doc);
+    uint32_t otherUs = micros() - start;
+
+    // Truncation is silent; a body that fills the buffer is treated as cut
+    if (len == 0 || len + 1 >= outLen) {
+        return 0;
+    }
+
+    stats.bodies++;
+    stats.bytes += len;
+    if (msgpack) {
+        stats.msgpackBodies++;
+        stats.msgpackBytes += len;
+        stats.msgpackUs += sentUs;
+        stats.jsonBytes += otherLen;
+        stats.jsonUs += otherUs;
+    } else {
+        stats.jsonBytes += len;
+        stats.jsonUs += sentUs;
+        stats.msgpackBytes += otherLen;
+        stats.msgpackUs += otherUs;
+    }
+    return len;
+}
+
+const char* WireFormat::contentType(bool msgpack, bool compact) {
+    if (msgpack) {
+        return compact ? MSGPACK_CONTENT_TYPE "; profile=compact" : MSGPACK_CONTENT_TYPE;
+    }
+    return compact ? "application/json; profile=compact" : "application/json";
+}
+
+void WireFormat::printStats(const char* label) const {
+    if (stats.bodies == 0) {
+        return;
+    }
+    Serial.printf("%s wire format: %s, %lu bodies (%lu MessagePack), %lu B sent; "
+                  "JSON %lu B / %lu us, MessagePack %lu B / %lu us\n",
+                  label, useMsgPack() ? "MessagePack" : "JSON",
+                  (unsigned long)stats.bodies, (unsigned long)stats.msgpackBodies,
+                  (unsigned long)stats.bytes,
+                  (unsigned long)stats.jsonBytes, (unsigned long)stats.jsonUs,
+                  (unsigned long)stats.msgpackBytes, (unsigned long)stats.msgpackUs);
+}
@@ -0,0 +1,57 @@
+/**
+ * Wire Format Module
+ * JSON or MessagePack bodies for device -> backend posts
+ *
+ * Bodies are built as ArduinoJson documents. They go out as MessagePack
+ * (application/msgpack) once the backend lists that type in an
+ * Accept-Post response header, and as JSON until then. Keys and values
+ * are the same in both encodings. A 415 reply to a MessagePack body
+ * switches the device back to JSON until reboot.
+ *
+ * Every body also measures the other encoding, so the heartbeat log
+ * compares bytes and serialization time of both on real payloads.
+ */
+
+#ifndef WIRE_FORMAT_H
+#define WIRE_FORMAT_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#define MSGPACK_CONTENT_TYPE "application/msgpack"
+#define HTTP_UNSUPPORTED_MEDIA_TYPE 415
+
+struct WireStats {
+    uint32_t bodies;
+    uint32_t msgpackBodies;
+    uint32_t bytes;          // As sent
+    uint32_t jsonBytes;      // Same bodies as JSON
+    uint32_t msgpackBytes;   // Same bodies as MessagePack
+    uint32_t jsonUs;         // Serialization time, summed
+    uint32_t msgpackUs;
+};
+
+class WireFormat {
+private:
+    bool offered;    // Backend advertised MessagePack
+    bool rejected;   // Backend answered 415 to it
+    WireStats stats;
+
+public:
+    WireFormat();
+
+    bool useMsgPack() const { return offered && !rejected; }
+    static bool isMsgPack(const char* contentType);
+
+    // From any response: the Accept-Post value (nullptr if absent) and status
+    void noteResponse(const char* acceptPost, int httpCode, const char* sentContentType);
+
+    // Returns the body length, 0 if it does not fit
+    size_t serialize(const JsonDocument& doc, bool msgpack, uint8_t* out, size_t outLen);
+    static const char* contentType(bool msgpack, bool compact = false);
+
+    WireStats getStats() const { return stats; }
+    void printStats(const char* label) const;
+};
+
+#endif // WIRE_FORMAT_H
@@ -0,0 +1,258 @@
+/**
+ * Host Arduino Core (native tests)
+ * Simulated clock, GPIO, Print/Stream and a buffered HardwareSerial
+ *
+ * Serial (the console) is discarded unless FAKE_SERIAL_ECHO is set in
+ * the environment.
+ */
+
+#ifndef FAKE_ARDUINO_H
+#define FAKE_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include <string>
+#include <deque>
+#include "fake_clock.h"
+#include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+#define IRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 1
+#define OUTPUT 2
+#define INPUT_PULLUP 3
+#define INPUT_PULLDOWN 4
+#define SERIAL_8N1 0
+
+typedef uint8_t byte;
+
+// ==================== TIME ====================
+
+inline void delay(unsigned long ms) { fakeAdvance(ms); }
+inline void delayMicroseconds(unsigned int us) { fakeAdvanceUs(us); }
+inline void yield() {}
+
+// ==================== GPIO ====================
+
+#define FAKE_PIN_COUNT 40
+
+inline int fakePinLevel[FAKE_PIN_COUNT];
+inline int fakePinMode[FAKE_PIN_COUNT];
+
+inline void pinMode(int pin, int mode) {
+    if (pin >= 0 && pin < FAKE_PIN_COUNT) fakePinMode[pin] = mode;
+}
+inline void digitalWrite(int pin, int level) {
+    if (pin >= 0 && pin < FAKE_PIN_COUNT) fakePinLevel[pin] = level;
+}
+inline int digitalRead(int pin) {
+    return pin >= 0 && pin < FAKE_PIN_COUNT ? fakePinLevel[pin] : LOW;
+}
+
+// ==================== STRING ====================
+
+class String {
+private:
+    std::string s;
+
+public:
+    String() {}
+    String(const char* c) : s(c ? c : "") {}
+    String(const std::string& x) : s(x) {}
+    String(char c) : s(1, c) {}
+    String(int v) : s(std::to_string(v)) {}
+    String(unsigned int v) : s(std::to_string(v)) {}
+    String(long v) : s(std::to_string(v)) {}
+    String(unsigned long v) : s(std::to_string(v)) {}
+
+    const char* c_str() const { return s.c_str(); }
+    unsigned int length() const { return s.size(); }
+    bool isEmpty() const { return s.empty(); }
+    char operator[](unsigned int i) const { return i < s.size() ? s[i] : 0; }
+
+    int indexOf(char c, unsigned int from = 0) const {
+        size_t p = s.find(c, from);
+        return p == std::string::npos ? -1 : (int)p;
+    }
+    int indexOf(const char* x, unsigned int from = 0) const {
+        size_t p = s.find(x, from);
+        return p == std::string::npos ? -1 : (int)p;
+    }
+    String substring(unsigned int from) const { return from < s.size() ? String(s.substr(from)) : String(); }
+    String substring(unsigned int from, unsigned int to) const {
+        return from < s.size() && to > from ? String(s.substr(from, to - from)) : String();
+    }
+    bool startsWith(const char* x) const { return s.compare(0, strlen(x), x) == 0; }
+    bool endsWith(const char* x) const {
+        size_t n = strlen(x);
+        return s.size() >= n && s.compare(s.size() - n, n, x) == 0;
+    }
+    long toInt() const { return atol(s.c_str()); }
+    void trim() {
+        size_t a = s.find_first_not_of(" \t\r\n");
+        size_t b = s.find_last_not_of(" \t\r\n");
+        s = a == std::string::npos ? std::string() : s.substr(a, b - a + 1);
+    }
+
+    String& operator+=(const String& x) { s += x.s; return *this; }
+    String& operator+=(const char* x) { s += x; return *this; }
+    String& operator+=(char c) { s += c; return *this; }
+    bool operator==(const String& x) const { return s == x.s; }
+    bool operator==(const char* x) const { return s == x; }
+    bool operator!=(const char* x) const { return s != x; }
+    friend String operator+(const String& a, const String& b) { return String(a.s + b.s); }
+    friend String operator+(const String& a, const char* b) { return String(a.s + b); }
+    friend String operator+(const char* a, const String& b) { return String(a + b.s); }
+};
+
+// ==================== IPADDRESS ====================
+
+class IPAddress {
+private:
+    uint32_t addr;
+
+public:
+    IPAddress() : addr(0) {}
+    IPAddress(uint32_t a) : addr(a) {}
+    // Stored little endian, as on the ESP32: first octet in the low byte
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+        : addr(a | (b << 8) | (c << 16) | ((uint32_t)d << 24)) {}
+    operator uint32_t() const { return addr; }
+    uint8_t operator[](int i) const { return (addr >> (8 * i)) & 0xFF; }
+    bool operator==(const IPAddress& other) const { return addr == other.addr; }
+    String toString() const {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+        return String(buf);
+    }
+};
+
+// ==================== PRINT / STREAM ====================
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size) {
+        size_t n = 0;
+        while (n < size && write(buffer[n])) n++;
+        return n;
+    }
+    size_t write(const char* str) { return str ? write((const uint8_t*)str, strlen(str)) : 0; }
+    size_t write(const char* buffer, size_t size) { return write((const uint8_t*)buffer, size); }
+    virtual void flush() {}
+
+    size_t print(const char* str) { return write(str); }
+    size_t print(const String& str) { return write(str.c_str()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int v, int base = 10) { return print((long)v, base); }
+    size_t print(unsigned int v, int base = 10) { return print((unsigned long)v, base); }
+    size_t print(long v, int base = 10) { return printf(base == 16 ? "%lx" : "%ld", v); }
+    size_t print(unsigned long v, int base = 10) { return printf(base == 16 ? "%lx" : "%lu", v); }
+    size_t print(double v, int digits = 2) { return printf("%.*f", digits, v); }
+    size_t print(const IPAddress& ip) { return print(ip.toString()); }
+
+    size_t println() { return write("\r\n"); }
+    template <typename T>
+    size_t println(const T& v) { size_t n = print(v); return n + println(); }
+    template <typename T>
+    size_t println(const T& v, int format) { size_t n = print(v, format); return n + println(); }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+        char buf[512];
+        va_list args;
+        va_start(args, format);
+        int len = vsnprintf(buf, sizeof(buf), format, args);
+        va_end(args);
+        if (len < 0) return 0;
+        return write((const uint8_t*)buf, (size_t)len < sizeof(buf) ? (size_t)len : sizeof(buf) - 1);
+    }
+};
+
+class Stream : public Print {
+protected:
+    unsigned long timeoutMs = 1000;
+
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+
+    void setTimeout(unsigned long ms) { timeoutMs = ms; }
+    // No waiting: whatever is buffered now
+    size_t readBytes(uint8_t* buffer, size_t length) {
+        size_t n = 0;
+        while (n < length && available() > 0) buffer[n++] = (uint8_t)read();
+        return n;
+    }
+    size_t readBytes(char* buffer, size_t length) { return readBytes((uint8_t*)buffer, length); }
+};
+
+// Loopback-style UART: tests inject() what the far end sends and take
+// what the firmware wrote from tx
+class HardwareSerial : public Stream {
+public:
+    std::deque<uint8_t> rx;
+    std::string tx;
+    unsigned long baud = 0;
+    bool echo = false;  // Copy writes to stdout (the console)
+    size_t rxBufferSize = 256;
+
+    explicit HardwareSerial(int uartNum = 0) {}
+    void begin(unsigned long speed, uint32_t config = SERIAL_8N1, int rxPin = -1, int txPin = -1) {
+        baud = speed;
+    }
+    void end() {}
+    size_t setRxBufferSize(size_t size) { rxBufferSize = size; return size; }
+    size_t setTxBufferSize(size_t size) { return size; }
+
+    int available() override { return (int)rx.size(); }
+    int read() override {
+        if (rx.empty()) return -1;
+        int c = rx.front();
+        rx.pop_front();
+        return c;
+    }
+    int peek() override { return rx.empty() ? -1 : rx.front(); }
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buffer, size_t size) override {
+        if (echo) fwrite(buffer, 1, size, stdout);
+        else tx.append((const char*)buffer, size);
+        return size;
+    }
+    using Print::write;
+    int availableForWrite() { return 128; }
+    operator bool() const { return true; }
+
+    void inject(const uint8_t* data, size_t len) { rx.insert(rx.end(), data, data + len); }
+    void inject(const char* text) { inject((const uint8_t*)text, strlen(text)); }
+    std::string takeTx() { std::string out; out.swap(tx); return out; }
+};
+
+struct FakeConsole : HardwareSerial {
+    FakeConsole() : HardwareSerial(0) { echo = getenv("FAKE_SERIAL_ECHO") != nullptr; }
+    size_t write(const uint8_t* buffer, size_t size) override {
+        if (echo) fwrite(buffer, 1, size, stdout);
+        return size;  // Console output is not kept
+    }
+    using HardwareSerial::write;
+};
+
+inline FakeConsole Serial;
+inline HardwareSerial Serial1(1);
+inline HardwareSerial Serial2(2);
+
+#endif // FAKE_ARDUINO_H
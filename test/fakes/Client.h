@@ -0,0 +1,60 @@
+/**
+ * Host Arduino Client interface (native tests)
+ */
+
+#ifndef FAKE_CLIENT_H
+#define FAKE_CLIENT_H
+
+#include "Arduino.h"
+
+class Client : public Stream {
+public:
+    virtual int connect(IPAddress ip, uint16_t port) = 0;
+    virtual int connect(const char* host, uint16_t port) = 0;
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buf, size_t size) = 0;
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int read(uint8_t* buf, size_t size) = 0;
+    virtual int peek() = 0;
+    virtual void flush() {}
+    virtual void stop() = 0;
+    virtual uint8_t connected() = 0;
+    virtual operator bool() { return connected(); }
+    using Print::write;
+};
+
+// Client that hands the connection to a server object the test installed
+// in *route when connect() is called; no server = no route to host
+class FakeRoutedClient : public Client {
+private:
+    Client** route;
+    Client* remote;
+
+public:
+    explicit FakeRoutedClient(Client** server) : route(server), remote(nullptr) {}
+
+    int connect(IPAddress ip, uint16_t port) override { return connect(ip.toString().c_str(), port); }
+    int connect(const char* host, uint16_t port) override {
+        remote = *route;
+        if (!remote || !remote->connect(host, port)) {
+            remote = nullptr;
+            return 0;
+        }
+        return 1;
+    }
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buf, size_t size) override { return remote ? remote->write(buf, size) : 0; }
+    int available() override { return remote ? remote->available() : 0; }
+    int read() override { return remote ? remote->read() : -1; }
+    int read(uint8_t* buf, size_t size) override { return remote ? remote->read(buf, size) : -1; }
+    int peek() override { return remote ? remote->peek() : -1; }
+    void stop() override {
+        if (remote) remote->stop();
+        remote = nullptr;
+    }
+    uint8_t connected() override { return remote && remote->connected(); }
+    using Print::write;
+};
+
+#endif // FAKE_CLIENT_H
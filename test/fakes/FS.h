@@ -0,0 +1,139 @@
+/**
+ * Host filesystem (native tests)
+ * Files are byte vectors in one process-wide map keyed by path, so they
+ * survive a simulated reboot; fakeFsErase() formats.
+ */
+
+#ifndef FAKE_FS_H
+#define FAKE_FS_H
+
+#include "Arduino.h"
+#include <map>
+#include <memory>
+#include <vector>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+inline std::map<std::string, std::shared_ptr<std::vector<uint8_t>>> fakeFiles;
+
+inline void fakeFsErase() { fakeFiles.clear(); }
+
+namespace fs {
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+class File : public Stream {
+private:
+    std::string path_;
+    std::shared_ptr<std::vector<uint8_t>> data;
+    size_t pos = 0;
+    bool writable = false;
+    bool dir = false;
+    size_t dirNext = 0;
+
+public:
+    File() {}
+    File(const std::string& path, std::shared_ptr<std::vector<uint8_t>> d, bool w)
+        : path_(path), data(d), writable(w) {}
+    static File directory(const std::string& path) {
+        File f;
+        f.path_ = path;
+        f.dir = true;
+        return f;
+    }
+
+    operator bool() const { return data != nullptr || dir; }
+    bool isDirectory() const { return dir; }
+    const char* name() const { return path_.c_str(); }
+    const char* path() const { return path_.c_str(); }
+    size_t size() const { return data ? data->size() : 0; }
+    size_t position() const { return pos; }
+    bool seek(uint32_t offset, SeekMode mode = SeekSet) {
+        size_t base = mode == SeekSet ? 0 : mode == SeekCur ? pos : size();
+        if (!data || base + offset > size()) return false;
+        pos = base + offset;
+        return true;
+    }
+    void close() {
+        data.reset();
+        dir = false;
+    }
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buf, size_t len) override {
+        if (!data || !writable) return 0;
+        if (pos + len > data->size()) data->resize(pos + len);
+        memcpy(data->data() + pos, buf, len);
+        pos += len;
+        return len;
+    }
+    using Print::write;
+    int available() override { return data ? (int)(data->size() - pos) : 0; }
+    int read() override { return available() > 0 ? (*data)[pos++] : -1; }
+    int peek() override { return available() > 0 ? (*data)[pos] : -1; }
+    size_t read(uint8_t* buf, size_t len) {
+        size_t n = available() < (int)len ? (size_t)available() : len;
+        if (n) memcpy(buf, data->data() + pos, n);
+        pos += n;
+        return n;
+    }
+
+    // Directory listing: files whose path starts with this directory's
+    File openNextFile(const char* mode = FILE_READ) {
+        std::string prefix = path_ == "/" ? "/" : path_ + "/";
+        size_t i = 0;
+        for (auto& entry : fakeFiles) {
+            if (entry.first.compare(0, prefix.size(), prefix) != 0) continue;
+            if (i++ == dirNext) {
+                dirNext++;
+                return File(entry.first, entry.second, false);
+            }
+        }
+        return File();
+    }
+    void rewindDirectory() { dirNext = 0; }
+};
+
+class FS {
+public:
+    File open(const char* path, const char* mode = FILE_READ, bool create = false) {
+        std::string p = path;
+        if (p == "/") return File::directory(p);
+        auto it = fakeFiles.find(p);
+        if (mode[0] == 'r') {
+            return it == fakeFiles.end() ? File() : File(p, it->second, false);
+        }
+        if (it == fakeFiles.end() || mode[0] == 'w') {
+            fakeFiles[p] = std::make_shared<std::vector<uint8_t>>();
+        }
+        File f(p, fakeFiles[p], true);
+        if (mode[0] == 'a') f.seek(0, SeekEnd);
+        return f;
+    }
+    File open(const String& path, const char* mode = FILE_READ, bool create = false) {
+        return open(path.c_str(), mode, create);
+    }
+    bool exists(const char* path) { return fakeFiles.count(path) > 0; }
+    bool exists(const String& path) { return exists(path.c_str()); }
+    bool remove(const char* path) { return fakeFiles.erase(path) > 0; }
+    bool remove(const String& path) { return remove(path.c_str()); }
+    bool rename(const char* from, const char* to) {
+        auto it = fakeFiles.find(from);
+        if (it == fakeFiles.end()) return false;
+        fakeFiles[to] = it->second;
+        fakeFiles.erase(from);
+        return true;
+    }
+};
+
+}  // namespace fs
+
+using fs::File;
+using fs::FS;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
+
+#endif // FAKE_FS_H
@@ -0,0 +1,34 @@
+/**
+ * Host HTTPClient (native tests): status code names only
+ */
+
+#ifndef FAKE_HTTP_CLIENT_H
+#define FAKE_HTTP_CLIENT_H
+
+#include "WiFiClient.h"
+
+#define HTTP_CODE_CONTINUE 100
+#define HTTP_CODE_OK 200
+#define HTTP_CODE_CREATED 201
+#define HTTP_CODE_ACCEPTED 202
+#define HTTP_CODE_NO_CONTENT 204
+#define HTTP_CODE_MULTI_STATUS 207
+#define HTTP_CODE_PERMANENT_REDIRECT 308
+#define HTTP_CODE_BAD_REQUEST 400
+#define HTTP_CODE_UNAUTHORIZED 401
+#define HTTP_CODE_FORBIDDEN 403
+#define HTTP_CODE_NOT_FOUND 404
+#define HTTP_CODE_METHOD_NOT_ALLOWED 405
+#define HTTP_CODE_CONFLICT 409
+#define HTTP_CODE_GONE 410
+#define HTTP_CODE_PAYLOAD_TOO_LARGE 413
+#define HTTP_CODE_UNSUPPORTED_MEDIA_TYPE 415
+#define HTTP_CODE_UNPROCESSABLE_ENTITY 422
+#define HTTP_CODE_TOO_MANY_REQUESTS 429
+#define HTTP_CODE_INTERNAL_SERVER_ERROR 500
+#define HTTP_CODE_NOT_IMPLEMENTED 501
+#define HTTP_CODE_BAD_GATEWAY 502
+#define HTTP_CODE_SERVICE_UNAVAILABLE 503
+#define HTTP_CODE_GATEWAY_TIMEOUT 504
+
+#endif // FAKE_HTTP_CLIENT_H
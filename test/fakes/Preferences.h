@@ -0,0 +1,96 @@
+/**
+ * Host NVS Preferences (native tests)
+ * Namespaces live in one process-wide map, so a second Preferences
+ * object opened after a simulated reboot sees what the first one wrote.
+ * fakeNvsErase() is a factory reset; fakeNvsWrites counts flash writes.
+ */
+
+#ifndef FAKE_PREFERENCES_H
+#define FAKE_PREFERENCES_H
+
+#include "Arduino.h"
+#include <map>
+#include <vector>
+
+inline std::map<std::string, std::map<std::string, std::vector<uint8_t>>> fakeNvs;
+
+inline unsigned fakeNvsWrites = 0;
+
+inline void fakeNvsErase() { fakeNvs.clear(); }
+
+class Preferences {
+private:
+    std::string ns;
+    bool open = false;
+    bool readOnly = false;
+
+    std::vector<uint8_t>* find(const char* key) {
+        if (!open) return nullptr;
+        auto& space = fakeNvs[ns];
+        auto it = space.find(key);
+        return it == space.end() ? nullptr : &it->second;
+    }
+
+    size_t put(const char* key, const void* value, size_t len) {
+        if (!open || readOnly) return 0;
+        fakeNvsWrites++;
+        fakeNvs[ns][key].assign((const uint8_t*)value, (const uint8_t*)value + len);
+        return len;
+    }
+
+    template <typename T>
+    T get(const char* key, T defaultValue) {
+        std::vector<uint8_t>* v = find(key);
+        if (!v || v->size() != sizeof(T)) return defaultValue;
+        T out;
+        memcpy(&out, v->data(), sizeof(T));
+        return out;
+    }
+
+public:
+    bool begin(const char* name, bool ro = false) {
+        ns = name;
+        open = true;
+        readOnly = ro;
+        return true;
+    }
+    void end() { open = false; }
+    bool clear() {
+        if (!open || readOnly) return false;
+        fakeNvs[ns].clear();
+        return true;
+    }
+    bool remove(const char* key) { return open && !readOnly && fakeNvs[ns].erase(key) > 0; }
+    bool isKey(const char* key) { return find(key) != nullptr; }
+
+    size_t putBytes(const char* key, const void* value, size_t len) { return put(key, value, len); }
+    size_t getBytesLength(const char* key) {
+        std::vector<uint8_t>* v = find(key);
+        return v ? v->size() : 0;
+    }
+    size_t getBytes(const char* key, void* buf, size_t maxLen) {
+        std::vector<uint8_t>* v = find(key);
+        if (!v || v->size() > maxLen) return 0;
+        memcpy(buf, v->data(), v->size());
+        return v->size();
+    }
+
+    size_t putUChar(const char* key, uint8_t value) { return put(key, &value, sizeof(value)); }
+    size_t putUShort(const char* key, uint16_t value) { return put(key, &value, sizeof(value)); }
+    size_t putInt(const char* key, int32_t value) { return put(key, &value, sizeof(value)); }
+    size_t putUInt(const char* key, uint32_t value) { return put(key, &value, sizeof(value)); }
+    size_t putULong(const char* key, uint32_t value) { return put(key, &value, sizeof(value)); }
+    uint8_t getUChar(const char* key, uint8_t d = 0) { return get(key, d); }
+    uint16_t getUShort(const char* key, uint16_t d = 0) { return get(key, d); }
+    int32_t getInt(const char* key, int32_t d = 0) { return get(key, d); }
+    uint32_t getUInt(const char* key, uint32_t d = 0) { return get(key, d); }
+    uint32_t getULong(const char* key, uint32_t d = 0) { return get(key, d); }
+
+    size_t putString(const char* key, const char* value) { return put(key, value, strlen(value) + 1); }
+    String getString(const char* key, const String& d = String()) {
+        std::vector<uint8_t>* v = find(key);
+        return v ? String((const char*)v->data()) : d;
+    }
+};
+
+#endif // FAKE_PREFERENCES_H
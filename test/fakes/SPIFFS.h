@@ -0,0 +1,33 @@
+/**
+ * Host SPIFFS (native tests)
+ */
+
+#ifndef FAKE_SPIFFS_H
+#define FAKE_SPIFFS_H
+
+#include "FS.h"
+
+class SPIFFSFS : public fs::FS {
+public:
+    size_t capacity = 1024 * 1024;
+
+    bool begin(bool formatOnFail = false, const char* basePath = "/spiffs",
+               uint8_t maxOpenFiles = 10, const char* label = nullptr) {
+        return true;
+    }
+    void end() {}
+    bool format() {
+        fakeFsErase();
+        return true;
+    }
+    size_t totalBytes() { return capacity; }
+    size_t usedBytes() {
+        size_t used = 0;
+        for (auto& entry : fakeFiles) used += entry.second->size();
+        return used;
+    }
+};
+
+inline SPIFFSFS SPIFFS;
+
+#endif // FAKE_SPIFFS_H
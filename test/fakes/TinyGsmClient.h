@@ -0,0 +1,63 @@
+/**
+ * Host TinyGSM (native tests)
+ * A scripted SIM800: attach takes fakeGprs.attachMs of simulated time
+ * (and fails while fakeGprs.attachFails is set); sockets connect to the
+ * server object in fakeGsmServer after fakeGprs.connectMs.
+ */
+
+#ifndef FAKE_TINY_GSM_CLIENT_H
+#define FAKE_TINY_GSM_CLIENT_H
+
+#include "Arduino.h"
+#include "Client.h"
+
+struct FakeGprs {
+    bool attached = false;
+    bool attachFails = false;
+    unsigned long attachMs = 0;
+    unsigned long connectMs = 0;
+    unsigned attaches = 0;
+    unsigned connects = 0;
+};
+
+inline FakeGprs fakeGprs;
+inline Client* fakeGsmServer = nullptr;
+
+class TinyGsm {
+public:
+    explicit TinyGsm(Stream& stream) {}
+
+    bool gprsConnect(const char* apn, const char* user = nullptr, const char* pass = nullptr) {
+        fakeGprs.attaches++;
+        delay(fakeGprs.attachMs);
+        fakeGprs.attached = !fakeGprs.attachFails;
+        return fakeGprs.attached;
+    }
+    bool gprsDisconnect() {
+        fakeGprs.attached = false;
+        return true;
+    }
+    bool isGprsConnected() { return fakeGprs.attached; }
+};
+
+class TinyGsmClient : public FakeRoutedClient {
+public:
+    TinyGsmClient() : FakeRoutedClient(&fakeGsmServer) {}
+    TinyGsmClient(TinyGsm& modem, uint8_t mux = 0) : FakeRoutedClient(&fakeGsmServer) {}
+
+    int connect(const char* host, uint16_t port) override {
+        if (!fakeGprs.attached) return 0;
+        fakeGprs.connects++;
+        delay(fakeGprs.connectMs);
+        return FakeRoutedClient::connect(host, port);
+    }
+    using FakeRoutedClient::connect;
+};
+
+class TinyGsmClientSecure : public TinyGsmClient {
+public:
+    TinyGsmClientSecure() {}
+    TinyGsmClientSecure(TinyGsm& modem, uint8_t mux = 0) : TinyGsmClient(modem, mux) {}
+};
+
+#endif // FAKE_TINY_GSM_CLIENT_H
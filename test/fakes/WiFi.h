@@ -0,0 +1,219 @@
+/**
+ * Host WiFi station (native tests)
+ * A scripted radio: begin() and scanNetworks() only record the request,
+ * and the test decides what the access point does with fakeJoin(),
+ * fakeRefuse(), fakeDrop() and fakeLease(). Each of those fires the same
+ * events the Arduino core would, on the caller's stack.
+ */
+
+#ifndef FAKE_WIFI_H
+#define FAKE_WIFI_H
+
+#include "Arduino.h"
+#include "Client.h"
+#include "WiFiClient.h"
+#include <vector>
+
+typedef enum {
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_CONNECTION_LOST = 5,
+    WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum { WIFI_OFF = 0, WIFI_STA = 1, WIFI_AP = 2, WIFI_AP_STA = 3 } wifi_mode_t;
+
+typedef enum {
+    ARDUINO_EVENT_WIFI_READY = 0,
+    ARDUINO_EVENT_WIFI_STA_START,
+    ARDUINO_EVENT_WIFI_STA_STOP,
+    ARDUINO_EVENT_WIFI_STA_CONNECTED,
+    ARDUINO_EVENT_WIFI_STA_DISCONNECTED,
+    ARDUINO_EVENT_WIFI_STA_GOT_IP,
+    ARDUINO_EVENT_WIFI_STA_LOST_IP,
+    ARDUINO_EVENT_MAX
+} arduino_event_id_t;
+
+typedef struct {
+    uint8_t ssid[33];
+    uint8_t ssid_len;
+    uint8_t bssid[6];
+    uint8_t reason;
+} wifi_event_sta_disconnected_t;
+
+typedef union {
+    wifi_event_sta_disconnected_t wifi_sta_disconnected;
+} arduino_event_info_t;
+
+typedef void (*WiFiEventFuncCb)(arduino_event_id_t event, arduino_event_info_t info);
+typedef int wifi_event_id_t;
+
+#define WIFI_SCAN_RUNNING (-1)
+#define WIFI_SCAN_FAILED (-2)
+
+struct FakeAccessPoint {
+    const char* ssid;
+    uint8_t bssid[6];
+    uint8_t channel;
+    int8_t rssi;
+};
+
+class WiFiClass {
+private:
+    struct Handler {
+        WiFiEventFuncCb cb;
+        arduino_event_id_t event;
+    };
+    std::vector<Handler> handlers;
+    std::vector<FakeAccessPoint> scanResults;
+
+    void emit(arduino_event_id_t event, uint8_t reason = 0) {
+        arduino_event_info_t info;
+        memset(&info, 0, sizeof(info));
+        info.wifi_sta_disconnected.reason = reason;
+        for (const Handler& h : handlers) {
+            if (h.event == event) h.cb(event, info);
+        }
+    }
+
+public:
+    // Radio environment, set by the test
+    std::vector<FakeAccessPoint> aps;
+    int scanPolls = 0;          // scanComplete() calls answered RUNNING before results
+    bool scanFails = false;
+    uint8_t mac[6] = { 0x24, 0x6F, 0x28, 0x00, 0x00, 0x01 };
+
+    // What the station was asked to do
+    wl_status_t state = WL_IDLE_STATUS;
+    unsigned beginCount = 0;
+    unsigned scanCount = 0;
+    unsigned disconnectCount = 0;
+    std::string beginSsid;
+    int32_t beginChannel = 0;
+    bool beginDirected = false;    // begin() named a BSSID
+    uint8_t beginBssid[6] = { 0 };
+    uint32_t staticIp = 0;         // Last config(), 0 = DHCP
+    uint32_t staticGateway = 0;
+    uint32_t staticSubnet = 0;
+    uint32_t staticDns = 0;
+    unsigned configCount = 0;
+
+    // Current association
+    FakeAccessPoint ap = {};
+    uint32_t ip = 0;
+
+    void fakeReset() { *this = WiFiClass(); }
+
+    // The access point accepts the pending begin(): associated, then an
+    // address (the static one if config() set it, else dhcpIp)
+    void fakeJoin(uint32_t dhcpIp) {
+        ap = FakeAccessPoint{};
+        for (const FakeAccessPoint& a : aps) {
+            if (beginSsid == a.ssid) {
+                ap = a;
+                break;
+            }
+        }
+        state = WL_CONNECTED;
+        ip = staticIp ? staticIp : dhcpIp;
+        emit(ARDUINO_EVENT_WIFI_STA_GOT_IP);
+    }
+    // DHCP answers while associated (lease or renewal)
+    void fakeLease(uint32_t dhcpIp) {
+        ip = dhcpIp;
+        emit(ARDUINO_EVENT_WIFI_STA_GOT_IP);
+    }
+    // The pending begin() fails, e.g. 201 no AP found, 15 bad password
+    void fakeRefuse(uint8_t reason) {
+        state = WL_DISCONNECTED;
+        emit(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, reason);
+    }
+    // An established link goes away (beacon timeout = 200)
+    void fakeDrop(uint8_t reason) {
+        state = WL_CONNECTION_LOST;
+        ip = 0;
+        emit(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, reason);
+    }
+
+    wl_status_t status() { return state; }
+    bool mode(wifi_mode_t m) { return true; }
+    bool setSleep(bool on) { return true; }
+    bool setAutoReconnect(bool on) { return true; }
+    bool persistent(bool on) { return true; }
+
+    wl_status_t begin(const char* ssid, const char* password = nullptr, int32_t channel = 0,
+                      const uint8_t* bssid = nullptr, bool connect = true) {
+        beginCount++;
+        beginSsid = ssid;
+        beginChannel = channel;
+        beginDirected = bssid != nullptr;
+        if (bssid) memcpy(beginBssid, bssid, 6);
+        state = WL_DISCONNECTED;
+        return state;
+    }
+    bool config(IPAddress local, IPAddress gateway, IPAddress subnet,
+                IPAddress dns1 = IPAddress(), IPAddress dns2 = IPAddress()) {
+        configCount++;
+        staticIp = local;
+        staticGateway = gateway;
+        staticSubnet = subnet;
+        staticDns = dns1;
+        return true;
+    }
+    bool disconnect(bool wifiOff = false, bool eraseAp = false) {
+        bool was = state == WL_CONNECTED;
+        disconnectCount++;
+        state = WL_DISCONNECTED;
+        ip = 0;
+        if (was) emit(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, 8);  // Assoc leave
+        return true;
+    }
+
+    wifi_event_id_t onEvent(WiFiEventFuncCb cb, arduino_event_id_t event = ARDUINO_EVENT_MAX) {
+        handlers.push_back({ cb, event });
+        return (wifi_event_id_t)handlers.size();
+    }
+
+    IPAddress localIP() { return IPAddress(ip); }
+    // x.y.z.1 on the station's /24
+    IPAddress gatewayIP() { return IPAddress(state == WL_CONNECTED ? (ip & 0x00FFFFFFu) | 0x01000000u : 0); }
+    IPAddress subnetMask() { return IPAddress(state == WL_CONNECTED ? 0x00FFFFFFu : 0); }
+    IPAddress dnsIP(uint8_t i = 0) { return gatewayIP(); }
+    String SSID() { return String(state == WL_CONNECTED && ap.ssid ? ap.ssid : ""); }
+    uint8_t* BSSID() { return ap.bssid; }
+    int8_t RSSI() { return state == WL_CONNECTED ? ap.rssi : 0; }
+    int32_t channel() { return ap.channel; }
+    uint8_t* macAddress(uint8_t* out) { memcpy(out, mac, 6); return out; }
+    String macAddress() {
+        char buf[18];
+        snprintf(buf, sizeof(buf), "%02X:%02X:%02X:%02X:%02X:%02X",
+                 mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+        return String(buf);
+    }
+
+    int16_t scanNetworks(bool async = false, bool hidden = false, bool passive = false,
+                         uint32_t msPerChannel = 300) {
+        scanCount++;
+        if (scanFails) return WIFI_SCAN_FAILED;
+        scanResults = aps;
+        return async ? WIFI_SCAN_RUNNING : (int16_t)scanResults.size();
+    }
+    int16_t scanComplete() {
+        if (scanPolls > 0) {
+            scanPolls--;
+            return WIFI_SCAN_RUNNING;
+        }
+        return (int16_t)scanResults.size();
+    }
+    void scanDelete() { scanResults.clear(); }
+    String SSID(uint8_t i) { return String(i < scanResults.size() ? scanResults[i].ssid : ""); }
+    int32_t RSSI(uint8_t i) { return i < scanResults.size() ? scanResults[i].rssi : 0; }
+    uint8_t* BSSID(uint8_t i) { return i < scanResults.size() ? scanResults[i].bssid : nullptr; }
+    int32_t channel(uint8_t i) { return i < scanResults.size() ? scanResults[i].channel : 0; }
+};
+
+inline WiFiClass WiFi;
+
+#endif // FAKE_WIFI_H
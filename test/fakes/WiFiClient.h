@@ -0,0 +1,20 @@
+/**
+ * Host WiFiClient (native tests)
+ * Connects to the server object in fakeWiFiServer, if any.
+ */
+
+#ifndef FAKE_WIFI_CLIENT_H
+#define FAKE_WIFI_CLIENT_H
+
+#include "Client.h"
+
+inline Client* fakeWiFiServer = nullptr;
+
+class WiFiClient : public FakeRoutedClient {
+public:
+    WiFiClient() : FakeRoutedClient(&fakeWiFiServer) {}
+    int setNoDelay(bool on) { return 0; }
+    int setTimeout(uint32_t seconds) { return 0; }
+};
+
+#endif // FAKE_WIFI_CLIENT_H
@@ -0,0 +1,17 @@
+/**
+ * Host WiFiClientSecure (native tests)
+ */
+
+#ifndef FAKE_WIFI_CLIENT_SECURE_H
+#define FAKE_WIFI_CLIENT_SECURE_H
+
+#include "WiFiClient.h"
+
+class WiFiClientSecure : public WiFiClient {
+public:
+    void setInsecure() {}
+    void setCACert(const char* cert) {}
+    void setHandshakeTimeout(unsigned long seconds) {}
+};
+
+#endif // FAKE_WIFI_CLIENT_SECURE_H
@@ -0,0 +1,24 @@
+/**
+ * Host camera driver types (native tests): frame buffers only
+ */
+
+#ifndef FAKE_ESP_CAMERA_H
+#define FAKE_ESP_CAMERA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/time.h>
+#include "esp_system.h"
+
+typedef enum { PIXFORMAT_JPEG = 4 } pixformat_t;
+
+typedef struct {
+    uint8_t* buf;
+    size_t len;
+    size_t width;
+    size_t height;
+    pixformat_t format;
+    struct timeval timestamp;
+} camera_fb_t;
+
+#endif // FAKE_ESP_CAMERA_H
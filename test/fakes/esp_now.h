@@ -0,0 +1,93 @@
+/**
+ * Host ESP-NOW (native tests)
+ * Sends are captured in fakeEspNowSent instead of going on air; a test
+ * plays the peer by calling fakeEspNowDeliver() with the frames it wants
+ * the firmware to receive. fakeEspNowSendResult makes sends fail.
+ */
+
+#ifndef FAKE_ESP_NOW_H
+#define FAKE_ESP_NOW_H
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include "esp_system.h"
+
+#define ESP_NOW_ETH_ALEN 6
+#define ESP_NOW_MAX_DATA_LEN 250
+
+typedef enum {
+    ESP_NOW_SEND_SUCCESS = 0,
+    ESP_NOW_SEND_FAIL
+} esp_now_send_status_t;
+
+typedef struct {
+    uint8_t peer_addr[ESP_NOW_ETH_ALEN];
+    uint8_t lmk[16];
+    uint8_t channel;
+    int ifidx;
+    bool encrypt;
+    void* priv;
+} esp_now_peer_info_t;
+
+typedef void (*esp_now_send_cb_t)(const uint8_t* mac, esp_now_send_status_t status);
+typedef void (*esp_now_recv_cb_t)(const uint8_t* mac, const uint8_t* data, int len);
+
+struct FakeEspNowFrame {
+    uint8_t mac[ESP_NOW_ETH_ALEN];
+    std::vector<uint8_t> data;
+};
+
+inline std::vector<FakeEspNowFrame> fakeEspNowSent;
+inline esp_err_t fakeEspNowSendResult = ESP_OK;
+inline esp_now_send_cb_t fakeEspNowSendCb = nullptr;
+inline esp_now_recv_cb_t fakeEspNowRecvCb = nullptr;
+inline std::vector<FakeEspNowFrame> fakeEspNowPeers;
+
+inline esp_err_t esp_now_init() { return ESP_OK; }
+inline esp_err_t esp_now_deinit() { return ESP_OK; }
+inline esp_err_t esp_now_register_send_cb(esp_now_send_cb_t cb) { fakeEspNowSendCb = cb; return ESP_OK; }
+inline esp_err_t esp_now_register_recv_cb(esp_now_recv_cb_t cb) { fakeEspNowRecvCb = cb; return ESP_OK; }
+
+inline bool esp_now_is_peer_exist(const uint8_t* mac) {
+    for (const FakeEspNowFrame& p : fakeEspNowPeers) {
+        if (memcmp(p.mac, mac, ESP_NOW_ETH_ALEN) == 0) return true;
+    }
+    return false;
+}
+
+inline esp_err_t esp_now_add_peer(const esp_now_peer_info_t* peer) {
+    if (!esp_now_is_peer_exist(peer->peer_addr)) {
+        FakeEspNowFrame p;
+        memcpy(p.mac, peer->peer_addr, ESP_NOW_ETH_ALEN);
+        fakeEspNowPeers.push_back(p);
+    }
+    return ESP_OK;
+}
+
+inline esp_err_t esp_now_send(const uint8_t* mac, const uint8_t* data, size_t len) {
+    if (fakeEspNowSendResult != ESP_OK) return fakeEspNowSendResult;
+    FakeEspNowFrame f;
+    memcpy(f.mac, mac, ESP_NOW_ETH_ALEN);
+    f.data.assign(data, data + len);
+    fakeEspNowSent.push_back(f);
+    return ESP_OK;
+}
+
+// Radio-task side of the fake: a frame from the peer, or a send outcome
+inline void fakeEspNowDeliver(const uint8_t* mac, const uint8_t* data, size_t len) {
+    if (fakeEspNowRecvCb) fakeEspNowRecvCb(mac, data, (int)len);
+}
+inline void fakeEspNowSendDone(const uint8_t* mac, bool delivered) {
+    if (fakeEspNowSendCb) fakeEspNowSendCb(mac, delivered ? ESP_NOW_SEND_SUCCESS : ESP_NOW_SEND_FAIL);
+}
+
+inline void fakeEspNowReset() {
+    fakeEspNowSent.clear();
+    fakeEspNowPeers.clear();
+    fakeEspNowSendResult = ESP_OK;
+    fakeEspNowSendCb = nullptr;
+    fakeEspNowRecvCb = nullptr;
+}
+
+#endif // FAKE_ESP_NOW_H
@@ -0,0 +1,25 @@
+/**
+ * Host ESP-IDF system calls (native tests)
+ */
+
+#ifndef FAKE_ESP_SYSTEM_H
+#define FAKE_ESP_SYSTEM_H
+
+#include <stdint.h>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+
+// Deterministic LCG so backoff jitter repeats run to run
+inline uint32_t fakeRandomState = 12345;
+
+inline uint32_t esp_random(void) {
+    fakeRandomState = fakeRandomState * 1664525u + 1013904223u;
+    return fakeRandomState;
+}
+
+inline uint32_t esp_get_free_heap_size(void) { return 200000; }
+inline void esp_restart(void) {}
+
+#endif // FAKE_ESP_SYSTEM_H
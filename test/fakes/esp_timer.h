@@ -0,0 +1,12 @@
+/**
+ * Host esp_timer (native tests): the simulated clock from Arduino.h
+ */
+
+#ifndef FAKE_ESP_TIMER_H
+#define FAKE_ESP_TIMER_H
+
+#include "Arduino.h"
+
+inline int64_t esp_timer_get_time(void) { return (int64_t)fakeNowUs; }
+
+#endif // FAKE_ESP_TIMER_H
@@ -0,0 +1,23 @@
+/**
+ * Simulated time for native tests
+ *
+ * Time only moves when a test (or the code under test) calls delay(),
+ * vTaskDelay(), a blocking FreeRTOS wait or fakeAdvance(), so timeouts
+ * run in simulated time and every suite is deterministic.
+ */
+
+#ifndef FAKE_CLOCK_H
+#define FAKE_CLOCK_H
+
+#include <stdint.h>
+
+inline uint64_t fakeNowUs = 0;
+
+inline void fakeAdvance(unsigned long ms) { fakeNowUs += (uint64_t)ms * 1000; }
+inline void fakeAdvanceUs(unsigned long us) { fakeNowUs += us; }
+inline void fakeResetClock(unsigned long ms = 1000) { fakeNowUs = (uint64_t)ms * 1000; }
+
+inline unsigned long millis() { return (unsigned long)(fakeNowUs / 1000); }
+inline unsigned long micros() { return (unsigned long)fakeNowUs; }
+
+#endif // FAKE_CLOCK_H
@@ -0,0 +1,197 @@
+/**
+ * Host HTTP Server (native tests)
+ * The far end of a Client: install it as fakeWiFiServer or fakeGsmServer
+ * and it parses each request (Content-Length bodies only) and answers
+ * through handler, all on the caller's stack.
+ *
+ * Faults are scripted per connection: refuse connects, accept only
+ * maxWrite bytes per write(), go silent or drop after some bytes, or
+ * close an idle kept-alive connection with closeIdle(), or vanish() it
+ * so the client still thinks it is open.
+ */
+
+#ifndef FAKE_HTTP_SERVER_H
+#define FAKE_HTTP_SERVER_H
+
+#include "Arduino.h"
+#include "Client.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+struct FakeHttpRequest {
+    std::string method;
+    std::string path;
+    std::string head;        // Request line and headers, as sent
+    std::string body;
+    unsigned connection;     // 1 = first connection
+
+    // Value of a header, "" if absent
+    std::string header(const char* name) const {
+        std::string key = std::string("\r\n") + name + ":";
+        size_t n = key.size();
+        for (size_t i = 0; i + n <= head.size(); i++) {
+            if (strncasecmp(head.c_str() + i, key.c_str(), n) == 0) {
+                size_t start = head.find_first_not_of(' ', i + n);
+                return head.substr(start, head.find("\r\n", start) - start);
+            }
+        }
+        return "";
+    }
+};
+
+struct FakeHttpReply {
+    int status = 200;
+    std::string headers;     // Extra "Name: value\r\n" lines
+    std::string body;
+    bool close = false;      // Connection: close
+    bool silent = false;     // No answer at all (reply lost)
+};
+
+class FakeHttpServer : public Client {
+public:
+    typedef std::function<FakeHttpReply(const FakeHttpRequest& request)> Handler;
+
+    Handler handler;                 // Default: 200, empty body
+    bool refuseConnect = false;
+    bool answerContinue = true;      // 100 Continue to "Expect: 100-continue"
+    size_t maxWrite = 0;             // Bytes taken per write(), 0 = all
+    long dropAfterBytes = -1;        // Connection dies after this many more bytes in
+
+    std::vector<FakeHttpRequest> requests;
+    std::vector<size_t> writeSizes;  // Every write() the client made
+    unsigned connections = 0;
+
+    void closeIdle() { open = false; }
+    // The peer is gone but no close reached the client: connected()
+    // stays true and whatever is written disappears
+    void vanish() {
+        open = false;
+        vanished = true;
+    }
+    bool isOpen() const { return open; }
+
+    int connect(IPAddress ip, uint16_t port) override { return connect(ip.toString().c_str(), port); }
+    int connect(const char* host, uint16_t port) override {
+        if (refuseConnect) {
+            return 0;
+        }
+        connections++;
+        open = true;
+        vanished = false;
+        in.clear();
+        out.clear();
+        outPos = 0;
+        headLen = 0;
+        continued = false;
+        return 1;
+    }
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buf, size_t size) override {
+        if (vanished) {
+            return size;
+        }
+        if (!open) {
+            return 0;
+        }
+        if (maxWrite && size > maxWrite) {
+            size = maxWrite;
+        }
+        if (dropAfterBytes >= 0) {
+            if ((long)size >= dropAfterBytes) {
+                size = dropAfterBytes;
+                dropAfterBytes = -1;
+                open = false;
+                out.clear();
+                return size;  // Taken, never arrives
+            }
+            dropAfterBytes -= size;
+        }
+        writeSizes.push_back(size);
+        in.append((const char*)buf, size);
+        parse();
+        return size;
+    }
+
+    int available() override { return (int)(out.size() - outPos); }
+    int read() override { return outPos < out.size() ? (uint8_t)out[outPos++] : -1; }
+    int read(uint8_t* buf, size_t size) override {
+        size_t n = out.size() - outPos;
+        n = n < size ? n : size;
+        memcpy(buf, out.data() + outPos, n);
+        outPos += n;
+        return n ? (int)n : -1;
+    }
+    int peek() override { return outPos < out.size() ? (uint8_t)out[outPos] : -1; }
+    void stop() override { open = vanished = false; }
+    uint8_t connected() override { return open || vanished; }
+    using Print::write;
+
+private:
+    bool open = false;
+    bool vanished = false;
+    std::string in;
+    std::string out;
+    size_t outPos = 0;
+    size_t headLen = 0;      // > 0 once the current request's head is in
+    size_t bodyLen = 0;
+    bool continued = false;
+
+    void send(const std::string& text) {
+        out.erase(0, outPos);
+        outPos = 0;
+        out += text;
+    }
+
+    void parse() {
+        while (open) {
+            if (headLen == 0) {
+                size_t end = in.find("\r\n\r\n");
+                if (end == std::string::npos) {
+                    return;
+                }
+                headLen = end + 4;
+                FakeHttpRequest probe;
+                probe.head = in.substr(0, headLen);
+                bodyLen = atol(probe.header("Content-Length").c_str());
+                if (answerContinue && bodyLen > 0 && !continued &&
+                    strcasecmp(probe.header("Expect").c_str(), "100-continue") == 0) {
+                    continued = true;
+                    send("HTTP/1.1 100 Continue\r\n\r\n");
+                }
+            }
+            if (in.size() < headLen + bodyLen) {
+                return;
+            }
+
+            FakeHttpRequest r;
+            r.head = in.substr(0, headLen);
+            r.body = in.substr(headLen, bodyLen);
+            r.method = r.head.substr(0, r.head.find(' '));
+            size_t p = r.method.size() + 1;
+            r.path = r.head.substr(p, r.head.find(' ', p) - p);
+            r.connection = connections;
+            in.erase(0, headLen + bodyLen);
+            headLen = 0;
+            continued = false;
+            requests.push_back(r);
+
+            FakeHttpReply reply = handler ? handler(r) : FakeHttpReply();
+            if (reply.silent) {
+                continue;
+            }
+            char line[96];
+            snprintf(line, sizeof(line), "HTTP/1.1 %d X\r\nContent-Length: %u\r\n",
+                     reply.status, (unsigned)reply.body.size());
+            send(line + reply.headers + (reply.close ? "Connection: close\r\n" : "") +
+                 "\r\n" + (r.method == "HEAD" ? "" : reply.body));
+            if (reply.close) {
+                // Whatever was sent can still be read
+                open = false;
+            }
+        }
+    }
+};
+
+#endif // FAKE_HTTP_SERVER_H
@@ -0,0 +1,56 @@
+/**
+ * Host FreeRTOS (native tests)
+ * Single-threaded: critical sections are no-ops, and a call that would
+ * block runs fakeBlockHook (tests deliver radio frames or UART bytes
+ * there) and then spends its timeout on the simulated clock.
+ */
+
+#ifndef FAKE_FREERTOS_H
+#define FAKE_FREERTOS_H
+
+#include <stdint.h>
+#include "../fake_clock.h"
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint8_t StackType_t;
+
+struct FakeTask;
+struct FakeQueue;
+typedef FakeTask* TaskHandle_t;
+typedef FakeQueue* QueueHandle_t;
+typedef FakeQueue* SemaphoreHandle_t;
+
+typedef struct { char reserved[96]; } StaticTask_t;
+typedef struct { char reserved[96]; } StaticQueue_t;
+typedef StaticQueue_t StaticSemaphore_t;
+
+typedef struct { int owner; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED { 0 }
+
+#define portMAX_DELAY 0xffffffffu
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdFAIL 0
+#define tskIDLE_PRIORITY 0
+#define tskNO_AFFINITY 0x7fffffff
+
+inline void portENTER_CRITICAL(portMUX_TYPE* mux) {}
+inline void portEXIT_CRITICAL(portMUX_TYPE* mux) {}
+inline void portENTER_CRITICAL_ISR(portMUX_TYPE* mux) {}
+inline void portEXIT_CRITICAL_ISR(portMUX_TYPE* mux) {}
+#define portYIELD_FROM_ISR(...) do {} while (0)
+
+inline void (*fakeBlockHook)() = nullptr;
+
+// A blocking wait that found nothing: let the test act, then move time
+inline void fakeBlock(TickType_t ticks) {
+    if (fakeBlockHook) fakeBlockHook();
+    fakeAdvance(ticks == portMAX_DELAY ? 1000 : ticks);
+}
+
+#endif // FAKE_FREERTOS_H
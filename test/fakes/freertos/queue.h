@@ -0,0 +1,72 @@
+/**
+ * Host FreeRTOS queues and semaphores (native tests)
+ */
+
+#ifndef FAKE_FREERTOS_QUEUE_H
+#define FAKE_FREERTOS_QUEUE_H
+
+#include "FreeRTOS.h"
+#include <string.h>
+#include <deque>
+#include <vector>
+
+struct FakeQueue {
+    UBaseType_t length;
+    UBaseType_t itemSize;
+    std::deque<std::vector<uint8_t>> items;
+};
+
+inline QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+    return new FakeQueue{ length, itemSize, {} };
+}
+
+inline QueueHandle_t xQueueCreateStatic(UBaseType_t length, UBaseType_t itemSize,
+                                        uint8_t* storage, StaticQueue_t* buffer) {
+    return xQueueCreate(length, itemSize);
+}
+
+inline BaseType_t fakeQueuePut(QueueHandle_t q, const void* item, bool front) {
+    if (q->items.size() >= q->length) return pdFALSE;
+    std::vector<uint8_t> data(q->itemSize);
+    if (q->itemSize) memcpy(data.data(), item, q->itemSize);
+    if (front) q->items.push_front(data);
+    else q->items.push_back(data);
+    return pdTRUE;
+}
+
+inline BaseType_t xQueueSend(QueueHandle_t q, const void* item, TickType_t ticks) {
+    return fakeQueuePut(q, item, false);
+}
+inline BaseType_t xQueueSendToBack(QueueHandle_t q, const void* item, TickType_t ticks) {
+    return fakeQueuePut(q, item, false);
+}
+inline BaseType_t xQueueSendToFront(QueueHandle_t q, const void* item, TickType_t ticks) {
+    return fakeQueuePut(q, item, true);
+}
+inline BaseType_t xQueueSendFromISR(QueueHandle_t q, const void* item, BaseType_t* woken) {
+    return fakeQueuePut(q, item, false);
+}
+inline BaseType_t xQueueOverwrite(QueueHandle_t q, const void* item) {
+    q->items.clear();
+    return fakeQueuePut(q, item, false);
+}
+
+inline BaseType_t xQueueReceive(QueueHandle_t q, void* out, TickType_t ticks) {
+    if (q->items.empty() && ticks > 0) fakeBlock(ticks);
+    if (q->items.empty()) return pdFALSE;
+    if (q->itemSize) memcpy(out, q->items.front().data(), q->itemSize);
+    q->items.pop_front();
+    return pdTRUE;
+}
+
+inline BaseType_t xQueuePeek(QueueHandle_t q, void* out, TickType_t ticks) {
+    if (q->items.empty()) return pdFALSE;
+    if (q->itemSize) memcpy(out, q->items.front().data(), q->itemSize);
+    return pdTRUE;
+}
+
+inline UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q) { return q->items.size(); }
+inline UBaseType_t uxQueueSpacesAvailable(QueueHandle_t q) { return q->length - q->items.size(); }
+inline void xQueueReset(QueueHandle_t q) { q->items.clear(); }
+
+#endif // FAKE_FREERTOS_QUEUE_H
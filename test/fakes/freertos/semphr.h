@@ -0,0 +1,23 @@
+/**
+ * Host FreeRTOS semaphores (native tests): one-slot queues
+ */
+
+#ifndef FAKE_FREERTOS_SEMPHR_H
+#define FAKE_FREERTOS_SEMPHR_H
+
+#include "queue.h"
+
+inline SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t* buffer) {
+    SemaphoreHandle_t s = xQueueCreate(1, 0);
+    fakeQueuePut(s, nullptr, false);  // Mutexes start available
+    return s;
+}
+inline SemaphoreHandle_t xSemaphoreCreateMutex() { return xSemaphoreCreateMutexStatic(nullptr); }
+inline SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t* buffer) { return xQueueCreate(1, 0); }
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t ticks) {
+    return xQueueReceive(s, nullptr, ticks);
+}
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t s) { return fakeQueuePut(s, nullptr, false); }
+
+#endif // FAKE_FREERTOS_SEMPHR_H
@@ -0,0 +1,100 @@
+/**
+ * Host FreeRTOS tasks (native tests)
+ * Tasks are never started; direct-to-task notifications are kept per
+ * handle so code that waits on them can be driven from a test.
+ */
+
+#ifndef FAKE_FREERTOS_TASK_H
+#define FAKE_FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void*);
+
+enum eNotifyAction { eNoAction = 0, eSetBits, eIncrement, eSetValueWithOverwrite, eSetValueWithoutOverwrite };
+
+struct FakeTask {
+    uint32_t value;
+    bool pending;
+};
+
+inline FakeTask fakeCurrentTask = { 0, false };
+
+inline TaskHandle_t xTaskGetCurrentTaskHandle() { return &fakeCurrentTask; }
+
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stack,
+                                          void* param, UBaseType_t priority,
+                                          TaskHandle_t* handle, BaseType_t core) {
+    if (handle) *handle = new FakeTask{ 0, false };
+    return pdPASS;
+}
+
+inline TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t fn, const char* name, uint32_t stack,
+                                                  void* param, UBaseType_t priority,
+                                                  StackType_t* stackBuf, StaticTask_t* taskBuf,
+                                                  BaseType_t core) {
+    return new FakeTask{ 0, false };
+}
+
+inline void vTaskDelay(TickType_t ticks) {
+    if (fakeBlockHook) fakeBlockHook();
+    fakeAdvance(ticks);
+}
+
+inline TickType_t xTaskGetTickCount() {
+    return (TickType_t)millis();
+}
+
+inline void vTaskDelayUntil(TickType_t* previousWake, TickType_t period) {
+    TickType_t now = xTaskGetTickCount();
+    *previousWake += period;
+    if ((int32_t)(*previousWake - now) > 0) vTaskDelay(*previousWake - now);
+}
+
+inline BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action) {
+    if (!task) return pdFAIL;
+    switch (action) {
+        case eSetBits: task->value |= value; break;
+        case eIncrement: task->value++; break;
+        case eSetValueWithOverwrite: task->value = value; break;
+        case eSetValueWithoutOverwrite:
+            if (task->pending) return pdFAIL;
+            task->value = value;
+            break;
+        default: break;
+    }
+    task->pending = true;
+    return pdPASS;
+}
+
+inline BaseType_t xTaskNotifyWait(uint32_t clearOnEntry, uint32_t clearOnExit,
+                                  uint32_t* value, TickType_t ticks) {
+    FakeTask* self = &fakeCurrentTask;
+    if (!self->pending) {
+        self->value &= ~clearOnEntry;
+        if (ticks == 0) return pdFALSE;
+        // Whatever the test delivers from the hook arrives "during" the wait
+        if (fakeBlockHook) fakeBlockHook();
+        if (!self->pending) {
+            fakeAdvance(ticks == portMAX_DELAY ? 1000 : ticks);
+            return pdFALSE;
+        }
+    }
+    if (value) *value = self->value;
+    self->value &= ~clearOnExit;
+    self->pending = false;
+    return pdTRUE;
+}
+
+inline BaseType_t xTaskNotifyGive(TaskHandle_t task) { return xTaskNotify(task, 0, eIncrement); }
+
+inline uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) {
+    uint32_t value = 0;
+    if (xTaskNotifyWait(0, 0, &value, ticks) != pdTRUE) return 0;
+    fakeCurrentTask.value = clearOnExit ? 0 : value - 1;
+    return value;
+}
+
+inline UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) { return 1024; }
+
+#endif // FAKE_FREERTOS_TASK_H
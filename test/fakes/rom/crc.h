@@ -0,0 +1,22 @@
+/**
+ * Host ROM CRC (native tests): the same CRC-32 as the ESP32 ROM
+ */
+
+#ifndef FAKE_ROM_CRC_H
+#define FAKE_ROM_CRC_H
+
+#include <stdint.h>
+
+// Reflected 0xEDB88320, crc passed in and returned non-inverted
+static inline uint32_t crc32_le(uint32_t crc, const uint8_t* buf, uint32_t len) {
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= buf[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+#endif // FAKE_ROM_CRC_H
@@ -0,0 +1,122 @@
+"""
+Latency report from exported trace batches.
+
+Reads the bodies the firmwares POST to /api/v1/burglary/trace/batch, one
+JSON object per line or a JSON array of them, and prints per-stage
+latency percentiles measured from the first PIR edge of each incident.
+
+    python tools/trace_report.py traces.jsonl [more.jsonl ...]
+    cat traces.jsonl | python tools/trace_report.py -
+"""
+
+import json
+import sys
+from collections import defaultdict
+
+# Pipeline order, as named by Tracer::pointName()
+POINTS = [
+    "pir_edge",
+    "detection",
+    "espnow_send",
+    "espnow_recv",
+    "espnow_ack",
+    "shutter",
+    "jpeg_ready",
+    "upload_start",
+    "upload_end",
+    "sms_prompt",
+    "sms_confirm",
+    "backend_2xx",
+]
+
+# Points recorded on the camera; unusable from a batch sent before the
+# camera had a clock offset
+CAM_POINTS = {"espnow_recv", "shutter", "jpeg_ready", "upload_start", "upload_end"}
+
+
+def load_batches(paths):
+    for path in paths:
+        stream = sys.stdin if path == "-" else open(path, encoding="utf-8")
+        with stream:
+            text = stream.read().strip()
+        if not text:
+            continue
+        if text.startswith("["):
+            yield from json.loads(text)
+            continue
+        for line in text.splitlines():
+            line = line.strip()
+            if line:
+                yield json.loads(line)
+
+
+def collect(batches):
+    """incident -> point -> earliest time (main controller ms)"""
+    incidents = defaultdict(dict)
+    dropped = {}  # Per device; the on-device counter only grows
+    skipped = 0
+    for batch in batches:
+        device = batch.get("device_id", "")
+        dropped[device] = max(dropped.get(device, 0), batch.get("dropped", 0))
+        synced = batch.get("clock_synced", True)
+        for incident, point, t in batch.get("spans", []):
+            if point in CAM_POINTS and not synced:
+                skipped += 1
+                continue
+            seen = incidents[incident].get(point)
+            if seen is None or t < seen:
+                incidents[incident][point] = t
+    return incidents, sum(dropped.values()), skipped
+
+
+def percentile(values, p):
+    if not values:
+        return None
+    k = (len(values) - 1) * p / 100.0
+    lo = int(k)
+    hi = min(lo + 1, len(values) - 1)
+    return values[lo] + (values[hi] - values[lo]) * (k - lo)
+
+
+def report(incidents):
+    latencies = defaultdict(list)
+    for points in incidents.values():
+        start = points.get("pir_edge", points.get("detection"))
+        if start is None:
+            continue
+        for point, t in points.items():
+            delta = t - start
+            # Negative means a clock offset from another boot; drop it
+            if delta >= 0:
+                latencies[point].append(delta)
+
+    print(f"{'stage':<14}{'n':>6}{'p50':>9}{'p90':>9}{'p99':>9}{'max':>9}   (ms from pir_edge)")
+    for point in POINTS:
+        values = sorted(latencies.get(point, []))
+        if not values:
+            continue
+        cols = [percentile(values, p) for p in (50, 90, 99)] + [values[-1]]
+        print(f"{point:<14}{len(values):>6}" + "".join(f"{v:>9.0f}" for v in cols))
+
+    end_to_end = sorted(latencies.get("upload_end", []))
+    if end_to_end:
+        print(
+            f"\nPIR edge -> image uploaded: p50 {percentile(end_to_end, 50):.0f} ms, "
+            f"p99 {percentile(end_to_end, 99):.0f} ms over {len(end_to_end)} incidents"
+        )
+
+
+def main():
+    paths = sys.argv[1:] or ["-"]
+    incidents, dropped, skipped = collect(load_batches(paths))
+    print(f"{len(incidents)} incidents")
+    if dropped:
+        print(f"{dropped} records overwritten on-device before export")
+    if skipped:
+        print(f"{skipped} camera records skipped (clock not synced)")
+    print()
+    report(incidents)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,209 @@
+"""
+Reference server for the camera's image uploads, with an optional lossy link.
+
+Implements the single-request multipart upload, the batch upload and the
+resumable upload protocol (docs/ESP32_CAM_FIRMWARE.md) under
+/api/v1/burglary, and answers
+every other POST (heartbeats, traces) with 201. Completed images are
+written to the output directory. Plain HTTP only: point the camera's
+BACKEND_URL at http://<this host>:<port>/api/v1/burglary/image/image.
+
+    python tools/upload_server.py --port 8000 --out uploads
+    python tools/upload_server.py --drop-rate 0.3   # cut 30% of chunk PUTs
+    python tools/upload_server.py --busy-rate 0.5   # 503 half the large requests
+
+With --drop-rate, a dropped PUT reads half of the chunk, then closes the
+connection without a reply, like a WiFi link lost mid-transfer. Nothing
+from that chunk is committed, so the camera must resume from the last
+committed offset. The log shows each drop and, per image, how many bytes
+had to be sent again; without resuming it would be the whole image each
+time.
+
+With --busy-rate, requests that carry "Expect: 100-continue" are turned
+away with 503 before their body is read, like a backend that is cold
+or overloaded. The log shows the body bytes that never had to be sent;
+the camera's log shows its image retries backing off.
+"""
+
+import argparse
+import hashlib
+import json
+import os
+import random
+import re
+import uuid
+import zlib
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+API = "/api/v1/burglary"
+SESSION_RE = re.compile(r"^" + API + r"/image/upload/([0-9a-f]{32})(/complete)?$")
+HASH_RE = re.compile(r"^" + API + r"/image/by-hash/([0-9a-f]{64})$")
+RANGE_RE = re.compile(r"^bytes (\d+)-(\d+)/(\d+)$")
+
+sessions = {}
+stored = set()  # SHA-256 (hex) of every image saved
+options = None
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"  # Keep-alive, as the firmware expects
+
+    def reply(self, status, headers=None, body=b""):
+        self.send_response(status)
+        for name, value in (headers or {}).items():
+            self.send_header(name, str(value))
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        if self.command != "HEAD":
+            self.wfile.write(body)
+
+    def handle_expect_100(self):
+        if random.random() < options.busy_rate:
+            self.log_message("503 to %s %s before %s body bytes", self.command, self.path,
+                             self.headers.get("Content-Length", "?"))
+            self.close_connection = True  # The body was never read
+            self.reply(503, {"Retry-After": 30})
+            return False
+        return super().handle_expect_100()
+
+    def read_body(self):
+        return self.rfile.read(int(self.headers.get("Content-Length", 0)))
+
+    def do_HEAD(self):
+        by_hash = HASH_RE.match(self.path)
+        if by_hash:
+            self.reply(200 if by_hash.group(1) in stored else 404)
+            return
+        match = SESSION_RE.match(self.path)
+        session = sessions.get(match.group(1)) if match and not match.group(2) else None
+        if session is None:
+            self.reply(404)
+            return
+        self.reply(200, {"Upload-Offset": len(session["data"])})
+
+    def do_PUT(self):
+        match = SESSION_RE.match(self.path)
+        session = sessions.get(match.group(1)) if match and not match.group(2) else None
+        if session is None:
+            self.read_body()
+            self.reply(404)
+            return
+
+        length = int(self.headers.get("Content-Length", 0))
+        if random.random() < options.drop_rate:
+            self.rfile.read(length // 2)
+            session["lost"] += length
+            self.log_message("dropping PUT %s at %d", match.group(1)[:8], len(session["data"]))
+            self.close_connection = True
+            self.connection.close()
+            return
+
+        chunk = self.rfile.read(length)
+        committed = len(session["data"])
+        offset = {"Upload-Offset": committed}
+        range_match = RANGE_RE.match(self.headers.get("Content-Range", ""))
+        if not range_match:
+            self.reply(400, offset)
+            return
+        first, last, total = (int(g) for g in range_match.groups())
+        if first != committed or total != session["size"] or last - first + 1 != len(chunk):
+            self.reply(409, offset)
+            return
+        if int(self.headers.get("X-Content-CRC32", "0"), 16) != zlib.crc32(chunk):
+            self.reply(400, offset)
+            return
+
+        session["data"] += chunk
+        self.reply(204, {"Upload-Offset": len(session["data"])})
+
+    def do_POST(self):
+        body = self.read_body()
+        match = SESSION_RE.match(self.path)
+
+        if self.path == API + "/image/upload":
+            meta = json.loads(body)
+            sid = uuid.uuid4().hex
+            sessions[sid] = {"meta": meta, "size": int(meta["size"]), "data": b"",
+                             "lost": 0}
+            self.reply(201, {"Location": "%s/image/upload/%s" % (API, sid)})
+        elif match and match.group(2):
+            session = sessions.get(match.group(1))
+            if session is None:
+                self.reply(404)
+                return
+            data = session["data"]
+            if len(data) != session["size"] or \
+                    "%08X" % zlib.crc32(data) != session["meta"]["crc32"].upper():
+                del sessions[match.group(1)]
+                self.reply(422)
+                return
+            name = save(data, session["meta"].get("timestamp"), session["meta"].get("incident_id"))
+            self.log_message("resumable %s complete: %d bytes, %d more sent for dropped chunks",
+                             name, len(data), session["lost"])
+            del sessions[match.group(1)]
+            self.reply(201)
+        elif self.path == API + "/image/image":
+            files = multipart_parts(self.headers.get("Content-Type", ""), body).get("file")
+            if not files:
+                self.reply(400)
+                return
+            if self.headers.get("Idempotency-Key") in stored:
+                self.log_message("multipart duplicate of %s ignored", self.headers["Idempotency-Key"][:16])
+                self.reply(200)
+                return
+            self.log_message("multipart %s: %d bytes", save(files[0], None, None), len(files[0]))
+            self.reply(201)
+        elif self.path == API + "/image/batch":
+            parts = multipart_parts(self.headers.get("Content-Type", ""), body)
+            manifest = json.loads(parts.get("manifest", [b"[]"])[0])
+            files = parts.get("files", [])
+            results = []
+            for entry, data in zip(manifest, files):
+                save(data, entry.get("timestamp"), entry.get("incident_id"))
+                results.append(201)
+            self.log_message("batch: %d images, %d bytes", len(results), len(body))
+            self.reply(200, {"Content-Type": "application/json"},
+                       json.dumps({"results": results}).encode())
+        else:
+            self.reply(201, {"Content-Type": "application/json"}, b"{}")
+
+
+def multipart_parts(content_type, body):
+    """Part data by field name, in body order."""
+    parts = {}
+    match = re.search(r"boundary=([^;]+)", content_type)
+    if not match:
+        return parts
+    for part in body.split(b"--" + match.group(1).encode()):
+        head, _, data = part.partition(b"\r\n\r\n")
+        name = re.search(rb'name="([^"]+)"', head)
+        if name:
+            data = data[:-2] if data.endswith(b"\r\n") else data
+            parts.setdefault(name.group(1).decode(), []).append(data)
+    return parts
+
+
+def save(data, timestamp, incident):
+    stored.add(hashlib.sha256(data).hexdigest())
+    name = "%s_%s.jpg" % (timestamp or "upload", incident or uuid.uuid4().hex[:8])
+    with open(os.path.join(options.out, name), "wb") as f:
+        f.write(data)
+    return name
+
+
+def main():
+    global options
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[1])
+    parser.add_argument("--port", type=int, default=8000)
+    parser.add_argument("--out", default="uploads")
+    parser.add_argument("--drop-rate", type=float, default=0.0,
+                        help="fraction of chunk PUTs cut off mid-body")
+    parser.add_argument("--busy-rate", type=float, default=0.0,
+                        help="fraction of Expect: 100-continue requests answered 503")
+    options = parser.parse_args()
+    os.makedirs(options.out, exist_ok=True)
+    ThreadingHTTPServer(("", options.port), Handler).serve_forever()
+
+
+if __name__ == "__main__":
+    main()